@@ -0,0 +1,35 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+# Runs a persistent analysis server on a Unix domain socket (see lib/analysis_server.rb):
+#
+#   ruby analysis_server.rb [socket_path] [threads]
+
+Dir.chdir(File.dirname(File.expand_path(__FILE__)))
+require './initialize.rb'
+
+server = Chess::AnalysisServer.new(ARGV[0] || Chess::AnalysisServer::DEFAULT_PATH, 
+                                   (ARGV[1] || Chess::AnalysisServer::THREADS).to_i)
+trap('INT') { Thread.new { server.stop } }
+trap('TERM') { Thread.new { server.stop } }
+puts "Listening on #{server.path}"
+$stdout.flush
+server.run
@@ -21,7 +21,11 @@
 
 #include "attack.h"
 
+// Each of the attack queries below is answered from the board's attack map when it keeps one (see Incremental 
+// attack maps, further down), and otherwise by scanning outward from the square.
+
 BB attack_map(BRD *cBoard, enumSq sq){
+  if(cBoard->attackers) return cBoard->attackers[sq];
   BB attacks = 0;
   BB occ = Occupied();
   // Pawns
@@ -43,6 +47,7 @@ BB attack_map(BRD *cBoard, enumSq sq){
 }
 
 BB color_attack_map(BRD *cBoard, enumSq sq, int c, int e){
+  if(cBoard->attackers) return cBoard->attackers[sq] & Placement(c);
   BB attacks = 0;
   BB occ = Occupied();
   // Pawns
@@ -60,7 +65,8 @@ BB color_attack_map(BRD *cBoard, enumSq sq, int c, int e){
   return attacks;
 }
 
-int is_attacked_by(BRD *cBoard, enumSq sq, int attacker, int defender){
+// Boards edited in place without updating their attack map (see move_evades_check) must be scanned.
+static inline int scan_attacked_by(BRD *cBoard, enumSq sq, int attacker, int defender){
   BB occ = Occupied();
   // Pawns
   if(pawn_attack_masks[defender][sq] & cBoard->pieces[attacker][PAWN]) return 1; 
@@ -75,40 +81,19 @@ int is_attacked_by(BRD *cBoard, enumSq sq, int attacker, int defender){
   return 0;
 }
 
-// Determines if a piece is blocking a ray attack to its king, and cannot move off this ray
-// without placing its king in check.
-// 1. Find the displacement vector between the piece at sq and its own king and determine if it
-//    lies along a valid ray attack.  If the vector is a valid ray attack:
-// 2. Scan toward the king to see if there are any other pieces blocking this route to the king.
-// 3. Scan in the opposite direction to see detect any potential threats along this ray.
+int is_attacked_by(BRD *cBoard, enumSq sq, int attacker, int defender){
+  if(cBoard->attackers) return (cBoard->attackers[sq] & Placement(attacker)) != 0;
+  return scan_attacked_by(cBoard, sq, attacker, defender);
+}
+
+// Determines if a piece is blocking a ray attack to its king, and cannot move off this ray without placing its 
+// king in check.  Pins are found for all of a side's pieces at once and cached with the node's other attack info 
+// (see pinned_pieces() below).  Returns the line through the piece and its king, or 0 if the piece isn't pinned.
 BB is_pinned(BRD* cBoard, int sq, int c, int e){
-  BB occ = Occupied();
-  BB threat = 0, guarded_king = 0;
+  if(!cBoard->pieces[c][KING]) return 0;
   int dir = directions[sq][furthest_forward(c, cBoard->pieces[c][KING])]; //get direction toward king
-  switch(dir){    // NW, NE, SE, SW, NORTH, EAST, SOUTH, WEST, INVALID
-    case NW:
-    case NE:
-      threat = scan_down(occ, dir+2, sq) & (cBoard->pieces[e][BISHOP]|cBoard->pieces[e][QUEEN]);
-      guarded_king = scan_up(occ, dir, sq) & (cBoard->pieces[c][KING]);
-      break;
-    case SE: 
-    case SW:
-      threat = scan_up(occ, dir-2, sq) & (cBoard->pieces[e][BISHOP]|cBoard->pieces[e][QUEEN]);
-      guarded_king = scan_down(occ, dir, sq) & (cBoard->pieces[c][KING]);
-      break;
-    case NORTH:
-    case EAST:
-      threat = scan_down(occ, dir+2, sq) & (cBoard->pieces[e][ROOK]|cBoard->pieces[e][QUEEN]);
-      guarded_king = scan_up(occ, dir, sq) & (cBoard->pieces[c][KING]);
-      break;
-    case SOUTH: 
-    case WEST:
-      threat = scan_up(occ, dir-2, sq) & (cBoard->pieces[e][ROOK]|cBoard->pieces[e][QUEEN]);
-      guarded_king = scan_down(occ, dir, sq) & (cBoard->pieces[c][KING]);
-      break;
-    case INVALID: return 0; break;
-  }
-  return threat & guarded_king;
+  if(dir == INVALID || !(pinned_pieces(cBoard, c) & sq_mask_on(sq))) return 0;
+  return ray_masks[dir][sq] | ray_masks[dir^2][sq];
 }
 
 // The Static Exchange Evaluation (SEE) heuristic provides a way to determine if a capture 
@@ -118,7 +103,7 @@ BB is_pinned(BRD* cBoard, int sq, int c, int e){
 // 2. SEE scoring of moves is used for move ordering of captures at critical nodes.
 // 3. During quiescence search, SEE is used to prune losing captures. This provides a very low-risk
 //    way of reducing the size of the q-search without impacting playing strength.
-extern int get_see(BRD *cBoard, int from, int to, int c, VALUE sq_board){
+KERNEL_INLINE int get_see_kernel(int isa, BRD *cBoard, int from, int to, int c, VALUE sq_board){
   int next_victim, type, last_type;
   int temp_color = c^1;
   int score = 0;
@@ -178,6 +163,9 @@ extern int get_see(BRD *cBoard, int from, int to, int c, VALUE sq_board){
   return piece_list[0];
 }
 
+KERNEL_VARIANTS(int, get_see, (BRD *cBoard, int from, int to, int c, VALUE sq_board), cBoard, from, to, c, sq_board)
+int (*get_see)(BRD *cBoard, int from, int to, int c, VALUE sq_board) = get_see_generic;
+
 
 // Alpha-beta variant of SEE algorithm.
 extern int get_see_ab(BRD *cBoard, int from, int to, int c, VALUE sq_board){
@@ -260,14 +248,380 @@ extern int get_see_ab(BRD *cBoard, int from, int to, int c, VALUE sq_board){
   return score;
 }
 
+// Setwise attack generation
+//
+// Rather than looking up attacks for each piece in turn, the attacks of all sliders moving in one direction are 
+// found at once with Kogge-Stone occluded fills.  Since a slider's ray ends at the first piece in its way, rays 
+// sharing a direction can only overlap on a blocking friendly piece, so counting the targets in each direction's 
+// fill gives the same result as counting each piece's attacks separately.  The same holds for knight jumps, 
+// since each jump direction maps squares one-to-one.
+//
+// With AVX2, four directions are filled in each register: shifts toward h8 in one, and toward a1 in the other.  These
+// are kernels (see cpu.h), so the pop counts compile to POPCNT on hosts that have it.
+
+#define NOT_A_FILE 0xfefefefefefefefeUL
+#define NOT_H_FILE 0x7f7f7f7f7f7f7f7fUL
+#define NOT_AB_FILE 0xfcfcfcfcfcfcfcfcUL
+#define NOT_GH_FILE 0x3f3f3f3f3f3f3f3fUL
+
+#ifdef CPU_X86
+
+ISA_TARGET(AVX2_TARGET) static inline int lane_pop_counts(__m256i v){
+  BB lanes[4];
+  _mm256_storeu_si256((__m256i *)lanes, v);
+  return pop_count(lanes[0]) + pop_count(lanes[1]) + pop_count(lanes[2]) + pop_count(lanes[3]);
+}
+
+ISA_TARGET(AVX2_TARGET) static inline BB lane_union(__m256i v){
+  __m128i half = _mm_or_si128(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  return (BB)_mm_cvtsi128_si64(_mm_or_si128(half, _mm_unpackhi_epi64(half, half)));
+}
+
+// Lanes hold the N, NE, E and NW directions.
+ISA_TARGET(AVX2_TARGET) static BB slider_attacks_avx2(BB orthogonal, BB diagonal, BB empty, BB targets, int *count){
+  __m256i shifts = _mm256_set_epi64x(7, 1, 9, 8);
+  __m256i shifts_2 = _mm256_slli_epi64(shifts, 1);
+  __m256i shifts_4 = _mm256_slli_epi64(shifts, 2);
+  __m256i gen = _mm256_set_epi64x(diagonal, orthogonal, diagonal, orthogonal);
+  __m256i up_masks = _mm256_set_epi64x(NOT_H_FILE, NOT_A_FILE, NOT_A_FILE, ~0UL);
+  __m256i down_masks = _mm256_set_epi64x(NOT_A_FILE, NOT_H_FILE, NOT_H_FILE, ~0UL);
+  __m256i pro, g;
+
+  // Fills toward h8.
+  g = gen;
+  pro = _mm256_and_si256(_mm256_set1_epi64x(empty), up_masks);
+  g = _mm256_or_si256(g, _mm256_and_si256(pro, _mm256_sllv_epi64(g, shifts)));
+  pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, shifts));
+  g = _mm256_or_si256(g, _mm256_and_si256(pro, _mm256_sllv_epi64(g, shifts_2)));
+  pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, shifts_2));
+  g = _mm256_or_si256(g, _mm256_and_si256(pro, _mm256_sllv_epi64(g, shifts_4)));
+  __m256i up = _mm256_and_si256(_mm256_sllv_epi64(g, shifts), up_masks);
+
+  // Fills toward a1.
+  g = gen;
+  pro = _mm256_and_si256(_mm256_set1_epi64x(empty), down_masks);
+  g = _mm256_or_si256(g, _mm256_and_si256(pro, _mm256_srlv_epi64(g, shifts)));
+  pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, shifts));
+  g = _mm256_or_si256(g, _mm256_and_si256(pro, _mm256_srlv_epi64(g, shifts_2)));
+  pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, shifts_2));
+  g = _mm256_or_si256(g, _mm256_and_si256(pro, _mm256_srlv_epi64(g, shifts_4)));
+  __m256i down = _mm256_and_si256(_mm256_srlv_epi64(g, shifts), down_masks);
+
+  __m256i t = _mm256_set1_epi64x(targets);
+  *count += lane_pop_counts(_mm256_and_si256(up, t)) + lane_pop_counts(_mm256_and_si256(down, t));
+  return lane_union(_mm256_or_si256(up, down));
+}
+
+#endif
+
+KERNEL_INLINE BB fill_up(BB gen, BB pro, int shift, BB mask){
+  pro &= mask;
+  gen |= pro & (gen << shift);
+  pro &= pro << shift;
+  gen |= pro & (gen << 2*shift);
+  pro &= pro << 2*shift;
+  gen |= pro & (gen << 4*shift);
+  return (gen << shift) & mask;
+}
+
+KERNEL_INLINE BB fill_down(BB gen, BB pro, int shift, BB mask){
+  pro &= mask;
+  gen |= pro & (gen >> shift);
+  pro &= pro >> shift;
+  gen |= pro & (gen >> 2*shift);
+  pro &= pro >> 2*shift;
+  gen |= pro & (gen >> 4*shift);
+  return (gen >> shift) & mask;
+}
+
+KERNEL_INLINE BB slider_attacks(int isa, BB orthogonal, BB diagonal, BB empty, BB targets, int *count){
+#ifdef CPU_X86
+  if(isa == ISA_AVX2) return slider_attacks_avx2(orthogonal, diagonal, empty, targets, count);
+#endif
+  BB rays[8] = {
+    fill_up(orthogonal, empty, 8, ~0UL),       fill_down(orthogonal, empty, 8, ~0UL),
+    fill_up(orthogonal, empty, 1, NOT_A_FILE), fill_down(orthogonal, empty, 1, NOT_H_FILE),
+    fill_up(diagonal, empty, 9, NOT_A_FILE),   fill_down(diagonal, empty, 9, NOT_H_FILE),
+    fill_up(diagonal, empty, 7, NOT_H_FILE),   fill_down(diagonal, empty, 7, NOT_A_FILE)
+  };
+  BB attacks = 0;
+  for(int i = 0; i < 8; i++){
+    *count += pop_count(rays[i] & targets);
+    attacks |= rays[i];
+  }
+  return attacks;
+}
+
+KERNEL_INLINE BB knight_attacks(BB knights, BB targets, int *count){
+  BB jumps[8] = {
+    (knights << 17) & NOT_A_FILE,  (knights << 15) & NOT_H_FILE,
+    (knights << 10) & NOT_AB_FILE, (knights << 6) & NOT_GH_FILE,
+    (knights >> 17) & NOT_H_FILE,  (knights >> 15) & NOT_A_FILE,
+    (knights >> 10) & NOT_GH_FILE, (knights >> 6) & NOT_AB_FILE
+  };
+  BB attacks = 0;
+  for(int i = 0; i < 8; i++){
+    *count += pop_count(jumps[i] & targets);
+    attacks |= jumps[i];
+  }
+  return attacks;
+}
+
+static inline BB pawn_attacks(int c, BB pawns){
+  return c ? ((pawns & NOT_A_FILE) << 7) | ((pawns & NOT_H_FILE) << 9)
+           : ((pawns & NOT_A_FILE) >> 9) | ((pawns & NOT_H_FILE) >> 7);
+}
+
+// Returns every square attacked by a knight, slider or king of side c, and adds to *count the number of target 
+// squares attacked, counting a square once for each piece attacking it.
+KERNEL_INLINE BB side_attacks_kernel(int isa, BRD *cBoard, int c, BB targets, int *count){
+  BB queens = cBoard->pieces[c][QUEEN];
+  BB attacks = knight_attacks(cBoard->pieces[c][KNIGHT], targets, count);
+  attacks |= slider_attacks(isa, cBoard->pieces[c][ROOK]|queens, cBoard->pieces[c][BISHOP]|queens, ~Occupied(), 
+                            targets, count);
+  BB king = cBoard->pieces[c][KING] ? king_masks[lsb(cBoard->pieces[c][KING])] : 0;
+  *count += pop_count(king & targets);
+  return attacks | king;
+}
+
+KERNEL_VARIANTS(BB, side_attacks, (BRD *cBoard, int c, BB targets, int *count), cBoard, c, targets, count)
+BB (*side_attacks)(BRD *cBoard, int c, BB targets, int *count) = side_attacks_generic;
+
+// Per-node attack info
+//
+// Evaluation, move generation and legality checks all ask the same questions about a position: which squares each
+// side attacks, which pieces are pinned, and what is giving check.  Answers are kept in the board's ATTACK_INFO and
+// computed at most once per position.  Rather than hooking every place a board is changed, the cache records the
+// piece placement it was computed from and is discarded whenever that no longer matches.  SEE keeps its own scan 
+// of the target square, since an early exit for undefended targets cost more than it saved.
+
+static inline int same_placement(BB key[2][6], BB pieces[2][6]){
+  BB diff = 0;
+  for(int i = 0; i < 6; i++) diff |= (key[BLACK][i] ^ pieces[BLACK][i]) | (key[WHITE][i] ^ pieces[WHITE][i]);
+  return !diff;
+}
+
+static inline ATTACK_INFO* attack_info(BRD *cBoard){
+  ATTACK_INFO *info = &cBoard->info[cBoard->info_slot];
+  if(same_placement(info->key, cBoard->pieces)) return info;
+  cBoard->info_slot ^= 1;  // try the other slot, and replace it on a miss.
+  info = &cBoard->info[cBoard->info_slot];
+  if(!same_placement(info->key, cBoard->pieces)){
+    memcpy(info->key, cBoard->pieces, sizeof(info->key));
+    info->valid = 0;
+  }
+  return info;
+}
+
+extern void clear_attack_info(BRD *cBoard){
+  cBoard->info_slot = 0;
+  cBoard->info[0].valid = cBoard->info[1].valid = 0;
+}
+
+static void fill_attacks(BRD *cBoard, ATTACK_INFO *info, int c){
+  BB unguarded = ~pawn_attacks(c^1, cBoard->pieces[c^1][PAWN]);
+  info->mobility[c] = 0;
+  info->attacks[c] = side_attacks(cBoard, c, ~Placement(c) & unguarded, &info->mobility[c]) | 
+                     pawn_attacks(c, cBoard->pieces[c][PAWN]);
+  info->valid |= AI_ATTACKS << c;
+}
+
+// Returns every square attacked by side c.
+extern BB attacks_by(BRD *cBoard, int c){
+  ATTACK_INFO *info = attack_info(cBoard);
+  if(!(info->valid & (AI_ATTACKS << c))) fill_attacks(cBoard, info, c);
+  return info->attacks[c];
+}
+
+// Returns the knight, slider and king mobility of side c, not counting squares defended by enemy pawns.
+extern int piece_mobility(BRD *cBoard, int c){
+  ATTACK_INFO *info = attack_info(cBoard);
+  if(!(info->valid & (AI_ATTACKS << c))) fill_attacks(cBoard, info, c);
+  return info->mobility[c];
+}
+
+// Returns the pieces of color b that are alone between the king on king_sq and a slider of color s that could 
+// attack along that line.
+static BB line_blockers(BRD *cBoard, int king_sq, int s, int b){
+  int sq;
+  BB occ = Occupied(), blockers = 0, between;
+  BB sliders = (rook_masks[king_sq] & (cBoard->pieces[s][ROOK]|cBoard->pieces[s][QUEEN])) |
+               (bishop_masks[king_sq] & (cBoard->pieces[s][BISHOP]|cBoard->pieces[s][QUEEN]));
+  for(; sliders; clear_sq(sq, sliders)){
+    sq = lsb(sliders);
+    between = intervening[sq][king_sq] & occ;
+    if(between && !(between & (between-1))) blockers |= between & Placement(b);
+  }
+  return blockers;
+}
+
+// A piece is pinned if it's the only piece between its king and an enemy slider that could attack along that line.
+static BB find_pinned(BRD *cBoard, int c){
+  if(!cBoard->pieces[c][KING]) return 0;
+  return line_blockers(cBoard, furthest_forward(c, cBoard->pieces[c][KING]), c^1, c);
+}
+
+// Returns side c's pieces that are pinned against their own king.
+extern BB pinned_pieces(BRD *cBoard, int c){
+  ATTACK_INFO *info = attack_info(cBoard);
+  if(!(info->valid & (AI_PINNED << c))){
+    info->pinned[c] = find_pinned(cBoard, c);
+    info->valid |= AI_PINNED << c;
+  }
+  return info->pinned[c];
+}
+
+// Returns the enemy pieces giving check to side c's king.
+extern BB checkers(BRD *cBoard, int c){
+  ATTACK_INFO *info = attack_info(cBoard);
+  if(!(info->valid & (AI_CHECKERS << c))){
+    BB king = cBoard->pieces[c][KING];
+    if(!king || ((info->valid & (AI_ATTACKS << (c^1))) && !(info->attacks[c^1] & king))) info->checkers[c] = 0;
+    else info->checkers[c] = color_attack_map(cBoard, furthest_forward(c, king), c^1, c);
+    info->valid |= AI_CHECKERS << c;
+  }
+  return info->checkers[c];
+}
+
+// Incremental attack maps
+//
+// A board can keep, for every square, the set of pieces attacking it, so that attack_map() and is_attacked_by() cost 
+// a load.  The map is updated as each piece is added or removed.  The piece's own attacks are toggled in, and when 
+// its square changes between empty and occupied, the rays of the sliders attacking that square are toggled beyond 
+// it, up to the next piece.  No other square needs to be looked at again.
+
+static inline BB attacks_from(BRD *cBoard, int c, int type, int sq){
+  switch(type){
+    case PAWN: return pawn_attack_masks[c][sq];
+    case KNIGHT: return knight_masks[sq];
+    case BISHOP: return bishop_attacks(Occupied(), sq);
+    case ROOK: return rook_attacks(Occupied(), sq);
+    case QUEEN: return queen_attacks(Occupied(), sq);
+    default: return king_masks[sq];
+  }
+}
+
+static inline void toggle_attacker(BB *attackers, BB targets, int from){
+  int sq;
+  for(; targets; clear_sq(sq, targets)){
+    sq = lsb(targets);
+    attackers[sq] ^= sq_mask_on(from);
+  }
+}
+
+// Toggles the squares beyond sq attacked through it by each slider attacking sq.
+static void toggle_rays_through(BRD *cBoard, int sq){
+  BB sliders = cBoard->pieces[WHITE][BISHOP] | cBoard->pieces[BLACK][BISHOP] | cBoard->pieces[WHITE][ROOK] | 
+               cBoard->pieces[BLACK][ROOK]   | cBoard->pieces[WHITE][QUEEN]  | cBoard->pieces[BLACK][QUEEN];
+  BB occ = Occupied();
+  BB ray, blockers;
+  int from, dir;
+  for(sliders &= cBoard->attackers[sq]; sliders; clear_sq(from, sliders)){
+    from = lsb(sliders);
+    dir = directions[from][sq];
+    ray = ray_masks[dir][sq];
+    blockers = ray & occ;
+    if(blockers){  // the ray stops at the nearest blocker.
+      int blocker = (dir == NW || dir == NE || dir == NORTH || dir == EAST) ? lsb(blockers) : msb(blockers);
+      ray &= ~ray_masks[dir][blocker];
+    }
+    toggle_attacker(cBoard->attackers, ray, from);
+  }
+}
+
+// Called once a piece has been placed on the board.  A capturing piece is placed before the captured piece is 
+// removed, so the square stays occupied throughout.
+extern void attack_map_add_piece(BRD *cBoard, int c, int type, int sq){
+  if(!(Placement(c^1) & sq_mask_on(sq))) toggle_rays_through(cBoard, sq);
+  toggle_attacker(cBoard->attackers, attacks_from(cBoard, c, type, sq), sq);
+}
+
+// Called once a piece has been taken off the board.
+extern void attack_map_remove_piece(BRD *cBoard, int c, int type, int sq){
+  toggle_attacker(cBoard->attackers, attacks_from(cBoard, c, type, sq), sq);
+  if(!(Placement(c^1) & sq_mask_on(sq))) toggle_rays_through(cBoard, sq);
+}
+
+extern void build_attack_map(BRD *cBoard){
+  int sq;
+  memset(cBoard->attackers, 0, 64 * sizeof(BB));
+  for(int c = BLACK; c <= WHITE; c++){
+    for(int type = PAWN; type <= KING; type++){
+      for(BB b = cBoard->pieces[c][type]; b; clear_sq(sq, b)){
+        sq = lsb(b);
+        toggle_attacker(cBoard->attackers, attacks_from(cBoard, c, type, sq), sq);
+      }
+    }
+  }
+}
+
+// Check info for side c: the squares each of its piece types would check the enemy king from, and its pieces that 
+// block one of its own sliders from the enemy king.  Together with the checkers above, this answers whether a move 
+// gives check without making it.
+static void fill_check_info(BRD *cBoard, ATTACK_INFO *info, int c){
+  int e = c^1;
+  BB occ = Occupied();
+  memset(info->check_squares[c], 0, sizeof(info->check_squares[c]));
+  info->discoverers[c] = 0;
+  info->valid |= AI_CHECK_INFO << c;
+  if(!cBoard->pieces[e][KING]) return;
+  int king_sq = furthest_forward(e, cBoard->pieces[e][KING]);
+  info->check_squares[c][PAWN] = pawn_attack_masks[e][king_sq];
+  info->check_squares[c][KNIGHT] = knight_masks[king_sq];
+  info->check_squares[c][BISHOP] = bishop_attacks(occ, king_sq);
+  info->check_squares[c][ROOK] = rook_attacks(occ, king_sq);
+  info->check_squares[c][QUEEN] = info->check_squares[c][BISHOP] | info->check_squares[c][ROOK];
+  info->discoverers[c] = line_blockers(cBoard, king_sq, c, c);
+}
+
+// Returns the squares from which side c's pieces of the given type would give check.
+extern BB check_squares(BRD *cBoard, int c, int type){
+  ATTACK_INFO *info = attack_info(cBoard);
+  if(!(info->valid & (AI_CHECK_INFO << c))) fill_check_info(cBoard, info, c);
+  return info->check_squares[c][type];
+}
+
+// Returns side c's pieces that would give discovered check by moving off the line to the enemy king.
+extern BB discoverers(BRD *cBoard, int c){
+  ATTACK_INFO *info = attack_info(cBoard);
+  if(!(info->valid & (AI_CHECK_INFO << c))) fill_check_info(cBoard, info, c);
+  return info->discoverers[c];
+}
+
+// Determines whether a move by side c would check the enemy king, directly or by discovery.  A promoted type of 
+// PAWN means no promotion.  En-passant captures and castling are judged by the moving pawn or king alone.
+extern int gives_check(BRD *cBoard, int c, int from, int to, int type, int promoted_type){
+  int e = c^1;
+  if(!cBoard->pieces[e][KING]) return 1;
+  int king_sq = furthest_forward(e, cBoard->pieces[e][KING]);
+  if(promoted_type == PAWN){
+    if(check_squares(cBoard, c, type) & sq_mask_on(to)) return 1;
+  } else {  // the promoted piece may attack through the square the pawn just left.
+    BB occ = (Occupied() & sq_mask_off(from)) | sq_mask_on(to);
+    BB attacks = promoted_type == KNIGHT ? knight_masks[to] : 
+                 promoted_type == BISHOP ? bishop_attacks(occ, to) :
+                 promoted_type == ROOK ? rook_attacks(occ, to) : queen_attacks(occ, to);
+    if(attacks & sq_mask_on(king_sq)) return 1;
+  }
+  if(discoverers(cBoard, c) & sq_mask_on(from)){
+    int dir = directions[from][king_sq];
+    return !((ray_masks[dir][from] | ray_masks[dir^2][from]) & sq_mask_on(to));
+  }
+  return 0;
+}
+
+extern void select_attack_kernels(int isa){
+  side_attacks = side_attacks_variants[isa];
+  get_see = get_see_variants[isa];
+}
+
 // Ruby interface
 
 static VALUE is_in_check(VALUE self, VALUE p_board, VALUE side_to_move){
   BRD *cBoard = get_cBoard(p_board);
   int c = SYM2COLOR(side_to_move);
-  int e = c^1;
   if(!cBoard->pieces[c][KING]) return Qtrue;
-  return (is_attacked_by(cBoard, furthest_forward(c, cBoard->pieces[c][KING]), e, c) ? Qtrue : Qfalse);
+  return checkers(cBoard, c) ? Qtrue : Qfalse;
 }
 
 static VALUE move_evades_check(VALUE self, VALUE p_board, VALUE sq_board, VALUE from, VALUE to, VALUE color){
@@ -290,12 +644,12 @@ static VALUE move_evades_check(VALUE self, VALUE p_board, VALUE sq_board, VALUE
     clear_sq(t, cBoard->pieces[e][piece_type(captured_piece)]);
     clear_sq(t, cBoard->occupied[e]);
     // determine if in check
-    check = is_attacked_by(cBoard, furthest_forward(c, cBoard->pieces[c][KING]), e, c);
+    check = scan_attacked_by(cBoard, furthest_forward(c, cBoard->pieces[c][KING]), e, c);
     add_sq(t, cBoard->pieces[e][piece_type(captured_piece)]);
     add_sq(t, cBoard->occupied[e]);
   } else {
     // determine if in check
-    check = is_attacked_by(cBoard, furthest_forward(c, cBoard->pieces[c][KING]), e, c);
+    check = scan_attacked_by(cBoard, furthest_forward(c, cBoard->pieces[c][KING]), e, c);
   }
   cBoard->pieces[c][piece_type(piece)] ^= delta;
   cBoard->occupied[c] ^= delta;
@@ -304,66 +658,38 @@ static VALUE move_evades_check(VALUE self, VALUE p_board, VALUE sq_board, VALUE
 }
 
 // Determines if a move will put the enemy's king in check.
-static VALUE move_gives_check(VALUE self, VALUE p_board, VALUE sq_board, VALUE from, VALUE to, 
+static VALUE move_gives_check(VALUE self, VALUE p_board, VALUE piece, VALUE from, VALUE to, 
                               VALUE color, VALUE promoted_piece){
-  BRD *cBoard = get_cBoard(p_board);
-  int c = SYM2COLOR(color);
-  int e = c^1;
-  int f = NUM2INT(from), t = NUM2INT(to);
-  int check;
-
-  int piece = NUM2INT(rb_ary_entry(sq_board, f));  // ?
-  int captured_piece = NUM2INT(rb_ary_entry(sq_board, t));
-
-  if(!cBoard->pieces[e][KING]) return Qtrue;
-
-  BB delta = (sq_mask_on(t)|sq_mask_on(f));
-  cBoard->occupied[c] ^= delta;
-  if(promoted_piece != Qnil){
-    clear_sq(f, cBoard->pieces[c][piece_type(piece)]);
-    add_sq(t, cBoard->pieces[c][piece_type(NUM2INT(promoted_piece))]);
-    if(captured_piece){
-      clear_sq(t, cBoard->pieces[e][piece_type(captured_piece)]);
-      clear_sq(t, cBoard->occupied[e]);
-      // determine if in check
-      check = is_attacked_by(cBoard, furthest_forward(e, cBoard->pieces[e][KING]), c, e);
-      add_sq(t, cBoard->pieces[e][piece_type(captured_piece)]);
-      add_sq(t, cBoard->occupied[e]);
-    } else { // determine if in check
-      check = is_attacked_by(cBoard, furthest_forward(e, cBoard->pieces[e][KING]), c, e);
-    }
-    add_sq(f, cBoard->pieces[c][piece_type(piece)]);
-    clear_sq(t, cBoard->pieces[c][piece_type(NUM2INT(promoted_piece))]);
+  int promoted_type = promoted_piece == Qnil ? PAWN : piece_type(NUM2INT(promoted_piece));
+  return gives_check(get_cBoard(p_board), SYM2COLOR(color), NUM2INT(from), NUM2INT(to), piece_type(NUM2INT(piece)), 
+                     promoted_type) ? Qtrue : Qfalse;
+}
 
-  } else {
-    cBoard->pieces[c][piece_type(piece)] ^= delta;
-    if(captured_piece){
-      clear_sq(t, cBoard->pieces[e][piece_type(captured_piece)]);
-      clear_sq(t, cBoard->occupied[e]);
-      // determine if in check
-      check = is_attacked_by(cBoard, furthest_forward(e, cBoard->pieces[e][KING]), c, e);
-      add_sq(t, cBoard->pieces[e][piece_type(captured_piece)]);
-      add_sq(t, cBoard->occupied[e]);
-    } else { // determine if in check
-      check = is_attacked_by(cBoard, furthest_forward(e, cBoard->pieces[e][KING]), c, e);
-    }
-    cBoard->pieces[c][piece_type(piece)] ^= delta;
-  }
-  cBoard->occupied[c] ^= delta;
 
-  return check ? Qtrue : Qfalse;
+// An en-passant capture removes two pawns from the line between the king and an enemy slider, e.g. on the fifth rank,
+// so the pin test on the moving pawn alone can't tell whether it's legal.
+static int enp_exposes_king(BRD *cBoard, int from, int to, int c, int e){
+  int captured = c ? to - 8 : to + 8;
+  int king = lsb(cBoard->pieces[c][KING]);
+  BB occ = (Occupied() ^ sq_mask_on(from) ^ sq_mask_on(captured)) | sq_mask_on(to);
+  BB queens = cBoard->pieces[e][QUEEN];
+  return ((rook_attacks(occ, king) & (cBoard->pieces[e][ROOK]|queens)) | 
+          (bishop_attacks(occ, king) & (cBoard->pieces[e][BISHOP]|queens))) != 0;
 }
 
-
 static VALUE is_pseudolegal_move_legal(VALUE self, VALUE p_board, VALUE piece, VALUE f, VALUE t, VALUE color){
   int c = SYM2COLOR(color);
   int e = c^1;
   BRD *cBoard = get_cBoard(p_board);
   if(piece_type(NUM2INT(piece)) == KING){ // determine if the to square is attacked by an enemy piece.
-    return is_attacked_by(cBoard, NUM2INT(t), e, c) ? Qfalse : Qtrue;  // castle moves are pre-checked for legality
+    return (attacks_by(cBoard, e) & sq_mask_on(NUM2INT(t))) ? Qfalse : Qtrue;  // castle moves are pre-checked for legality
   } else { // determine if the piece being moved is pinned on the king and can't move without putting king at risk.
-    BB pinned = is_pinned(cBoard, NUM2INT(f), c, e);
-    return pinned && (~pinned & sq_mask_on(NUM2INT(t))) ? Qfalse : Qtrue;
+    int from = NUM2INT(f), to = NUM2INT(t);
+    if(piece_type(NUM2INT(piece)) == PAWN && column(from) != column(to) && !(Placement(e) & sq_mask_on(to))){
+      return enp_exposes_king(cBoard, from, to, c, e) ? Qfalse : Qtrue;
+    }
+    BB pinned = is_pinned(cBoard, from, c, e);
+    return pinned && (~pinned & sq_mask_on(to)) ? Qfalse : Qtrue;
   }
 }
 
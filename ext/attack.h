@@ -22,6 +22,7 @@
 #ifndef ATTACK
 #define ATTACK
 
+#include <string.h>
 #include "shared.h"
 
 
@@ -29,6 +30,12 @@ static VALUE mod_chess;
 static VALUE mod_position;
 static VALUE mod_search;
 
+// ATTACK_INFO entries, shifted left by the color they belong to.
+#define AI_ATTACKS       0x1
+#define AI_PINNED        0x10
+#define AI_CHECKERS      0x40
+#define AI_CHECK_INFO    0x100
+
 BB attack_map(BRD *cBoard, enumSq sq);
 BB color_attack_map(BRD *cBoard, enumSq sq, int c, int e);
 
@@ -36,18 +43,37 @@ int is_attacked_by(BRD *cBoard, enumSq sq, int attacker, int defender);
 
 BB is_pinned(BRD* cBoard, int sq, int c, int e);
 
-extern int get_see(BRD *cBoard, int from, int to, int c, VALUE sq_board);
+extern BB (*side_attacks)(BRD *cBoard, int c, BB targets, int *count);
+
+extern void attack_map_add_piece(BRD *cBoard, int c, int type, int sq);
+extern void attack_map_remove_piece(BRD *cBoard, int c, int type, int sq);
+extern void build_attack_map(BRD *cBoard);
+
+extern void clear_attack_info(BRD *cBoard);
+extern BB attacks_by(BRD *cBoard, int c);
+extern int piece_mobility(BRD *cBoard, int c);
+extern BB pinned_pieces(BRD *cBoard, int c);
+extern BB checkers(BRD *cBoard, int c);
+extern BB check_squares(BRD *cBoard, int c, int type);
+extern BB discoverers(BRD *cBoard, int c);
+extern int gives_check(BRD *cBoard, int c, int from, int to, int type, int promoted_type);
+
+extern int (*get_see)(BRD *cBoard, int from, int to, int c, VALUE sq_board);
+
+extern void select_attack_kernels(int isa);
 
 static VALUE is_in_check(VALUE self, VALUE p_board, VALUE side_to_move);
 
 static VALUE move_evades_check(VALUE self, VALUE p_board, VALUE sq_board, VALUE from, VALUE to, VALUE color);
 
-static VALUE move_gives_check(VALUE self, VALUE p_board, VALUE sq_board, VALUE from, VALUE to, 
+static VALUE move_gives_check(VALUE self, VALUE p_board, VALUE piece, VALUE from, VALUE to, 
                               VALUE color, VALUE promoted_piece);
 
 static VALUE static_exchange_evaluation(VALUE self, VALUE p_board, VALUE from, VALUE to, 
                                         VALUE side_to_move, VALUE sq_board);
 
+static int enp_exposes_king(BRD *cBoard, int from, int to, int c, int e);
+
 static VALUE is_pseudolegal_move_legal(VALUE self, VALUE p_board, VALUE piece, VALUE f, VALUE t, VALUE color);
 
 extern void Init_attack();
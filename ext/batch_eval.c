@@ -0,0 +1,248 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#include "batch_eval.h"
+
+// Evaluates arrays of packed positions without creating any Ruby objects.  The array is split into contiguous 
+// chunks, one per thread, and each thread works in its own slice of a scratch arena allocated for the call, so 
+// concurrent calls from several Ruby threads share nothing.  The network is read-locked for the whole batch.
+//
+// Scores are either the static eval, or the result of a capture search from the position.  The capture search is 
+// a simplified quiescence search: captures and queen promotions only, ordered MVV/LVA with delta pruning, and 
+// without en-passant.  Mates aren't detected; a side in check with no legal capture is scored statically.
+
+extern void unpack_board(PACKED_BOARD *packed, BRD *cBoard){
+  memcpy(cBoard->pieces, packed->pieces, sizeof(cBoard->pieces));
+  clear_attack_info(cBoard);
+  cBoard->material_key = 0;
+  cBoard->attackers = NULL;
+  for(int c = BLACK; c <= WHITE; c++){
+    cBoard->occupied[c] = 0;
+    cBoard->material[c] = 0;
+    for(int type = PAWN; type <= KING; type++){
+      cBoard->occupied[c] |= cBoard->pieces[c][type];
+      cBoard->material[c] += pop_count(cBoard->pieces[c][type]) * piece_values[type];
+      cBoard->material_key += pop_count(cBoard->pieces[c][type]) * material_key_delta(c, type);
+    }
+  }
+}
+
+// The network's score when one is loaded, otherwise the hand-set evaluation.  Recognized endgames (endgame.c) are 
+// either scored directly, or have the general score scaled.
+extern int static_eval(BRD *cBoard, ACCUMULATOR *acc, int c){
+  int e = c^1;
+  int score;
+  EG_ENTRY *endgame = probe_endgame(cBoard);
+  if(endgame && endgame->kind == EG_VALUE) return endgame_score(endgame, cBoard, c);
+  if(network && cBoard->pieces[c][KING] && cBoard->pieces[e][KING]){
+    score = nnue_evaluate(acc, cBoard, c);
+  } else {
+    score = adjusted_placement(c, e, cBoard) - adjusted_placement(e, c, cBoard);
+  }
+  return endgame ? endgame_scale(endgame, cBoard, c, score) : score;
+}
+
+// Copies the board at ply into the next ply and makes the move there.  A promoted type of PAWN means no promotion.
+// Each ply's attack info is left in place, since it's checked against the pieces before use.
+static BRD* make_capture(SCRATCH *s, int ply, int c, int type, int from, int to, int victim, int promoted_type){
+  BRD *cBoard = &s->boards[ply+1];
+  ACCUMULATOR *acc = &s->accs[ply+1];
+  int e = c^1;
+  memcpy(cBoard, &s->boards[ply], offsetof(BRD, info_slot));
+  if(network) *acc = s->accs[ply];
+  if(victim != -1){
+    clear_sq(to, cBoard->pieces[e][victim]);
+    clear_sq(to, cBoard->occupied[e]);
+    cBoard->material[e] -= piece_values[victim];
+    cBoard->material_key -= material_key_delta(e, victim);
+    nnue_remove_piece(acc, cBoard, e, victim, to);
+  }
+  if(promoted_type != PAWN){
+    clear_sq(from, cBoard->pieces[c][PAWN]);
+    cBoard->material[c] -= piece_values[PAWN];
+    nnue_remove_piece(acc, cBoard, c, PAWN, from);
+    add_sq(to, cBoard->pieces[c][promoted_type]);
+    cBoard->material[c] += piece_values[promoted_type];
+    cBoard->material_key += material_key_delta(c, promoted_type) - material_key_delta(c, PAWN);
+    cBoard->occupied[c] ^= sq_mask_on(from)|sq_mask_on(to);
+    nnue_add_piece(acc, cBoard, c, promoted_type, to);
+  } else {
+    BB delta = sq_mask_on(from)|sq_mask_on(to);
+    cBoard->pieces[c][type] ^= delta;
+    cBoard->occupied[c] ^= delta;
+    nnue_move_piece(acc, cBoard, c, type, from, to);
+  }
+  return cBoard;
+}
+
+static int qsearch(SCRATCH *s, int ply, int c, int alpha, int beta);
+
+// Searches one move from the given ply.  Returns -Q_INF if the move leaves the mover's king in check.
+static int search_move(SCRATCH *s, int ply, int c, int type, int from, int to, int victim, int alpha, int beta){
+  int promoted_type = (type == PAWN && (to >= 56 || to < 8)) ? QUEEN : PAWN;
+  BRD *cBoard = make_capture(s, ply, c, type, from, to, victim, promoted_type);
+  if(is_attacked_by(cBoard, lsb(cBoard->pieces[c][KING]), c^1, c)) return -Q_INF;
+  return -qsearch(s, ply+1, c^1, -beta, -alpha);
+}
+
+static int qsearch(SCRATCH *s, int ply, int c, int alpha, int beta){
+  BRD *cBoard = &s->boards[ply];
+  int e = c^1;
+  int stand_pat = static_eval(cBoard, &s->accs[ply], c);
+  int best = -Q_INF;
+  int value, from, to;
+  BB targets, attackers;
+
+  if(!cBoard->pieces[c][KING] || !cBoard->pieces[e][KING]) return stand_pat;
+  int in_check = is_attacked_by(cBoard, lsb(cBoard->pieces[c][KING]), e, c);
+
+  if(!in_check){
+    if(stand_pat >= beta) return beta;
+    if(stand_pat > alpha) alpha = stand_pat;
+    best = stand_pat;
+  }
+  if(ply == Q_MAX_PLY) return stand_pat;
+
+  // Captures, most valuable victim first, then least valuable attacker first.  Once even winning the victim 
+  // outright can't raise alpha, the remaining captures are pruned (delta pruning).
+  for(int victim = QUEEN; victim >= PAWN; victim--){
+    if(!in_check && stand_pat + piece_values[victim] + Q_DELTA_MARGIN <= alpha) break;
+    for(targets = cBoard->pieces[e][victim]; targets; clear_sq(to, targets)){
+      to = lsb(targets);
+      BB attack_set = color_attack_map(cBoard, to, c, e);
+      for(int type = PAWN; type <= KING; type++){
+        for(attackers = attack_set & cBoard->pieces[c][type]; attackers; clear_sq(from, attackers)){
+          from = lsb(attackers);
+          value = search_move(s, ply, c, type, from, to, victim, alpha, beta);
+          if(value > best) best = value;
+          if(value > alpha){
+            if(value >= beta) return beta;
+            alpha = value;
+          }
+        }
+      }
+    }
+  }
+  // Queen promotions without capture.
+  BB promoting = cBoard->pieces[c][PAWN] & row_masks[c ? 6 : 1];
+  for(; promoting; clear_sq(from, promoting)){
+    from = lsb(promoting);
+    to = c ? from + 8 : from - 8;
+    if(Occupied() & sq_mask_on(to)) continue;
+    value = search_move(s, ply, c, PAWN, from, to, -1, alpha, beta);
+    if(value > best) best = value;
+    if(value > alpha){
+      if(value >= beta) return beta;
+      alpha = value;
+    }
+  }
+  return best == -Q_INF ? stand_pat : alpha;
+}
+
+static void* run_batch_job(void *data){
+  BATCH_JOB *job = data;
+  SCRATCH *s = job->scratch;
+  for(long i = 0; i < job->count; i++){
+    PACKED_BOARD *packed = &job->positions[i];
+    int c = packed->side ? WHITE : BLACK;
+    unpack_board(packed, &s->boards[0]);
+    nnue_invalidate(&s->accs[0]);
+    job->scores[i] = job->qsearch ? qsearch(s, 0, c, -Q_INF, Q_INF) : static_eval(&s->boards[0], &s->accs[0], c);
+  }
+  return NULL;
+}
+
+typedef struct {
+  BATCH_JOB *jobs;
+  int n_threads;
+} BATCH;
+
+static void* run_batch(void *data){
+  BATCH *batch = data;
+  pthread_t threads[BATCH_MAX_THREADS];
+  pthread_rwlock_rdlock(&network_lock);
+  for(int t = 1; t < batch->n_threads; t++) pthread_create(&threads[t], NULL, run_batch_job, &batch->jobs[t]);
+  run_batch_job(&batch->jobs[0]);
+  for(int t = 1; t < batch->n_threads; t++) pthread_join(threads[t], NULL);
+  pthread_rwlock_unlock(&network_lock);
+  return NULL;
+}
+
+// Ruby interface
+
+// Returns the board and side to move packed as a single batch entry.
+static VALUE pack_position(VALUE self, VALUE p_board, VALUE color){
+  PACKED_BOARD packed;
+  memcpy(packed.pieces, get_cBoard(p_board)->pieces, sizeof(packed.pieces));
+  packed.side = SYM2COLOR(color);
+  return rb_str_new((char *)&packed, sizeof(PACKED_BOARD));
+}
+
+// Evaluates each position in the packed string, writing one native-endian int32 score per position into out, 
+// which must already be large enough.  Scores are from the perspective of the side to move.  Returns the number of 
+// positions evaluated.
+static VALUE evaluate_batch(VALUE self, VALUE packed, VALUE out, VALUE qsearch, VALUE threads){
+  StringValue(packed);
+  StringValue(out);
+  packed = rb_str_new_frozen(packed);  // a frozen view, so other Ruby threads can't change the input mid-batch.
+  long count = RSTRING_LEN(packed) / sizeof(PACKED_BOARD);
+  int n_threads = NIL_P(threads) ? sysconf(_SC_NPROCESSORS_ONLN) : NUM2INT(threads);
+  if(RSTRING_LEN(packed) % sizeof(PACKED_BOARD)) rb_raise(rb_eArgError, "packed positions have the wrong length");
+  if(RSTRING_LEN(out) < count * (long)sizeof(int32_t)) rb_raise(rb_eArgError, "output buffer is too small");
+  rb_str_modify(out);
+  n_threads = max(1, min(n_threads, BATCH_MAX_THREADS));
+  if(count < n_threads) n_threads = count > 0 ? count : 1;
+
+  rb_str_locktmp(out);
+  SCRATCH *arena = malloc(n_threads * sizeof(SCRATCH));
+  if(!arena){
+    rb_str_unlocktmp(out);
+    rb_raise(rb_eNoMemError, "failed to allocate scratch space");
+  }
+  BATCH_JOB jobs[BATCH_MAX_THREADS];
+  PACKED_BOARD *positions = (PACKED_BOARD *)RSTRING_PTR(packed);
+  int32_t *scores = (int32_t *)RSTRING_PTR(out);
+  long start = 0;
+  for(int t = 0; t < n_threads; t++){
+    long end = count * (t+1) / n_threads;
+    for(int ply = 0; ply <= Q_MAX_PLY; ply++) clear_attack_info(&arena[t].boards[ply]);
+    jobs[t] = (BATCH_JOB){ positions + start, scores + start, end - start, RTEST(qsearch), &arena[t] };
+    start = end;
+  }
+  BATCH batch = { jobs, n_threads };
+  rb_thread_call_without_gvl(run_batch, &batch, NULL, NULL);
+  free(arena);
+  rb_str_unlocktmp(out);
+  RB_GC_GUARD(packed);
+  return LONG2NUM(count);
+}
+
+extern void Init_batch_eval(){
+  printf("  -Loading batch_eval extension...");
+
+  VALUE mod_chess = rb_define_module("Chess");
+  VALUE mod_eval = rb_define_module_under(mod_chess, "Evaluation");
+
+  rb_define_module_function(mod_eval, "pack_position", pack_position, 2);
+  rb_define_module_function(mod_eval, "evaluate_batch", evaluate_batch, 4);
+
+  printf("done.\n");
+}
@@ -0,0 +1,58 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef BATCH_EVAL
+#define BATCH_EVAL
+
+#include "shared.h"
+#include <stddef.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <ruby/thread.h>
+
+#define BATCH_MAX_THREADS 64
+#define Q_MAX_PLY 32
+#define Q_INF 1000000
+#define Q_DELTA_MARGIN 200
+
+// Per-thread scratch space for the capture search, one board and accumulator for each ply.
+typedef struct {
+  BRD boards[Q_MAX_PLY+1];
+  ACCUMULATOR accs[Q_MAX_PLY+1];
+} SCRATCH;
+
+typedef struct {
+  PACKED_BOARD *positions;
+  int32_t *scores;
+  long count;
+  int qsearch;
+  SCRATCH *scratch;
+} BATCH_JOB;
+
+extern void unpack_board(PACKED_BOARD *packed, BRD *cBoard);
+extern int static_eval(BRD *cBoard, ACCUMULATOR *acc, int c);
+
+static VALUE pack_position(VALUE self, VALUE p_board, VALUE color);
+static VALUE evaluate_batch(VALUE self, VALUE packed, VALUE out, VALUE qsearch, VALUE threads);
+
+extern void Init_batch_eval();
+
+#endif
@@ -24,20 +24,33 @@
 // This module Ruby object wrapper for the BRD struct, providing methods for accessing 
 // and updating the struct from within Ruby.
 
+static int attack_maps = 0;  // whether new boards keep an attack map.
+
 // destructor
 void free_cBoard(BRD *b){
   ruby_xfree(b);
 }
 
 extern BRD* get_cBoard(VALUE self){
-  BRD *b;
-  Data_Get_Struct(self, BRD, b);
-  return b;
+  BOARD_DATA *b;
+  Data_Get_Struct(self, BOARD_DATA, b);
+  return &b->brd;
+}
+
+extern ACCUMULATOR* get_accumulator(VALUE self){
+  BOARD_DATA *b;
+  Data_Get_Struct(self, BOARD_DATA, b);
+  return &b->acc;
 }
 
 // associates the underlying BRD struct with a constructor and destructor.
 static VALUE o_alloc(VALUE klass){  
-  return Data_Wrap_Struct(klass, 0, free_cBoard, ruby_xmalloc(sizeof(BRD)));
+  BOARD_DATA *b = ruby_xmalloc(sizeof(BOARD_DATA));
+  nnue_invalidate(&b->acc);
+  b->acc.network_id = 0;
+  b->brd.attackers = NULL;
+  clear_attack_info(&b->brd);
+  return Data_Wrap_Struct(klass, 0, free_cBoard, b);
 }
 
 // Initialize a new Chess::PiecewiseBoard instance
@@ -45,6 +58,8 @@ static VALUE o_initialize(VALUE self, VALUE sq_board){
   BRD blank_board = { { {0}, {0} }, {0} };
   BRD *cBoard = get_cBoard(self);
   *cBoard = blank_board;
+  nnue_invalidate(get_accumulator(self));
+  if(attack_maps) o_set_attack_maps(self, Qtrue);  // the map is filled in as setup adds each piece.
   rb_funcall(self, rb_intern("setup"), 1, sq_board);
 
   return self;
@@ -70,7 +85,10 @@ static VALUE o_get_occupancy(VALUE self, VALUE color_sym){
 // Set the value of the bitboard corresponding to the given piece id.
 static VALUE o_set_bitboard(VALUE self, VALUE piece_id, VALUE bitboard){
   int id = NUM2INT(piece_id);
-  get_cBoard(self)->pieces[piece_color(id)][piece_type(id)] = NUM2ULONG(bitboard);
+  BRD *cBoard = get_cBoard(self);
+  cBoard->pieces[piece_color(id)][piece_type(id)] = NUM2ULONG(bitboard);
+  nnue_invalidate(get_accumulator(self));
+  if(cBoard->attackers) build_attack_map(cBoard);
   return bitboard;
 }
 // Adds a piece at the specified square to the BRD struct.  Used to add a piece into play.
@@ -84,6 +102,9 @@ static VALUE o_add_square(VALUE self, VALUE piece_id, VALUE square){
   add_sq(sq, cBoard->pieces[c][t]);
   add_sq(sq, cBoard->occupied[c]);
   cBoard->material[c] += piece_values[t]; // Incrementally update material.
+  cBoard->material_key += material_key_delta(c, t);
+  nnue_add_piece(get_accumulator(self), cBoard, c, t, sq);
+  if(cBoard->attackers) attack_map_add_piece(cBoard, c, t, sq);
   return Qnil;  
 }
 // Removes a piece at the specified square from the BRD struct.  Used to remove a piece from play.
@@ -97,6 +118,9 @@ static VALUE o_remove_square(VALUE self, VALUE piece_id, VALUE square){
   clear_sq(sq, cBoard->pieces[c][t]);
   clear_sq(sq, cBoard->occupied[c]);
   cBoard->material[c] -= piece_values[t];  // Incrementally update material.
+  cBoard->material_key -= material_key_delta(c, t);
+  nnue_remove_piece(get_accumulator(self), cBoard, c, t, sq);
+  if(cBoard->attackers) attack_map_remove_piece(cBoard, c, t, sq);
   return Qnil;  
 }
 // Shifts the stored location of a piece from one square to another.
@@ -108,8 +132,18 @@ static VALUE o_relocate_piece(VALUE self, VALUE piece_id, VALUE from, VALUE to){
   int t = NUM2INT(to);
 
   BB delta = (sq_mask_on(t)|sq_mask_on(f));
-  cBoard->pieces[c][type] ^= delta;
-  cBoard->occupied[c] ^= delta;
+  if(cBoard->attackers){  // lift the piece and then place it, so the attack map sees each square change.
+    clear_sq(f, cBoard->pieces[c][type]);
+    clear_sq(f, cBoard->occupied[c]);
+    attack_map_remove_piece(cBoard, c, type, f);
+    add_sq(t, cBoard->pieces[c][type]);
+    add_sq(t, cBoard->occupied[c]);
+    attack_map_add_piece(cBoard, c, type, t);
+  } else {
+    cBoard->pieces[c][type] ^= delta;
+    cBoard->occupied[c] ^= delta;
+  }
+  nnue_move_piece(get_accumulator(self), cBoard, c, type, f, t);
   return Qnil;
 }
 
@@ -118,6 +152,34 @@ static VALUE o_get_base_material(VALUE self, VALUE color){
   return INT2NUM(cBoard->material[SYM2COLOR(color)]);
 }
 
+static VALUE o_get_material_key(VALUE self){
+  return ULONG2NUM(get_cBoard(self)->material_key);
+}
+
+// Turns this board's attack map on or off.
+static VALUE o_set_attack_maps(VALUE self, VALUE enabled){
+  BOARD_DATA *b;
+  Data_Get_Struct(self, BOARD_DATA, b);
+  if(RTEST(enabled)){
+    b->brd.attackers = b->attackers;
+    build_attack_map(&b->brd);
+  } else {
+    b->brd.attackers = NULL;
+  }
+  return enabled;
+}
+
+// Returns the pieces of either color attacking the given square.
+static VALUE o_get_attack_map(VALUE self, VALUE square){
+  return ULONG2NUM(attack_map(get_cBoard(self), NUM2INT(square)));
+}
+
+// Sets whether boards created from now on keep an attack map.
+static VALUE set_default_attack_maps(VALUE self, VALUE enabled){
+  attack_maps = RTEST(enabled);
+  return enabled;
+}
+
 static VALUE o_in_endgame(VALUE self, VALUE color){
   BRD *cBoard = get_cBoard(self);
   int c = SYM2COLOR(color);
@@ -214,6 +276,10 @@ extern void Init_board(){
   rb_define_method(cls_board, "relocate_piece", RUBY_METHOD_FUNC(o_relocate_piece), 3);
 
   rb_define_method(cls_board, "get_base_material", RUBY_METHOD_FUNC(o_get_base_material), 1);
+  rb_define_method(cls_board, "material_key", RUBY_METHOD_FUNC(o_get_material_key), 0);
+  rb_define_method(cls_board, "attack_maps=", RUBY_METHOD_FUNC(o_set_attack_maps), 1);
+  rb_define_method(cls_board, "attack_map", RUBY_METHOD_FUNC(o_get_attack_map), 1);
+  rb_define_module_function(mod_bitboard, "attack_maps=", set_default_attack_maps, 1);
   rb_define_method(cls_board, "endgame?", RUBY_METHOD_FUNC(o_in_endgame), 1);
 
   printf("done.\n");
@@ -28,10 +28,19 @@
 
 #include "shared.h"
 
+// Each board carries the NNUE accumulator for its position, and optionally an attack map, alongside the bitboards.  
+// The BRD comes first, so the wrapped struct can be used wherever a BRD is expected.
+typedef struct {
+  BRD brd;
+  ACCUMULATOR acc;
+  BB attackers[64];  // the attack map, used when attack maps are enabled (see attack.c).
+} BOARD_DATA;
+
 void add_square(int color, int type, int sq);
 
 static void free_cBoard(BRD* board);
 extern BRD* get_cBoard(VALUE self);
+extern ACCUMULATOR* get_accumulator(VALUE self);
 static VALUE o_alloc(VALUE klass);
 static VALUE o_initialize(VALUE self, VALUE sq_board);
 
@@ -46,6 +55,11 @@ static VALUE o_test_legality(VALUE self, VALUE p, VALUE f, VALUE t, VALUE side_t
 
 static VALUE o_initialize_material(VALUE self, VALUE color);
 static VALUE o_get_base_material(VALUE self, VALUE color);
+static VALUE o_get_material_key(VALUE self);
+
+static VALUE o_set_attack_maps(VALUE self, VALUE enabled);
+static VALUE o_get_attack_map(VALUE self, VALUE square);
+static VALUE set_default_attack_maps(VALUE self, VALUE enabled);
 
 extern void Init_board();
   
@@ -0,0 +1,61 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef BOOK
+#define BOOK
+
+#include "shared.h"
+#include <stdint.h>
+
+// Polyglot books are arrays of 16 byte big-endian entries (key, move, weight, learn), sorted by key.  Keys are 
+// formed by XORing together values from a table of 781 random numbers: 768 for piece placement, 4 for castling 
+// rights, 8 for the en-passant file, and 1 for white to move.
+#define POLYGLOT_RANDOM_SIZE 781
+#define POLYGLOT_CASTLE      768
+#define POLYGLOT_ENP         772
+#define POLYGLOT_TURN        780
+#define BOOK_ENTRY_SIZE      16
+
+typedef struct {
+  uint8_t *base;
+  size_t size;
+  long count;
+} BOOK_FILE;
+
+extern uint64_t polyglot_random[POLYGLOT_RANDOM_SIZE];
+
+extern uint64_t polyglot_key(BRD *cBoard, int c, int castle, int enp_target);
+extern int polyglot_move(BRD *cBoard, int c, int move, int *from, int *to);
+
+static void free_book(BOOK_FILE *b);
+extern BOOK_FILE* get_book(VALUE self);
+static VALUE book_alloc(VALUE klass);
+
+static VALUE book_initialize(VALUE self, VALUE path);
+static VALUE book_count(VALUE self);
+static VALUE book_probe(VALUE self, VALUE p_board, VALUE color, VALUE castle, VALUE enp_target);
+
+static VALUE object_polyglot_key(VALUE self, VALUE p_board, VALUE color, VALUE castle, VALUE enp_target);
+static VALUE load_random64(VALUE self, VALUE path);
+
+extern void Init_book();
+
+#endif
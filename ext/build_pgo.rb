@@ -0,0 +1,125 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+# Builds a profile-guided, link-time optimized native extension in three stages:
+#
+# 1. An instrumented build (extconf.rb --with-pgo=generate).
+# 2. A training run of the bench, which searches its positions with the instrumented extension and writes out
+#    profile data.
+# 3. A rebuild using the profile data, with LTO (extconf.rb --with-pgo=use).
+#
+# The optimized build is then compared with a default build by running the bench with each in turn, and the best 
+# nodes/second of each is reported along with the speedup.  The optimized extension is left in ext/.  Most of the 
+# search runs in Ruby, so the bench gains little and its speedup can fall within run to run noise; run kernel_bench 
+# with each build (build/pgo/default.so and optimized.so) to compare the native kernels alone.  Run from the root of
+# the repository:
+#
+#   ruby ext/build_pgo.rb [training_depth] [bench_depth] [bench_runs]
+#
+# Set CC=clang to build with Clang; llvm-profdata must then be on the path.  Objects and profile data are kept
+# under build/pgo.
+
+require 'fileutils'
+require 'etc'
+require 'rbconfig'
+
+module PGOBuild
+  ROOT = File.expand_path('..', File.dirname(__FILE__))
+  EXTCONF = File.join(ROOT, 'ext', 'extconf.rb')
+  BUILD_DIR = File.join(ROOT, 'build', 'pgo')
+  PROFILE_DIR = File.join(BUILD_DIR, 'profile')
+  TARGET = "ruby_chess.#{RbConfig::CONFIG['DLEXT']}"
+
+  # Depth 5 takes 15-20 seconds per run, long enough that startup and timer noise don't dominate.
+  TRAINING_DEPTH = 5
+  BENCH_DEPTH = 5
+  BENCH_RUNS = 5
+
+  # Every stage builds in the same directory: GCC names its profile data after the object files it instruments.  The
+  # sources are copied into it rather than built from ext/, where make would otherwise pick up any objects left by 
+  # an in-place build.  The extension is installed in ext/ and a copy is kept as build/pgo/<name>.
+  def self.build(name, *options)
+    obj_dir = File.join(BUILD_DIR, 'obj')
+    FileUtils.rm_rf(obj_dir)
+    FileUtils.mkdir_p(obj_dir)
+    FileUtils.cp(Dir[File.join(ROOT, 'ext', '*.{c,h}')] << EXTCONF, obj_dir)
+    Dir.chdir(obj_dir) do
+      system(RbConfig.ruby, 'extconf.rb', "--with-pgo-dir=#{PROFILE_DIR}", *options) or abort 'extconf.rb failed'
+      system(ENV['MAKE'] || 'make', "-j#{Etc.nprocessors}") or abort 'make failed'
+    end
+    FileUtils.cp(File.join(obj_dir, TARGET), File.join(BUILD_DIR, "#{name}.#{RbConfig::CONFIG['DLEXT']}"))
+    install(name)
+  end
+
+  def self.install(name)
+    FileUtils.cp(File.join(BUILD_DIR, "#{name}.#{RbConfig::CONFIG['DLEXT']}"), File.join(ROOT, 'ext', TARGET))
+  end
+
+  # Runs the bench in a fresh interpreter, so that the extension just built is the one loaded.  Returns nodes/second.
+  def self.bench(depth)
+    output = Dir.chdir(ROOT) do
+      IO.popen([RbConfig.ruby, '-e', "require './initialize.rb'; bench(#{depth})"], &:read)
+    end
+    abort "bench failed:\n#{output}" unless $?.success? && output =~ /Nodes\/second\s*:\s*(\d+)/
+    $1.to_i
+  end
+
+  def self.clang?
+    (ENV['CC'] || RbConfig::CONFIG['CC']) =~ /clang/
+  end
+
+  def self.run(training_depth=TRAINING_DEPTH, bench_depth=BENCH_DEPTH, bench_runs=BENCH_RUNS)
+    puts "Stage 0: default build"
+    build('default')
+
+    puts "Stage 1: instrumented build"
+    FileUtils.rm_rf(PROFILE_DIR)
+    FileUtils.mkdir_p(PROFILE_DIR)
+    build('instrumented', '--with-pgo=generate')
+
+    puts "Stage 2: training run (bench at depth #{training_depth})"
+    bench(training_depth)
+    if clang?
+      profiles = Dir[File.join(PROFILE_DIR, '*.profraw')]
+      system('llvm-profdata', 'merge', "-output=#{File.join(PROFILE_DIR, 'default.profdata')}", *profiles) or
+        abort 'llvm-profdata merge failed'
+    end
+
+    puts "Stage 3: optimized build (PGO + LTO)"
+    build('optimized', '--with-pgo=use')
+
+    puts "Comparing builds (bench at depth #{bench_depth}, best of #{bench_runs})"
+    nps = Hash.new { |h, name| h[name] = [] }
+    bench_runs.times do  # alternate between builds, so that both see the same background load.
+      %w(default optimized).each do |name|
+        install(name)
+        nps[name] << bench(bench_depth)
+      end
+    end
+
+    puts "\n==========================="
+    puts "Default build  : #{nps['default'].max} nodes/second (worst #{nps['default'].min})"
+    puts "PGO + LTO build: #{nps['optimized'].max} nodes/second (worst #{nps['optimized'].min})"
+    puts "Speedup        : #{(nps['optimized'].max.to_f/nps['default'].max).round(3)}x"
+  end
+end
+
+PGOBuild.run(*ARGV.map(&:to_i)) if __FILE__ == $0
@@ -0,0 +1,112 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#include "cpu.h"
+
+#ifdef CPU_X86
+#include <cpuid.h>
+#endif
+
+// Runtime ISA dispatch
+//
+// The levels build on one another: POPCNT gives a hardware pop count (without it, __builtin_popcountl is a library
+// call), BMI2 adds LZCNT/TZCNT and the other bit manipulation instructions, and AVX2 adds the vectorized slider fills
+// and NNUE kernels.  The highest level supported by both the CPU and the OS is found with cpuid when the extension 
+// is loaded, and each module's kernel pointers are set to that level's variants.  Setting CHESS_ISA selects a lower 
+// level, e.g. to compare levels with the kernel bench.
+
+static const char *isa_names[ISA_COUNT] = { "generic", "popcnt", "bmi2", "avx2" };
+
+static int supported_isa = ISA_GENERIC;
+int cpu_isa = ISA_GENERIC;
+
+static int detect_isa(){
+#ifdef CPU_X86
+  unsigned a, b, c, d, xcr0_lo, xcr0_hi;
+  int os_saves_ymm = 0;
+  if(!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_POPCNT)) return ISA_GENERIC;
+  if((c & bit_OSXSAVE) && (c & bit_AVX)){  // the OS must save the upper halves of the ymm registers.
+    __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    os_saves_ymm = (xcr0_lo & 0x6) == 0x6;
+  }
+  if(!__get_cpuid(0x80000001, &a, &b, &c, &d) || !(c & bit_LZCNT)) return ISA_POPCNT;
+  if(!__get_cpuid_count(7, 0, &a, &b, &c, &d) || !(b & bit_BMI) || !(b & bit_BMI2)) return ISA_POPCNT;
+  if(!(b & bit_AVX2) || !os_saves_ymm) return ISA_BMI2;
+  return ISA_AVX2;
+#else
+  return ISA_GENERIC;
+#endif
+}
+
+static int isa_index(const char *name){
+  for(int isa = ISA_GENERIC; isa < ISA_COUNT; isa++){
+    if(!strcmp(name, isa_names[isa])) return isa;
+  }
+  return -1;
+}
+
+extern void select_isa(int isa){
+  cpu_isa = isa;
+  select_attack_kernels(isa);
+  select_eval_kernels(isa);
+  select_nnue_kernels(isa);
+}
+
+
+// Ruby interface
+
+static VALUE get_isa(VALUE self){
+  return ID2SYM(rb_intern(isa_names[cpu_isa]));
+}
+
+static VALUE get_supported_isas(VALUE self){
+  VALUE isas = rb_ary_new();
+  for(int isa = ISA_GENERIC; isa <= supported_isa; isa++) rb_ary_push(isas, ID2SYM(rb_intern(isa_names[isa])));
+  return isas;
+}
+
+static VALUE set_isa(VALUE self, VALUE isa){
+  const char *name = rb_id2name(SYM2ID(isa));
+  int i = isa_index(name);
+  if(i < 0) rb_raise(rb_eArgError, "unknown ISA: %s", name);
+  if(i > supported_isa) rb_raise(rb_eArgError, "%s is not supported on this CPU", name);
+  select_isa(i);
+  return isa;
+}
+
+extern void Init_cpu(){
+  printf("  -Loading cpu extension...");
+
+  VALUE mod_chess = rb_define_module("Chess");
+  VALUE mod_cpu = rb_define_module_under(mod_chess, "CPU");
+
+  rb_define_module_function(mod_cpu, "isa", get_isa, 0);
+  rb_define_module_function(mod_cpu, "supported_isas", get_supported_isas, 0);
+  rb_define_module_function(mod_cpu, "isa=", set_isa, 1);
+
+  supported_isa = detect_isa();
+  int isa = supported_isa;
+  const char *requested = getenv("CHESS_ISA");
+  if(requested && isa_index(requested) >= 0 && isa_index(requested) < isa) isa = isa_index(requested);
+  select_isa(isa);
+
+  printf("done (%s kernels).\n", isa_names[cpu_isa]);
+}
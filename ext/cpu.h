@@ -0,0 +1,68 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef CPU
+#define CPU
+
+#include "shared.h"
+
+// Hot kernels (pop counts, slider attacks, mobility, SEE and evaluation) are compiled once for each of the ISA levels
+// below, and the best level the host supports is selected when the extension is loaded (see cpu.c).  The extension
+// itself is built for the baseline ISA, so one binary runs on every x86-64 host.
+typedef enum { ISA_GENERIC, ISA_POPCNT, ISA_BMI2, ISA_AVX2, ISA_COUNT } enumIsa;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_X86
+#include <immintrin.h>
+#define ISA_TARGET(options) __attribute__((target(options)))
+#else
+#define ISA_TARGET(options)
+#endif
+
+#define POPCNT_TARGET "popcnt"
+#define BMI2_TARGET   "popcnt,lzcnt,bmi,bmi2"
+#define AVX2_TARGET   "popcnt,lzcnt,bmi,bmi2,avx2"
+
+// A kernel is written once as name_kernel(), a KERNEL_INLINE function taking its ISA level as the first argument.
+// KERNEL_VARIANTS(ret, name, (params), args...) then defines a wrapper for each level, compiled with that level's 
+// target options, and a table name_variants[] of the wrappers indexed by level.  Everything the kernel calls that 
+// should be compiled for the wrapper's level must also be KERNEL_INLINE.
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+
+#define KERNEL_VARIANTS(ret, name, params, ...)                                                                   \
+  static ret name##_generic params { return name##_kernel(ISA_GENERIC, __VA_ARGS__); }                            \
+  ISA_TARGET(POPCNT_TARGET) static ret name##_popcnt params { return name##_kernel(ISA_POPCNT, __VA_ARGS__); }    \
+  ISA_TARGET(BMI2_TARGET) static ret name##_bmi2 params { return name##_kernel(ISA_BMI2, __VA_ARGS__); }          \
+  ISA_TARGET(AVX2_TARGET) static ret name##_avx2 params { return name##_kernel(ISA_AVX2, __VA_ARGS__); }          \
+  static ret (* const name##_variants[ISA_COUNT]) params = { name##_generic, name##_popcnt, name##_bmi2,          \
+                                                             name##_avx2 };
+
+extern int cpu_isa;  // the ISA level currently in use.
+
+extern void select_isa(int isa);
+
+static VALUE get_isa(VALUE self);
+static VALUE get_supported_isas(VALUE self);
+static VALUE set_isa(VALUE self, VALUE isa);
+
+extern void Init_cpu();
+
+#endif
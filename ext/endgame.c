@@ -0,0 +1,252 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#include "endgame.h"
+
+static EG_ENTRY eg_table[EG_HASH_SIZE];
+
+// KPK bitbase.  One bit per position with the pawn's side as white, set if white wins.  Positions with the pawn on 
+// files e-h are mirrored onto files a-d.
+static uint32_t kpk_bitbase[KPK_SIZE/32];
+
+enum { KPK_INVALID = 0, KPK_UNKNOWN = 1, KPK_DRAW = 2, KPK_WIN = 4 };
+
+static int kpk_index(int stm, int bk, int wk, int psq){
+  return wk | (bk << 6) | (stm << 12) | (column(psq) << 13) | ((6 - row(psq)) << 15);
+}
+
+// Classifies the positions that can be decided without looking ahead.
+static int kpk_initial(int stm, int wk, int bk, int psq){
+  BB pawn_attacks = pawn_attack_masks[WHITE][psq];
+  int promote_sq = psq + 8;
+
+  if(chebyshev_distance(wk, bk) <= 1 || wk == psq || bk == psq) return KPK_INVALID;
+  if(stm == WHITE && (pawn_attacks & sq_mask_on(bk))) return KPK_INVALID;
+  // White promotes without the queen being taken.
+  if(stm == WHITE && row(psq) == 6 && wk != promote_sq && bk != promote_sq && 
+     (chebyshev_distance(bk, promote_sq) > 1 || (king_masks[wk] & sq_mask_on(promote_sq)))) return KPK_WIN;
+  // Black is stalemated, or takes the pawn.
+  if(stm == BLACK && (!(king_masks[bk] & ~(king_masks[wk] | pawn_attacks)) || 
+                      (king_masks[bk] & sq_mask_on(psq) & ~king_masks[wk]))) return KPK_DRAW;
+  return KPK_UNKNOWN;
+}
+
+// A position is won for white if any white move (or every black move) leads to a win, and drawn if any black move 
+// (or every white move) leads to a draw.  Otherwise it stays unknown until its successors are resolved.
+static int kpk_classify(uint8_t *db, int stm, int wk, int bk, int psq){
+  int good = stm == WHITE ? KPK_WIN : KPK_DRAW;
+  int bad = stm == WHITE ? KPK_DRAW : KPK_WIN;
+  int r = KPK_INVALID;
+  int sq;
+
+  for(BB b = king_masks[stm == WHITE ? wk : bk]; b; clear_sq(sq, b)){
+    sq = lsb(b);
+    r |= stm == WHITE ? db[kpk_index(BLACK, bk, sq, psq)] : db[kpk_index(WHITE, sq, wk, psq)];
+  }
+  if(stm == WHITE){
+    if(row(psq) < 6) r |= db[kpk_index(BLACK, bk, wk, psq + 8)];
+    if(row(psq) == 1 && psq + 8 != wk && psq + 8 != bk) r |= db[kpk_index(BLACK, bk, wk, psq + 16)];
+  }
+  return (r & good) ? good : ((r & KPK_UNKNOWN) ? KPK_UNKNOWN : bad);
+}
+
+// Retrograde analysis over every KPK position, repeated until no unknown position can be resolved.  Anything still 
+// unknown at that point is a draw.
+static void generate_kpk(){
+  uint8_t *db = ALLOC_N(uint8_t, KPK_SIZE);
+  int changed = 1;
+
+  for(int i = 0; i < KPK_SIZE; i++){
+    db[i] = kpk_initial((i >> 12) & 1, i & 63, (i >> 6) & 63, 8*(6 - (i >> 15)) + ((i >> 13) & 3));
+  }
+  while(changed){
+    changed = 0;
+    for(int i = 0; i < KPK_SIZE; i++){
+      if(db[i] != KPK_UNKNOWN) continue;
+      db[i] = kpk_classify(db, (i >> 12) & 1, i & 63, (i >> 6) & 63, 8*(6 - (i >> 15)) + ((i >> 13) & 3));
+      changed |= db[i] != KPK_UNKNOWN;
+    }
+  }
+  memset(kpk_bitbase, 0, sizeof(kpk_bitbase));
+  for(int i = 0; i < KPK_SIZE; i++){
+    if(db[i] == KPK_WIN) kpk_bitbase[i >> 5] |= 1U << (i & 31);
+  }
+  xfree(db);
+}
+
+
+// Helpers for driving the losing king into a corner.
+
+static int push_to_edge(int sq){
+  return 20 * (6 - min(row(sq), 7 - row(sq)) - min(column(sq), 7 - column(sq)));
+}
+
+static int push_close(int a, int b){
+  return 20 * (7 - chebyshev_distance(a, b));
+}
+
+#define light_square(sq) ((row(sq) + column(sq)) & 1)
+
+
+// Value functions
+
+static int draw_value(BRD *cBoard, int strong, int c){
+  return 0;
+}
+
+static int kpk_value(BRD *cBoard, int strong, int c){
+  int wk = lsb(cBoard->pieces[strong][KING]);
+  int bk = lsb(cBoard->pieces[strong^1][KING]);
+  int psq = lsb(cBoard->pieces[strong][PAWN]);
+
+  if(strong == BLACK){  // view the board from the pawn's side.
+    wk ^= 56; bk ^= 56; psq ^= 56;
+  }
+  if(column(psq) >= 4){
+    wk ^= 7; bk ^= 7; psq ^= 7;
+  }
+  if(row(psq) < 1 || row(psq) > 6) return 0;
+  int index = kpk_index(c == strong ? WHITE : BLACK, bk, wk, psq);
+  if(!(kpk_bitbase[index >> 5] & (1U << (index & 31)))) return 0;
+  return EG_KNOWN_WIN + piece_values[PAWN] + 10 * row(psq);
+}
+
+// KRK and KQK.  The weak king is driven to the edge with the strong king close behind.
+static int mating_value(BRD *cBoard, int strong, int c){
+  int winner = lsb(cBoard->pieces[strong][KING]);
+  int loser = lsb(cBoard->pieces[strong^1][KING]);
+  return EG_KNOWN_WIN + cBoard->material[strong] - piece_values[KING] + push_to_edge(loser) + push_close(winner, loser);
+}
+
+// Mate can only be forced in a corner of the bishop's color.
+static int kbnk_value(BRD *cBoard, int strong, int c){
+  int winner = lsb(cBoard->pieces[strong][KING]);
+  int loser = lsb(cBoard->pieces[strong^1][KING]);
+  int corner = light_square(lsb(cBoard->pieces[strong][BISHOP])) ? H1 : A1;
+  int opposite = corner ^ 63;
+  int distance = min(manhattan_distance(loser, corner), manhattan_distance(loser, opposite));
+  return EG_KNOWN_WIN + piece_values[KNIGHT] + piece_values[BISHOP] + push_close(winner, loser) + 20 * (14 - distance);
+}
+
+
+// Scale functions
+
+// A rook against a minor piece is usually drawn.
+static int drawish_scale(BRD *cBoard, int strong, int c){
+  return EG_SCALE_NORMAL / 4;
+}
+
+// A rook pawn can't be forced through when the bishop doesn't control the queening square and the weak king holds it.
+static int kbpk_scale(BRD *cBoard, int strong, int c){
+  int psq = lsb(cBoard->pieces[strong][PAWN]);
+  int loser = lsb(cBoard->pieces[strong^1][KING]);
+  int queening_sq = strong ? 56 + column(psq) : column(psq);
+
+  if(column(psq) != 0 && column(psq) != 7) return EG_SCALE_NORMAL;
+  if(light_square(queening_sq) == light_square(lsb(cBoard->pieces[strong][BISHOP]))) return EG_SCALE_NORMAL;
+  return chebyshev_distance(loser, queening_sq) <= 1 ? 0 : EG_SCALE_NORMAL;
+}
+
+
+static const struct {
+  const char *code;
+  int kind;
+  EG_FUNCTION fn;
+} endgames[] = {
+  { "KPvK",   EG_VALUE, kpk_value },
+  { "KRvK",   EG_VALUE, mating_value },
+  { "KQvK",   EG_VALUE, mating_value },
+  { "KBNvK",  EG_VALUE, kbnk_value },
+  { "KvK",    EG_VALUE, draw_value },
+  { "KNvK",   EG_VALUE, draw_value },
+  { "KBvK",   EG_VALUE, draw_value },
+  { "KNNvK",  EG_VALUE, draw_value },
+  { "KNvKN",  EG_VALUE, draw_value },
+  { "KBvKN",  EG_VALUE, draw_value },
+  { "KBvKB",  EG_VALUE, draw_value },
+  { "KRvKN",  EG_SCALE, drawish_scale },
+  { "KRvKB",  EG_SCALE, drawish_scale },
+  { "KBPvK",  EG_SCALE, kbpk_scale }
+};
+
+static int eg_hash_index(BB key){
+  return (int)((key * 0x9E3779B97F4A7C15UL) >> (64 - EG_HASH_BITS));
+}
+
+extern EG_ENTRY *probe_endgame(BRD *cBoard){
+  for(int i = eg_hash_index(cBoard->material_key); eg_table[i].fn; i = (i+1) & (EG_HASH_SIZE-1)){
+    if(eg_table[i].key == cBoard->material_key) return &eg_table[i];
+  }
+  return NULL;
+}
+
+// The entry's score from the perspective of side c.
+extern int endgame_score(EG_ENTRY *entry, BRD *cBoard, int c){
+  int score = entry->fn(cBoard, entry->strong, c);
+  return c == entry->strong ? score : -score;
+}
+
+// Scales down a general evaluation (from the perspective of side c) that favors the stronger side.
+extern int endgame_scale(EG_ENTRY *entry, BRD *cBoard, int c, int score){
+  if((c == entry->strong) != (score > 0)) return score;
+  return score * entry->fn(cBoard, entry->strong, c) / EG_SCALE_NORMAL;
+}
+
+// Adds the endgame under the key for each color taking the stronger side.  Symmetric endgames share one key.
+static void add_endgame(const char *code, int kind, EG_FUNCTION fn){
+  for(int strong = BLACK; strong <= WHITE; strong++){
+    BB key = 0;
+    int side = strong;
+    for(const char *p = code; *p; p++){
+      if(*p == 'v'){
+        side ^= 1;
+        continue;
+      }
+      key += material_key_delta(side, strchr("PNBRQK", *p) - "PNBRQK");
+    }
+    int i = eg_hash_index(key);
+    while(eg_table[i].fn && eg_table[i].key != key) i = (i+1) & (EG_HASH_SIZE-1);
+    if(eg_table[i].fn) continue;
+    eg_table[i] = (EG_ENTRY){ key, strong, kind, fn, code };
+  }
+}
+
+// Returns the code of the endgame recognized on the board (e.g. "KPvK"), or nil.
+static VALUE recognize_endgame(VALUE self, VALUE p_board){
+  EG_ENTRY *entry = probe_endgame(get_cBoard(p_board));
+  return entry ? rb_str_new2(entry->code) : Qnil;
+}
+
+extern void Init_endgame(){
+  printf("  -Loading endgame extension...");
+
+  generate_kpk();
+  memset(eg_table, 0, sizeof(eg_table));
+  for(size_t i = 0; i < sizeof(endgames)/sizeof(endgames[0]); i++){
+    add_endgame(endgames[i].code, endgames[i].kind, endgames[i].fn);
+  }
+
+  VALUE mod_chess = rb_define_module("Chess");
+  VALUE mod_eval = rb_define_module_under(mod_chess, "Evaluation");
+  rb_define_module_function(mod_eval, "endgame", recognize_endgame, 1);
+
+  printf("done.\n");
+}
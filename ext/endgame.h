@@ -0,0 +1,66 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef ENDGAME
+#define ENDGAME
+
+#include "shared.h"
+#include <stdint.h>
+#include <string.h>
+
+// Specialized endgame evaluation.  Each board carries a material key counting the pieces of each type held by each 
+// side, kept up to date as pieces are added and removed.  The key indexes a table of handlers for endgames the 
+// general evaluation misjudges: some score the position outright (KPK from a bitbase, the basic mates, dead draws), 
+// others scale the general evaluation down when the stronger side can't be expected to win.
+
+// Four bits per count, with white's counts in the low 24 bits, as in the tablebase material keys (tablebase.c).
+#define material_key_delta(c, type) (1UL << (4*(type) + ((c) ? 0 : 24)))
+
+#define EG_KNOWN_WIN    10000  // below tablebase wins and mate scores, but above any heuristic evaluation.
+#define EG_SCALE_NORMAL 64
+#define EG_HASH_BITS    8
+#define EG_HASH_SIZE    (1 << EG_HASH_BITS)
+
+#define KPK_SIZE (2*24*64*64)  // side to move, pawn on files a-d and ranks 2-7, and both king squares.
+
+enum { EG_VALUE, EG_SCALE };
+
+// Endgame functions take the color of the side holding the extra material, and the side to move.  Value functions 
+// return a score for the stronger side, and scale functions a factor out of EG_SCALE_NORMAL.
+typedef int (*EG_FUNCTION)(BRD *cBoard, int strong, int c);
+
+typedef struct {
+  BB key;
+  int strong;
+  int kind;
+  EG_FUNCTION fn;
+  const char *code;  // e.g. "KBNvK", with the stronger side first.
+} EG_ENTRY;
+
+extern EG_ENTRY *probe_endgame(BRD *cBoard);
+extern int endgame_score(EG_ENTRY *entry, BRD *cBoard, int c);
+extern int endgame_scale(EG_ENTRY *entry, BRD *cBoard, int c, int score);
+
+static VALUE recognize_endgame(VALUE self, VALUE p_board);
+
+extern void Init_endgame();
+
+#endif
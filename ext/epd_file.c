@@ -0,0 +1,401 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#include "epd_file.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Bulk EPD parser (see epd_file.h).  A line holds the four FEN fields for piece placement, side to move, castling 
+// rights and en passant target, optionally followed by the two FEN clocks, then any number of operations of the 
+// form 'opcode operand...;'.  Besides bm, am, id and c0, the parser reads the clocks from hmvc and fmvn, and a game 
+// result from c9 ("1-0", "1/2-1/2", "0-1") or a bracketed score ([1.0], [0.5], [0.0]) for tuning.
+
+static const char *OPCODE_NAMES[EPD_OPCODES] = { "bm", "am", "id", "c0" };
+
+// Castling rights, as in MoveGen.
+#define CASTLE_WQ 0x8
+#define CASTLE_WK 0x4
+#define CASTLE_BQ 0x2
+#define CASTLE_BK 0x1
+
+// Returns the position file code for a FEN piece letter, or -1.
+static int piece_code(char ch){
+  int color = isupper(ch) ? WHITE : BLACK;
+  switch(tolower(ch)){
+    case 'p': return (PAWN << 1) | color;
+    case 'n': return (KNIGHT << 1) | color;
+    case 'b': return (BISHOP << 1) | color;
+    case 'r': return (ROOK << 1) | color;
+    case 'q': return (QUEEN << 1) | color;
+    case 'k': return (KING << 1) | color;
+    default: return -1;
+  }
+}
+
+static int is_blank(char ch){
+  return ch == ' ' || ch == '\t' || ch == '\r';
+}
+
+static const char* skip_blanks(const char *p, const char *end){
+  while(p < end && is_blank(*p)) p++;
+  return p;
+}
+
+static const char* token_end(const char *p, const char *end){
+  while(p < end && !is_blank(*p) && *p != ';') p++;
+  return p;
+}
+
+// Reads an unsigned number filling the whole token.  Returns -1 if the token isn't a number.
+static long parse_number(const char *p, const char *end){
+  long n = 0;
+  if(p == end) return -1;
+  for(; p < end; p++){
+    if(!isdigit(*p) || n > 0xffffff) return -1;
+    n = n * 10 + (*p - '0');
+  }
+  return n;
+}
+
+// Returns a result code (2 if white won, 1 for a draw, 0 if black won) for a c9 operand or bracketed score, or 
+// PF_NO_RESULT.
+static int parse_result(const char *p, long length){
+  if((length == 3 && !memcmp(p, "1-0", 3)) || (length == 3 && !memcmp(p, "1.0", 3))) return 2;
+  if((length == 3 && !memcmp(p, "0-1", 3)) || (length == 3 && !memcmp(p, "0.0", 3))) return 0;
+  if((length == 7 && !memcmp(p, "1/2-1/2", 7)) || (length == 3 && !memcmp(p, "0.5", 3))) return 1;
+  return PF_NO_RESULT;
+}
+
+// Packs the piece placement field.  Returns a pointer past the field, or NULL if it isn't a valid placement of at 
+// most 32 pieces.
+static const char* parse_placement(const char *p, const char *end, PACKED_POSITION *record){
+  uint8_t codes[64];
+  int rank = 7, file = 0, code, i = 0;
+  BB occupied = 0;
+  for(; p < end && !is_blank(*p); p++){
+    if(*p >= '1' && *p <= '8'){
+      file += *p - '0';
+      if(file > 8) return NULL;
+    } else if(*p == '/'){
+      if(file != 8 || rank == 0) return NULL;
+      rank--;
+      file = 0;
+    } else {
+      if((code = piece_code(*p)) < 0 || file > 7) return NULL;
+      codes[rank * 8 + file] = code;
+      occupied |= (BB)1 << (rank * 8 + file);
+      file++;
+    }
+  }
+  if(rank != 0 || file != 8 || pop_count(occupied) > 32) return NULL;
+  record->occupied = occupied;
+  for(BB b = occupied; b; b &= b-1, i++) record->pieces[i >> 1] |= codes[lsb(b)] << ((i & 1) * 4);
+  return p;
+}
+
+// Parses one line (without its newline) into a record and the spans of its operations.  Returns 0 if the line 
+// isn't a valid EPD or FEN position.
+static int parse_line(const char *start, const char *end, PACKED_POSITION *record, EPD_LINE *line){
+  const char *p = start, *q;
+  int castle = 0, enp_target = PF_NO_SQUARE, result = PF_NO_RESULT;
+  long halfmove_clock = 0, fullmove = 1, n;
+
+  memset(record, 0, sizeof(PACKED_POSITION));
+  memset(line->ops, 0, sizeof(line->ops));
+  if(!(p = parse_placement(skip_blanks(p, end), end, record))) return 0;
+
+  p = skip_blanks(p, end);
+  if(end - p < 1 || (*p != 'w' && *p != 'b') || (p + 1 < end && !is_blank(p[1]))) return 0;
+  record->flags = *p == 'w' ? PF_WHITE_TO_MOVE : 0;
+
+  p = skip_blanks(p + 1, end);
+  for(q = token_end(p, end); p < q; p++){
+    switch(*p){
+      case 'K': castle |= CASTLE_WK; break;
+      case 'Q': castle |= CASTLE_WQ; break;
+      case 'k': castle |= CASTLE_BK; break;
+      case 'q': castle |= CASTLE_BQ; break;
+      case '-': break;
+      default: return 0;
+    }
+  }
+
+  p = skip_blanks(p, end);
+  q = token_end(p, end);
+  if(q - p == 2 && p[0] >= 'a' && p[0] <= 'h' && p[1] >= '1' && p[1] <= '8'){
+    enp_target = (p[1] - '1') * 8 + (p[0] - 'a');
+  } else if(q - p != 1 || *p != '-'){
+    return 0;
+  }
+
+  // FEN clocks.
+  p = skip_blanks(q, end);
+  if((n = parse_number(p, q = token_end(p, end))) >= 0){
+    halfmove_clock = n;
+    p = skip_blanks(q, end);
+    if((n = parse_number(p, q = token_end(p, end))) >= 0){
+      fullmove = n;
+      p = skip_blanks(q, end);
+    }
+  }
+
+  // Operations.  Operands run to the next semicolon outside of a quoted string.
+  while(p < end){
+    if(*p == '['){
+      for(q = p; q < end && *q != ']'; q++);
+      result = parse_result(p + 1, q - p - 1);
+      p = skip_blanks(q + (q < end), end);
+      continue;
+    }
+    const char *opcode = p;
+    long opcode_length = (q = token_end(p, end)) - p;
+    int quoted = 0;
+    if(opcode_length == 0){  // a stray semicolon.
+      p = skip_blanks(p + 1, end);
+      continue;
+    }
+    const char *operand = p = skip_blanks(q, end);
+    for(; p < end && (quoted || *p != ';'); p++) if(*p == '"') quoted = !quoted;
+    q = p;
+    while(q > operand && is_blank(q[-1])) q--;
+    if(q - operand >= 2 && *operand == '"' && q[-1] == '"'){
+      operand++;
+      q--;
+    }
+    p = skip_blanks(p + (p < end), end);
+
+    if(opcode_length == 4 && !memcmp(opcode, "hmvc", 4)){
+      if((halfmove_clock = parse_number(operand, q)) < 0) return 0;
+    } else if(opcode_length == 4 && !memcmp(opcode, "fmvn", 4)){
+      if((fullmove = parse_number(operand, q)) < 0) return 0;
+    } else if(opcode_length == 2 && !memcmp(opcode, "c9", 2)){
+      result = parse_result(operand, q - operand);
+    } else if(opcode_length == 2){
+      for(int op = 0; op < EPD_OPCODES; op++){
+        if(memcmp(opcode, OPCODE_NAMES[op], 2)) continue;
+        line->ops[op].offset = operand - start;
+        line->ops[op].length = q - operand;
+      }
+    }
+  }
+
+  record->flags |= castle << PF_CASTLE_SHIFT;
+  record->enp_target = enp_target;
+  record->halfmove_clock = min(halfmove_clock, 255);
+  record->fullmove = min(fullmove, 0xffff);
+  record->result = result;
+  return 1;
+}
+
+static void grow_reader(EPD_READER *r){
+  r->capacity = r->capacity ? r->capacity * 2 : EPD_CAPACITY;
+  REALLOC_N(r->records, PACKED_POSITION, r->capacity);
+  REALLOC_N(r->lines, EPD_LINE, r->capacity);
+}
+
+// Indexes every non-blank line of the mapped file.  Returns the number (from 1) of the first line that can't be 
+// parsed, or 0 if all of them parsed.
+static long parse_file(EPD_READER *r){
+  const char *text = (const char *)r->base, *end = text + r->size, *p = text, *eol;
+  long line_number = 0;
+  for(; p < end; p = eol + 1){
+    line_number++;
+    if(!(eol = memchr(p, '\n', end - p))) eol = end;
+    if(skip_blanks(p, eol) == eol) continue;
+    if(eol - p > EPD_MAX_LINE) return line_number;
+    if(r->count == r->capacity) grow_reader(r);
+    EPD_LINE *line = &r->lines[r->count];
+    if(!parse_line(p, eol, &r->records[r->count], line)) return line_number;
+    line->offset = p - text;
+    line->length = eol - p;
+    r->count++;
+  }
+  return 0;
+}
+
+static void release_reader(EPD_READER *r){
+  if(r->base) munmap(r->base, r->size);
+  if(r->records) ruby_xfree(r->records);
+  if(r->lines) ruby_xfree(r->lines);
+  r->base = NULL;
+  r->records = NULL;
+  r->lines = NULL;
+  r->count = r->capacity = 0;
+}
+
+static void free_reader(EPD_READER *r){
+  release_reader(r);
+  ruby_xfree(r);
+}
+
+static EPD_READER* get_reader(VALUE self){
+  EPD_READER *r;
+  Data_Get_Struct(self, EPD_READER, r);
+  if(!r->base) rb_raise(rb_eIOError, "closed EPD file");
+  return r;
+}
+
+static long get_index(EPD_READER *r, VALUE index){
+  long i = NUM2LONG(index);
+  if(i < 0 || i >= r->count) rb_raise(rb_eIndexError, "line %ld out of range", i);
+  return i;
+}
+
+static void check_range(EPD_READER *r, long start, long count){
+  if(start < 0 || count < 0 || start + count > r->count) rb_raise(rb_eIndexError, "lines out of range");
+}
+
+static VALUE epd_reader_alloc(VALUE klass){
+  EPD_READER *r = ALLOC(EPD_READER);
+  memset(r, 0, sizeof(EPD_READER));
+  return Data_Wrap_Struct(klass, 0, free_reader, r);
+}
+
+// Memory-maps and parses the whole file.  Raises ArgumentError naming the first line that isn't a valid position.
+static VALUE epd_reader_initialize(VALUE self, VALUE path){
+  EPD_READER *r;
+  Data_Get_Struct(self, EPD_READER, r);
+  struct stat st;
+  struct timespec start, finish;
+  int fd = open(StringValueCStr(path), O_RDONLY);
+  if(fd == -1) rb_sys_fail(StringValueCStr(path));
+  if(fstat(fd, &st) || st.st_size == 0){
+    close(fd);
+    rb_raise(rb_eArgError, "%s is empty", StringValueCStr(path));
+  }
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(base == MAP_FAILED) rb_sys_fail(StringValueCStr(path));
+  madvise(base, st.st_size, MADV_SEQUENTIAL);
+  r->base = base;
+  r->size = st.st_size;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  long error_line = parse_file(r);
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  if(error_line){
+    release_reader(r);
+    rb_raise(rb_eArgError, "%s:%ld: invalid EPD", StringValueCStr(path), error_line);
+  }
+  r->parse_time = (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec) / 1e9;
+  return self;
+}
+
+static VALUE epd_reader_count(VALUE self){
+  return LONG2NUM(get_reader(self)->count);
+}
+
+static VALUE epd_reader_bytes(VALUE self){
+  return SIZET2NUM(get_reader(self)->size);
+}
+
+static VALUE epd_reader_parse_time(VALUE self){
+  return rb_float_new(get_reader(self)->parse_time);
+}
+
+static VALUE epd_reader_line(VALUE self, VALUE index){
+  EPD_READER *r = get_reader(self);
+  EPD_LINE *line = &r->lines[get_index(r, index)];
+  return rb_str_new((char *)r->base + line->offset, line->length);
+}
+
+// Returns the operand of the given opcode (bm, am, id or c0), without any quotes, or nil if the line doesn't have 
+// that operation.
+static VALUE epd_reader_operation(VALUE self, VALUE index, VALUE opcode){
+  EPD_READER *r = get_reader(self);
+  EPD_LINE *line = &r->lines[get_index(r, index)];
+  const char *name = StringValueCStr(opcode);
+  for(int op = 0; op < EPD_OPCODES; op++){
+    if(strcmp(name, OPCODE_NAMES[op])) continue;
+    if(line->ops[op].length == 0) return Qnil;
+    return rb_str_new((char *)r->base + line->offset + line->ops[op].offset, line->ops[op].length);
+  }
+  rb_raise(rb_eArgError, "unsupported opcode %s", name);
+}
+
+static VALUE epd_reader_entry(VALUE self, VALUE index){
+  EPD_READER *r = get_reader(self);
+  return position_record_entry(&r->records[get_index(r, index)]);
+}
+
+static VALUE epd_reader_load(VALUE self, VALUE index, VALUE p_board){
+  EPD_READER *r = get_reader(self);
+  PACKED_POSITION *record = &r->records[get_index(r, index)];
+  unpack_position_record(record, get_cBoard(p_board));
+  nnue_invalidate(get_accumulator(p_board));
+  return position_record_info(record);
+}
+
+static VALUE epd_reader_records(VALUE self, VALUE start, VALUE count){
+  EPD_READER *r = get_reader(self);
+  check_range(r, NUM2LONG(start), NUM2LONG(count));
+  return rb_str_new((char *)&r->records[NUM2LONG(start)], NUM2LONG(count) * sizeof(PACKED_POSITION));
+}
+
+// Returns the records of every line labeled with a game result.
+static VALUE epd_reader_labeled_records(VALUE self){
+  EPD_READER *r = get_reader(self);
+  long labeled = 0;
+  for(long i = 0; i < r->count; i++) labeled += r->records[i].result != PF_NO_RESULT;
+  VALUE records = rb_str_new(NULL, labeled * sizeof(PACKED_POSITION));
+  PACKED_POSITION *out = (PACKED_POSITION *)RSTRING_PTR(records);
+  for(long i = 0; i < r->count; i++) if(r->records[i].result != PF_NO_RESULT) *out++ = r->records[i];
+  return records;
+}
+
+static VALUE epd_reader_batch(VALUE self, VALUE start, VALUE count){
+  EPD_READER *r = get_reader(self);
+  check_range(r, NUM2LONG(start), NUM2LONG(count));
+  return unpack_position_batch(&r->records[NUM2LONG(start)], NUM2LONG(count));
+}
+
+static VALUE epd_reader_close(VALUE self){
+  release_reader(get_reader(self));
+  return Qnil;
+}
+
+extern void Init_epd_file(){
+  printf("  -Loading epd_file extension...");
+
+  VALUE mod_chess = rb_define_module("Chess");
+  VALUE mod_epd_file = rb_define_module_under(mod_chess, "EPDFile");
+  VALUE cls_reader = rb_define_class_under(mod_epd_file, "Reader", rb_cObject);
+
+  rb_define_alloc_func(cls_reader, epd_reader_alloc);
+  rb_define_method(cls_reader, "initialize", RUBY_METHOD_FUNC(epd_reader_initialize), 1);
+  rb_define_method(cls_reader, "count", RUBY_METHOD_FUNC(epd_reader_count), 0);
+  rb_define_method(cls_reader, "bytes", RUBY_METHOD_FUNC(epd_reader_bytes), 0);
+  rb_define_method(cls_reader, "parse_time", RUBY_METHOD_FUNC(epd_reader_parse_time), 0);
+  rb_define_method(cls_reader, "line", RUBY_METHOD_FUNC(epd_reader_line), 1);
+  rb_define_method(cls_reader, "operation", RUBY_METHOD_FUNC(epd_reader_operation), 2);
+  rb_define_method(cls_reader, "entry", RUBY_METHOD_FUNC(epd_reader_entry), 1);
+  rb_define_method(cls_reader, "load", RUBY_METHOD_FUNC(epd_reader_load), 2);
+  rb_define_method(cls_reader, "records", RUBY_METHOD_FUNC(epd_reader_records), 2);
+  rb_define_method(cls_reader, "labeled_records", RUBY_METHOD_FUNC(epd_reader_labeled_records), 0);
+  rb_define_method(cls_reader, "batch", RUBY_METHOD_FUNC(epd_reader_batch), 2);
+  rb_define_method(cls_reader, "close", RUBY_METHOD_FUNC(epd_reader_close), 0);
+
+  printf("done.\n");
+}
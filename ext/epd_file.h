@@ -0,0 +1,77 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef EPD_FILE
+#define EPD_FILE
+
+#include "shared.h"
+#include <stdint.h>
+
+// EPD files (and files of plain FEN strings, one per line) are parsed in a single pass over a memory-mapped copy 
+// of the file.  Each line is packed into the same 32 byte record used by position files (position_file.h), and the 
+// opcodes the engine uses are kept as spans of the mapped text, so nothing is allocated per line.  Strings are only
+// created for the operations that are actually asked for.
+#define EPD_OP_BM     0  // best moves
+#define EPD_OP_AM     1  // avoid moves
+#define EPD_OP_ID     2
+#define EPD_OP_C0     3  // comment
+#define EPD_OPCODES   4
+#define EPD_MAX_LINE  0xffff
+#define EPD_CAPACITY  1024  // initial number of lines.  The tables double in size as needed.
+
+typedef struct {
+  uint16_t offset;  // from the start of the line.
+  uint16_t length;  // 0 if the operation isn't present.
+} EPD_SPAN;
+
+typedef struct {
+  size_t offset;
+  uint16_t length;
+  EPD_SPAN ops[EPD_OPCODES];
+} EPD_LINE;
+
+typedef struct {
+  uint8_t *base;
+  size_t size;
+  struct PACKED_POSITION *records;
+  EPD_LINE *lines;
+  long count;
+  long capacity;
+  double parse_time;  // seconds.
+} EPD_READER;
+
+static VALUE epd_reader_alloc(VALUE klass);
+static VALUE epd_reader_initialize(VALUE self, VALUE path);
+static VALUE epd_reader_count(VALUE self);
+static VALUE epd_reader_bytes(VALUE self);
+static VALUE epd_reader_parse_time(VALUE self);
+static VALUE epd_reader_line(VALUE self, VALUE index);
+static VALUE epd_reader_operation(VALUE self, VALUE index, VALUE opcode);
+static VALUE epd_reader_entry(VALUE self, VALUE index);
+static VALUE epd_reader_load(VALUE self, VALUE index, VALUE p_board);
+static VALUE epd_reader_records(VALUE self, VALUE start, VALUE count);
+static VALUE epd_reader_labeled_records(VALUE self);
+static VALUE epd_reader_batch(VALUE self, VALUE start, VALUE count);
+static VALUE epd_reader_close(VALUE self);
+
+extern void Init_epd_file();
+
+#endif
@@ -25,113 +25,8 @@ int non_king_value;
 int endgame_value;
 int mate_value;
 
-const int passed_pawn_bonus[2][8] = { { 0, 49, 28, 16, 9,  5,  3,  0 },   
-                                      { 0,  3,  5, 9, 16, 16, 28, 49 } };
-
 const int promote_row[2][2] = { {1, 2}, {6, 5} };
 
-
-const int isolated_pawn_penalty = -5;
-const int double_pawn_penalty   = -10;
-
-const int pawn_duo_bonus        = 3;
-
-static int main_pst[2][5][64] = {
-  { // Black
-    // Pawn
-   {  0,  0,  0,  0,  0,  0,  0,  0, 
-     -1,  1,  1,  1,  1,  1,  1, -1, 
-     -2,  0,  1,  2,  2,  1,  0, -2, 
-     -3, -1,  2, 10, 10,  2, -1, -3, 
-     -4, -2,  4, 14, 14,  4, -2, -4, 
-     -5, -3,  0,  9,  9,  0, -3, -5, 
-     -6, -4,  0,-20,-20,  0, -4, -6, 
-      0,  0,  0,  0,  0,  0,  0,  0 },
-  // Knight
-   { -8, -8, -6, -6, -6, -6, -8, -8, 
-     -8,  0,  0,  0,  0,  0,  0, -8, 
-     -6,  0,  4,  4,  4,  4,  0, -6, 
-     -6,  0,  4,  8,  8,  4,  0, -6, 
-     -6,  0,  4,  8,  8,  4,  0, -6, 
-     -6,  0,  4,  4,  4,  4,  0, -6, 
-     -8,  0,  1,  2,  2,  1,  0, -8, 
-    -10,-12, -6, -6, -6, -6,-12,-10 },
-  // Bishop
-   { -3, -3, -3, -3, -3, -3, -3, -3, 
-     -3,  0,  0,  0,  0,  0,  0, -3, 
-     -3,  0,  2,  4,  4,  2,  0, -3, 
-     -3,  0,  4,  5,  5,  4,  0, -3, 
-     -3,  0,  4,  5,  5,  4,  0, -3, 
-     -3,  1,  2,  4,  4,  2,  1, -3, 
-     -3,  2,  1,  1,  1,  1,  2, -3, 
-     -3, -3,-10, -3, -3,-10, -3, -3 },
-  // Rook
-  {   4,  4,  4,  4,  4,  4,  4,  4,
-     16, 16, 16, 16, 16, 16, 16, 16,
-     -4,  0,  0,  0,  0,  0,  0, -4,
-     -4,  0,  0,  0,  0,  0,  0, -4,
-     -4,  0,  0,  0,  0,  0,  0, -4,
-     -4,  0,  0,  0,  0,  0,  0, -4,
-     -4,  0,  0,  0,  0,  0,  0, -4,
-      0,  0,  0,  2,  2,  0,  0,  0 },
-  // Queen
-   {  0,  0,  0,  1,  1,  0,  0,  0, 
-      0,  0,  1,  2,  2,  1,  0,  0, 
-      0,  1,  2,  2,  2,  2,  1,  0, 
-      0,  1,  2,  3,  3,  2,  1,  0, 
-      0,  1,  2,  3,  3,  2,  1,  0, 
-      0,  1,  1,  2,  2,  1,  1,  0, 
-      0,  0,  1,  1,  1,  1,  0,  0, 
-     -6, -6, -6, -6, -6, -6, -6, -6 },
-}, // White
-{  // Pawn
-    { 0,  0,  0,  0,  0,  0,  0,  0, 
-     -6, -4,  0,-20,-20,  0, -4, -6, 
-     -5, -3,  0,  9,  9,  0, -3, -5,
-     -4, -2,  4, 14, 14,  4, -2, -4, 
-     -3, -1,  2, 10, 10,  2, -1, -3, 
-     -2,  0,  1,  2,  2,  1,  0, -2, 
-     -1,  1,  1,  1,  1,  1,  1, -1, 
-      0,  0,  0,  0,  0,  0,  0,  0 },
-  // Knight
-   {-10,-12, -6, -6, -6, -6,-12,-10, 
-     -8,  0,  1,  2,  2,  1,  0, -8, 
-     -6,  0,  4,  4,  4,  4,  0, -6, 
-     -6,  0,  4,  8,  8,  4,  0, -6, 
-     -6,  0,  4,  8,  8,  4,  0, -6,
-     -6,  0,  4,  4,  4,  4,  0, -6, 
-     -8,  0,  0,  0,  0,  0,  0, -8, 
-     -8, -8, -6, -6, -6, -6, -8, -8 },
-    // Bishop
-   { -3, -3,-10, -3, -3,-10, -3, -3, 
-     -3,  2,  1,  1,  1,  1,  2, -3, 
-     -3,  1,  2,  4,  4,  2,  1, -3, 
-     -3,  0,  4,  5,  5,  4,  0, -3, 
-     -3,  0,  4,  5,  5,  4,  0, -3, 
-     -3,  0,  2,  4,  4,  2,  0, -3, 
-     -3,  0,  0,  0,  0,  0,  0, -3, 
-     -3, -3, -3, -3, -3, -3, -3, -3 },
-    // Rook
-   {  0,  0,  0,  2,  2,  0,  0,  0, 
-     -4,  0,  0,  0,  0,  0,  0, -4, 
-     -4,  0,  0,  0,  0,  0,  0, -4, 
-     -4,  0,  0,  0,  0,  0,  0, -4, 
-     -4,  0,  0,  0,  0,  0,  0, -4, 
-     -4,  0,  0,  0,  0,  0,  0, -4, 
-     16, 16, 16, 16, 16, 16, 16, 16, 
-      4,  4,  4,  4,  4,  4,  4,  4 },
-      // Queen
-   { -6, -6, -6, -6, -6, -6, -6, -6,
-      0,  0,  1,  1,  1,  1,  0,  0, 
-      0,  1,  1,  2,  2,  1,  1,  0, 
-      0,  1,  2,  3,  3,  2,  1,  0, 
-      0,  1,  2,  3,  3,  2,  1,  0, 
-      0,  1,  2,  2,  2,  2,  1,  0, 
-      0,  0,  1,  2,  2,  1,  0,  0, 
-      0,  0,  0,  1,  1,  0,  0,  0 }
-  }
-};
-
 const int mirror[64] = 
    { 56, 57, 58, 59, 60, 61, 62, 63, // Used to create a mirror image of the base PST
      48, 49, 50, 51, 52, 53, 54, 55, // during initialization.
@@ -142,48 +37,6 @@ const int mirror[64] =
       8,  9, 10, 11, 12, 13, 14, 15,
       0,  1,  2,  3,  4,  5,  6,  7 };
 
-
-static int king_pst[2][2][64] = { 
- { // Black // False
-  { -52,-50,-50,-50,-50,-50,-50,-52,   // In early game, encourage the king to stay on back 
-    -50,-48,-48,-48,-48,-48,-48,-50,   // row defended by friendly pieces.
-    -48,-46,-46,-46,-46,-46,-46,-48,
-    -46,-44,-44,-44,-44,-44,-44,-46,
-    -44,-42,-42,-42,-42,-42,-42,-44,
-    -42,-40,-40,-40,-40,-40,-40,-42,
-    -16,-15,-20,-20,-20,-20,-15,-16,
-      0, 20, 30,-30,  0,-20, 30, 20 },
-    { // True
-    -30,-20,-10,  0,  0,-10,-20,-30,     // In end game (when few friendly pieces are available
-    -20,-10,  0, 10, 10,  0,-10,-20,     // to protect king), the king should move toward the center
-    -10,  0, 10, 20, 20, 10,  0,-10,     // and avoid getting trapped in corners.
-      0, 10, 20, 30, 30, 20, 10,  0,
-      0, 10, 20, 30, 30, 20, 10,  0,
-    -10,  0, 10, 20, 20, 10,  0,-10,
-    -20,-10,  0, 10, 10,  0,-10,-20,
-    -30,-20,-10,  0,  0,-10,-20,-30 }
-  },
-  { // White // False
-   {  0, 20, 30,-30,  0,-20, 30, 20, 
-    -16,-15,-20,-20,-20,-20,-15,-16, 
-    -42,-40,-40,-40,-40,-40,-40,-42, 
-    -44,-42,-42,-42,-42,-42,-42,-44, 
-    -46,-44,-44,-44,-44,-44,-44,-46, 
-    -48,-46,-46,-46,-46,-46,-46,-48, 
-    -50,-48,-48,-48,-48,-48,-48,-50, 
-    -52,-50,-50,-50,-50,-50,-50,-52 },
-    { // True
-    -30,-20,-10,  0,  0,-10,-20,-30, 
-    -20,-10,  0, 10, 10,  0,-10,-20, 
-    -10,  0, 10, 20, 20, 10,  0,-10, 
-      0, 10, 20, 30, 30, 20, 10,  0, 
-      0, 10, 20, 30, 30, 20, 10,  0, 
-    -10,  0, 10, 20, 20, 10,  0,-10,
-    -20,-10,  0, 10, 10,  0,-10,-20, 
-    -30,-20,-10,  0,  0,-10,-20,-30 }
-  }
-};
-
 void setup_eval_constants(){
   non_king_value = piece_values[PAWN]*8 + piece_values[KNIGHT]*2 + piece_values[BISHOP]*2 +
                    piece_values[ROOK]*2 + piece_values[QUEEN];
@@ -194,41 +47,19 @@ void setup_eval_constants(){
 
 
 static VALUE net_placement(VALUE self, VALUE pc_board, VALUE color){
-  BRD *cBoard = get_cBoard(pc_board);  
-  int c = SYM2COLOR(color);
-  int e = c^1;
-  return INT2NUM(adjusted_placement(c, e, cBoard)-adjusted_placement(e, c, cBoard));
-}
-
-static int adjusted_placement(int c, int e, BRD *cBoard){
-  double ratio;
-  int sq, placement = 0;
-  BB b;
-  int enemy_king_sq = furthest_forward(e, cBoard->pieces[e][KING]);
-  
-  for(int type = PAWN; type < KING; type++){
-    for(b = cBoard->pieces[c][type]; b; clear_sq(sq, b)){
-      sq = furthest_forward(c, b);
-      placement += (main_pst[c][type][sq] + tropism_bonus[sq][enemy_king_sq][type]);
-    }
-  }
-  for(b = cBoard->pieces[c][KING]; b; clear_sq(sq, b)){
-    sq = furthest_forward(c, b);
-    placement += king_pst[c][in_endgame(c)][sq];
-  }
-  // Base material is incrementally updated as moves are made/unmade.
-  return cBoard->material[c] + placement + mobility(c, e, cBoard) + pawn_structure(c, e, cBoard);
+  // The network needs both kings on the board.  Positions where a king has been captured fall through to the 
+  // hand-crafted eval, which the search relies on to detect king loss (see static_eval in batch_eval.c).
+  return INT2NUM(static_eval(get_cBoard(pc_board), get_accumulator(pc_board), SYM2COLOR(color)));
 }
 
 // Counts the total possible moves for the given side, not including any target squares defended by enemy pawns.
-static int mobility(int c, int e, BRD *cBoard){
+COLOR_INLINE int mobility_for(int c, BRD *cBoard){
+  int e = c^1;
   BB friendly = Placement(c);
-  BB available = ~friendly;
   BB enemy = Placement(e);
   BB occ = friendly|enemy;
   BB empty = ~occ;
   BB unguarded;
-  int sq;
   int mobility=0;
 
   // pawn mobility
@@ -249,32 +80,8 @@ static int mobility(int c, int e, BRD *cBoard){
 
   mobility += (pop_count((single_advances|double_advances) & unguarded) 
                + pop_count(left_temp & unguarded) + pop_count(right_temp & unguarded));
-  // knight mobility
-  for(BB b = cBoard->pieces[c][KNIGHT]; b; clear_sq(sq, b)){
-    sq = furthest_forward(c, b);
-    mobility += pop_count(knight_masks[sq] & available & unguarded);
-  }
-  // bishop mobility
-  for(BB b = cBoard->pieces[c][BISHOP]; b; clear_sq(sq, b)){
-    sq = furthest_forward(c, b);
-    mobility += pop_count(bishop_attacks(occ, sq) & available & unguarded);
-  }
-  // rook mobility
-  for(BB b = cBoard->pieces[c][ROOK]; b; clear_sq(sq, b)){
-    sq = furthest_forward(c, b);
-    mobility += pop_count(rook_attacks(occ, sq) & available & unguarded);
-  }
-  // queen mobility
-  for(BB b = cBoard->pieces[c][QUEEN]; b; clear_sq(sq, b)){
-    sq = furthest_forward(c, b);
-    mobility += pop_count(queen_attacks(occ, sq) & available & unguarded);
-  }
-  // king mobility
-  for(BB b = cBoard->pieces[c][KING]; b; clear_sq(sq, b)){
-    sq = furthest_forward(c, b);
-    mobility += pop_count(king_masks[sq] & available & unguarded);
-  }
-  return mobility;
+  // knight, slider and king mobility
+  return mobility + piece_mobility(cBoard, c);
 }
 
 // PAWN EVALUATION
@@ -287,7 +94,8 @@ static int mobility(int c, int e, BRD *cBoard){
 // Bad structures:
 //   -Isolated pawns - Penalty for any pawn without friendly pawns on adjacent files.  
 //   -Double/tripled pawns - Penalty for having multiple pawns on the same file.
-static int pawn_structure(int c, int e, BRD *cBoard){
+COLOR_INLINE int pawn_structure_for(int c, BRD *cBoard){
+  int e = c^1;
   int structure = 0;
   int sq;
   BB own_pawns = cBoard->pieces[c][PAWN];
@@ -297,34 +105,84 @@ static int pawn_structure(int c, int e, BRD *cBoard){
     sq = furthest_forward(c, b);
     // passed pawns
     if(!(pawn_passed_masks[c][sq] & enemy_pawns)) {
-      structure += passed_pawn_bonus[c][row(sq)];        
+      structure += eval_params.passed_pawn_bonus[c][row(sq)];        
       if(row(sq) == promote_row[c][0]){
-        if(!is_attacked_by(cBoard, (c ? sq+8 : sq-8), c^1, c)){
-          structure += passed_pawn_bonus[c][row(sq)];  // double the value of the bonus if path to promotion is undefended.          
+        if(!(attacks_by(cBoard, e) & sq_mask_on(c ? sq+8 : sq-8))){
+          structure += eval_params.passed_pawn_bonus[c][row(sq)];  // double the value of the bonus if path to promotion is undefended.          
         }
       } else if(row(sq) == promote_row[c][1]) {
-        if(!is_attacked_by(cBoard, (c ? sq+8 : sq-8), c^1, c) && 
-           !is_attacked_by(cBoard, (c ? sq+16 : sq-16), c^1, c)){
-          structure += passed_pawn_bonus[c][row(sq)];  // double the value of the bonus if path to promotion is undefended.
+        if(!(attacks_by(cBoard, e) & (sq_mask_on(c ? sq+8 : sq-8) | sq_mask_on(c ? sq+16 : sq-16)))){
+          structure += eval_params.passed_pawn_bonus[c][row(sq)];  // double the value of the bonus if path to promotion is undefended.
         }
       }
     }
     // isolated pawns
-    if(!(pawn_isolated_masks[sq] & own_pawns)) structure += isolated_pawn_penalty;
+    if(!(pawn_isolated_masks[sq] & own_pawns)) structure += eval_params.isolated_pawn_penalty;
     // pawn duos 
-    if(pawn_side_masks[sq] & own_pawns) structure += pawn_duo_bonus;
+    if(pawn_side_masks[sq] & own_pawns) structure += eval_params.pawn_duo_bonus;
   }
   int column_count;
   for(int i=0; i<8; i++){
     // doubled/tripled pawns
     column_count = pop_count(column_masks[i] & own_pawns);
     if (column_count > 1){
-      structure += (double_pawn_penalty<<(column_count-2));
+      structure += (eval_params.double_pawn_penalty<<(column_count-2));
     }
   }
   return structure;
 }
 
+COLOR_INLINE int adjusted_placement_for(int c, BRD *cBoard){
+  int e = c^1;
+  double ratio;
+  int sq, placement = 0;
+  BB b;
+  int enemy_king_sq = furthest_forward(e, cBoard->pieces[e][KING]);
+  
+  for(int type = PAWN; type < KING; type++){
+    for(b = cBoard->pieces[c][type]; b; clear_sq(sq, b)){
+      sq = furthest_forward(c, b);
+      placement += (eval_params.main_pst[c][type][sq] + tropism_bonus[sq][enemy_king_sq][type]);
+    }
+  }
+  for(b = cBoard->pieces[c][KING]; b; clear_sq(sq, b)){
+    sq = furthest_forward(c, b);
+    placement += eval_params.king_pst[c][in_endgame(c)][sq];
+  }
+  // Base material is incrementally updated as moves are made/unmade.
+  return cBoard->material[c] + placement + mobility_for(c, cBoard) + pawn_structure_for(c, cBoard);
+}
+
+// The evaluation terms are kernels (see cpu.h), each specialized for the side being evaluated.  Each variant of 
+// adjusted_placement inlines the mobility and pawn structure terms compiled for the same ISA level and side.  The 
+// enemy color e is always c^1.
+
+KERNEL_INLINE int mobility_kernel(int isa, int c, int e, BRD *cBoard){
+  return FOR_COLOR(c, mobility_for, cBoard);
+}
+
+KERNEL_INLINE int pawn_structure_kernel(int isa, int c, int e, BRD *cBoard){
+  return FOR_COLOR(c, pawn_structure_for, cBoard);
+}
+
+KERNEL_INLINE int adjusted_placement_kernel(int isa, int c, int e, BRD *cBoard){
+  return FOR_COLOR(c, adjusted_placement_for, cBoard);
+}
+
+KERNEL_VARIANTS(int, mobility, (int c, int e, BRD *cBoard), c, e, cBoard)
+KERNEL_VARIANTS(int, pawn_structure, (int c, int e, BRD *cBoard), c, e, cBoard)
+KERNEL_VARIANTS(int, adjusted_placement, (int c, int e, BRD *cBoard), c, e, cBoard)
+
+int (*mobility)(int c, int e, BRD *cBoard) = mobility_generic;
+int (*pawn_structure)(int c, int e, BRD *cBoard) = pawn_structure_generic;
+int (*adjusted_placement)(int c, int e, BRD *cBoard) = adjusted_placement_generic;
+
+extern void select_eval_kernels(int isa){
+  mobility = mobility_variants[isa];
+  pawn_structure = pawn_structure_variants[isa];
+  adjusted_placement = adjusted_placement_variants[isa];
+}
+
 
 
 static VALUE net_material(VALUE self, VALUE pc_board, VALUE color){
@@ -343,12 +201,12 @@ static int adjusted_material(int c, BRD *cBoard){
   for(int type = PAWN; type < QUEEN; type++){
     for(b = cBoard->pieces[c][type]; b; clear_sq(sq, b)){
       sq = furthest_forward(c, b);
-      placement += main_pst[c][type][sq];
+      placement += eval_params.main_pst[c][type][sq];
     }
   }
   for(b = cBoard->pieces[c][KING]; b; clear_sq(sq, b)){
     sq = furthest_forward(c, b);
-    placement += king_pst[c][in_endgame(c)][sq];
+    placement += eval_params.king_pst[c][in_endgame(c)][sq];
   }
   return cBoard->material[c] + placement;
 }
@@ -364,12 +222,12 @@ static VALUE evaluate_material(VALUE self, VALUE pc_board, VALUE color){
     b = cBoard->pieces[c][type];
     for(b = cBoard->pieces[c][type]; b; clear_sq(sq, b)){
       sq = furthest_forward(c, b);
-      placement += main_pst[c][type][sq];
+      placement += eval_params.main_pst[c][type][sq];
     }
   }
   for(b = cBoard->pieces[c][KING]; b; clear_sq(sq, b)){
     sq = furthest_forward(c, b);
-    placement += king_pst[c][in_endgame(c)][sq];
+    placement += eval_params.king_pst[c][in_endgame(c)][sq];
   }
   return INT2NUM(cBoard->material[c] + placement);
 }
@@ -24,14 +24,27 @@
 
 #include "shared.h"
 
+// The hand-set weights of the evaluation, gathered in one place so they can be tuned (tuner.c).  Defaults are in 
+// eval_params.c.
+typedef struct {
+  int main_pst[2][5][64];
+  int king_pst[2][2][64];
+  int passed_pawn_bonus[2][8];
+  int isolated_pawn_penalty;
+  int double_pawn_penalty;
+  int pawn_duo_bonus;
+  float tropism_ratio;  // share of a piece's value given as a bonus when next to the enemy king.
+} EVAL_PARAMS;
+
+extern EVAL_PARAMS eval_params;
+extern const int promote_row[2][2];
+
 void setup_eval_constants();
 
 extern int non_king_value;
 extern int endgame_value;
 extern int mate_value;
 
-static int main_pst[2][5][64];
-static int king_pst[2][2][64];
 static VALUE mod_chess;
 static VALUE mod_eval;
 
@@ -46,11 +59,13 @@ static VALUE evaluate_material(VALUE self, VALUE pc_board, VALUE color);
 static VALUE net_material(VALUE self, VALUE pc_board, VALUE color);
 static VALUE net_placement(VALUE self, VALUE pc_board, VALUE color);
 
-static int adjusted_placement(int c, int e, BRD *cBoard);
+extern int (*adjusted_placement)(int c, int e, BRD *cBoard);
 static int adjusted_material(int c, BRD *cBoard);
 
-static int mobility(int c, int e, BRD *cBoard);
-static int pawn_structure(int c, int e, BRD *cBoard);
+extern int (*mobility)(int c, int e, BRD *cBoard);
+extern int (*pawn_structure)(int c, int e, BRD *cBoard);
+
+extern void select_eval_kernels(int isa);
 
 extern void Init_eval();
 
@@ -25,6 +25,37 @@ RbConfig::MAKEFILE_CONFIG['CC'] = ENV['CC'] if ENV['CC']
 
 target = 'ruby_chess'
 
+# Optimized builds.  These are normally driven by build_pgo.rb, which runs all three stages:
+#
+#   --with-pgo=generate   instrumented build that writes profile data to --with-pgo-dir when it exits.
+#   --with-pgo=use        rebuild using the profile data in --with-pgo-dir.
+#   --enable-lto          link-time optimization.  On by default with --with-pgo=use.
+#
+# GCC and Clang are both supported.  Clang writes one raw profile per process, which must be merged with 
+# llvm-profdata into default.profdata before the final build.
+pgo = with_config('pgo')
+pgo_dir = File.expand_path(with_config('pgo-dir', 'pgo'))
+clang = RbConfig::MAKEFILE_CONFIG['CC'] =~ /clang/
+
+case pgo
+when 'generate'
+  flags = clang ? "-fprofile-instr-generate=#{pgo_dir}/%p.profraw" : "-fprofile-generate=#{pgo_dir}"
+  $CFLAGS << " #{flags}"
+  $DLDFLAGS << " #{flags}"
+when 'use'
+  $CFLAGS << (clang ? " -fprofile-instr-use=#{pgo_dir}/default.profdata -Wno-profile-instr-unprofiled" :
+                      " -fprofile-use=#{pgo_dir} -fprofile-partial-training -Wno-missing-profile")
+when nil
+else
+  abort "unknown --with-pgo stage '#{pgo}' (expected generate or use)"
+end
+
+if enable_config('lto', pgo == 'use')
+  flags = clang ? '-flto' : '-flto=auto'
+  $CFLAGS << " #{flags}"
+  $DLDFLAGS << " #{flags}"
+end
+
 dir_config(target)
 create_makefile(target)
 
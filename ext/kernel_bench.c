@@ -0,0 +1,201 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#include "kernel_bench.h"
+
+// Micro-benchmarks for the native kernels.  Each call to time_kernel runs one kernel over every position in the 
+// corpus for the given number of passes, and returns the mean time per kernel call in nanoseconds.  Repetitions, 
+// warmup and summary statistics are handled by the caller (see lib/kernel_bench.rb).
+//
+// Results are accumulated into a volatile sink so the compiler can't discard calls whose results are unused.
+
+static volatile BB sink;
+
+static const char *kernel_names[KERNEL_COUNT] = { "attack_map", "is_attacked_by", "is_pinned", "get_see", "mobility", 
+                                                  "pawn_structure", "adjusted_placement", "get_non_captures", 
+                                                  "get_captures", "get_winning_captures", "get_evasions", 
+                                                  "node_queries" };
+
+static double elapsed_ns(struct timespec *start, struct timespec *end){
+  return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+// Each corpus entry is an array of [p_board, side_to_move, sq_board, enp_target, castle].  Capture pairs for SEE 
+// (each friendly piece attacking an enemy piece) are found up front so that finding them isn't timed.
+static void load_position(VALUE entry, BENCH_POS *pos){
+  BRD *cBoard;
+  BB targets, attackers;
+  int to, from, e;
+  pos->p_board = rb_ary_entry(entry, 0);
+  pos->color = rb_ary_entry(entry, 1);
+  pos->sq_board = rb_ary_entry(entry, 2);
+  pos->enp_target = rb_ary_entry(entry, 3);
+  pos->castle = rb_ary_entry(entry, 4);
+  pos->cBoard = cBoard = get_cBoard(pos->p_board);
+  pos->c = SYM2COLOR(pos->color);
+  e = pos->c^1;
+  pos->in_check = cBoard->pieces[pos->c][KING] && 
+                  is_attacked_by(cBoard, lsb(cBoard->pieces[pos->c][KING]), e, pos->c);
+  pos->see_count = 0;
+  for(targets = Placement(e) & ~cBoard->pieces[e][KING]; targets; clear_sq(to, targets)){
+    to = lsb(targets);
+    for(attackers = attack_map(cBoard, to) & Placement(pos->c); attackers; clear_sq(from, attackers)){
+      from = lsb(attackers);
+      if(pos->see_count < MAX_SEE_PAIRS){
+        pos->see_from[pos->see_count] = from;
+        pos->see_to[pos->see_count] = to;
+        pos->see_count++;
+      }
+    }
+  }
+}
+
+// Runs the kernel once over a single position, returning the number of kernel calls made.
+static long run_kernel(int kernel, BENCH_POS *pos){
+  BRD *cBoard = pos->cBoard;
+  int c = pos->c, e = pos->c^1;
+  int sq;
+  long calls = 0;
+  BB b;
+
+  clear_attack_info(cBoard);  // time each kernel from a cold cache, as on the first visit to a node.
+  switch(kernel){
+    case K_ATTACK_MAP:
+      for(b = Occupied(); b; clear_sq(sq, b), calls++){
+        sq = lsb(b);
+        sink ^= attack_map(cBoard, sq);
+      }
+      break;
+    case K_IS_ATTACKED_BY:
+      for(sq = 0; sq < 64; sq++, calls++) sink ^= is_attacked_by(cBoard, sq, e, c);
+      break;
+    case K_IS_PINNED:
+      for(b = Placement(c); b; clear_sq(sq, b), calls++){
+        sq = lsb(b);
+        sink ^= is_pinned(cBoard, sq, c, e);
+      }
+      break;
+    case K_GET_SEE:
+      for(int i = 0; i < pos->see_count; i++, calls++){
+        sink ^= get_see(cBoard, pos->see_from[i], pos->see_to[i], c, pos->sq_board);
+      }
+      break;
+    case K_MOBILITY:
+      sink ^= mobility(c, e, cBoard);
+      calls++;
+      break;
+    case K_PAWN_STRUCTURE:
+      sink ^= pawn_structure(c, e, cBoard);
+      calls++;
+      break;
+    case K_ADJUSTED_PLACEMENT:
+      sink ^= adjusted_placement(c, e, cBoard);
+      calls++;
+      break;
+    // The generators assume the side to move is not in check, except for get_evasions which requires it.
+    case K_GET_NON_CAPTURES:
+      if(pos->in_check) break;
+      get_non_captures(Qnil, pos->p_board, pos->color, pos->castle, rb_ary_new(), Qfalse);
+      calls++;
+      break;
+    case K_GET_CAPTURES:
+      if(pos->in_check) break;
+      get_captures(Qnil, pos->p_board, pos->color, pos->sq_board, pos->enp_target, rb_ary_new(), rb_ary_new());
+      calls++;
+      break;
+    case K_GET_WINNING_CAPTURES:
+      if(pos->in_check) break;
+      get_winning_captures(Qnil, pos->p_board, pos->color, pos->sq_board, pos->enp_target, rb_ary_new(), 
+                           rb_ary_new());
+      calls++;
+      break;
+    case K_GET_EVASIONS:
+      if(!pos->in_check) break;
+      get_evasions(Qnil, pos->p_board, pos->color, pos->sq_board, pos->enp_target, rb_ary_new(), rb_ary_new(), 
+                   rb_ary_new());
+      calls++;
+      break;
+    // The native queries made at a typical interior node: a check test, the evaluation, a pin test for each 
+    // friendly piece and SEE for each capture.  These share a single fill of the node's attack info.
+    case K_NODE_QUERIES:
+      sink ^= checkers(cBoard, c);
+      sink ^= adjusted_placement(c, e, cBoard) - adjusted_placement(e, c, cBoard);
+      for(b = Placement(c); b; clear_sq(sq, b)){
+        sq = lsb(b);
+        sink ^= is_pinned(cBoard, sq, c, e);
+      }
+      for(int i = 0; i < pos->see_count; i++){
+        sink ^= get_see(cBoard, pos->see_from[i], pos->see_to[i], c, pos->sq_board);
+      }
+      calls++;
+      break;
+  }
+  return calls;
+}
+
+static int kernel_index(VALUE kernel){
+  const char *name = rb_id2name(SYM2ID(kernel));
+  for(int k = 0; k < KERNEL_COUNT; k++){
+    if(strcmp(name, kernel_names[k]) == 0) return k;
+  }
+  rb_raise(rb_eArgError, "unknown kernel: %s", name);
+  return -1;
+}
+
+// Returns the mean nanoseconds per kernel call over all passes, or nil if the kernel doesn't apply to any position 
+// in the corpus (e.g. get_evasions when no position is in check).
+static VALUE time_kernel(VALUE self, VALUE kernel, VALUE corpus, VALUE passes){
+  int k = kernel_index(kernel);
+  int count = RARRAY_LEN(corpus);
+  int n_passes = NUM2INT(passes);
+  BENCH_POS *positions = ALLOC_N(BENCH_POS, count);
+  struct timespec start, end;
+  long calls = 0;
+
+  for(int i = 0; i < count; i++) load_position(rb_ary_entry(corpus, i), &positions[i]);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(int p = 0; p < n_passes; p++){
+    for(int i = 0; i < count; i++) calls += run_kernel(k, &positions[i]);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  xfree(positions);
+  return calls ? DBL2NUM(elapsed_ns(&start, &end)/calls) : Qnil;
+}
+
+static VALUE kernels(VALUE self){
+  VALUE names = rb_ary_new();
+  for(int k = 0; k < KERNEL_COUNT; k++) rb_ary_push(names, ID2SYM(rb_intern(kernel_names[k])));
+  return names;
+}
+
+extern void Init_kernel_bench(){
+  printf("  -Loading kernel_bench extension...");
+
+  VALUE mod_chess = rb_define_module("Chess");
+  VALUE mod_kernel_bench = rb_define_module_under(mod_chess, "KernelBench");
+
+  rb_define_module_function(mod_kernel_bench, "time_kernel", time_kernel, 3);
+  rb_define_module_function(mod_kernel_bench, "kernels", kernels, 0);
+
+  printf("done.\n");
+}
@@ -0,0 +1,54 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef KERNEL_BENCH
+#define KERNEL_BENCH
+
+#include "shared.h"
+#include <string.h>
+#include <time.h>
+
+#define MAX_SEE_PAIRS 128
+
+typedef enum { K_ATTACK_MAP, K_IS_ATTACKED_BY, K_IS_PINNED, K_GET_SEE, K_MOBILITY, K_PAWN_STRUCTURE, 
+               K_ADJUSTED_PLACEMENT, K_GET_NON_CAPTURES, K_GET_CAPTURES, K_GET_WINNING_CAPTURES, K_GET_EVASIONS, 
+               K_NODE_QUERIES, KERNEL_COUNT } enumKernel;
+
+typedef struct {
+  BRD *cBoard;
+  VALUE p_board;
+  VALUE color;
+  VALUE sq_board;
+  VALUE enp_target;
+  VALUE castle;
+  int c;
+  int in_check;
+  int see_count;
+  int see_from[MAX_SEE_PAIRS];
+  int see_to[MAX_SEE_PAIRS];
+} BENCH_POS;
+
+static VALUE time_kernel(VALUE self, VALUE kernel, VALUE corpus, VALUE passes);
+static VALUE kernels(VALUE self);
+
+extern void Init_kernel_bench();
+
+#endif
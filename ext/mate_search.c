@@ -0,0 +1,297 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#include "mate_search.h"
+
+// Proof-number search stores, for each node, the number of leaves that would still have to be proven to show that 
+// the attacker mates (the proof number, pn), and the number that would have to be disproven to show that the 
+// defender escapes (the disproof number, dn).  At attacker (OR) nodes pn is the smallest pn of the children and dn 
+// the sum of their dns; at defender (AND) nodes the reverse.  Each step expands the most-proving node: the child 
+// with the smallest pn at OR nodes or the smallest dn at AND nodes, until the root is proven or disproven.
+//
+// The depth-first variant (df-pn) searches below a child until its numbers cross thresholds set from its siblings,
+// then backs up, keeping the numbers of every node in a transposition table rather than holding the tree in memory.
+// Thresholds are widened by a quarter (the 1+epsilon trick) so that the search doesn't thrash between siblings with
+// similar numbers.  New nodes are scored by mobility: a defender with few legal replies is cheap to prove mated, and
+// an attacker with many moves is expensive to disprove.
+
+static uint32_t add_numbers(uint32_t a, uint32_t b){
+  return min(a + b, MATE_INF);
+}
+
+static uint32_t widen(uint32_t n){
+  return min(n + n / 4 + 1, MATE_INF);
+}
+
+static MATE_ENTRY* probe(MATE_SOLVER *ms, BB key){
+  MATE_ENTRY *entry = &ms->tt[key & ms->tt_mask];
+  return entry->key == key ? entry : NULL;
+}
+
+static void store(MATE_SOLVER *ms, BB key, uint32_t pn, uint32_t dn, int distance){
+  MATE_ENTRY *entry = &ms->tt[key & ms->tt_mask];
+  entry->key = key;
+  entry->pn = pn;
+  entry->dn = dn;
+  entry->distance = distance;
+}
+
+static int check_stop(MATE_SOLVER *ms){
+  if((ms->node_limit && ms->nodes_searched >= ms->node_limit) || ms->interrupted) ms->stopped = 1;
+  return ms->stopped;
+}
+
+// Like the engine's own move generator (move_gen.c), the search only promotes to queens and knights.
+static int generate_moves(NODE *node, uint16_t *moves){
+  int n = generate_node_moves(node, moves, 0, node_in_check(node)), kept = 0;
+  for(int i = 0; i < n; i++){
+    int flag = sp_flag(moves[i]);
+    if(flag != SP_PROMOTE + BISHOP - KNIGHT && flag != SP_PROMOTE + ROOK - KNIGHT) moves[kept++] = moves[i];
+  }
+  return kept;
+}
+
+static int count_legal_moves(MATE_SOLVER *ms, int ply){
+  NODE *node = &ms->nodes[ply];
+  uint16_t moves[MATE_MAX_MOVES];
+  int n = generate_moves(node, moves), legal = 0;
+  for(int i = 0; i < n; i++){
+    ms->nodes_searched++;
+    legal += make_node_move(node, &ms->nodes[ply+1], moves[i]);
+  }
+  return legal;
+}
+
+// Sets the proof and disproof numbers of the node at ply, which has just been made.  Repetitions of a position 
+// earlier in the line and lines longer than MATE_MAX_PLY are disproven.
+static void evaluate_node(MATE_SOLVER *ms, int ply, uint32_t *pn, uint32_t *dn, uint16_t *distance){
+  NODE *node = &ms->nodes[ply];
+  int defender = node->c != ms->attacker;
+  *distance = 0;
+  for(int i = ply - 4; i >= 0; i -= 2){
+    if(ms->path[i] == node->key){
+      *pn = MATE_INF;
+      *dn = 0;
+      return;
+    }
+  }
+  MATE_ENTRY *entry = ply < MATE_MAX_PLY ? probe(ms, node->key) : NULL;
+  if(entry){
+    *pn = entry->pn;
+    *dn = entry->dn;
+    *distance = entry->distance;
+    return;
+  }
+  int legal = count_legal_moves(ms, ply);
+  if(legal == 0 || ply >= MATE_MAX_PLY){
+    int mated = legal == 0 && defender && node_in_check(node);
+    *pn = mated ? 0 : MATE_INF;
+    *dn = mated ? MATE_INF : 0;
+    return;
+  }
+  *pn = defender ? legal : 1;
+  *dn = defender ? 1 : legal;
+}
+
+// Searches the node at ply until its proof number reaches thpn or its disproof number reaches thdn, and returns 
+// its new numbers.
+static void mid(MATE_SOLVER *ms, int ply, uint32_t thpn, uint32_t thdn, uint32_t *pn_out, uint32_t *dn_out, 
+                uint16_t *distance_out){
+  NODE *node = &ms->nodes[ply], *child = &ms->nodes[ply+1];
+  MATE_CHILDREN *children = &ms->children[ply];
+  uint16_t moves[MATE_MAX_MOVES];
+  uint32_t pn, dn, second, child_thpn, child_thdn;
+  int or_node = node->c == ms->attacker, distance = 0, best, k;
+  int n = generate_moves(node, moves);
+
+  ms->path[ply] = node->key;
+  children->count = 0;
+  for(int i = 0; i < n; i++){
+    ms->nodes_searched++;
+    if(!make_node_move(node, child, moves[i])) continue;
+    k = children->count++;
+    children->moves[k] = moves[i];
+    evaluate_node(ms, ply+1, &children->pn[k], &children->dn[k], &children->distance[k]);
+    if(or_node ? children->pn[k] == 0 : children->dn[k] == 0) break;  // already decided.
+  }
+
+  for(;;){
+    best = -1;
+    second = MATE_INF;
+    if(or_node){
+      pn = MATE_INF;
+      dn = 0;
+      for(k = 0; k < children->count; k++){
+        dn = add_numbers(dn, children->dn[k]);
+        if(children->pn[k] < pn){
+          second = pn;
+          pn = children->pn[k];
+          best = k;
+        } else if(children->pn[k] < second){
+          second = children->pn[k];
+        }
+      }
+    } else {
+      pn = 0;
+      dn = MATE_INF;
+      for(k = 0; k < children->count; k++){
+        pn = add_numbers(pn, children->pn[k]);
+        if(children->dn[k] < dn){
+          second = dn;
+          dn = children->dn[k];
+          best = k;
+        } else if(children->dn[k] < second){
+          second = children->dn[k];
+        }
+      }
+    }
+    if(pn >= thpn || dn >= thdn || check_stop(ms)) break;
+
+    if(or_node){
+      child_thpn = min(thpn, widen(second));
+      child_thdn = min(thdn - dn + children->dn[best], MATE_INF);
+    } else {
+      child_thpn = min(thpn - pn + children->pn[best], MATE_INF);
+      child_thdn = min(thdn, widen(second));
+    }
+    ms->nodes_searched++;
+    make_node_move(node, child, children->moves[best]);
+    mid(ms, ply+1, child_thpn, child_thdn, &children->pn[best], &children->dn[best], &children->distance[best]);
+  }
+
+  // The attacker takes its quickest mate, and the defender delays mate as long as it can.
+  if(pn == 0){
+    distance = or_node ? MATE_MAX_PLY : 0;
+    for(k = 0; k < children->count; k++){
+      if(children->pn[k] != 0) continue;
+      distance = or_node ? min(distance, children->distance[k]) : max(distance, children->distance[k]);
+    }
+    distance++;
+  }
+  store(ms, node->key, pn, dn, distance);
+  *pn_out = pn;
+  *dn_out = dn;
+  *distance_out = distance;
+}
+
+static void* run_mate_search(void *data){
+  MATE_SOLVER *ms = (MATE_SOLVER *)data;
+  uint32_t pn, dn;
+  uint16_t distance;
+  mid(ms, 0, MATE_INF, MATE_INF, &pn, &dn, &distance);
+  return NULL;
+}
+
+static void interrupt_mate_search(void *data){
+  ((MATE_SOLVER *)data)->interrupted = 1;
+}
+
+// Follows the proof from the root, as mid scored it: the attacker plays its quickest mate, and the defender the 
+// reply that delays mate longest.  Returns the moves as [from, to, promoted type or nil], or nil if the line 
+// doesn't end in checkmate because part of the proof has been overwritten in the table.
+static VALUE proven_line(MATE_SOLVER *ms){
+  VALUE line = rb_ary_new();
+  uint16_t moves[MATE_MAX_MOVES], distance, best_distance = 0;
+  uint32_t pn, dn;
+  for(int ply = 0; ply < MATE_MAX_PLY; ply++){
+    NODE *node = &ms->nodes[ply];
+    int or_node = node->c == ms->attacker, best = -1, legal = 0;
+    int n = generate_moves(node, moves);
+    ms->path[ply] = node->key;
+    for(int i = 0; i < n; i++){
+      if(!make_node_move(node, &ms->nodes[ply+1], moves[i])) continue;
+      legal++;
+      evaluate_node(ms, ply+1, &pn, &dn, &distance);
+      if(pn != 0) continue;
+      if(best < 0 || (or_node ? distance < best_distance : distance > best_distance)){
+        best = moves[i];
+        best_distance = distance;
+      }
+    }
+    if(best < 0) return !or_node && legal == 0 && node_in_check(node) ? line : Qnil;
+    make_node_move(node, &ms->nodes[ply+1], best);
+    int flag = sp_flag(best);
+    rb_ary_push(line, rb_ary_new3(3, INT2NUM(sp_from(best)), INT2NUM(sp_to(best)), 
+                                  flag >= SP_PROMOTE ? INT2NUM(flag - SP_PROMOTE + KNIGHT) : Qnil));
+  }
+  return Qnil;
+}
+
+static void free_solver(MATE_SOLVER *ms){
+  free(ms->tt);
+  free(ms->nodes);
+  free(ms);
+}
+
+static MATE_SOLVER* new_solver(int tt_bits){
+  MATE_SOLVER *ms = calloc(1, sizeof(MATE_SOLVER));
+  if(ms){
+    ms->nodes = calloc(MATE_MAX_PLY+2, sizeof(NODE));
+    ms->tt = calloc((size_t)1 << tt_bits, sizeof(MATE_ENTRY));
+  }
+  if(!ms || !ms->nodes || !ms->tt){
+    if(ms) free_solver(ms);
+    return NULL;
+  }
+  ms->tt_mask = ((BB)1 << tt_bits) - 1;
+  return ms;
+}
+
+// Searches for a forced mate by the side to move, visiting up to max_nodes positions (0 for no limit).  Returns 
+// [line, nodes searched], where line is the mating line as [from, to, promoted type or nil] moves, or nil if no 
+// mate was proven.  If the root is proven but the line can't be read back to mate, the search is repeated with a 
+// larger table, up to 2^MATE_TT_MAX_BITS entries.
+static VALUE object_mate_search(VALUE self, VALUE p_board, VALUE color, VALUE castle, VALUE enp_target, 
+                                VALUE max_nodes){
+  VALUE line = Qnil;
+  long nodes_searched = 0;
+  for(int bits = MATE_TT_BITS; bits <= MATE_TT_MAX_BITS; bits += 2){
+    MATE_SOLVER *ms = new_solver(bits);
+    if(!ms) rb_raise(rb_eNoMemError, "failed to allocate mate search");
+    ms->node_limit = NUM2LONG(max_nodes);
+    ms->attacker = SYM2COLOR(color);
+    set_node(&ms->nodes[0], get_cBoard(p_board), ms->attacker, NUM2INT(castle), 
+             NIL_P(enp_target) ? -1 : NUM2INT(enp_target), 0);
+
+    rb_thread_call_without_gvl(run_mate_search, ms, interrupt_mate_search, ms);
+
+    MATE_ENTRY *root = probe(ms, ms->nodes[0].key);
+    int proven = root && root->pn == 0;
+    if(proven) line = proven_line(ms);
+    nodes_searched += ms->nodes_searched;
+    int interrupted = ms->interrupted;
+    free_solver(ms);
+    if(interrupted) rb_thread_check_ints();
+    if(!proven || !NIL_P(line) || interrupted) break;
+  }
+  return rb_ary_new3(2, line, LONG2NUM(nodes_searched));
+}
+
+extern void Init_mate_search(){
+  printf("  -Loading mate_search extension...");
+
+  VALUE mod_chess = rb_define_module("Chess");
+  VALUE mod_mate_search = rb_define_module_under(mod_chess, "MateSearch");
+
+  rb_define_module_function(mod_mate_search, "search", object_mate_search, 5);
+
+  printf("done.\n");
+}
@@ -0,0 +1,73 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef MATE_SEARCH
+#define MATE_SEARCH
+
+#include "shared.h"
+#include <stdint.h>
+#include <ruby/thread.h>
+
+// Mate finding by depth-first proof-number search (df-pn), over the self-play engine's move generator.  The side to 
+// move at the root is the attacker.  A node is proven once the attacker can force mate from it, and disproven once 
+// the defender can avoid mate (or the line runs past MATE_MAX_PLY, or repeats a position).
+#define MATE_MAX_PLY   64   // as SP_MAX_PLY.
+#define MATE_MAX_MOVES 256  // as SP_MAX_MOVES.
+#define MATE_INF       100000000  // proof and disproof numbers saturate here.
+#define MATE_TT_BITS   20
+#define MATE_TT_MAX_BITS 24  // the table grows up to this size when the proven line can't be read back.
+
+typedef struct {
+  BB key;
+  uint32_t pn;
+  uint32_t dn;
+  uint16_t distance;  // for proven nodes, the length in plies of the mating line found.
+} MATE_ENTRY;
+
+// The children of a node being expanded, with their current proof and disproof numbers.
+typedef struct {
+  uint16_t moves[MATE_MAX_MOVES];
+  BB keys[MATE_MAX_MOVES];
+  uint32_t pn[MATE_MAX_MOVES];
+  uint32_t dn[MATE_MAX_MOVES];
+  uint16_t distance[MATE_MAX_MOVES];
+  int count;
+} MATE_CHILDREN;
+
+typedef struct {
+  struct NODE *nodes;  // MATE_MAX_PLY+2 of them.
+  MATE_CHILDREN children[MATE_MAX_PLY+1];
+  BB path[MATE_MAX_PLY+1];  // keys of the positions along the current line, for repetition detection.
+  int attacker;
+  MATE_ENTRY *tt;
+  BB tt_mask;
+  long nodes_searched;
+  long node_limit;
+  int stopped;
+  volatile int interrupted;
+} MATE_SOLVER;
+
+static VALUE object_mate_search(VALUE self, VALUE p_board, VALUE color, VALUE castle, VALUE enp_target, 
+                                VALUE max_nodes);
+
+extern void Init_mate_search();
+
+#endif
@@ -158,9 +158,9 @@ static void build_enp_capture_with_see(VALUE id, int from, int to, VALUE cls, in
   rb_ary_push(moves, rb_class_new_instance(5, args, cls_move));                           
 }
 
-static VALUE get_non_captures(VALUE self, VALUE p_board, VALUE color, VALUE castle_rights, VALUE moves, VALUE in_check){
-  BRD *cBoard = get_cBoard(p_board);
-  int c = SYM2COLOR(color);
+// Each generator is specialized for the side to move (see FOR_COLOR in shared.h).
+
+COLOR_INLINE void non_captures_for(int c, BRD *cBoard, VALUE castle_rights, VALUE moves, VALUE in_check){
   int e = c^1;     
   int from, to;
   BB occupied = Occupied();
@@ -174,20 +174,20 @@ static VALUE get_non_captures(VALUE self, VALUE p_board, VALUE color, VALUE cast
   if (castle && in_check == Qfalse){
     if(c){
       if ((castle & C_WQ) && !(castle_queenside_intervening[1] & occupied)
-        && !is_attacked_by(cBoard, D1, e, c) && !is_attacked_by(cBoard, C1, e, c)){
+        && !(attacks_by(cBoard, e) & (sq_mask_on(D1)|sq_mask_on(C1)))){
         build_castle(INT2NUM(0x1b), E1, C1, INT2NUM(0x17), A1, D1, moves);
       }
       if ((castle & C_WK) && !(castle_kingside_intervening[1] & occupied)
-        && !is_attacked_by(cBoard, F1, e, c) && !is_attacked_by(cBoard, G1, e, c)){
+        && !(attacks_by(cBoard, e) & (sq_mask_on(F1)|sq_mask_on(G1)))){
         build_castle(INT2NUM(0x1b), E1, G1, INT2NUM(0x17), H1, F1, moves);
       }
     } else {
       if ((castle & C_BQ) && !(castle_queenside_intervening[0] & occupied)
-        && !is_attacked_by(cBoard, D8, e, c) && !is_attacked_by(cBoard, C8, e, c)){
+        && !(attacks_by(cBoard, e) & (sq_mask_on(D8)|sq_mask_on(C8)))){
         build_castle(INT2NUM(0x1a), E8, C8, INT2NUM(0x16), A8, D8, moves);
       }
       if ((castle & C_BK) && !(castle_kingside_intervening[0] & occupied)
-        && !is_attacked_by(cBoard, F8, e, c) && !is_attacked_by(cBoard, G8, e, c)){
+        && !(attacks_by(cBoard, e) & (sq_mask_on(F8)|sq_mask_on(G8)))){
         build_castle(INT2NUM(0x1a), E8, G8, INT2NUM(0x16), H8, F8, moves);
       }
     }
@@ -264,17 +264,18 @@ static VALUE get_non_captures(VALUE self, VALUE p_board, VALUE color, VALUE cast
       build_move(piece_id, from, to, cls_regular_move, moves);
     } 
   }
+}
 
+extern VALUE get_non_captures(VALUE self, VALUE p_board, VALUE color, VALUE castle_rights, VALUE moves, VALUE in_check){
+  FOR_COLOR(SYM2COLOR(color), non_captures_for, get_cBoard(p_board), castle_rights, moves, in_check);
   return Qnil;
 }
 
 
 // Pawn promotions are also generated during get_captures routine.
 
-static VALUE get_captures(VALUE self, VALUE p_board, VALUE color, VALUE sq_board, VALUE enp_target, VALUE moves, VALUE promotions){
-  BRD *cBoard = get_cBoard(p_board);
-
-  int c = SYM2COLOR(color); // color of side to move
+COLOR_INLINE void captures_for(int c, BRD *cBoard, VALUE color, VALUE sq_board, VALUE enp_target, VALUE moves, 
+                               VALUE promotions){
   int from, to;
   BB occupied = Occupied();
   BB enemy = Placement(c^1);
@@ -385,16 +386,18 @@ static VALUE get_captures(VALUE self, VALUE p_board, VALUE color, VALUE sq_board
       build_capture(piece_id, from, to, cls_regular_capture, sq_board, moves);
     }
   }
+}
+
+extern VALUE get_captures(VALUE self, VALUE p_board, VALUE color, VALUE sq_board, VALUE enp_target, VALUE moves, VALUE promotions){
+  FOR_COLOR(SYM2COLOR(color), captures_for, get_cBoard(p_board), color, sq_board, enp_target, moves, promotions);
   return Qnil;
 }
 
 
 // Pawn promotions are also generated during get_captures routine.
 
-static VALUE get_winning_captures(VALUE self, VALUE p_board, VALUE color, VALUE sq_board, VALUE enp_target, VALUE moves, VALUE promotions){
-  BRD *cBoard = get_cBoard(p_board);
-
-  int c = SYM2COLOR(color); // color of side to move
+COLOR_INLINE void winning_captures_for(int c, BRD *cBoard, VALUE color, VALUE sq_board, VALUE enp_target, 
+                                       VALUE moves, VALUE promotions){
   int from, to;
   BB occupied = Occupied();
   BB enemy = Placement(c^1);
@@ -516,13 +519,16 @@ static VALUE get_winning_captures(VALUE self, VALUE p_board, VALUE color, VALUE
       if(see >= 0) build_capture_with_see(piece_id, from, to, cls_regular_capture, sq_board, moves, see);
     }
   }
+}
+
+extern VALUE get_winning_captures(VALUE self, VALUE p_board, VALUE color, VALUE sq_board, VALUE enp_target, VALUE moves, VALUE promotions){
+  FOR_COLOR(SYM2COLOR(color), winning_captures_for, get_cBoard(p_board), color, sq_board, enp_target, moves, 
+            promotions);
   return Qnil;
 }
 
-static VALUE get_evasions(VALUE self, VALUE p_board, VALUE color, VALUE sq_board, VALUE enp_target,
-                          VALUE promotions, VALUE captures, VALUE moves){
-  BRD *cBoard = get_cBoard(p_board);
-  int c = SYM2COLOR(color);
+COLOR_INLINE void evasions_for(int c, BRD *cBoard, VALUE color, VALUE sq_board, VALUE enp_target, VALUE promotions, 
+                               VALUE captures, VALUE moves){
   int e = c^1;
   int threat_sq_1, threat_sq_2, piece_id;
   int threat_dir_1 = INVALID, threat_dir_2 = INVALID;
@@ -532,10 +538,10 @@ static VALUE get_evasions(VALUE self, VALUE p_board, VALUE color, VALUE sq_board
   BB enemy = cBoard->occupied[e];
   BB defense_map = 0;
 
-  if(!cBoard->pieces[c][KING]) return Qnil;
+  if(!cBoard->pieces[c][KING]) return;
 
   int king_sq = furthest_forward(c, cBoard->pieces[c][KING]);
-  BB threats = color_attack_map(cBoard, king_sq, e, c); // find any enemy pieces that attack the king.
+  BB threats = checkers(cBoard, c); // find any enemy pieces that attack the king.
   // printf("%s\n","threats:" );
   // rb_funcall(mod_chess, rb_intern("print_bitboard"),1, ULONG2NUM(threats));
 
@@ -716,7 +722,7 @@ static VALUE get_evasions(VALUE self, VALUE p_board, VALUE color, VALUE sq_board
   piece_id = INT2NUM(0x1a|c); // get king piece ID for color c.
   for(BB t = (king_masks[king_sq] & enemy); t; clear_sq(to, t)){ // generate to squares
     to = furthest_forward(c, t);
-    if(!is_attacked_by(cBoard, to, e, c) && (threat_dir_1 != directions[king_sq][to])
+    if(!(attacks_by(cBoard, e) & sq_mask_on(to)) && (threat_dir_1 != directions[king_sq][to])
        && (threat_dir_1 != directions[king_sq][to]))
       build_capture(piece_id, king_sq, to, cls_regular_capture, sq_board, captures);
   }
@@ -724,11 +730,16 @@ static VALUE get_evasions(VALUE self, VALUE p_board, VALUE color, VALUE sq_board
 
   for(BB t = (king_masks[king_sq] & empty); t; clear_sq(to, t)){ // generate to squares
     to = furthest_forward(c, t);
-    if(!is_attacked_by(cBoard, to, e, c) && (threat_dir_1 != directions[king_sq][to])
+    if(!(attacks_by(cBoard, e) & sq_mask_on(to)) && (threat_dir_1 != directions[king_sq][to])
        && (threat_dir_1 != directions[king_sq][to]))
       build_move(piece_id, king_sq, to, cls_regular_move, moves);
   }
+}
 
+extern VALUE get_evasions(VALUE self, VALUE p_board, VALUE color, VALUE sq_board, VALUE enp_target,
+                          VALUE promotions, VALUE captures, VALUE moves){
+  FOR_COLOR(SYM2COLOR(color), evasions_for, get_cBoard(p_board), color, sq_board, enp_target, promotions, captures, 
+            moves);
   return Qnil;
 }
 
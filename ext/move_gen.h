@@ -81,15 +81,15 @@ static void build_promotion_captures(VALUE id, int from, int to, VALUE color, VA
 
 static void build_enp_capture(VALUE id, int from, int to, VALUE cls, int target, VALUE sq_board, VALUE moves);
 
-static VALUE get_non_captures(VALUE self, VALUE p_board, VALUE color, VALUE castle_rights, VALUE moves, VALUE in_check);
+extern VALUE get_non_captures(VALUE self, VALUE p_board, VALUE color, VALUE castle_rights, VALUE moves, VALUE in_check);
 
-static VALUE get_captures(VALUE self, VALUE p_board, VALUE color, VALUE sq_board, 
+extern VALUE get_captures(VALUE self, VALUE p_board, VALUE color, VALUE sq_board, 
                           VALUE enp_target, VALUE moves, VALUE promotions);
 
-static VALUE get_winning_captures(VALUE self, VALUE p_board, VALUE color, VALUE sq_board, 
+extern VALUE get_winning_captures(VALUE self, VALUE p_board, VALUE color, VALUE sq_board, 
                                   VALUE enp_target, VALUE moves, VALUE promotions);
 
-static VALUE get_evasions(VALUE self, VALUE p_board, VALUE color, VALUE sq_board, VALUE enp_target,
+extern VALUE get_evasions(VALUE self, VALUE p_board, VALUE color, VALUE sq_board, VALUE enp_target,
                           VALUE promotions, VALUE captures, VALUE moves);
 
 
@@ -0,0 +1,388 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#include "nnue.h"
+#include <ruby/thread.h>
+
+// An efficiently updatable neural network (NNUE) evaluator.  When a network is loaded, it replaces the hand-crafted 
+// evaluation behind net_placement.
+//
+// 1. Features - HalfKP: each non-king piece is a feature, indexed by its type, color and square relative to the 
+//    king of the side whose perspective is being evaluated.  Each perspective has its own 256-wide first layer 
+//    (the accumulator), which is updated incrementally by board.c as pieces are added, removed and moved.
+// 2. Layers - The two accumulators, side to move first, are clipped to 0..127 and fed through two 32-wide hidden 
+//    layers with 8-bit weights, then a single output.
+// 3. Kernels - The accumulator updates and hidden layers use AVX2 on hosts that support it (selected at load time,
+//    see cpu.h), and portable scalar code otherwise.  Both produce identical results.
+//
+// The file format is that of Stockfish 12's HalfKP 256x2-32-32 networks.
+
+NETWORK *network = NULL;
+static unsigned network_id = 0;  // incremented each time a network is loaded.
+static VALUE network_file = Qnil;  // the path the network was loaded from.
+
+// Code that evaluates outside the GVL (batch evaluation, self-play) holds network_lock for reading while it runs, 
+// so the network can't be replaced or freed under it.  Ruby-side evaluation is already serialized by the GVL.
+pthread_rwlock_t network_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static inline int orient(int perspective, int sq){
+  return perspective == WHITE ? sq : sq ^ 63;
+}
+
+static inline int feature_index(int perspective, int king_sq, int c, int type, int sq){
+  int piece_kind = 2*type + (c != perspective);
+  return orient(perspective, sq) + 1 + 64*piece_kind + NNUE_PS_END*orient(perspective, king_sq);
+}
+
+
+// Accumulator kernels
+
+static void add_feature_scalar(int16_t *values, int index){
+  int16_t *weights = &network->ft_weights[index*NNUE_HALF];
+  for(int i = 0; i < NNUE_HALF; i++) values[i] += weights[i];
+}
+
+static void remove_feature_scalar(int16_t *values, int index){
+  int16_t *weights = &network->ft_weights[index*NNUE_HALF];
+  for(int i = 0; i < NNUE_HALF; i++) values[i] -= weights[i];
+}
+
+#ifdef CPU_X86
+
+ISA_TARGET(AVX2_TARGET) static void add_feature_avx2(int16_t *values, int index){
+  int16_t *weights = &network->ft_weights[index*NNUE_HALF];
+  for(int i = 0; i < NNUE_HALF; i += 16){
+    __m256i v = _mm256_loadu_si256((__m256i *)&values[i]);
+    _mm256_storeu_si256((__m256i *)&values[i], _mm256_add_epi16(v, _mm256_loadu_si256((__m256i *)&weights[i])));
+  }
+}
+
+ISA_TARGET(AVX2_TARGET) static void remove_feature_avx2(int16_t *values, int index){
+  int16_t *weights = &network->ft_weights[index*NNUE_HALF];
+  for(int i = 0; i < NNUE_HALF; i += 16){
+    __m256i v = _mm256_loadu_si256((__m256i *)&values[i]);
+    _mm256_storeu_si256((__m256i *)&values[i], _mm256_sub_epi16(v, _mm256_loadu_si256((__m256i *)&weights[i])));
+  }
+}
+
+#endif
+
+static void (*add_feature)(int16_t *values, int index) = add_feature_scalar;
+static void (*remove_feature)(int16_t *values, int index) = remove_feature_scalar;
+
+// Recomputes the accumulator for one perspective from scratch.
+static void refresh(ACCUMULATOR *acc, BRD *cBoard, int perspective){
+  int king_sq = lsb(cBoard->pieces[perspective][KING]);
+  int sq;
+  BB b;
+  memcpy(acc->values[perspective], network->ft_biases, sizeof(network->ft_biases));
+  for(int c = BLACK; c <= WHITE; c++){
+    for(int type = PAWN; type < KING; type++){
+      for(b = cBoard->pieces[c][type]; b; clear_sq(sq, b)){
+        sq = lsb(b);
+        add_feature(acc->values[perspective], feature_index(perspective, king_sq, c, type, sq));
+      }
+    }
+  }
+  acc->computed[perspective] = 1;
+}
+
+extern void nnue_invalidate(ACCUMULATOR *acc){
+  acc->computed[BLACK] = acc->computed[WHITE] = 0;
+}
+
+// Called by board.c after the piece has been added to cBoard.
+extern void nnue_add_piece(ACCUMULATOR *acc, BRD *cBoard, int c, int type, int sq){
+  if(!network) return;
+  if(type == KING){
+    acc->computed[c] = 0;
+    return;
+  }
+  for(int p = BLACK; p <= WHITE; p++){
+    if(acc->computed[p]){
+      add_feature(acc->values[p], feature_index(p, lsb(cBoard->pieces[p][KING]), c, type, sq));
+    }
+  }
+}
+
+// Called by board.c after the piece has been removed from cBoard.
+extern void nnue_remove_piece(ACCUMULATOR *acc, BRD *cBoard, int c, int type, int sq){
+  if(!network) return;
+  if(type == KING){
+    acc->computed[c] = 0;
+    return;
+  }
+  for(int p = BLACK; p <= WHITE; p++){
+    if(acc->computed[p]){
+      remove_feature(acc->values[p], feature_index(p, lsb(cBoard->pieces[p][KING]), c, type, sq));
+    }
+  }
+}
+
+// Called by board.c after the piece has been moved.
+extern void nnue_move_piece(ACCUMULATOR *acc, BRD *cBoard, int c, int type, int from, int to){
+  if(!network) return;
+  if(type == KING){
+    acc->computed[c] = 0;
+    return;
+  }
+  for(int p = BLACK; p <= WHITE; p++){
+    if(acc->computed[p]){
+      int king_sq = lsb(cBoard->pieces[p][KING]);
+      remove_feature(acc->values[p], feature_index(p, king_sq, c, type, from));
+      add_feature(acc->values[p], feature_index(p, king_sq, c, type, to));
+    }
+  }
+}
+
+
+// Forward pass
+
+// Clips the accumulator values to 0..127.
+static void transform_scalar(int16_t *values, uint8_t *output){
+  for(int i = 0; i < NNUE_HALF; i++) output[i] = min(max(values[i], 0), 127);
+}
+
+// A fully connected layer followed by a clipped ReLU.
+static void hidden_layer_scalar(uint8_t *input, int n_inputs, int8_t *weights, int32_t *biases, int n_outputs, 
+                                uint8_t *output){
+  for(int i = 0; i < n_outputs; i++){
+    int8_t *row = &weights[i*n_inputs];
+    int32_t sum = biases[i];
+    for(int j = 0; j < n_inputs; j++) sum += row[j] * input[j];
+    output[i] = min(max(sum >> NNUE_WEIGHT_SHIFT, 0), 127);
+  }
+}
+
+#ifdef CPU_X86
+
+ISA_TARGET(AVX2_TARGET) static void transform_avx2(int16_t *values, uint8_t *output){
+  for(int i = 0; i < NNUE_HALF; i += 32){
+    __m256i a = _mm256_loadu_si256((__m256i *)&values[i]);
+    __m256i b = _mm256_loadu_si256((__m256i *)&values[i+16]);
+    __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(a, b), _mm256_setzero_si256());
+    _mm256_storeu_si256((__m256i *)&output[i], _mm256_permute4x64_epi64(packed, 0xD8));
+  }
+}
+
+// Inputs are 0..127, so the 16-bit pairwise sums can't saturate.
+ISA_TARGET(AVX2_TARGET) static void hidden_layer_avx2(uint8_t *input, int n_inputs, int8_t *weights, int32_t *biases, 
+                                                      int n_outputs, uint8_t *output){
+  __m256i ones = _mm256_set1_epi16(1);
+  for(int i = 0; i < n_outputs; i++){
+    int8_t *row = &weights[i*n_inputs];
+    int32_t sum = biases[i];
+    __m256i total = _mm256_setzero_si256();
+    for(int j = 0; j < n_inputs; j += 32){
+      __m256i products = _mm256_maddubs_epi16(_mm256_loadu_si256((__m256i *)&input[j]), 
+                                              _mm256_loadu_si256((__m256i *)&row[j]));
+      total = _mm256_add_epi32(total, _mm256_madd_epi16(products, ones));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(total), _mm256_extracti128_si256(total, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    sum += _mm_cvtsi128_si32(half);
+    output[i] = min(max(sum >> NNUE_WEIGHT_SHIFT, 0), 127);
+  }
+}
+
+#endif
+
+static void (*transform)(int16_t *values, uint8_t *output) = transform_scalar;
+static void (*hidden_layer)(uint8_t *input, int n_inputs, int8_t *weights, int32_t *biases, int n_outputs, 
+                            uint8_t *output) = hidden_layer_scalar;
+
+extern void select_nnue_kernels(int isa){
+#ifdef CPU_X86
+  if(isa == ISA_AVX2){
+    add_feature = add_feature_avx2;
+    remove_feature = remove_feature_avx2;
+    transform = transform_avx2;
+    hidden_layer = hidden_layer_avx2;
+    return;
+  }
+#endif
+  add_feature = add_feature_scalar;
+  remove_feature = remove_feature_scalar;
+  transform = transform_scalar;
+  hidden_layer = hidden_layer_scalar;
+}
+
+// Returns the network's evaluation from the perspective of side c, in the same units as the hand-crafted eval.
+extern int nnue_evaluate(ACCUMULATOR *acc, BRD *cBoard, int c){
+  uint8_t input[NNUE_INPUT], hidden_1[NNUE_L1], hidden_2[NNUE_L2];
+  int32_t sum;
+  if(acc->network_id != network_id){
+    nnue_invalidate(acc);
+    acc->network_id = network_id;
+  }
+  for(int p = BLACK; p <= WHITE; p++){
+    if(!acc->computed[p]) refresh(acc, cBoard, p);
+  }
+  transform(acc->values[c], input);
+  transform(acc->values[c^1], input + NNUE_HALF);
+  hidden_layer(input, NNUE_INPUT, network->weights_1, network->biases_1, NNUE_L1, hidden_1);
+  hidden_layer(hidden_1, NNUE_L1, network->weights_2, network->biases_2, NNUE_L2, hidden_2);
+  sum = network->bias_out;
+  for(int j = 0; j < NNUE_L2; j++) sum += network->weights_out[j] * hidden_2[j];
+  return (sum / NNUE_FV_SCALE) * piece_values[PAWN] / NNUE_PAWN_VALUE;
+}
+
+
+// Network file loading.  All values are stored little-endian.
+
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  size_t pos;
+} READER;
+
+static int read_bytes(READER *r, void *dest, size_t n){
+  if(r->pos + n > r->size) return 0;
+  memcpy(dest, r->data + r->pos, n);
+  r->pos += n;
+  return 1;
+}
+
+static int read_u32(READER *r, uint32_t *v){
+  uint8_t b[4];
+  if(!read_bytes(r, b, 4)) return 0;
+  *v = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+  return 1;
+}
+
+static int read_i16s(READER *r, int16_t *dest, size_t n){
+  uint8_t b[2];
+  for(size_t i = 0; i < n; i++){
+    if(!read_bytes(r, b, 2)) return 0;
+    dest[i] = (int16_t)(b[0] | (b[1] << 8));
+  }
+  return 1;
+}
+
+static int read_i32s(READER *r, int32_t *dest, size_t n){
+  uint32_t v;
+  for(size_t i = 0; i < n; i++){
+    if(!read_u32(r, &v)) return 0;
+    dest[i] = (int32_t)v;
+  }
+  return 1;
+}
+
+static int read_network(READER *r, NETWORK *net){
+  uint32_t version, hash, desc_size, section_hash;
+  if(!read_u32(r, &version) || version != NNUE_VERSION) return 0;
+  if(!read_u32(r, &hash) || hash != NNUE_HASH) return 0;
+  if(!read_u32(r, &desc_size) || r->pos + desc_size > r->size) return 0;
+  r->pos += desc_size;
+
+  if(!read_u32(r, &section_hash) || section_hash != NNUE_FT_HASH) return 0;
+  if(!read_i16s(r, net->ft_biases, NNUE_HALF)) return 0;
+  if(!read_i16s(r, net->ft_weights, (size_t)NNUE_FEATURES*NNUE_HALF)) return 0;
+
+  if(!read_u32(r, &section_hash) || section_hash != NNUE_NETWORK_HASH) return 0;
+  if(!read_i32s(r, net->biases_1, NNUE_L1)) return 0;
+  if(!read_bytes(r, net->weights_1, sizeof(net->weights_1))) return 0;
+  if(!read_i32s(r, net->biases_2, NNUE_L2)) return 0;
+  if(!read_bytes(r, net->weights_2, sizeof(net->weights_2))) return 0;
+  if(!read_i32s(r, &net->bias_out, 1)) return 0;
+  if(!read_bytes(r, net->weights_out, sizeof(net->weights_out))) return 0;
+  return r->pos == r->size;
+}
+
+static void* write_lock_network(void *unused){
+  pthread_rwlock_wrlock(&network_lock);
+  return NULL;
+}
+
+// Swaps in the given network (or none), waiting without the GVL for any running batch or self-play session to 
+// finish with the old one.
+static void replace_network(NETWORK *net){
+  rb_thread_call_without_gvl(write_lock_network, NULL, NULL, NULL);
+  if(network) ruby_xfree(network);
+  network = net;
+  if(net) network_id++;
+  pthread_rwlock_unlock(&network_lock);
+}
+
+// Loads the network from the given file, replacing any network already loaded.  Accumulators built for an earlier 
+// network (or left stale while none was loaded) are refreshed on their next evaluation.
+static VALUE load_network(VALUE self, VALUE path){
+  FILE *f = fopen(StringValueCStr(path), "rb");
+  if(!f) rb_sys_fail(StringValueCStr(path));
+  fseek(f, 0, SEEK_END);
+  READER r = { NULL, ftell(f), 0 };
+  fseek(f, 0, SEEK_SET);
+  r.data = ruby_xmalloc(r.size);
+  size_t n = fread(r.data, 1, r.size, f);
+  fclose(f);
+
+  NETWORK *net = ruby_xmalloc(sizeof(NETWORK));
+  if(n != r.size || !read_network(&r, net)){
+    ruby_xfree(r.data);
+    ruby_xfree(net);
+    rb_raise(rb_eArgError, "%s is not a HalfKP 256x2-32-32 network", StringValueCStr(path));
+  }
+  ruby_xfree(r.data);
+  replace_network(net);
+  network_file = rb_str_new_frozen(path);
+  return Qtrue;
+}
+
+static VALUE unload_network(VALUE self){
+  replace_network(NULL);
+  network_file = Qnil;
+  return Qnil;
+}
+
+static VALUE is_network_loaded(VALUE self){
+  return network ? Qtrue : Qfalse;
+}
+
+// Returns the path of the loaded network, or nil if none is loaded.
+static VALUE get_network_file(VALUE self){
+  return network_file;
+}
+
+// Evaluates the position with the network.  If refresh is true, the accumulators are first recomputed from scratch.
+static VALUE evaluate_network(VALUE self, VALUE p_board, VALUE color, VALUE refresh){
+  if(!network) return Qnil;
+  ACCUMULATOR *acc = get_accumulator(p_board);
+  if(RTEST(refresh)) nnue_invalidate(acc);
+  return INT2NUM(nnue_evaluate(acc, get_cBoard(p_board), SYM2COLOR(color)));
+}
+
+extern void Init_nnue(){
+  printf("  -Loading nnue extension...");
+
+  rb_gc_register_address(&network_file);
+
+  VALUE mod_chess = rb_define_module("Chess");
+  VALUE mod_eval = rb_define_module_under(mod_chess, "Evaluation");
+
+  rb_define_module_function(mod_eval, "load_network", load_network, 1);
+  rb_define_module_function(mod_eval, "unload_network", unload_network, 0);
+  rb_define_module_function(mod_eval, "network_loaded?", is_network_loaded, 0);
+  rb_define_module_function(mod_eval, "network_file", get_network_file, 0);
+  rb_define_module_function(mod_eval, "evaluate_network", evaluate_network, 3);
+
+  printf("done.\n");
+}
@@ -0,0 +1,88 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef NNUE
+#define NNUE
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+// Network dimensions, matching the HalfKP 256x2-32-32 networks used by Stockfish 12.
+#define NNUE_VERSION       0x7AF32F16
+#define NNUE_HASH          0x3E5AA6EE
+#define NNUE_FT_HASH       0x5D69D7B8
+#define NNUE_NETWORK_HASH  0x63337156
+
+#define NNUE_PS_END     641    // piece-square features per king square: 10 piece kinds x 64 squares, plus one unused.
+#define NNUE_FEATURES   (64*NNUE_PS_END)
+#define NNUE_HALF       256    // accumulator size for each perspective.
+#define NNUE_INPUT      (2*NNUE_HALF)
+#define NNUE_L1         32
+#define NNUE_L2         32
+
+#define NNUE_WEIGHT_SHIFT  6   // hidden layer outputs are scaled down by 2^6 before clipping.
+#define NNUE_FV_SCALE      16  // output scale.
+#define NNUE_PAWN_VALUE    208 // value of a pawn in network output units.
+
+// The first layer's output for each perspective is kept up to date as pieces are added, removed and moved.  A
+// perspective is marked stale when its king moves, since every feature depends on the king square, and is
+// recomputed from scratch the next time the position is evaluated.
+typedef struct {
+  int16_t values[2][NNUE_HALF];
+  int computed[2];
+  unsigned network_id;  // the network the values were computed for.
+} ACCUMULATOR;
+
+typedef struct {
+  int16_t ft_biases[NNUE_HALF];
+  int16_t ft_weights[NNUE_FEATURES*NNUE_HALF];
+  int32_t biases_1[NNUE_L1];
+  int8_t  weights_1[NNUE_L1*NNUE_INPUT];
+  int32_t biases_2[NNUE_L2];
+  int8_t  weights_2[NNUE_L2*NNUE_L1];
+  int32_t bias_out;
+  int8_t  weights_out[NNUE_L2];
+} NETWORK;
+
+// Included after the typedefs above, since board.h embeds an ACCUMULATOR in each board.
+#include "shared.h"
+
+extern NETWORK *network;
+extern pthread_rwlock_t network_lock;
+
+extern void nnue_add_piece(ACCUMULATOR *acc, BRD *cBoard, int c, int type, int sq);
+extern void nnue_remove_piece(ACCUMULATOR *acc, BRD *cBoard, int c, int type, int sq);
+extern void nnue_move_piece(ACCUMULATOR *acc, BRD *cBoard, int c, int type, int from, int to);
+extern void nnue_invalidate(ACCUMULATOR *acc);
+extern int nnue_evaluate(ACCUMULATOR *acc, BRD *cBoard, int c);
+
+extern void select_nnue_kernels(int isa);
+
+static VALUE load_network(VALUE self, VALUE path);
+static VALUE is_network_loaded(VALUE self);
+static VALUE unload_network(VALUE self);
+static VALUE get_network_file(VALUE self);
+static VALUE evaluate_network(VALUE self, VALUE p_board, VALUE color, VALUE refresh);
+
+extern void Init_nnue();
+
+#endif
@@ -0,0 +1,374 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#include "position_file.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Streaming reader and writer for position files (see position_file.h).  A writer buffers records and writes them 
+// out in blocks.  A reader memory-maps the file, and decodes records straight into a BRD or into the packed boards 
+// used by batch evaluation and the tuner, without creating a Ruby object per position.
+
+extern int pack_position_record(BRD *cBoard, int c, int castle, int enp_target, int halfmove_clock, int fullmove, 
+                                PACKED_POSITION *record){
+  uint8_t codes[64];
+  int i = 0;
+  memset(record, 0, sizeof(PACKED_POSITION));
+  record->occupied = Occupied();
+  if(pop_count(record->occupied) > 32) return 0;
+  for(int color = BLACK; color <= WHITE; color++){
+    for(int type = PAWN; type <= KING; type++){
+      for(BB b = cBoard->pieces[color][type]; b; b &= b-1) codes[lsb(b)] = (type << 1) | color;
+    }
+  }
+  for(BB b = record->occupied; b; b &= b-1, i++) record->pieces[i >> 1] |= codes[lsb(b)] << ((i & 1) * 4);
+  record->flags = (c ? PF_WHITE_TO_MOVE : 0) | ((castle & 0xf) << PF_CASTLE_SHIFT);
+  record->enp_target = enp_target < 0 ? PF_NO_SQUARE : enp_target;
+  record->halfmove_clock = min(halfmove_clock, 255);
+  record->fullmove = fullmove;
+  record->result = PF_NO_RESULT;
+  return 1;
+}
+
+// Codes that don't name a piece type can only come from a corrupt file, and are skipped.
+extern void unpack_position_board(PACKED_POSITION *record, PACKED_BOARD *packed){
+  int i = 0, code;
+  memset(packed, 0, sizeof(PACKED_BOARD));
+  for(BB b = record->occupied; b && i < 32; b &= b-1, i++){
+    code = (record->pieces[i >> 1] >> ((i & 1) * 4)) & 0xf;
+    if((code >> 1) <= KING) packed->pieces[code & 1][code >> 1] |= b & -b;
+  }
+  packed->side = record->flags & PF_WHITE_TO_MOVE;
+}
+
+extern void unpack_position_record(PACKED_POSITION *record, BRD *cBoard){
+  PACKED_BOARD packed;
+  unpack_position_board(record, &packed);
+  unpack_board(&packed, cBoard);
+}
+
+// Returns [packed boards, results], in the formats taken by Evaluation::evaluate_batch and Tuner::Dataset.
+extern VALUE unpack_position_batch(PACKED_POSITION *records, long count){
+  VALUE boards = rb_str_new(NULL, count * sizeof(PACKED_BOARD));
+  VALUE results = rb_str_new(NULL, count);
+  PACKED_BOARD *packed = (PACKED_BOARD *)RSTRING_PTR(boards);
+  uint8_t *result = (uint8_t *)RSTRING_PTR(results);
+  for(long i = 0; i < count; i++){
+    unpack_position_board(&records[i], &packed[i]);
+    result[i] = records[i].result;
+  }
+  return rb_ary_new3(2, boards, results);
+}
+
+// Arguments are p_board, side_to_move, castle, enp_target, halfmove_clock, and optionally fullmove, score and 
+// result.  A nil score or result is left unset.
+static void record_from_args(int argc, VALUE *argv, PACKED_POSITION *record){
+  VALUE p_board, color, castle, enp_target, halfmove_clock, fullmove, score, result;
+  rb_scan_args(argc, argv, "53", &p_board, &color, &castle, &enp_target, &halfmove_clock, &fullmove, &score, &result);
+  BRD *cBoard = get_cBoard(p_board);
+  if(!pack_position_record(cBoard, SYM2COLOR(color), NUM2INT(castle), NIL_P(enp_target) ? -1 : NUM2INT(enp_target), 
+                           NUM2INT(halfmove_clock), NIL_P(fullmove) ? 1 : NUM2INT(fullmove), record)){
+    rb_raise(rb_eArgError, "positions with more than 32 pieces can't be packed");
+  }
+  if(!NIL_P(score)){
+    record->score = max(-32767, min(NUM2INT(score), 32767));
+    record->flags |= PF_HAS_SCORE;
+  }
+  if(!NIL_P(result)) record->result = NUM2INT(result) & 3;
+}
+
+static VALUE object_pack_record(int argc, VALUE *argv, VALUE self){
+  PACKED_POSITION record;
+  record_from_args(argc, argv, &record);
+  return rb_str_new((char *)&record, sizeof(PACKED_POSITION));
+}
+
+static VALUE object_unpack_records(VALUE self, VALUE records){
+  StringValue(records);
+  if(RSTRING_LEN(records) % sizeof(PACKED_POSITION)) rb_raise(rb_eArgError, "records have the wrong length");
+  return unpack_position_batch((PACKED_POSITION *)RSTRING_PTR(records), 
+                               RSTRING_LEN(records) / sizeof(PACKED_POSITION));
+}
+
+
+// Writer
+
+// Writes out the buffered records.  Returns 0 on a write error.  Doesn't call into Ruby, so it's safe to use 
+// without the GVL.
+static int flush_writer(POSITION_WRITER *w){
+  int written = !w->buffered || fwrite(w->buffer, sizeof(PACKED_POSITION), w->buffered, w->file) == (size_t)w->buffered;
+  w->buffered = 0;
+  return written;
+}
+
+// Adds count records to the writer.  Returns 0 on a write error.  Like flush_writer, this is safe to call without 
+// the GVL, as long as callers don't share the writer between threads without a lock.
+extern int write_position_records(POSITION_WRITER *w, PACKED_POSITION *records, long count){
+  int written = 1;
+  for(long i = 0; i < count; i++){
+    w->buffer[w->buffered++] = records[i];
+    if(w->buffered == POSITION_BUFFER) written &= flush_writer(w);
+  }
+  w->count += count;
+  return written;
+}
+
+// destructor.  A writer that wasn't closed still has its buffered records written out.
+static void free_writer(POSITION_WRITER *w){
+  if(w->file){
+    flush_writer(w);
+    fclose(w->file);
+  }
+  ruby_xfree(w);
+}
+
+extern POSITION_WRITER* get_position_writer(VALUE self){
+  POSITION_WRITER *w;
+  Data_Get_Struct(self, POSITION_WRITER, w);
+  if(!w->file) rb_raise(rb_eIOError, "closed position file");
+  return w;
+}
+
+static VALUE writer_alloc(VALUE klass){
+  POSITION_WRITER *w = ALLOC(POSITION_WRITER);
+  w->file = NULL;
+  w->count = 0;
+  w->buffered = 0;
+  return Data_Wrap_Struct(klass, 0, free_writer, w);
+}
+
+static VALUE writer_initialize(VALUE self, VALUE path){
+  POSITION_WRITER *w;
+  Data_Get_Struct(self, POSITION_WRITER, w);
+  if(w->file) rb_raise(rb_eIOError, "position file already open");
+  w->file = fopen(StringValueCStr(path), "wb");
+  if(!w->file) rb_sys_fail(StringValueCStr(path));
+  fwrite(POSITION_FILE_MAGIC, 1, POSITION_HEADER_SIZE, w->file);
+  return self;
+}
+
+static VALUE writer_add(int argc, VALUE *argv, VALUE self){
+  POSITION_WRITER *w = get_position_writer(self);
+  PACKED_POSITION record;
+  record_from_args(argc, argv, &record);
+  if(!write_position_records(w, &record, 1)) rb_sys_fail("position file");
+  return self;
+}
+
+// Appends records that are already packed, e.g. by PositionFile::pack.
+static VALUE writer_add_records(VALUE self, VALUE records){
+  POSITION_WRITER *w = get_position_writer(self);
+  StringValue(records);
+  if(RSTRING_LEN(records) % sizeof(PACKED_POSITION)) rb_raise(rb_eArgError, "records have the wrong length");
+  if(!flush_writer(w) || 
+     fwrite(RSTRING_PTR(records), 1, RSTRING_LEN(records), w->file) != (size_t)RSTRING_LEN(records)){
+    rb_sys_fail("position file");
+  }
+  w->count += RSTRING_LEN(records) / sizeof(PACKED_POSITION);
+  return self;
+}
+
+static VALUE writer_flush(VALUE self){
+  POSITION_WRITER *w = get_position_writer(self);
+  if(!flush_writer(w) || fflush(w->file)) rb_sys_fail("position file");
+  return self;
+}
+
+static VALUE writer_close(VALUE self){
+  POSITION_WRITER *w = get_position_writer(self);
+  int written = flush_writer(w);
+  written &= !fclose(w->file);
+  w->file = NULL;
+  if(!written) rb_sys_fail("position file");
+  return Qnil;
+}
+
+static VALUE writer_count(VALUE self){
+  POSITION_WRITER *w;
+  Data_Get_Struct(self, POSITION_WRITER, w);
+  return LONG2NUM(w->count);
+}
+
+
+// Reader
+
+static void free_reader(POSITION_READER *r){
+  if(r->base) munmap(r->base, r->size);
+  ruby_xfree(r);
+}
+
+static POSITION_READER* get_reader(VALUE self){
+  POSITION_READER *r;
+  Data_Get_Struct(self, POSITION_READER, r);
+  if(!r->base) rb_raise(rb_eIOError, "closed position file");
+  return r;
+}
+
+static PACKED_POSITION* get_record(POSITION_READER *r, VALUE index){
+  long i = NUM2LONG(index);
+  if(i < 0 || i >= r->count) rb_raise(rb_eIndexError, "record %ld out of range", i);
+  return &r->records[i];
+}
+
+static void check_range(POSITION_READER *r, long start, long count){
+  if(start < 0 || count < 0 || start + count > r->count) rb_raise(rb_eIndexError, "records out of range");
+}
+
+static VALUE reader_alloc(VALUE klass){
+  POSITION_READER *r = ALLOC(POSITION_READER);
+  r->base = NULL;
+  r->records = NULL;
+  r->size = r->count = 0;
+  return Data_Wrap_Struct(klass, 0, free_reader, r);
+}
+
+// Memory-maps the file.  Pages are loaded by the OS as they're touched, so records can be streamed from files much
+// larger than memory.
+static VALUE reader_initialize(VALUE self, VALUE path){
+  POSITION_READER *r;
+  Data_Get_Struct(self, POSITION_READER, r);
+  if(r->base) rb_raise(rb_eIOError, "position file already open");
+  struct stat st;
+  int fd = open(StringValueCStr(path), O_RDONLY);
+  if(fd == -1) rb_sys_fail(StringValueCStr(path));
+  if(fstat(fd, &st) || st.st_size < POSITION_HEADER_SIZE || 
+     (st.st_size - POSITION_HEADER_SIZE) % sizeof(PACKED_POSITION)){
+    close(fd);
+    rb_raise(rb_eArgError, "%s is not a position file", StringValueCStr(path));
+  }
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(base == MAP_FAILED) rb_sys_fail(StringValueCStr(path));
+  if(memcmp(base, POSITION_FILE_MAGIC, POSITION_HEADER_SIZE)){
+    munmap(base, st.st_size);
+    rb_raise(rb_eArgError, "%s is not a position file", StringValueCStr(path));
+  }
+  madvise(base, st.st_size, MADV_SEQUENTIAL);
+  r->base = base;
+  r->size = st.st_size;
+  r->records = (PACKED_POSITION *)(r->base + POSITION_HEADER_SIZE);
+  r->count = (st.st_size - POSITION_HEADER_SIZE) / sizeof(PACKED_POSITION);
+  return self;
+}
+
+static VALUE reader_count(VALUE self){
+  return LONG2NUM(get_reader(self)->count);
+}
+
+extern VALUE position_record_info(PACKED_POSITION *record){
+  VALUE info = rb_ary_new();
+  rb_ary_push(info, ID2SYM(rb_intern((record->flags & PF_WHITE_TO_MOVE) ? "w" : "b")));
+  rb_ary_push(info, INT2NUM((record->flags >> PF_CASTLE_SHIFT) & 0xf));
+  rb_ary_push(info, record->enp_target < 64 ? INT2NUM(record->enp_target) : Qnil);
+  rb_ary_push(info, INT2NUM(record->halfmove_clock));
+  rb_ary_push(info, INT2NUM(record->fullmove));
+  rb_ary_push(info, (record->flags & PF_HAS_SCORE) ? INT2NUM(record->score) : Qnil);
+  rb_ary_push(info, record->result == PF_NO_RESULT ? Qnil : INT2NUM(record->result));
+  return info;
+}
+
+// Returns [squares, side_to_move, castle, enp_target, halfmove_clock, fullmove, score, result] for a record, where 
+// squares holds the piece id on each square (0 if empty).
+extern VALUE position_record_entry(PACKED_POSITION *record){
+  PACKED_BOARD packed;
+  VALUE squares = rb_ary_new2(64);
+  int sq_ids[64] = {0};
+  unpack_position_board(record, &packed);
+  for(int c = BLACK; c <= WHITE; c++){
+    for(int type = PAWN; type <= KING; type++){
+      for(BB b = packed.pieces[c][type]; b; b &= b-1) sq_ids[lsb(b)] = 0x10 | (type << 1) | c;
+    }
+  }
+  for(int sq = 0; sq < 64; sq++) rb_ary_push(squares, INT2NUM(sq_ids[sq]));
+  VALUE entry = position_record_info(record);
+  rb_ary_unshift(entry, squares);
+  return entry;
+}
+
+static VALUE reader_entry(VALUE self, VALUE index){
+  return position_record_entry(get_record(get_reader(self), index));
+}
+
+// Decodes record i into an existing PiecewiseBoard, and returns the rest of the record as for entry, without the 
+// squares.
+static VALUE reader_load(VALUE self, VALUE index, VALUE p_board){
+  PACKED_POSITION *record = get_record(get_reader(self), index);
+  unpack_position_record(record, get_cBoard(p_board));
+  nnue_invalidate(get_accumulator(p_board));
+  return position_record_info(record);
+}
+
+// Returns the raw records in the given range.
+static VALUE reader_records(VALUE self, VALUE start, VALUE count){
+  POSITION_READER *r = get_reader(self);
+  check_range(r, NUM2LONG(start), NUM2LONG(count));
+  return rb_str_new((char *)&r->records[NUM2LONG(start)], NUM2LONG(count) * sizeof(PACKED_POSITION));
+}
+
+static VALUE reader_batch(VALUE self, VALUE start, VALUE count){
+  POSITION_READER *r = get_reader(self);
+  check_range(r, NUM2LONG(start), NUM2LONG(count));
+  return unpack_position_batch(&r->records[NUM2LONG(start)], NUM2LONG(count));
+}
+
+static VALUE reader_close(VALUE self){
+  POSITION_READER *r = get_reader(self);
+  munmap(r->base, r->size);
+  r->base = NULL;
+  r->records = NULL;
+  r->count = 0;
+  return Qnil;
+}
+
+extern void Init_position_file(){
+  printf("  -Loading position_file extension...");
+
+  VALUE mod_chess = rb_define_module("Chess");
+  VALUE mod_position_file = rb_define_module_under(mod_chess, "PositionFile");
+  VALUE cls_writer = rb_define_class_under(mod_position_file, "Writer", rb_cObject);
+  VALUE cls_reader = rb_define_class_under(mod_position_file, "Reader", rb_cObject);
+
+  rb_define_const(mod_position_file, "RECORD_SIZE", INT2NUM(sizeof(PACKED_POSITION)));
+
+  rb_define_module_function(mod_position_file, "pack", object_pack_record, -1);
+  rb_define_module_function(mod_position_file, "unpack_records", object_unpack_records, 1);
+
+  rb_define_alloc_func(cls_writer, writer_alloc);
+  rb_define_method(cls_writer, "initialize", RUBY_METHOD_FUNC(writer_initialize), 1);
+  rb_define_method(cls_writer, "add", RUBY_METHOD_FUNC(writer_add), -1);
+  rb_define_method(cls_writer, "add_records", RUBY_METHOD_FUNC(writer_add_records), 1);
+  rb_define_method(cls_writer, "flush", RUBY_METHOD_FUNC(writer_flush), 0);
+  rb_define_method(cls_writer, "close", RUBY_METHOD_FUNC(writer_close), 0);
+  rb_define_method(cls_writer, "count", RUBY_METHOD_FUNC(writer_count), 0);
+
+  rb_define_alloc_func(cls_reader, reader_alloc);
+  rb_define_method(cls_reader, "initialize", RUBY_METHOD_FUNC(reader_initialize), 1);
+  rb_define_method(cls_reader, "count", RUBY_METHOD_FUNC(reader_count), 0);
+  rb_define_method(cls_reader, "entry", RUBY_METHOD_FUNC(reader_entry), 1);
+  rb_define_method(cls_reader, "load", RUBY_METHOD_FUNC(reader_load), 2);
+  rb_define_method(cls_reader, "records", RUBY_METHOD_FUNC(reader_records), 2);
+  rb_define_method(cls_reader, "batch", RUBY_METHOD_FUNC(reader_batch), 2);
+  rb_define_method(cls_reader, "close", RUBY_METHOD_FUNC(reader_close), 0);
+
+  printf("done.\n");
+}
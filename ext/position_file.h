@@ -0,0 +1,99 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef POSITION_FILE
+#define POSITION_FILE
+
+#include "shared.h"
+#include <stdint.h>
+
+// Position files hold datasets of positions (e.g. for tuning or training) as fixed-size 32 byte records, after an 
+// 8 byte header.  A record stores the occupied squares, then a 4-bit code for the piece on each occupied square in 
+// square order, low nibble first.  The code is (type << 1) | color, the low bits of the engine's piece ids.  Records
+// are written in the host's byte order.
+#define POSITION_FILE_MAGIC  "RCPOS01\n"
+#define POSITION_HEADER_SIZE 8
+#define POSITION_BUFFER      2048  // records buffered by a writer between writes.
+
+#define PF_WHITE_TO_MOVE 0x1
+#define PF_CASTLE_SHIFT  1    // castle rights (C_WQ, C_WK, C_BQ, C_BK) are kept in bits 1-4 of the flags.
+#define PF_HAS_SCORE     0x20
+#define PF_NO_SQUARE     0xff
+#define PF_NO_RESULT     3    // results are otherwise 0 (black won), 1 (draw) or 2 (white won), as in the tuner.
+
+typedef struct PACKED_POSITION {
+  BB occupied;
+  uint8_t pieces[16];      // up to 32 pieces.
+  uint8_t flags;
+  uint8_t enp_target;      // en-passant target square, or PF_NO_SQUARE.
+  uint8_t halfmove_clock;
+  uint8_t result;
+  int16_t score;           // from the perspective of the side to move, if PF_HAS_SCORE is set.
+  uint16_t fullmove;
+} PACKED_POSITION;
+
+typedef struct POSITION_WRITER {
+  FILE *file;
+  long count;              // records written so far, including those still buffered.
+  int buffered;
+  PACKED_POSITION buffer[POSITION_BUFFER];
+} POSITION_WRITER;
+
+typedef struct {
+  uint8_t *base;
+  size_t size;
+  PACKED_POSITION *records;
+  long count;
+} POSITION_READER;
+
+extern int pack_position_record(BRD *cBoard, int c, int castle, int enp_target, int halfmove_clock, int fullmove, 
+                                PACKED_POSITION *record);
+extern void unpack_position_record(PACKED_POSITION *record, BRD *cBoard);
+extern void unpack_position_board(PACKED_POSITION *record, PACKED_BOARD *packed);
+extern VALUE unpack_position_batch(PACKED_POSITION *records, long count);
+extern VALUE position_record_info(PACKED_POSITION *record);
+extern VALUE position_record_entry(PACKED_POSITION *record);
+extern int write_position_records(POSITION_WRITER *w, PACKED_POSITION *records, long count);
+extern POSITION_WRITER* get_position_writer(VALUE self);
+
+static VALUE object_pack_record(int argc, VALUE *argv, VALUE self);
+static VALUE object_unpack_records(VALUE self, VALUE records);
+
+static VALUE writer_alloc(VALUE klass);
+static VALUE writer_initialize(VALUE self, VALUE path);
+static VALUE writer_add(int argc, VALUE *argv, VALUE self);
+static VALUE writer_add_records(VALUE self, VALUE records);
+static VALUE writer_flush(VALUE self);
+static VALUE writer_close(VALUE self);
+static VALUE writer_count(VALUE self);
+
+static VALUE reader_alloc(VALUE klass);
+static VALUE reader_initialize(VALUE self, VALUE path);
+static VALUE reader_count(VALUE self);
+static VALUE reader_entry(VALUE self, VALUE index);
+static VALUE reader_load(VALUE self, VALUE index, VALUE p_board);
+static VALUE reader_records(VALUE self, VALUE start, VALUE count);
+static VALUE reader_batch(VALUE self, VALUE start, VALUE count);
+static VALUE reader_close(VALUE self);
+
+extern void Init_position_file();
+
+#endif
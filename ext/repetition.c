@@ -0,0 +1,102 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#include "repetition.h"
+
+// The KeyStack class records the hash key of each position reached before the current position.  Keys are pushed
+// as moves are made and popped as moves are unmade, so a single stack covers both the moves played so far in the 
+// game and the moves along the current search path.
+
+// destructor
+static void free_key_stack(KEY_STACK *s){
+  ruby_xfree(s);
+}
+
+extern KEY_STACK* get_key_stack(VALUE self){
+  KEY_STACK *s;
+  Data_Get_Struct(self, KEY_STACK, s);
+  return s;
+}
+
+// associates the underlying KEY_STACK struct with a constructor and destructor.
+static VALUE ks_alloc(VALUE klass){
+  KEY_STACK *s = ruby_xmalloc(sizeof(KEY_STACK));
+  s->count = 0;
+  return Data_Wrap_Struct(klass, 0, free_key_stack, s);
+}
+
+// Save the key of the position being left by the move about to be made.
+static VALUE ks_push(VALUE self, VALUE key){
+  KEY_STACK *s = get_key_stack(self);
+  s->keys[s->count & KEY_STACK_MASK] = NUM2ULONG(key);
+  s->count++;
+  return Qnil;
+}
+
+static VALUE ks_pop(VALUE self){
+  KEY_STACK *s = get_key_stack(self);
+  if(s->count > 0) s->count--;
+  return Qnil;
+}
+
+static VALUE ks_clear(VALUE self){
+  get_key_stack(self)->count = 0;
+  return Qnil;
+}
+
+static VALUE ks_count(VALUE self){
+  return INT2NUM(get_key_stack(self)->count);
+}
+
+// Scan back through the keys of positions with the same side to move, stopping at the last irreversible move.
+// Positions further back than the halfmove clock can't be repeated, since a pawn move or capture separates them 
+// from the current position.
+extern int is_repetition(KEY_STACK *s, BB key, int halfmove_clock){
+  int window = min(halfmove_clock, s->count);
+  window = min(window, KEY_STACK_SIZE);
+  for(int i = 2; i <= window; i += 2){
+    if(s->keys[(s->count - i) & KEY_STACK_MASK] == key) return 1;
+  }
+  return 0;
+}
+
+static VALUE ks_is_repetition(VALUE self, VALUE key, VALUE halfmove_clock){
+  return is_repetition(get_key_stack(self), NUM2ULONG(key), NUM2INT(halfmove_clock)) ? Qtrue : Qfalse;
+}
+
+extern void Init_repetition(){
+  printf("  -Loading repetition extension...");
+
+  VALUE mod_chess = rb_define_module("Chess");
+  VALUE mod_memory = rb_define_module_under(mod_chess, "Memory");
+  VALUE cls_key_stack = rb_define_class_under(mod_memory, "KeyStack", rb_cObject);
+
+  rb_define_alloc_func(cls_key_stack, ks_alloc);
+
+  rb_define_method(cls_key_stack, "push", RUBY_METHOD_FUNC(ks_push), 1);
+  rb_define_method(cls_key_stack, "pop", RUBY_METHOD_FUNC(ks_pop), 0);
+  rb_define_method(cls_key_stack, "clear", RUBY_METHOD_FUNC(ks_clear), 0);
+  rb_define_method(cls_key_stack, "count", RUBY_METHOD_FUNC(ks_count), 0);
+  rb_define_method(cls_key_stack, "repetition?", RUBY_METHOD_FUNC(ks_is_repetition), 2);
+
+  printf("done.\n");
+}
+
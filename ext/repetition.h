@@ -0,0 +1,51 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef REPETITION
+#define REPETITION
+
+#include "shared.h"
+
+// Only positions reached since the last irreversible move can be repeated, and the Halfmove Rule limits this
+// window to 100 plies.  Keys are kept in a circular buffer large enough to cover the window plus the search path.
+#define KEY_STACK_SIZE 1024
+#define KEY_STACK_MASK (KEY_STACK_SIZE-1)
+
+typedef struct {
+  BB keys[KEY_STACK_SIZE];
+  int count;
+} KEY_STACK;
+
+static void free_key_stack(KEY_STACK *s);
+extern KEY_STACK* get_key_stack(VALUE self);
+static VALUE ks_alloc(VALUE klass);
+
+static VALUE ks_push(VALUE self, VALUE key);
+static VALUE ks_pop(VALUE self);
+static VALUE ks_clear(VALUE self);
+static VALUE ks_count(VALUE self);
+static VALUE ks_is_repetition(VALUE self, VALUE key, VALUE halfmove_clock);
+
+extern int is_repetition(KEY_STACK *s, BB key, int halfmove_clock);
+
+extern void Init_repetition();
+
+#endif
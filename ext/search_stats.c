@@ -0,0 +1,81 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#include "search_stats.h"
+
+// Counters for search instrumentation.  Each thread updates its own set of counters, so no synchronization is 
+// needed.  The search only calls into this module when instrumentation is enabled (see Analytics::INSTRUMENT).
+
+static __thread STATS stats;
+
+static const char *stat_names[STAT_COUNT] = { "TT_PROBES", "TT_HITS", "TT_CUTOFFS", "FIRST_CUTOFFS", "LATE_CUTOFFS",
+                                              "NULL_PRUNES", "FUTILITY_PRUNES", "IID_CALLS", "PV_NODES", 
+                                              "CUT_NODES", "ALL_NODES" };
+
+static VALUE stats_add(VALUE self, VALUE stat){
+  int i = NUM2INT(stat);
+  if(i < 0 || i >= STAT_COUNT) rb_raise(rb_eIndexError, "invalid counter: %d", i);
+  stats.counts[i]++;
+  return Qnil;
+}
+
+// Plies searched below the horizon are tallied together once they reach Q_DEPTH_MAX-1.
+static VALUE stats_add_q_depth(VALUE self, VALUE ply){
+  int i = NUM2INT(ply);
+  stats.q_depths[min(max(i, 0), Q_DEPTH_MAX-1)]++;
+  return Qnil;
+}
+
+static VALUE stats_reset(VALUE self){
+  memset(&stats, 0, sizeof(STATS));
+  return Qnil;
+}
+
+static VALUE stats_counts(VALUE self){
+  VALUE counts = rb_ary_new2(STAT_COUNT);
+  for(int i = 0; i < STAT_COUNT; i++) rb_ary_push(counts, LONG2NUM(stats.counts[i]));
+  return counts;
+}
+
+static VALUE stats_q_depths(VALUE self){
+  VALUE q_depths = rb_ary_new2(Q_DEPTH_MAX);
+  for(int i = 0; i < Q_DEPTH_MAX; i++) rb_ary_push(q_depths, LONG2NUM(stats.q_depths[i]));
+  return q_depths;
+}
+
+extern void Init_search_stats(){
+  printf("  -Loading search_stats extension...");
+
+  VALUE mod_chess = rb_define_module("Chess");
+  VALUE mod_analytics = rb_define_module_under(mod_chess, "Analytics");
+  VALUE mod_counters = rb_define_module_under(mod_analytics, "Counters");
+
+  for(int i = 0; i < STAT_COUNT; i++) rb_define_const(mod_counters, stat_names[i], INT2NUM(i));
+  rb_define_const(mod_counters, "Q_DEPTH_MAX", INT2NUM(Q_DEPTH_MAX));
+
+  rb_define_module_function(mod_counters, "add", stats_add, 1);
+  rb_define_module_function(mod_counters, "add_q_depth", stats_add_q_depth, 1);
+  rb_define_module_function(mod_counters, "reset", stats_reset, 0);
+  rb_define_module_function(mod_counters, "counts", stats_counts, 0);
+  rb_define_module_function(mod_counters, "q_depths", stats_q_depths, 0);
+
+  printf("done.\n");
+}
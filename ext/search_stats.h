@@ -0,0 +1,46 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef SEARCH_STATS
+#define SEARCH_STATS
+
+#include "shared.h"
+#include <string.h>
+
+#define Q_DEPTH_MAX 16
+
+typedef enum { TT_PROBES, TT_HITS, TT_CUTOFFS, FIRST_CUTOFFS, LATE_CUTOFFS, NULL_PRUNES, FUTILITY_PRUNES, 
+               IID_CALLS, PV_NODES, CUT_NODES, ALL_NODES, STAT_COUNT } enumStat;
+
+typedef struct {
+  long counts[STAT_COUNT];
+  long q_depths[Q_DEPTH_MAX];
+} STATS;
+
+static VALUE stats_add(VALUE self, VALUE stat);
+static VALUE stats_add_q_depth(VALUE self, VALUE ply);
+static VALUE stats_reset(VALUE self);
+static VALUE stats_counts(VALUE self);
+static VALUE stats_q_depths(VALUE self);
+
+extern void Init_search_stats();
+
+#endif
@@ -0,0 +1,706 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#include "self_play.h"
+
+// Generates training data by self-play.  Each thread runs a private engine: a small alpha-beta searcher with its own
+// transposition table and move ordering tables, built on the same attack tables, evaluation and network as the rest 
+// of the extension.  Threads take games from a shared counter and play them out in full at a fixed node or depth 
+// budget per move, starting with a few random plies for diversity.  Each quiet position (side to move not in check,
+// best move not a capture or promotion) is recorded with its search score, and the game's positions are labeled 
+// with its result and appended to a position file.  Threads share nothing else, so throughput scales with cores.
+//
+// This is a second engine, separate from move_gen.c and the Ruby search, so the labels don't come from the search 
+// being tuned.  Unlike MoveGen, its generator includes rook and bishop promotions; self_play_spec.rb checks the two 
+// generators against each other by perft.
+//
+// The search is kept simple: iterative deepening with PVS, a transposition table, null move pruning, late move 
+// reductions, killer and history ordering, and a capture search with delta pruning.  Games end by mate, stalemate, 
+// the fifty move rule, threefold repetition, insufficient material, the SP_MAX_GAME ply limit, or adjudication once
+// both sides agree on a decisive score.
+
+static BB piece_keys[2][6][64];
+static BB side_key;
+static BB castle_keys[16];
+static BB enp_keys[8];
+static int castle_masks[64];  // castle rights that survive a move from or to each square.
+
+// splitmix64
+static BB next_random(BB *state){
+  BB z = (*state += 0x9E3779B97F4A7C15UL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9UL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBUL;
+  return z ^ (z >> 31);
+}
+
+static int piece_at(BRD *cBoard, int c, int sq){
+  for(int type = PAWN; type <= KING; type++){
+    if(cBoard->pieces[c][type] & sq_mask_on(sq)) return type;
+  }
+  return -1;
+}
+
+static BB compute_key(NODE *node){
+  BB key = node->c ? side_key : 0;
+  for(int c = BLACK; c <= WHITE; c++){
+    for(int type = PAWN; type <= KING; type++){
+      for(BB b = node->board.pieces[c][type]; b; b &= b-1) key ^= piece_keys[c][type][lsb(b)];
+    }
+  }
+  key ^= castle_keys[node->castle];
+  if(node->enp_target >= 0) key ^= enp_keys[column(node->enp_target)];
+  return key;
+}
+
+// The rest of the engine (and the position file format) marks en-passant by the square of the pawn that can be 
+// captured, where nodes keep the square the capturing pawn moves to.  c is the side to move.
+static int enp_capture_square(int c, int enp_target){
+  return enp_target < 0 ? -1 : (c ? enp_target + 8 : enp_target - 8);
+}
+
+static int enp_pawn_square(int c, int enp_target){
+  return enp_target < 0 ? -1 : (c ? enp_target - 8 : enp_target + 8);
+}
+
+// enp_target is given as the square of the capturable pawn, as elsewhere in the engine.
+extern void set_node(NODE *node, BRD *cBoard, int c, int castle, int enp_target, int halfmove_clock){
+  PACKED_BOARD packed;
+  memcpy(packed.pieces, cBoard->pieces, sizeof(packed.pieces));
+  unpack_board(&packed, &node->board);
+  nnue_invalidate(&node->acc);
+  node->c = c;
+  node->castle = castle & 0xf;
+  node->enp_target = enp_capture_square(c, enp_target);
+  node->halfmove_clock = halfmove_clock;
+  node->key = compute_key(node);
+}
+
+extern void set_start_node(NODE *node){
+  BRD start;
+  memset(start.pieces, 0, sizeof(start.pieces));
+  start.pieces[WHITE][PAWN] = row_masks[1];
+  start.pieces[WHITE][KNIGHT] = sq_mask_on(B1)|sq_mask_on(G1);
+  start.pieces[WHITE][BISHOP] = sq_mask_on(C1)|sq_mask_on(F1);
+  start.pieces[WHITE][ROOK] = sq_mask_on(A1)|sq_mask_on(H1);
+  start.pieces[WHITE][QUEEN] = sq_mask_on(D1);
+  start.pieces[WHITE][KING] = sq_mask_on(E1);
+  start.pieces[BLACK][PAWN] = row_masks[6];
+  for(int type = KNIGHT; type <= KING; type++) start.pieces[BLACK][type] = start.pieces[WHITE][type] << 56;
+  set_node(node, &start, WHITE, C_WQ|C_WK|C_BQ|C_BK, -1, 0);
+}
+
+
+// Move generation
+
+static int add_promotions(uint16_t *moves, int n, int from, int to, int all){
+  if(all){
+    for(int flag = SP_PROMOTE; flag < SP_PROMOTE+3; flag++) moves[n++] = sp_move(from, to, flag);
+  }
+  moves[n++] = sp_move(from, to, SP_PROMOTE + QUEEN - KNIGHT);
+  return n;
+}
+
+// Generates pseudo-legal moves, returning the number generated.  With captures_only set, only captures (including 
+// en-passant) and queen promotions are generated.  Castling is only generated when legal.
+extern int generate_node_moves(NODE *node, uint16_t *moves, int captures_only, int in_check){
+  BRD *cBoard = &node->board;
+  int c = node->c, e = c^1;
+  int n = 0, from, to;
+  BB occ = Occupied();
+  BB enemy = Placement(e);
+  BB targets = captures_only ? enemy : ~Placement(c);
+  BB last_row = row_masks[c ? 7 : 0];
+  BB b, a, attacks;
+
+  for(b = cBoard->pieces[c][PAWN]; b; b &= b-1){
+    from = lsb(b);
+    for(a = pawn_attack_masks[c][from] & enemy; a; a &= a-1){
+      to = lsb(a);
+      if(sq_mask_on(to) & last_row) n = add_promotions(moves, n, from, to, !captures_only);
+      else moves[n++] = sp_move(from, to, SP_QUIET);
+    }
+    if(node->enp_target >= 0 && (pawn_attack_masks[c][from] & sq_mask_on(node->enp_target))){
+      moves[n++] = sp_move(from, node->enp_target, SP_ENP);
+    }
+    to = c ? from + 8 : from - 8;
+    if(occ & sq_mask_on(to)) continue;
+    if(sq_mask_on(to) & last_row){
+      n = add_promotions(moves, n, from, to, !captures_only);
+    } else if(!captures_only){
+      moves[n++] = sp_move(from, to, SP_QUIET);
+      if(row(from) == (c ? 1 : 6) && !(occ & sq_mask_on(c ? to + 8 : to - 8))){
+        moves[n++] = sp_move(from, c ? to + 8 : to - 8, SP_DOUBLE);
+      }
+    }
+  }
+  for(int type = KNIGHT; type <= KING; type++){
+    for(b = cBoard->pieces[c][type]; b; b &= b-1){
+      from = lsb(b);
+      switch(type){
+        case KNIGHT: attacks = knight_masks[from]; break;
+        case BISHOP: attacks = bishop_attacks(occ, from); break;
+        case ROOK:   attacks = rook_attacks(occ, from); break;
+        case QUEEN:  attacks = queen_attacks(occ, from); break;
+        default:     attacks = king_masks[from];
+      }
+      for(a = attacks & targets; a; a &= a-1) moves[n++] = sp_move(from, lsb(a), SP_QUIET);
+    }
+  }
+  if(!captures_only && !in_check && node->castle){
+    int king_sq = c ? E1 : E8;
+    int castle_k = c ? C_WK : C_BK, castle_q = c ? C_WQ : C_BQ;
+    BB rooks = cBoard->pieces[c][ROOK];
+    if((node->castle & castle_k) && !(castle_kingside_intervening[c] & occ) && (rooks & sq_mask_on(king_sq+3)) &&
+       !is_attacked_by(cBoard, king_sq+1, e, c)){
+      moves[n++] = sp_move(king_sq, king_sq+2, SP_CASTLE);
+    }
+    if((node->castle & castle_q) && !(castle_queenside_intervening[c] & occ) && (rooks & sq_mask_on(king_sq-4)) &&
+       !is_attacked_by(cBoard, king_sq-1, e, c)){
+      moves[n++] = sp_move(king_sq, king_sq-2, SP_CASTLE);
+    }
+  }
+  return n;
+}
+
+// Captures and promotions.
+static int is_tactical(NODE *node, int move){
+  return sp_flag(move) >= SP_ENP || (node->board.occupied[node->c^1] & sq_mask_on(sp_to(move)));
+}
+
+// Makes the move from parent into child, copying the board as batch_eval.c does.  Returns 0 if the move leaves the
+// mover's king in check.
+extern int make_node_move(NODE *parent, NODE *child, int move){
+  BRD *cBoard = &child->board;
+  ACCUMULATOR *acc = &child->acc;
+  int c = parent->c, e = c^1;
+  int from = sp_from(move), to = sp_to(move), flag = sp_flag(move);
+  int type = piece_at(&parent->board, c, from);
+  int victim = flag == SP_ENP ? PAWN : piece_at(&parent->board, e, to);
+  int capture_sq = flag == SP_ENP ? (c ? to - 8 : to + 8) : to;
+  BB delta = sq_mask_on(from)|sq_mask_on(to);
+  BB key = parent->key ^ side_key ^ castle_keys[parent->castle];
+
+  memcpy(cBoard, &parent->board, offsetof(BRD, info_slot));
+  if(network) *acc = parent->acc;
+  if(parent->enp_target >= 0) key ^= enp_keys[column(parent->enp_target)];
+  if(victim != -1){
+    clear_sq(capture_sq, cBoard->pieces[e][victim]);
+    clear_sq(capture_sq, cBoard->occupied[e]);
+    cBoard->material[e] -= piece_values[victim];
+    cBoard->material_key -= material_key_delta(e, victim);
+    nnue_remove_piece(acc, cBoard, e, victim, capture_sq);
+    key ^= piece_keys[e][victim][capture_sq];
+  }
+  if(flag >= SP_PROMOTE){
+    int promoted_type = flag - SP_PROMOTE + KNIGHT;
+    clear_sq(from, cBoard->pieces[c][PAWN]);
+    cBoard->material[c] -= piece_values[PAWN];
+    nnue_remove_piece(acc, cBoard, c, PAWN, from);
+    add_sq(to, cBoard->pieces[c][promoted_type]);
+    cBoard->material[c] += piece_values[promoted_type];
+    cBoard->material_key += material_key_delta(c, promoted_type) - material_key_delta(c, PAWN);
+    cBoard->occupied[c] ^= delta;
+    nnue_add_piece(acc, cBoard, c, promoted_type, to);
+    key ^= piece_keys[c][PAWN][from] ^ piece_keys[c][promoted_type][to];
+  } else {
+    cBoard->pieces[c][type] ^= delta;
+    cBoard->occupied[c] ^= delta;
+    nnue_move_piece(acc, cBoard, c, type, from, to);
+    key ^= piece_keys[c][type][from] ^ piece_keys[c][type][to];
+    if(flag == SP_CASTLE){
+      int rook_from = to > from ? to + 1 : to - 2;
+      int rook_to = to > from ? to - 1 : to + 1;
+      BB rook_delta = sq_mask_on(rook_from)|sq_mask_on(rook_to);
+      cBoard->pieces[c][ROOK] ^= rook_delta;
+      cBoard->occupied[c] ^= rook_delta;
+      nnue_move_piece(acc, cBoard, c, ROOK, rook_from, rook_to);
+      key ^= piece_keys[c][ROOK][rook_from] ^ piece_keys[c][ROOK][rook_to];
+    }
+  }
+  child->c = e;
+  child->castle = parent->castle & castle_masks[from] & castle_masks[to];
+  child->enp_target = flag == SP_DOUBLE ? (from + to) / 2 : -1;
+  child->halfmove_clock = (type == PAWN || victim != -1) ? 0 : parent->halfmove_clock + 1;
+  key ^= castle_keys[child->castle];
+  if(child->enp_target >= 0) key ^= enp_keys[column(child->enp_target)];
+  child->key = key;
+  return !is_attacked_by(cBoard, lsb(cBoard->pieces[c][KING]), e, c);
+}
+
+extern int node_in_check(NODE *node){
+  BRD *cBoard = &node->board;
+  return is_attacked_by(cBoard, lsb(cBoard->pieces[node->c][KING]), node->c^1, node->c);
+}
+
+extern long perft(ENGINE *engine, int ply, int depth){
+  NODE *node = &engine->nodes[ply];
+  uint16_t moves[SP_MAX_MOVES];
+  int n = generate_node_moves(node, moves, 0, node_in_check(node));
+  long count = 0;
+  for(int i = 0; i < n; i++){
+    if(make_node_move(node, &engine->nodes[ply+1], moves[i])) count += depth > 1 ? perft(engine, ply+1, depth-1) : 1;
+  }
+  return count;
+}
+
+
+// Search
+
+// Counts a node, and returns 1 once the search should stop.  The first iteration always runs to completion, so that
+// there's a move to play.
+static int check_stop(ENGINE *engine){
+  engine->nodes_searched++;
+  if(engine->root_depth > 1 && ((engine->node_limit && engine->nodes_searched >= engine->node_limit) || 
+                                *engine->interrupted)){
+    engine->stopped = 1;
+  }
+  return engine->stopped;
+}
+
+// Looks back through positions since the last irreversible move for earlier occurrences of the node's position.
+static int repeats_position(ENGINE *engine, NODE *node, int index, int repeats){
+  int seen = 0;
+  for(int i = index - 4; i >= 0 && i >= index - node->halfmove_clock; i -= 2){
+    if(engine->keys[i] == node->key && ++seen == repeats) return 1;
+  }
+  return 0;
+}
+
+static int has_pieces(BRD *cBoard, int c){
+  return (cBoard->pieces[c][KNIGHT] | cBoard->pieces[c][BISHOP] | cBoard->pieces[c][ROOK] | 
+          cBoard->pieces[c][QUEEN]) != 0;
+}
+
+// Mate scores are stored relative to the node, rather than the root.
+static int to_tt(int score, int ply){
+  return score >= SP_MATE_BOUND ? score + ply : (score <= -SP_MATE_BOUND ? score - ply : score);
+}
+
+static int from_tt(int score, int ply){
+  return score >= SP_MATE_BOUND ? score - ply : (score <= -SP_MATE_BOUND ? score + ply : score);
+}
+
+// Orders the hash move first, then captures and promotions by MVV/LVA, then killers, then quiet moves by history.
+static void score_moves(ENGINE *engine, NODE *node, int ply, uint16_t *moves, int *scores, int n, int tt_move){
+  BRD *cBoard = &node->board;
+  int c = node->c;
+  for(int i = 0; i < n; i++){
+    int move = moves[i], from = sp_from(move), to = sp_to(move);
+    if(move == tt_move){
+      scores[i] = 1 << 30;
+    } else if(is_tactical(node, move)){
+      int victim = sp_flag(move) == SP_ENP ? PAWN : piece_at(cBoard, c^1, to);
+      scores[i] = (1 << 24) + (victim + 1) * 16 - piece_at(cBoard, c, from);
+      if(sp_flag(move) >= SP_PROMOTE) scores[i] += (sp_flag(move) - SP_PROMOTE) * 64;
+    } else if(move == engine->killers[ply][0]){
+      scores[i] = (1 << 22) + 1;
+    } else if(move == engine->killers[ply][1]){
+      scores[i] = 1 << 22;
+    } else {
+      scores[i] = engine->history[c][from][to];
+    }
+  }
+}
+
+// Selection sort, one move at a time, since most nodes cut off after the first few moves.
+static int next_move(uint16_t *moves, int *scores, int n, int i){
+  int best = i;
+  for(int j = i+1; j < n; j++) if(scores[j] > scores[best]) best = j;
+  int move = moves[best], score = scores[best];
+  moves[best] = moves[i];
+  scores[best] = scores[i];
+  moves[i] = move;
+  scores[i] = score;
+  return move;
+}
+
+static int qsearch(ENGINE *engine, int ply, int alpha, int beta){
+  NODE *node = &engine->nodes[ply];
+  BRD *cBoard = &node->board;
+  uint16_t moves[SP_MAX_MOVES];
+  int scores[SP_MAX_MOVES];
+  int c = node->c, e = c^1;
+  int best = -SP_INF, stand_pat = 0, legal = 0;
+
+  if(check_stop(engine)) return 0;
+  int checked = node_in_check(node);
+  if(!checked){
+    stand_pat = static_eval(cBoard, &node->acc, c);
+    if(stand_pat >= beta || ply >= SP_MAX_PLY) return stand_pat;
+    if(stand_pat > alpha) alpha = stand_pat;
+    best = stand_pat;
+  } else if(ply >= SP_MAX_PLY){
+    return static_eval(cBoard, &node->acc, c);
+  }
+  int n = generate_node_moves(node, moves, !checked, checked);
+  score_moves(engine, node, ply, moves, scores, n, 0);
+  for(int i = 0; i < n; i++){
+    int move = next_move(moves, scores, n, i);
+    // Delta pruning: skip captures that can't raise alpha even if the victim is won outright.
+    if(!checked && sp_flag(move) < SP_PROMOTE){
+      int victim = sp_flag(move) == SP_ENP ? PAWN : piece_at(cBoard, e, sp_to(move));
+      if(stand_pat + piece_values[victim] + 200 <= alpha) continue;
+    }
+    if(!make_node_move(node, &engine->nodes[ply+1], move)) continue;
+    legal++;
+    int value = -qsearch(engine, ply+1, -beta, -alpha);
+    if(engine->stopped) return 0;
+    if(value > best){
+      best = value;
+      if(value > alpha){
+        if(value >= beta) return value;
+        alpha = value;
+      }
+    }
+  }
+  if(checked && !legal) return -SP_MATE + ply;
+  return best;
+}
+
+static int search(ENGINE *engine, int ply, int depth, int alpha, int beta, int null_ok){
+  NODE *node = &engine->nodes[ply];
+  NODE *child = &engine->nodes[ply+1];
+  BRD *cBoard = &node->board;
+  uint16_t moves[SP_MAX_MOVES];
+  int scores[SP_MAX_MOVES];
+  int c = node->c, e = c^1;
+  int pv = beta - alpha > 1;
+  int original_alpha = alpha, best = -SP_INF, best_move = 0, legal = 0, tt_move = 0, value;
+
+  engine->keys[engine->game_ply + ply] = node->key;
+  if(ply && (node->halfmove_clock >= 100 || repeats_position(engine, node, engine->game_ply + ply, 1))) return 0;
+  int checked = node_in_check(node);
+  if(checked) depth++;
+  if(depth <= 0) return qsearch(engine, ply, alpha, beta);
+  if(check_stop(engine)) return 0;
+  if(ply >= SP_MAX_PLY) return static_eval(cBoard, &node->acc, c);
+
+  TT_ENTRY *entry = &engine->tt[node->key & engine->tt_mask];
+  if(entry->key == node->key){
+    tt_move = entry->move;
+    if(!pv && entry->depth >= depth){
+      int score = from_tt(entry->score, ply);
+      if(entry->bound == TT_EXACT || (entry->bound == TT_LOWER && score >= beta) || 
+         (entry->bound == TT_UPPER && score <= alpha)) return score;
+    }
+  }
+
+  // Null move pruning: if passing still fails high at reduced depth, so will the best move.
+  if(null_ok && !pv && !checked && depth >= 3 && has_pieces(cBoard, c) && static_eval(cBoard, &node->acc, c) >= beta){
+    memcpy(&child->board, cBoard, offsetof(BRD, info_slot));
+    if(network) child->acc = node->acc;
+    child->c = e;
+    child->castle = node->castle;
+    child->enp_target = -1;
+    child->halfmove_clock = 0;
+    child->key = node->key ^ side_key ^ (node->enp_target >= 0 ? enp_keys[column(node->enp_target)] : 0);
+    value = -search(engine, ply+1, depth - 3 - depth/6, -beta, -beta+1, 0);
+    if(engine->stopped) return 0;
+    if(value >= beta) return value >= SP_MATE_BOUND ? beta : value;
+  }
+
+  int n = generate_node_moves(node, moves, 0, checked);
+  score_moves(engine, node, ply, moves, scores, n, tt_move);
+  for(int i = 0; i < n; i++){
+    int move = next_move(moves, scores, n, i);
+    int quiet = !is_tactical(node, move);
+    if(!make_node_move(node, child, move)) continue;
+    legal++;
+    if(legal == 1){
+      value = -search(engine, ply+1, depth-1, -beta, -alpha, 1);
+    } else {
+      // Late move reductions for quiet moves, then a full window re-search of anything that beats alpha.
+      int reduction = (depth >= 3 && legal > 3 && quiet && !checked) ? 1 + (legal > 8) : 0;
+      value = -search(engine, ply+1, depth-1-reduction, -alpha-1, -alpha, 1);
+      if(value > alpha && (reduction || value < beta)) value = -search(engine, ply+1, depth-1, -beta, -alpha, 1);
+    }
+    if(engine->stopped) return 0;
+    if(value > best){
+      best = value;
+      best_move = move;
+      if(ply == 0) engine->root_move = move;
+      if(value > alpha){
+        alpha = value;
+        if(value >= beta){
+          if(quiet){
+            if(engine->killers[ply][0] != move){
+              engine->killers[ply][1] = engine->killers[ply][0];
+              engine->killers[ply][0] = move;
+            }
+            engine->history[c][sp_from(move)][sp_to(move)] += depth * depth;
+          }
+          break;
+        }
+      }
+    }
+  }
+  if(!legal) return checked ? -SP_MATE + ply : 0;
+
+  entry->key = node->key;
+  entry->score = to_tt(best, ply);
+  entry->move = best_move;
+  entry->depth = depth;
+  entry->bound = best >= beta ? TT_LOWER : (best > original_alpha ? TT_EXACT : TT_UPPER);
+  return best;
+}
+
+// Iterative deepening from nodes[0], within the node budget (if any) and up to max_depth plies.  Returns the score
+// of the last completed iteration, and its best move in best_move.
+static int think(ENGINE *engine, long nodes, int max_depth, uint16_t *best_move){
+  int score = 0;
+  engine->node_limit = nodes ? engine->nodes_searched + nodes : 0;
+  for(int depth = 1; depth <= max_depth; depth++){
+    engine->root_depth = depth;
+    int value = search(engine, 0, depth, -SP_INF, SP_INF, 0);
+    if(engine->stopped) break;
+    score = value;
+    *best_move = engine->root_move;
+    if(engine->node_limit && engine->nodes_searched >= engine->node_limit) break;
+  }
+  engine->stopped = 0;
+  return score;
+}
+
+
+// Games
+
+static int insufficient_material(BRD *cBoard){
+  BB majors = 0, minors = 0;
+  for(int c = BLACK; c <= WHITE; c++){
+    majors |= cBoard->pieces[c][PAWN] | cBoard->pieces[c][ROOK] | cBoard->pieces[c][QUEEN];
+    minors |= cBoard->pieces[c][KNIGHT] | cBoard->pieces[c][BISHOP];
+  }
+  return !majors && pop_count(minors) <= 1;
+}
+
+// Plays out one game from the start position, recording each quiet position in records.  Returns the result (0 if 
+// black won, 1 for a draw, 2 if white won), or -1 if interrupted.
+static int play_game(ENGINE *engine, SELF_PLAY_SESSION *sp, long game, PACKED_POSITION *records, int *count){
+  NODE *root = &engine->nodes[0];
+  uint16_t moves[SP_MAX_MOVES], move = 0;
+  int max_depth = sp->depth ? min(sp->depth, SP_MAX_PLY) : SP_MAX_PLY;
+  int decisive = 0;  // consecutive plies with a decisive score, with the sign of the side it favors.
+
+  // Each game is seeded by its index, and starts with cleared tables, so its moves don't depend on the thread.
+  engine->rng = sp->seed ^ ((BB)game * 0xD1B54A32D192ED03UL);
+  memset(engine->tt, 0, (engine->tt_mask + 1) * sizeof(TT_ENTRY));
+  memset(engine->killers, 0, sizeof(engine->killers));
+  memset(engine->history, 0, sizeof(engine->history));
+  set_start_node(root);
+  *count = 0;
+
+  for(engine->game_ply = 0; ; engine->game_ply++){
+    engine->keys[engine->game_ply] = root->key;
+    int checked = node_in_check(root);
+    int legal = 0, n = generate_node_moves(root, moves, 0, checked);
+    for(int i = 0; i < n; i++) if(make_node_move(root, &engine->nodes[1], moves[i])) moves[legal++] = moves[i];
+
+    if(!legal) return checked ? (root->c ? 0 : 2) : 1;
+    if(root->halfmove_clock >= 100 || repeats_position(engine, root, engine->game_ply, 2) || 
+       insufficient_material(&root->board) || engine->game_ply >= SP_MAX_GAME) return 1;
+
+    if(engine->game_ply < sp->random_plies){
+      move = moves[next_random(&engine->rng) % legal];
+    } else {
+      int score = think(engine, sp->nodes, max_depth, &move);
+      if(*engine->interrupted) return -1;
+      if(!checked && !is_tactical(root, move) && abs(score) < SP_MATE_BOUND){
+        PACKED_POSITION *record = &records[(*count)++];
+        pack_position_record(&root->board, root->c, root->castle, enp_pawn_square(root->c, root->enp_target), 
+                             root->halfmove_clock, engine->game_ply/2 + 1, record);
+        record->score = score;
+        record->flags |= PF_HAS_SCORE;
+      }
+      // Adjudicate once the scores for both sides have agreed on a winner for SP_RESIGN_PLIES plies in a row.
+      int white_score = root->c ? score : -score;
+      if(abs(score) >= SP_RESIGN_SCORE){
+        decisive = (white_score > 0) == (decisive > 0) ? decisive + (decisive > 0 ? 1 : -1) : (white_score > 0 ? 1 : -1);
+        if(abs(decisive) >= SP_RESIGN_PLIES) return decisive > 0 ? 2 : 0;
+      } else {
+        decisive = 0;
+      }
+    }
+    make_node_move(root, &engine->nodes[1], move);
+    *root = engine->nodes[1];
+  }
+}
+
+static void* run_self_play(void *data){
+  SELF_PLAY_SESSION *sp = ((SELF_PLAY_SESSION **)data)[0];
+  ENGINE *engine = ((ENGINE **)data)[1];
+  PACKED_POSITION records[SP_MAX_GAME];
+  int count;
+  while(1){
+    pthread_mutex_lock(&sp->lock);
+    long game = (sp->next_game < sp->games && !sp->interrupted) ? sp->next_game++ : -1;
+    pthread_mutex_unlock(&sp->lock);
+    if(game < 0) break;
+
+    long nodes_before = engine->nodes_searched;
+    int result = play_game(engine, sp, game, records, &count);
+    if(result < 0) break;
+    for(int i = 0; i < count; i++) records[i].result = result;
+
+    pthread_mutex_lock(&sp->lock);
+    if(!write_position_records(sp->writer, records, count)) sp->write_failed = 1;
+    sp->positions += count;
+    sp->results[result]++;
+    sp->nodes_searched += engine->nodes_searched - nodes_before;
+    pthread_mutex_unlock(&sp->lock);
+  }
+  return NULL;
+}
+
+typedef struct {
+  SELF_PLAY_SESSION *sp;
+  ENGINE **engines;
+  int n_threads;
+} SELF_PLAY_RUN;
+
+static void* run_threads(void *data){
+  SELF_PLAY_RUN *run = data;
+  pthread_t threads[SP_MAX_THREADS];
+  void *args[SP_MAX_THREADS][2];
+  for(int t = 0; t < run->n_threads; t++){
+    args[t][0] = run->sp;
+    args[t][1] = run->engines[t];
+  }
+  pthread_rwlock_rdlock(&network_lock);
+  for(int t = 1; t < run->n_threads; t++) pthread_create(&threads[t], NULL, run_self_play, args[t]);
+  run_self_play(args[0]);
+  for(int t = 1; t < run->n_threads; t++) pthread_join(threads[t], NULL);
+  pthread_rwlock_unlock(&network_lock);
+  return NULL;
+}
+
+static void interrupt_self_play(void *data){
+  ((SELF_PLAY_SESSION *)data)->interrupted = 1;
+}
+
+static ENGINE* new_engine(SELF_PLAY_SESSION *sp, int tt_bits){
+  ENGINE *engine = calloc(1, sizeof(ENGINE));
+  if(!engine) return NULL;
+  engine->tt = calloc((BB)1 << tt_bits, sizeof(TT_ENTRY));
+  if(!engine->tt){
+    free(engine);
+    return NULL;
+  }
+  engine->tt_mask = ((BB)1 << tt_bits) - 1;
+  engine->interrupted = &sp->interrupted;
+  return engine;
+}
+
+static void free_engine(ENGINE *engine){
+  if(!engine) return;
+  free(engine->tt);
+  free(engine);
+}
+
+
+// Ruby interface
+
+// Counts the leaf nodes of the legal move tree to the given depth, as a check on the engine's move generation.
+static VALUE object_perft(VALUE self, VALUE p_board, VALUE color, VALUE castle, VALUE enp_target, VALUE depth){
+  SELF_PLAY_SESSION sp = { 0 };
+  ENGINE *engine = new_engine(&sp, 0);
+  if(!engine) rb_raise(rb_eNoMemError, "failed to allocate engine");
+  set_node(&engine->nodes[0], get_cBoard(p_board), SYM2COLOR(color), NUM2INT(castle), 
+               NIL_P(enp_target) ? -1 : NUM2INT(enp_target), 0);
+  long count = NUM2INT(depth) > 0 ? perft(engine, 0, min(NUM2INT(depth), SP_MAX_PLY)) : 1;
+  free_engine(engine);
+  return LONG2NUM(count);
+}
+
+// Plays the given number of games on up to threads threads, appending their quiet positions to writer (a 
+// PositionFile::Writer).  Each move is searched to nodes nodes and/or depth plies; either may be 0 for no limit.  
+// Engines each get a transposition table of 2^tt_bits entries.  Returns [positions, black wins, draws, white wins, 
+// nodes searched].
+static VALUE object_play_games(VALUE self, VALUE writer, VALUE games, VALUE threads, VALUE nodes, VALUE depth, 
+                               VALUE random_plies, VALUE seed, VALUE tt_bits){
+  SELF_PLAY_SESSION sp = { 0 };
+  ENGINE *engines[SP_MAX_THREADS] = { 0 };
+  int n_threads = NIL_P(threads) ? sysconf(_SC_NPROCESSORS_ONLN) : NUM2INT(threads);
+  int bits = NUM2INT(tt_bits);
+
+  sp.writer = get_position_writer(writer);
+  sp.games = NUM2LONG(games);
+  sp.nodes = NUM2LONG(nodes);
+  sp.depth = NUM2INT(depth);
+  sp.random_plies = NUM2INT(random_plies);
+  sp.seed = NUM2ULL(seed);
+  if(sp.nodes <= 0 && sp.depth <= 0) rb_raise(rb_eArgError, "a node or depth limit is required");
+  if(bits < 1 || bits > 30) rb_raise(rb_eArgError, "table size out of range");
+  n_threads = max(1, min(n_threads, SP_MAX_THREADS));
+  if(sp.games < n_threads) n_threads = sp.games > 0 ? sp.games : 1;
+
+  for(int t = 0; t < n_threads; t++){
+    if(!(engines[t] = new_engine(&sp, bits))){
+      for(int i = 0; i < t; i++) free_engine(engines[i]);
+      rb_raise(rb_eNoMemError, "failed to allocate engines");
+    }
+  }
+  pthread_mutex_init(&sp.lock, NULL);
+  SELF_PLAY_RUN run = { &sp, engines, n_threads };
+  rb_thread_call_without_gvl(run_threads, &run, interrupt_self_play, &sp);
+  pthread_mutex_destroy(&sp.lock);
+  for(int t = 0; t < n_threads; t++) free_engine(engines[t]);
+
+  if(sp.write_failed) rb_sys_fail("position file");
+  if(sp.interrupted) rb_thread_check_ints();
+  VALUE stats = rb_ary_new();
+  rb_ary_push(stats, LONG2NUM(sp.positions));
+  for(int i = 0; i < 3; i++) rb_ary_push(stats, LONG2NUM(sp.results[i]));
+  rb_ary_push(stats, LONG2NUM(sp.nodes_searched));
+  return stats;
+}
+
+static void setup_keys(){
+  BB state = 0x5EED;
+  for(int c = BLACK; c <= WHITE; c++){
+    for(int type = PAWN; type <= KING; type++){
+      for(int sq = 0; sq < 64; sq++) piece_keys[c][type][sq] = next_random(&state);
+    }
+  }
+  side_key = next_random(&state);
+  for(int i = 0; i < 16; i++) castle_keys[i] = next_random(&state);
+  for(int i = 0; i < 8; i++) enp_keys[i] = next_random(&state);
+  for(int sq = 0; sq < 64; sq++) castle_masks[sq] = 0xf;
+  castle_masks[A1] &= ~C_WQ;
+  castle_masks[H1] &= ~C_WK;
+  castle_masks[E1] &= ~(C_WQ|C_WK);
+  castle_masks[A8] &= ~C_BQ;
+  castle_masks[H8] &= ~C_BK;
+  castle_masks[E8] &= ~(C_BQ|C_BK);
+}
+
+extern void Init_self_play(){
+  printf("  -Loading self_play extension...");
+
+  VALUE mod_chess = rb_define_module("Chess");
+  VALUE mod_self_play = rb_define_module_under(mod_chess, "SelfPlay");
+
+  setup_keys();
+
+  rb_define_module_function(mod_self_play, "perft", object_perft, 5);
+  rb_define_module_function(mod_self_play, "play_games", object_play_games, 8);
+
+  printf("done.\n");
+}
@@ -0,0 +1,129 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef SELF_PLAY
+#define SELF_PLAY
+
+#include "shared.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <ruby/thread.h>
+
+#define SP_MAX_THREADS 64
+#define SP_MAX_PLY     64     // search depth limit, in plies from the root.
+#define SP_MAX_MOVES   256
+#define SP_MAX_GAME    400    // games still running after this many plies are scored as draws.
+#define SP_INF         32000
+#define SP_MATE        31000  // score for delivering mate at the root; mate in n plies scores SP_MATE - n.
+#define SP_MATE_BOUND  (SP_MATE - SP_MAX_PLY)
+
+#define SP_RESIGN_SCORE 1000  // a game is adjudicated once the side to move's score is beyond this
+#define SP_RESIGN_PLIES 8     // for this many consecutive plies.
+
+// Moves are packed into 16 bits: from and to squares, and a 4-bit flag.  Flags from SP_PROMOTE up encode the 
+// promoted type as flag - SP_PROMOTE + KNIGHT.
+#define SP_QUIET      0
+#define SP_DOUBLE     1
+#define SP_CASTLE     2
+#define SP_ENP        3
+#define SP_PROMOTE    4
+
+#define sp_move(from, to, flag) ((from) | ((to) << 6) | ((flag) << 12))
+#define sp_from(move)  ((move) & 63)
+#define sp_to(move)    (((move) >> 6) & 63)
+#define sp_flag(move)  ((move) >> 12)
+
+#define TT_EXACT 0
+#define TT_LOWER 1
+#define TT_UPPER 2
+
+typedef struct {
+  BB key;
+  int16_t score;
+  uint16_t move;
+  int8_t depth;
+  uint8_t bound;
+} TT_ENTRY;
+
+// The full state of a position, as kept for each ply of the game and of the search.
+typedef struct NODE {
+  BRD board;
+  ACCUMULATOR acc;
+  BB key;
+  int c;
+  int castle;
+  int enp_target;  // square an en-passant capture moves to, or -1 if none.
+  int halfmove_clock;
+} NODE;
+
+// A private engine for one thread: a transposition table, move ordering tables, and a stack of nodes for the 
+// search.  keys holds the hash key of each position in the game so far, followed by those along the search path, 
+// for repetition detection.
+typedef struct {
+  NODE nodes[SP_MAX_PLY+2];
+  BB keys[SP_MAX_GAME+SP_MAX_PLY+2];
+  int game_ply;
+  TT_ENTRY *tt;
+  BB tt_mask;
+  uint16_t killers[SP_MAX_PLY+2][2];
+  int history[2][64][64];
+  long nodes_searched;
+  long node_limit;       // stop searching once nodes_searched reaches this, unless 0.
+  int root_depth;
+  uint16_t root_move;
+  int stopped;
+  volatile int *interrupted;
+  BB rng;
+} ENGINE;
+
+typedef struct {
+  struct POSITION_WRITER *writer;
+  pthread_mutex_t lock;  // guards the writer, the game counter and the totals below.
+  long games;
+  long next_game;
+  long nodes;            // per move; 0 for no limit.
+  int depth;
+  int random_plies;
+  int tt_bits;
+  BB seed;
+  volatile int interrupted;
+  int write_failed;
+  long positions;
+  long results[3];
+  long nodes_searched;
+} SELF_PLAY_SESSION;
+
+extern void set_start_node(NODE *node);
+extern void set_node(NODE *node, BRD *cBoard, int c, int castle, int enp_target, int halfmove_clock);
+extern int generate_node_moves(NODE *node, uint16_t *moves, int captures_only, int in_check);
+extern int make_node_move(NODE *parent, NODE *child, int move);
+extern int node_in_check(NODE *node);
+extern long perft(ENGINE *engine, int ply, int depth);
+
+static VALUE object_perft(VALUE self, VALUE p_board, VALUE color, VALUE castle, VALUE enp_target, VALUE depth);
+static VALUE object_play_games(VALUE self, VALUE writer, VALUE games, VALUE threads, VALUE nodes, VALUE depth, 
+                               VALUE random_plies, VALUE seed, VALUE tt_bits);
+
+extern void Init_self_play();
+
+#endif
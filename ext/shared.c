@@ -24,13 +24,27 @@
 extern void Init_ruby_chess(){
   printf("Loading native extension:\n");
 
+  Init_cpu();
   Init_bitwise_math();
   Init_board();
   Init_bitboard();
   Init_attack();
   Init_move_gen();
   Init_eval();
+  Init_endgame();
   Init_tropism();
+  Init_repetition();
+  Init_tablebase();
+  Init_book();
+  Init_kernel_bench();
+  Init_search_stats();
+  Init_nnue();
+  Init_batch_eval();
+  Init_tuner();
+  Init_position_file();
+  Init_self_play();
+  Init_epd_file();
+  Init_mate_search();
 
   printf("...finished.\n\n");
 }
\ No newline at end of file
@@ -30,12 +30,36 @@
 
 typedef unsigned long BB;
 
+// Attack sets for a position, filled in lazily by attack.c the first time a caller asks for them.  Entries stay
+// valid for as long as the piece placement matches key, so moves and temporary edits need no explicit invalidation.
+// Each board keeps two, so that a parent node's info survives making and unmaking a move to visit a child.
+typedef struct {
+  BB key[2][6];            // the piece bitboards the entries below were computed from.
+  int valid;               // which entries are up to date (see attack.h).
+  BB attacks[2];           // all squares attacked by each side.
+  BB pinned[2];            // each side's pieces pinned against their own king.
+  BB checkers[2];          // enemy pieces giving check to each side's king.
+  BB check_squares[2][6];  // squares from which each side's pieces of each type would check the enemy king.
+  BB discoverers[2];       // each side's pieces that would give discovered check by moving off the line.
+  int mobility[2];         // knight, slider and king mobility, as counted by eval.c.
+} ATTACK_INFO;
+
 typedef struct {
   BB pieces[2][6];
   BB occupied[2];
   int material[2];
+  BB material_key;  // the number of pieces of each type held by each side (see endgame.h).
+  BB *attackers;    // if not NULL, the pieces attacking each square, kept up to date as pieces move (attack.c).
+  int info_slot;  // the most recently used of info[].
+  ATTACK_INFO info[2];
 } BRD;
 
+// A position as stored in batches and datasets: the piece bitboards followed by the side to move (1 for white).
+typedef struct {
+  BB pieces[2][6];
+  BB side;
+} PACKED_BOARD;
+
 typedef enum { NW=0, NE=1, SE=2, SW=3, NORTH=4, EAST=5, SOUTH=6, WEST=7, INVALID=8 } enumDir;
 
 typedef enum {  A1, B1, C1, D1, E1, F1, G1, H1, 
@@ -93,6 +117,13 @@ extern int directions[64][64];
 #define SYM2COLOR(sym)    (sym == ID2SYM(rb_intern("w")) ? 1 : 0)
 #define SYM2OPPCOLOR(sym) (sym == ID2SYM(rb_intern("w")) ? 0 : 1)
 
+// Color specialization.  A routine that branches on the side to move is written as a COLOR_INLINE function taking 
+// the color as its first argument, and called through FOR_COLOR, which passes the color as a constant.  The routine 
+// is then compiled once for each side, with pawn shifts, promotion ranks, castle squares and furthest_forward() 
+// folded to constants, and the color is tested once per call rather than once per piece.
+#define COLOR_INLINE static inline __attribute__((always_inline))
+#define FOR_COLOR(c, routine, ...) ((c) ? routine(WHITE, __VA_ARGS__) : routine(BLACK, __VA_ARGS__))
+
 #define sq_mask_on(sq) (square_masks_on[sq])
 #define sq_mask_off(sq) (square_masks_off[sq])
 
@@ -110,11 +141,25 @@ extern int directions[64][64];
 // Include child header files
 #include "bitboard.h"
 #include "bitwise_math.h"
+#include "cpu.h"
+#include "nnue.h"
 #include "board.h"
 #include "attack.h"
 #include "move_gen.h"
 #include "eval.h"
+#include "endgame.h"
 #include "tropism.h"
+#include "repetition.h"
+#include "tablebase.h"
+#include "book.h"
+#include "kernel_bench.h"
+#include "search_stats.h"
+#include "batch_eval.h"
+#include "tuner.h"
+#include "position_file.h"
+#include "self_play.h"
+#include "epd_file.h"
+#include "mate_search.h"
 
 extern void Init_ruby_chess();
 
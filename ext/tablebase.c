@@ -0,0 +1,964 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#include "tablebase.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const uint8_t wdl_magic[4] = { 0x71, 0xE8, 0x23, 0x5D };
+static const uint8_t dtz_magic[4] = { 0xD7, 0x66, 0x0C, 0xA5 };
+
+static const char piece_chars[6] = { 'P', 'N', 'B', 'R', 'Q', 'K' };
+
+int tb_max_pieces = 0;
+
+static TB_ENTRY *tb_entries = NULL;
+static int tb_entry_count = 0;
+static TB_ENTRY *tb_hash[TB_HASH_SIZE];
+
+// Lookup tables used to encode piece placement as a table index.
+static int map_b1h1h7[64];
+static int map_a1d1d4[64];
+static int map_kk[10][64];
+static int map_pawns[64];
+static int lead_pawn_idx[6][64];
+static int lead_pawns_size[6][4];
+static uint64_t binomial[6][64];
+
+#define off_a1h8(sq) (row(sq) - column(sq))
+#define edge_distance(col) (min(col, 7-col))
+#define sign_of(x) ((x > 0) - (x < 0))
+
+// Table data is little-endian, except for the Huffman codes themselves which are read big-endian.
+static inline uint32_t read_le16(const uint8_t *p){ return p[0] | (p[1] << 8); }
+static inline uint32_t read_le32(const uint8_t *p){ 
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); 
+}
+static inline uint32_t read_be32(const uint8_t *p){ 
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; 
+}
+static inline uint64_t read_be64(const uint8_t *p){ 
+  return ((uint64_t)read_be32(p) << 32) | read_be32(p+4); 
+}
+
+// Each btree entry packs the left and right child symbols into 12 bits each.
+static inline int btree_left(PAIRS_DATA *d, int sym){ 
+  uint8_t *lr = d->btree + 3*sym;
+  return ((lr[1] & 0xF) << 8) | lr[0]; 
+}
+static inline int btree_right(PAIRS_DATA *d, int sym){ 
+  uint8_t *lr = d->btree + 3*sym;
+  return (lr[2] << 4) | (lr[1] >> 4); 
+}
+
+
+// Material keys identify a table by the number of pieces of each type held by each side.  Tables are named with the 
+// stronger side first (KRvK), so each table is reachable under two keys depending on which color is stronger.
+static BB material_key(int counts[2][6]){
+  BB key = 0;
+  for(int t = PAWN; t <= KING; t++){
+    key |= ((BB)counts[WHITE][t] << (4*t)) | ((BB)counts[BLACK][t] << (4*t + 24));
+  }
+  return key;
+}
+
+static BB board_material_key(BRD *cBoard){
+  int counts[2][6];
+  for(int c = BLACK; c <= WHITE; c++){
+    for(int t = PAWN; t <= KING; t++) counts[c][t] = pop_count(cBoard->pieces[c][t]);
+  }
+  return material_key(counts);
+}
+
+static int hash_index(BB key){
+  return (int)((key * 0x9E3779B97F4A7C15UL) >> (64 - TB_HASH_BITS));
+}
+
+static void hash_insert(BB key, TB_ENTRY *e){
+  int i = hash_index(key);
+  while(tb_hash[i]) i = (i+1) & (TB_HASH_SIZE-1);
+  tb_hash[i] = e;
+}
+
+static TB_ENTRY *hash_lookup(BB key){
+  for(int i = hash_index(key); tb_hash[i]; i = (i+1) & (TB_HASH_SIZE-1)){
+    if(tb_hash[i]->key == key || tb_hash[i]->key2 == key) return tb_hash[i];
+  }
+  return NULL;
+}
+
+
+static void init_encoding_tables(){
+  int code = 0;
+  // map_b1h1h7[] encodes a square below the a1-h8 diagonal to 0..27
+  for(int sq = A1; sq <= H8; sq++){
+    if(off_a1h8(sq) < 0) map_b1h1h7[sq] = code++;
+  }
+  // map_a1d1d4[] encodes a square in the a1-d1-d4 triangle to 0..9, with the diagonal squares encoded last.
+  code = 0;
+  for(int sq = A1; sq <= D4; sq++){
+    if(off_a1h8(sq) < 0 && column(sq) <= 3) map_a1d1d4[sq] = code++;
+  }
+  for(int sq = A1; sq <= D4; sq++){
+    if(off_a1h8(sq) == 0 && column(sq) <= 3) map_a1d1d4[sq] = code++;
+  }
+  // map_kk[] encodes the 462 legal placements of two kings where the first king is in the a1-d1-d4 triangle.
+  // When the first king is on the a1-d4 diagonal, the second king must not be above the a1-h8 diagonal.  
+  // Placements with both kings on the diagonal are encoded last.
+  int diagonal_idx[10*64], diagonal_sq[10*64], n = 0;
+  code = 0;
+  for(int idx = 0; idx < 10; idx++){
+    for(int s1 = A1; s1 <= D4; s1++){
+      if(map_a1d1d4[s1] != idx || (idx == 0 && s1 != B1)) continue;
+      for(int s2 = A1; s2 <= H8; s2++){
+        if((king_masks[s1] | sq_mask_on(s1)) & sq_mask_on(s2)) continue;  // illegal placement
+        else if(!off_a1h8(s1) && off_a1h8(s2) > 0) continue;
+        else if(!off_a1h8(s1) && !off_a1h8(s2)){
+          diagonal_idx[n] = idx;
+          diagonal_sq[n++] = s2;
+        } else map_kk[idx][s2] = code++;
+      }
+    }
+  }
+  for(int i = 0; i < n; i++) map_kk[diagonal_idx[i]][diagonal_sq[i]] = code++;
+
+  // binomial[k][n] is the number of ways to choose k elements from a set of n elements.
+  binomial[0][0] = 1;
+  for(int n = 1; n < 64; n++){
+    for(int k = 0; k < 6 && k <= n; k++){
+      binomial[k][n] = (k > 0 ? binomial[k-1][n-1] : 0) + (k < n ? binomial[k][n-1] : 0);
+    }
+  }
+  // map_pawns[] encodes squares a2-h7 to 0..47.  The pawn with the highest map_pawns[] value is the leading pawn: 
+  // the pawn nearest the edge and, among pawns on the same file, the pawn with the lowest rank.
+  int available = 47;
+  for(int lead_pawns = 1; lead_pawns <= 5; lead_pawns++){
+    for(int f = 0; f <= 3; f++){
+      int idx = 0;
+      for(int r = 1; r <= 6; r++){
+        int sq = r*8 + f;
+        if(lead_pawns == 1){
+          map_pawns[sq] = available--;
+          map_pawns[sq^7] = available--;
+        }
+        lead_pawn_idx[lead_pawns][sq] = idx;
+        idx += binomial[lead_pawns-1][map_pawns[sq]];
+      }
+      lead_pawns_size[lead_pawns][f] = idx;
+    }
+  }
+}
+
+
+// Table setup
+
+// Groups pieces that are encoded together.  The leading group is formed by the pawns of the leading color, or in
+// pawnless tables by three unique pieces or by the two kings.  Each remaining group holds pieces of the same 
+// type and color.  The order in which groups are encoded is stored per table in order[].
+static void set_groups(TB_ENTRY *e, PAIRS_DATA *d, int order[2], int f){
+  int n = 0, first_len = e->has_pawns ? 0 : (e->has_unique_pieces ? 3 : 2);
+  d->group_len[n] = 1;
+  for(int i = 1; i < e->piece_count; i++){
+    if(--first_len > 0 || d->pieces[i] == d->pieces[i-1]) d->group_len[n]++;
+    else d->group_len[++n] = 1;
+  }
+  d->group_len[++n] = 0;
+
+  int pp = e->has_pawns && e->pawn_count[1];  // pawns on both sides
+  int next = pp ? 2 : 1;
+  int free_squares = 64 - d->group_len[0] - (pp ? d->group_len[1] : 0);
+  uint64_t idx = 1;
+
+  for(int k = 0; next < n || k == order[0] || k == order[1]; k++){
+    if(k == order[0]){  // leading pawns or pieces
+      d->group_idx[0] = idx;
+      idx *= e->has_pawns ? lead_pawns_size[d->group_len[0]][f] : (e->has_unique_pieces ? 31332 : 462);
+    } else if(k == order[1]){  // remaining pawns
+      d->group_idx[1] = idx;
+      idx *= binomial[d->group_len[1]][48 - d->group_len[0]];
+    } else {  // remaining pieces
+      d->group_idx[next] = idx;
+      idx *= binomial[d->group_len[next]][free_squares];
+      free_squares -= d->group_len[next++];
+    }
+  }
+  d->group_idx[n] = idx;
+}
+
+// In Recursive Pairing compression, each symbol represents a pair of child symbols.  Expand each symbol into its 
+// children until reaching the leaves, recording the number of values represented by each symbol.
+static int set_symlen(PAIRS_DATA *d, int sym, uint8_t *visited){
+  visited[sym] = 1;
+  int sr = btree_right(d, sym);
+  if(sr == 0xFFF) return 0;
+  int sl = btree_left(d, sym);
+  if(!visited[sl]) d->symlen[sl] = set_symlen(d, sl, visited);
+  if(!visited[sr]) d->symlen[sr] = set_symlen(d, sr, visited);
+  return d->symlen[sl] + d->symlen[sr] + 1;
+}
+
+static uint8_t *set_sizes(PAIRS_DATA *d, uint8_t *data){
+  d->flags = *data++;
+  if(d->flags & TB_SINGLE_VALUE){
+    d->num_blocks = d->span = d->block_length_size = d->sparse_index_size = 0;
+    d->min_sym_len = *data++;  // the single value stored by this table
+    return data;
+  }
+  int n = 0;
+  while(d->group_len[n]) n++;
+  uint64_t tb_size = d->group_idx[n];
+
+  d->block_size = 1UL << *data++;
+  d->span = 1UL << *data++;
+  d->sparse_index_size = (tb_size + d->span - 1) / d->span;
+  int padding = *data++;
+  d->num_blocks = read_le32(data);  
+  data += 4;
+  d->block_length_size = d->num_blocks + padding;
+  d->max_sym_len = *data++;
+  d->min_sym_len = *data++;
+  d->lowest_sym = data;
+
+  // The canonical Huffman code is ordered so that longer symbols have lower numeric value.  base64[] holds the 
+  // lowest symbol of each length, left-aligned in 64 bits, so that symbol length can be found by comparison.
+  int base_size = d->max_sym_len - d->min_sym_len + 1;
+  d->base64 = calloc(base_size, sizeof(uint64_t));
+  for(int i = base_size - 2; i >= 0; i--){
+    d->base64[i] = (d->base64[i+1] + read_le16(d->lowest_sym + 2*i) - read_le16(d->lowest_sym + 2*(i+1))) / 2;
+  }
+  for(int i = 0; i < base_size; i++) d->base64[i] <<= 64 - i - d->min_sym_len;
+  data += base_size * 2;
+
+  d->sym_count = read_le16(data);
+  data += 2;
+  d->btree = data;
+  d->symlen = calloc(d->sym_count, 1);
+  uint8_t *visited = calloc(d->sym_count, 1);
+  for(int sym = 0; sym < d->sym_count; sym++){
+    if(!visited[sym]) d->symlen[sym] = set_symlen(d, sym, visited);
+  }
+  free(visited);
+  return data + d->sym_count * 3 + (d->sym_count & 1);
+}
+
+// DTZ values are stored sorted by frequency for each WDL outcome.  Record where each value map begins.
+static uint8_t *set_dtz_map(TB_FILE *file, uint8_t *data, int max_file){
+  file->map = data;
+  for(int f = 0; f <= max_file; f++){
+    PAIRS_DATA *d = &file->items[0][f];
+    if(!(d->flags & TB_MAPPED)) continue;
+    if(d->flags & TB_WIDE){
+      data += (uintptr_t)data & 1;
+      for(int i = 0; i < 4; i++){
+        d->map_idx[i] = (uint16_t)(((data - file->map) >> 1) + 1);
+        data += 2 * read_le16(data) + 2;
+      }
+    } else {
+      for(int i = 0; i < 4; i++){
+        d->map_idx[i] = (uint16_t)(data - file->map + 1);
+        data += *data + 1;
+      }
+    }
+  }
+  return data + ((uintptr_t)data & 1);
+}
+
+static int init_table(TB_ENTRY *e, TB_FILE *file, uint8_t *data, int dtz){
+  if(((*data & 2) != 0) != e->has_pawns || ((*data & 1) != 0) != (e->key != e->key2)) return 0;
+  data++;
+
+  int sides = (!dtz && e->key != e->key2) ? 2 : 1;
+  int max_file = e->has_pawns ? 3 : 0;
+  int pp = e->has_pawns && e->pawn_count[1];
+
+  for(int f = 0; f <= max_file; f++){
+    int order[2][2] = { { *data & 0xF, pp ? *(data+1) & 0xF : 0xF },
+                        { *data >> 4,  pp ? *(data+1) >> 4  : 0xF } };
+    data += 1 + pp;
+    for(int k = 0; k < e->piece_count; k++, data++){
+      for(int i = 0; i < sides; i++) file->items[i][f].pieces[k] = i ? *data >> 4 : *data & 0xF;
+    }
+    for(int i = 0; i < sides; i++) set_groups(e, &file->items[i][f], order[i], f);
+  }
+  data += (uintptr_t)data & 1;
+
+  for(int f = 0; f <= max_file; f++){
+    for(int i = 0; i < sides; i++) data = set_sizes(&file->items[i][f], data);
+  }
+  if(dtz) data = set_dtz_map(file, data, max_file);
+
+  for(int f = 0; f <= max_file; f++){
+    for(int i = 0; i < sides; i++){
+      file->items[i][f].sparse_index = data;
+      data += file->items[i][f].sparse_index_size * 6;
+    }
+  }
+  for(int f = 0; f <= max_file; f++){
+    for(int i = 0; i < sides; i++){
+      file->items[i][f].block_length = data;
+      data += file->items[i][f].block_length_size * 2;
+    }
+  }
+  for(int f = 0; f <= max_file; f++){
+    for(int i = 0; i < sides; i++){
+      data = (uint8_t *)(((uintptr_t)data + 0x3F) & ~(uintptr_t)0x3F);  // 64 byte alignment
+      file->items[i][f].data = data;
+      data += file->items[i][f].num_blocks * file->items[i][f].block_size;
+    }
+  }
+  return data <= file->base + file->size;
+}
+
+// Table files are memory-mapped the first time they are probed.  Files are expected to be a multiple of 64 bytes
+// plus a 16 byte checksum.
+static int map_table(TB_ENTRY *e, int dtz){
+  TB_FILE *file = dtz ? &e->dtz : &e->wdl;
+  if(file->state) return file->state > 0;
+  file->state = -1;
+  if(dtz && !e->has_dtz) return 0;
+
+  char path[FILENAME_MAX];
+  struct stat st;
+  snprintf(path, sizeof(path), "%s%s", e->path, dtz ? ".rtbz" : ".rtbw");
+  int fd = open(path, O_RDONLY);
+  if(fd == -1) return 0;
+  if(fstat(fd, &st) || st.st_size % 64 != 16){
+    close(fd);
+    return 0;
+  }
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(base == MAP_FAILED) return 0;
+
+  file->base = base;
+  file->size = st.st_size;
+  if(memcmp(file->base, dtz ? dtz_magic : wdl_magic, 4) || !init_table(e, file, file->base + 4, dtz)){
+    printf("Corrupt tablebase file %s\n", path);
+    return 0;
+  }
+  file->state = 1;
+  return 1;
+}
+
+static void unmap_table(TB_FILE *file){
+  for(int i = 0; i < 2; i++){
+    for(int f = 0; f < 4; f++){
+      free(file->items[i][f].base64);
+      free(file->items[i][f].symlen);
+    }
+  }
+  if(file->base) munmap(file->base, file->size);
+}
+
+
+// Decompression
+
+// Locates the block holding the value at index idx, then decodes the canonical Huffman symbols in that block 
+// until reaching the symbol that covers idx.  Symbols are expanded through the pair tree to recover the value.
+static int decompress_pairs(PAIRS_DATA *d, uint64_t idx){
+  if(d->flags & TB_SINGLE_VALUE) return d->min_sym_len;
+
+  // The sparse index entry k describes the value at index k*span + span/2.  Starting from the nearest entry, 
+  // step through neighboring blocks until reaching the block that holds idx.
+  uint32_t k = (uint32_t)(idx / d->span);
+  uint32_t block = read_le32(d->sparse_index + 6*k);
+  int offset = read_le16(d->sparse_index + 6*k + 4);
+  offset += (int)(idx % d->span) - (int)(d->span / 2);
+
+  while(offset < 0) offset += read_le16(d->block_length + 2*(--block)) + 1;
+  while(offset > (int)read_le16(d->block_length + 2*block)) offset -= read_le16(d->block_length + 2*(block++)) + 1;
+
+  uint8_t *ptr = d->data + (uint64_t)block * d->block_size;
+  uint64_t buf64 = read_be64(ptr);
+  int buf64_size = 64;
+  int sym;
+  ptr += 8;
+
+  for(;;){
+    int len = 0;  // symbol length - min_sym_len
+    while(buf64 < d->base64[len]) len++;
+    sym = (int)((buf64 - d->base64[len]) >> (64 - len - d->min_sym_len));
+    sym += read_le16(d->lowest_sym + 2*len);
+    if(offset < d->symlen[sym] + 1) break;
+
+    offset -= d->symlen[sym] + 1;
+    len += d->min_sym_len;
+    buf64 <<= len;
+    buf64_size -= len;
+    if(buf64_size <= 32){
+      buf64_size += 32;
+      buf64 |= (uint64_t)read_be32(ptr) << (64 - buf64_size);
+      ptr += 4;
+    }
+  }
+  while(d->symlen[sym]){
+    int left = btree_left(d, sym);
+    if(offset < d->symlen[left] + 1) sym = left;
+    else {
+      offset -= d->symlen[left] + 1;
+      sym = btree_right(d, sym);
+    }
+  }
+  return btree_left(d, sym);
+}
+
+// DTZ tables store only one side to move.  Pawnless tables with identical material for both sides are the 
+// exception, since either side to move can be handled by flipping colors.
+static int check_dtz_stm(TB_ENTRY *e, int stm, int f){
+  int flags = e->dtz.items[0][f].flags;
+  return (flags & TB_STM) == stm || (e->key == e->key2 && !e->has_pawns);
+}
+
+static int map_dtz_score(TB_ENTRY *e, int f, int value, int wdl){
+  static const int wdl_map[] = { 1, 3, 0, 2, 0 };
+  PAIRS_DATA *d = &e->dtz.items[0][f];
+  int flags = d->flags;
+  if(flags & TB_MAPPED){
+    int i = d->map_idx[wdl_map[wdl+2]] + value;
+    value = (flags & TB_WIDE) ? read_le16(e->dtz.map + 2*i) : e->dtz.map[i];
+  }
+  // DTZ is stored either in moves or in plies.  Convert to plies where needed.
+  if((wdl == TB_WIN && !(flags & TB_WIN_PLIES)) || (wdl == TB_LOSS && !(flags & TB_LOSS_PLIES)) || 
+      wdl == TB_CURSED_WIN || wdl == TB_BLESSED_LOSS) value *= 2;
+  return value + 1;
+}
+
+
+// Probing
+
+static inline int piece_type_on(BRD *cBoard, int c, int sq){
+  for(int t = PAWN; t <= KING; t++){
+    if(cBoard->pieces[c][t] & sq_mask_on(sq)) return t;
+  }
+  return -1;
+}
+
+// Table pieces are coded by type (pawn = 1 ... king = 6), with 8 added for black pieces.
+static inline int piece_code_on(BRD *cBoard, int sq){
+  int t = piece_type_on(cBoard, WHITE, sq);
+  return t >= 0 ? t + 1 : piece_type_on(cBoard, BLACK, sq) + 9;
+}
+
+static void sort_squares(int *squares, int n, int *keys){
+  for(int i = 1; i < n; i++){
+    int sq = squares[i], j = i;
+    for(; j > 0 && (keys ? keys[squares[j-1]] > keys[sq] : squares[j-1] > sq); j--) squares[j] = squares[j-1];
+    squares[j] = sq;
+  }
+}
+
+// Maps the position to an index into the table and decompresses the stored value.  Tables are generated with 
+// white as the stronger side, so colors and ranks are flipped where necessary.  Symmetry is then used to bring the 
+// leading piece into a canonical region of the board before encoding each group of pieces.
+static int do_probe_table(TB_POS *pos, TB_ENTRY *e, int dtz, int wdl, int *result){
+  BRD *cBoard = &pos->brd;
+  int squares[TB_MAX_PIECES] = { 0 }, pieces[TB_MAX_PIECES];
+  int next = 0, size = 0, lead_pawns_cnt = 0, tb_file = 0;
+  BB b, lead_pawns = 0;
+  uint64_t idx;
+
+  int stm = pos->side == WHITE ? 0 : 1;
+  int flip = (e->key == e->key2 && stm) || board_material_key(cBoard) != e->key;
+  int flip_color = flip * 8, flip_squares = flip * 56;
+  stm ^= flip;
+
+  TB_FILE *file = dtz ? &e->dtz : &e->wdl;
+  if(e->has_pawns){
+    // The leading pawn is the pawn with the highest map_pawns[] value.  Its file selects which of the 
+    // four sub-tables is used.
+    int pc = file->items[0][0].pieces[0] ^ flip_color;
+    lead_pawns = b = cBoard->pieces[(pc & 8) ? BLACK : WHITE][PAWN];
+    for(; b; b &= b-1) squares[size++] = lsb(b) ^ flip_squares;
+    lead_pawns_cnt = size;
+    for(int i = 1; i < lead_pawns_cnt; i++){
+      if(map_pawns[squares[i]] > map_pawns[squares[0]]){
+        int tmp = squares[0]; squares[0] = squares[i]; squares[i] = tmp;
+      }
+    }
+    tb_file = edge_distance(column(squares[0]));
+  }
+  if(dtz && !check_dtz_stm(e, stm, tb_file)){
+    *result = TB_CHANGE_STM;
+    return 0;
+  }
+  for(b = Occupied() ^ lead_pawns; b; b &= b-1){
+    int sq = lsb(b);
+    squares[size] = sq ^ flip_squares;
+    pieces[size++] = piece_code_on(cBoard, sq) ^ flip_color;
+  }
+  PAIRS_DATA *d = &file->items[dtz ? 0 : stm][e->has_pawns ? tb_file : 0];
+
+  // Reorder the pieces into the sequence used by the table.
+  for(int i = lead_pawns_cnt; i < size - 1; i++){
+    for(int j = i + 1; j < size; j++){
+      if(d->pieces[i] == pieces[j]){
+        int tmp = pieces[i]; pieces[i] = pieces[j]; pieces[j] = tmp;
+        tmp = squares[i]; squares[i] = squares[j]; squares[j] = tmp;
+        break;
+      }
+    }
+  }
+  // Mirror the board so that the leading piece is on files a-d.
+  if(column(squares[0]) > 3){
+    for(int i = 0; i < size; i++) squares[i] ^= 7;
+  }
+
+  if(e->has_pawns){
+    idx = lead_pawn_idx[lead_pawns_cnt][squares[0]];
+    sort_squares(squares + 1, lead_pawns_cnt - 1, map_pawns);
+    for(int i = 1; i < lead_pawns_cnt; i++) idx += binomial[i][map_pawns[squares[i]]];
+  } else {
+    // Without pawns, also mirror the leading piece onto ranks 1-4, and then below the a1-h8 diagonal.
+    if(row(squares[0]) > 3){
+      for(int i = 0; i < size; i++) squares[i] ^= 56;
+    }
+    for(int i = 0; i < d->group_len[0]; i++){
+      if(!off_a1h8(squares[i])) continue;
+      if(off_a1h8(squares[i]) > 0){
+        for(int j = i; j < size; j++) squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+      }
+      break;
+    }
+    if(e->has_unique_pieces){  // encode three unique pieces together
+      int adjust1 = squares[1] > squares[0];
+      int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+      if(off_a1h8(squares[0])){
+        idx = (map_a1d1d4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+      } else if(off_a1h8(squares[1])){
+        idx = (6 * 63 + row(squares[0]) * 28 + map_b1h1h7[squares[1]]) * 62 + squares[2] - adjust2;
+      } else if(off_a1h8(squares[2])){
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + row(squares[0]) * 7 * 28 + (row(squares[1]) - adjust1) * 28 
+              + map_b1h1h7[squares[2]];
+      } else {
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + row(squares[0]) * 7 * 6 + (row(squares[1]) - adjust1) * 6 
+              + (row(squares[2]) - adjust2);
+      }
+    } else {  // otherwise encode the two kings together
+      idx = map_kk[map_a1d1d4[squares[0]]][squares[1]];
+    }
+  }
+
+  // Encode the remaining groups.  Each square is mapped down past the squares occupied by earlier groups.
+  idx *= d->group_idx[0];
+  int *group_sq = squares + d->group_len[0];
+  int remaining_pawns = e->has_pawns && e->pawn_count[1];
+  while(d->group_len[++next]){
+    uint64_t n = 0;
+    sort_squares(group_sq, d->group_len[next], NULL);
+    for(int i = 0; i < d->group_len[next]; i++){
+      int adjust = 0;
+      for(int *sq = squares; sq < group_sq; sq++) adjust += group_sq[i] > *sq;
+      n += binomial[i+1][group_sq[i] - adjust - 8 * remaining_pawns];
+    }
+    remaining_pawns = 0;
+    idx += n * d->group_idx[next];
+    group_sq += d->group_len[next];
+  }
+
+  int value = decompress_pairs(d, idx);
+  return dtz ? map_dtz_score(e, tb_file, value, wdl) : value - 2;
+}
+
+static int probe_table(TB_POS *pos, int dtz, int wdl, int *result){
+  BRD *cBoard = &pos->brd;
+  if(pop_count(Occupied()) == 2) return 0;  // KvK
+  TB_ENTRY *e = hash_lookup(board_material_key(cBoard));
+  if(!e || !map_table(e, dtz)){
+    *result = TB_FAIL;
+    return 0;
+  }
+  return do_probe_table(pos, e, dtz, wdl, result);
+}
+
+
+// Move generation
+
+// Tables do not store positions where an en-passant capture is possible, and the value stored for a position 
+// may be incorrect when its best move is a capture.  Probing therefore requires a small search over captures, 
+// using a private legal move generator that works on copies of the board.
+
+static inline int in_check(TB_POS *pos){
+  BRD *cBoard = &pos->brd;
+  return is_attacked_by(cBoard, lsb(cBoard->pieces[pos->side][KING]), pos->side^1, pos->side);
+}
+
+static inline int is_capture(TB_POS *pos, TB_MOVE *m){
+  return (pos->brd.occupied[pos->side^1] & sq_mask_on(m->to)) || 
+         (pos->enp >= 0 && (pos->brd.pieces[pos->side][PAWN] & sq_mask_on(m->from)) && column(m->from) != column(m->to));
+}
+
+static inline int is_zeroing(TB_POS *pos, TB_MOVE *m){
+  return is_capture(pos, m) || (pos->brd.pieces[pos->side][PAWN] & sq_mask_on(m->from));
+}
+
+static void make_move(TB_POS *pos, TB_MOVE *m){
+  BRD *cBoard = &pos->brd;
+  int c = pos->side, e = c^1;
+  int type = piece_type_on(cBoard, c, m->from);
+  int captured = piece_type_on(cBoard, e, m->to);
+  BB delta = sq_mask_on(m->from) | sq_mask_on(m->to);
+
+  if(captured >= 0){
+    clear_sq(m->to, cBoard->pieces[e][captured]);
+    clear_sq(m->to, cBoard->occupied[e]);
+  } else if(type == PAWN && column(m->from) != column(m->to)){  // en-passant
+    clear_sq(pos->enp, cBoard->pieces[e][PAWN]);
+    clear_sq(pos->enp, cBoard->occupied[e]);
+  }
+  cBoard->pieces[c][type] ^= delta;
+  cBoard->occupied[c] ^= delta;
+  if(m->promote){
+    clear_sq(m->to, cBoard->pieces[c][PAWN]);
+    add_sq(m->to, cBoard->pieces[c][m->promote]);
+  }
+  pos->enp = (type == PAWN && abs(m->to - m->from) == 16) ? m->to : -1;
+  pos->side = e;
+}
+
+static inline int add_move(TB_POS *pos, TB_MOVE *list, int n, int from, int to, int promote){
+  TB_POS next = *pos;
+  TB_MOVE m = { from, to, promote };
+  make_move(&next, &m);
+  next.side = pos->side;
+  if(!in_check(&next)) list[n++] = m;
+  return n;
+}
+
+static int add_pawn_moves(TB_POS *pos, TB_MOVE *list, int n, int from, int to){
+  if(row(to) == 0 || row(to) == 7){
+    for(int t = QUEEN; t >= KNIGHT; t--) n = add_move(pos, list, n, from, to, t);
+    return n;
+  }
+  return add_move(pos, list, n, from, to, 0);
+}
+
+static int legal_moves(TB_POS *pos, TB_MOVE *list){
+  BRD *cBoard = &pos->brd;
+  int c = pos->side, e = c^1, n = 0;
+  BB occ = Occupied(), empty = ~occ, targets = ~Placement(c), b, t;
+
+  for(b = cBoard->pieces[c][PAWN]; b; b &= b-1){
+    int from = lsb(b);
+    int forward = c ? from + 8 : from - 8;
+    if(empty & sq_mask_on(forward)){
+      n = add_pawn_moves(pos, list, n, from, forward);
+      int dbl = c ? from + 16 : from - 16;
+      if(row(from) == (c ? 1 : 6) && (empty & sq_mask_on(dbl))) n = add_move(pos, list, n, from, dbl, 0);
+    }
+    for(t = pawn_attack_masks[c][from] & Placement(e); t; t &= t-1) n = add_pawn_moves(pos, list, n, from, lsb(t));
+    if(pos->enp >= 0 && (pawn_side_masks[pos->enp] & sq_mask_on(from))){
+      n = add_move(pos, list, n, from, c ? pos->enp + 8 : pos->enp - 8, 0);
+    }
+  }
+  for(b = cBoard->pieces[c][KNIGHT]; b; b &= b-1){
+    for(t = knight_masks[lsb(b)] & targets; t; t &= t-1) n = add_move(pos, list, n, lsb(b), lsb(t), 0);
+  }
+  for(b = cBoard->pieces[c][BISHOP]; b; b &= b-1){
+    for(t = bishop_attacks(occ, lsb(b)) & targets; t; t &= t-1) n = add_move(pos, list, n, lsb(b), lsb(t), 0);
+  }
+  for(b = cBoard->pieces[c][ROOK]; b; b &= b-1){
+    for(t = rook_attacks(occ, lsb(b)) & targets; t; t &= t-1) n = add_move(pos, list, n, lsb(b), lsb(t), 0);
+  }
+  for(b = cBoard->pieces[c][QUEEN]; b; b &= b-1){
+    for(t = queen_attacks(occ, lsb(b)) & targets; t; t &= t-1) n = add_move(pos, list, n, lsb(b), lsb(t), 0);
+  }
+  for(b = cBoard->pieces[c][KING]; b; b &= b-1){
+    for(t = king_masks[lsb(b)] & targets; t; t &= t-1) n = add_move(pos, list, n, lsb(b), lsb(t), 0);
+  }
+  return n;
+}
+
+
+// Searches captures (and pawn moves, if check_zeroing is set) to resolve the WDL value of the position, since 
+// the stored value cannot be trusted when a capture is the best move.
+static int tb_search(TB_POS *pos, int check_zeroing, int *result){
+  TB_MOVE moves[TB_MAX_MOVES];
+  TB_POS next;
+  int value, best_value = TB_LOSS, move_count = 0;
+  int total = legal_moves(pos, moves);
+
+  for(int i = 0; i < total; i++){
+    if(!is_capture(pos, &moves[i]) && (!check_zeroing || !is_zeroing(pos, &moves[i]))) continue;
+    move_count++;
+    next = *pos;
+    make_move(&next, &moves[i]);
+    value = -tb_search(&next, 0, result);
+    if(*result == TB_FAIL) return TB_DRAW;
+    if(value > best_value){
+      best_value = value;
+      if(value >= TB_WIN){
+        *result = TB_ZEROING_BEST_MOVE;
+        return value;
+      }
+    }
+  }
+  // If every legal move has been searched, the stored value isn't needed (and may be wrong).
+  int no_more_moves = move_count && move_count == total;
+  if(no_more_moves) value = best_value;
+  else {
+    value = probe_table(pos, 0, 0, result);
+    if(*result == TB_FAIL) return TB_DRAW;
+  }
+  if(best_value >= value){
+    *result = (best_value > TB_DRAW || no_more_moves) ? TB_ZEROING_BEST_MOVE : TB_OK;
+    return best_value;
+  }
+  *result = TB_OK;
+  return value;
+}
+
+extern int probe_wdl(TB_POS *pos, int *result){
+  *result = TB_OK;
+  return tb_search(pos, 0, result);
+}
+
+static int dtz_before_zeroing(int wdl){
+  switch(wdl){
+    case TB_WIN: return 1;
+    case TB_CURSED_WIN: return 101;
+    case TB_BLESSED_LOSS: return -101;
+    case TB_LOSS: return -1;
+    default: return 0;
+  }
+}
+
+// Returns the number of plies to the next zeroing move (capture or pawn move) under optimal play, signed by 
+// the WDL value of the position.  When the table stores only the other side to move, a 1-ply search is used.
+extern int probe_dtz(TB_POS *pos, int *result){
+  *result = TB_OK;
+  int wdl = tb_search(pos, 1, result);
+  if(*result == TB_FAIL || wdl == TB_DRAW) return 0;
+  if(*result == TB_ZEROING_BEST_MOVE) return dtz_before_zeroing(wdl);
+
+  int dtz = probe_table(pos, 1, wdl, result);
+  if(*result == TB_FAIL) return 0;
+  if(*result != TB_CHANGE_STM){
+    return (dtz + 100 * (wdl == TB_BLESSED_LOSS || wdl == TB_CURSED_WIN)) * sign_of(wdl);
+  }
+
+  TB_MOVE moves[TB_MAX_MOVES];
+  TB_MOVE replies[TB_MAX_MOVES];
+  TB_POS next;
+  int min_dtz = 0xFFFF;
+  int total = legal_moves(pos, moves);
+  for(int i = 0; i < total; i++){
+    int zeroing = is_zeroing(pos, &moves[i]);
+    next = *pos;
+    make_move(&next, &moves[i]);
+    dtz = zeroing ? -dtz_before_zeroing(tb_search(&next, 0, result)) : -probe_dtz(&next, result);
+    if(dtz == 1 && in_check(&next) && !legal_moves(&next, replies)) min_dtz = 1;
+    if(!zeroing) dtz += sign_of(dtz);
+    if(dtz < min_dtz && sign_of(dtz) == sign_of(wdl)) min_dtz = dtz;
+    if(*result == TB_FAIL) return 0;
+  }
+  return min_dtz == 0xFFFF ? -1 : min_dtz;
+}
+
+
+// Table registration
+
+// Parses a table name such as KRPvKR into piece counts, with the stronger side (listed first) as white.
+static int parse_table_name(const char *name, int counts[2][6]){
+  int c = WHITE, len = 0;
+  memset(counts, 0, sizeof(int) * 12);
+  for(const char *p = name; *p; p++){
+    if(*p == 'v' && c == WHITE){
+      c = BLACK;
+      continue;
+    }
+    const char *pc = memchr(piece_chars, *p, 6);
+    if(!pc) return 0;
+    counts[c][pc - piece_chars]++;
+    len++;
+  }
+  return c == BLACK && counts[WHITE][KING] == 1 && counts[BLACK][KING] == 1 ? len : 0;
+}
+
+static void register_table(const char *dir, const char *name, int piece_count, int counts[2][6]){
+  TB_ENTRY *e = &tb_entries[tb_entry_count];
+  int swapped[2][6];
+  for(int t = PAWN; t <= KING; t++){
+    swapped[WHITE][t] = counts[BLACK][t];
+    swapped[BLACK][t] = counts[WHITE][t];
+  }
+  memset(e, 0, sizeof(TB_ENTRY));
+  e->key = material_key(counts);
+  e->key2 = material_key(swapped);
+  if(hash_lookup(e->key)) return;  // already found in an earlier directory
+
+  e->path = malloc(strlen(dir) + strlen(name) + 2);
+  sprintf(e->path, "%s/%s", dir, name);
+  e->piece_count = piece_count;
+  e->has_pawns = counts[WHITE][PAWN] || counts[BLACK][PAWN];
+  for(int c = BLACK; c <= WHITE; c++){
+    for(int t = PAWN; t < KING; t++){
+      if(counts[c][t] == 1) e->has_unique_pieces = 1;
+    }
+  }
+  // The leading color is the side with fewer pawns, when both sides have pawns.
+  int lead = !counts[BLACK][PAWN] || (counts[WHITE][PAWN] && counts[BLACK][PAWN] >= counts[WHITE][PAWN]);
+  e->pawn_count[0] = counts[lead ? WHITE : BLACK][PAWN];
+  e->pawn_count[1] = counts[lead ? BLACK : WHITE][PAWN];
+
+  char dtz_path[FILENAME_MAX];
+  snprintf(dtz_path, sizeof(dtz_path), "%s.rtbz", e->path);
+  e->has_dtz = access(dtz_path, R_OK) == 0;
+
+  hash_insert(e->key, e);
+  if(e->key2 != e->key) hash_insert(e->key2, e);
+  tb_max_pieces = max(tb_max_pieces, piece_count);
+  tb_entry_count++;
+}
+
+static void free_tables(){
+  for(int i = 0; i < tb_entry_count; i++){
+    unmap_table(&tb_entries[i].wdl);
+    unmap_table(&tb_entries[i].dtz);
+    free(tb_entries[i].path);
+  }
+  free(tb_entries);
+  tb_entries = NULL;
+  tb_entry_count = tb_max_pieces = 0;
+  memset(tb_hash, 0, sizeof(tb_hash));
+}
+
+// Registers each WDL table found in the given directories (separated by ':').  Tables are not mapped until 
+// they are first probed.
+static void find_tables(const char *paths){
+  char *list = strdup(paths);
+  for(char *dir = strtok(list, ":"); dir; dir = strtok(NULL, ":")){
+    DIR *d = opendir(dir);
+    struct dirent *ent;
+    if(!d) continue;
+    while((ent = readdir(d)) && tb_entry_count < TB_MAX_TABLES){
+      char name[FILENAME_MAX];
+      int counts[2][6], len = strlen(ent->d_name) - 5;
+      if(len <= 0 || len >= FILENAME_MAX || strcmp(ent->d_name + len, ".rtbw")) continue;
+      memcpy(name, ent->d_name, len);
+      name[len] = '\0';
+      int piece_count = parse_table_name(name, counts);
+      if(piece_count && piece_count <= TB_MAX_PIECES) register_table(dir, name, piece_count, counts);
+    }
+    closedir(d);
+  }
+  free(list);
+}
+
+
+// Ruby interface
+
+static int set_position(TB_POS *pos, VALUE p_board, VALUE color, VALUE enp_target){
+  pos->brd = *get_cBoard(p_board);
+  pos->brd.attackers = NULL;  // the copy is changed without updating the original board's attack map.
+  pos->side = SYM2COLOR(color);
+  pos->enp = NIL_P(enp_target) ? -1 : NUM2INT(enp_target);
+  BRD *cBoard = &pos->brd;
+  return pop_count(Occupied()) <= tb_max_pieces;
+}
+
+static VALUE load_tables(VALUE self, VALUE path){
+  free_tables();
+  if(NIL_P(path)) return INT2NUM(0);
+  tb_entries = calloc(TB_MAX_TABLES, sizeof(TB_ENTRY));
+  find_tables(StringValueCStr(path));
+  return INT2NUM(tb_max_pieces);
+}
+
+static VALUE get_max_pieces(VALUE self){
+  return INT2NUM(tb_max_pieces);
+}
+
+// Returns the WDL value of the position from the side to move's perspective, or nil if it can't be probed.
+static VALUE object_probe_wdl(VALUE self, VALUE p_board, VALUE color, VALUE enp_target){
+  TB_POS pos;
+  int result;
+  if(!set_position(&pos, p_board, color, enp_target)) return Qnil;
+  int wdl = probe_wdl(&pos, &result);
+  return result == TB_FAIL ? Qnil : INT2NUM(wdl);
+}
+
+static VALUE object_probe_dtz(VALUE self, VALUE p_board, VALUE color, VALUE enp_target){
+  TB_POS pos;
+  int result;
+  if(!set_position(&pos, p_board, color, enp_target)) return Qnil;
+  int dtz = probe_dtz(&pos, &result);
+  return result == TB_FAIL ? Qnil : INT2NUM(dtz);
+}
+
+// Ranks each legal move at the root by the DTZ of the resulting position.  Quick wins are preferred to wins that 
+// would be spoiled by the Halfmove Rule, followed by draws, losses saved by the Halfmove Rule, and slow losses.
+// Returns an array of [from, to, promoted_type, dtz, rank] for each move, or nil if the position can't be probed.
+static VALUE object_probe_root(VALUE self, VALUE p_board, VALUE color, VALUE enp_target, VALUE halfmove_clock){
+  TB_POS pos, next;
+  TB_MOVE moves[TB_MAX_MOVES], replies[TB_MAX_MOVES];
+  int result, dtz, rank;
+  int cnt50 = NUM2INT(halfmove_clock);
+  if(!set_position(&pos, p_board, color, enp_target)) return Qnil;
+
+  VALUE ranked = rb_ary_new();
+  int total = legal_moves(&pos, moves);
+  for(int i = 0; i < total; i++){
+    next = pos;
+    make_move(&next, &moves[i]);
+    if(is_zeroing(&pos, &moves[i])){
+      dtz = dtz_before_zeroing(-probe_wdl(&next, &result));
+    } else {
+      dtz = -probe_dtz(&next, &result);
+      dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz;
+    }
+    if(dtz == 2 && in_check(&next) && !legal_moves(&next, replies)) dtz = 1;  // mating moves
+    if(result == TB_FAIL) return Qnil;
+
+    if(dtz > 0) rank = (dtz + cnt50 <= 99) ? TB_MAX_DTZ - dtz : TB_MAX_DTZ/2 - dtz;
+    else if(dtz < 0) rank = (-dtz + cnt50 < 100) ? -TB_MAX_DTZ - dtz : -TB_MAX_DTZ/2 - dtz;
+    else rank = 0;
+
+    VALUE entry = rb_ary_new();
+    rb_ary_push(entry, INT2NUM(moves[i].from));
+    rb_ary_push(entry, INT2NUM(moves[i].to));
+    rb_ary_push(entry, moves[i].promote ? INT2NUM(moves[i].promote) : Qnil);
+    rb_ary_push(entry, INT2NUM(dtz));
+    rb_ary_push(entry, INT2NUM(rank));
+    rb_ary_push(ranked, entry);
+  }
+  return ranked;
+}
+
+extern void Init_tablebase(){
+  printf("  -Loading tablebase extension...");
+
+  init_encoding_tables();
+
+  VALUE mod_chess = rb_define_module("Chess");
+  VALUE mod_tablebase = rb_define_module_under(mod_chess, "Tablebase");
+
+  rb_define_module_function(mod_tablebase, "load_tables", load_tables, 1);
+  rb_define_module_function(mod_tablebase, "max_pieces", get_max_pieces, 0);
+  rb_define_module_function(mod_tablebase, "probe_wdl", object_probe_wdl, 3);
+  rb_define_module_function(mod_tablebase, "probe_dtz", object_probe_dtz, 3);
+  rb_define_module_function(mod_tablebase, "probe_root", object_probe_root, 4);
+
+  printf("done.\n");
+}
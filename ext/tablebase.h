@@ -0,0 +1,113 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef TABLEBASE
+#define TABLEBASE
+
+#include "shared.h"
+#include <stdint.h>
+
+// This module probes Syzygy endgame tablebases.  The probing code follows the table format and index 
+// encoding designed by Ronald de Man for his Syzygy tablebase generator.
+
+#define TB_MAX_PIECES 7
+#define TB_MAX_MOVES  256
+#define TB_MAX_TABLES 2048
+#define TB_HASH_BITS  13     // each table is hashed under two keys, so the hash must hold twice TB_MAX_TABLES.
+#define TB_HASH_SIZE  (1 << TB_HASH_BITS)
+#define TB_MAX_DTZ    100000
+
+enum { TB_LOSS = -2, TB_BLESSED_LOSS = -1, TB_DRAW = 0, TB_CURSED_WIN = 1, TB_WIN = 2 };  // WDL values
+
+enum { TB_FAIL = 0, TB_OK = 1, TB_CHANGE_STM = -1, TB_ZEROING_BEST_MOVE = 2 };  // probe results
+
+enum { TB_STM = 1, TB_MAPPED = 2, TB_WIN_PLIES = 4, TB_LOSS_PLIES = 8, TB_WIDE = 16, TB_SINGLE_VALUE = 128 };
+
+// Each table (or each side to move / leading pawn file of a table) is compressed separately. The PAIRS_DATA
+// struct describes where the compressed data is found and how the position index is encoded.
+typedef struct {
+  uint8_t flags;
+  size_t block_size;              // block size in bytes
+  size_t span;                    // about every span values there is a sparse index entry
+  int num_blocks;
+  int max_sym_len;                // max. and min. length in bits of the Huffman symbols
+  int min_sym_len;
+  uint8_t *lowest_sym;            // lowest_sym[l] is the symbol of length l with the lowest value
+  uint8_t *btree;                 // btree[sym] stores the left and right symbols that expand sym
+  uint8_t *block_length;          // number of values (minus one) stored in each block
+  int block_length_size;
+  uint8_t *sparse_index;          // partial indices into block_length[]
+  size_t sparse_index_size;
+  uint8_t *data;                  // start of the Huffman compressed data
+  uint64_t *base64;               // base64[l - min_sym_len] is the 64-bit padded lowest symbol of length l
+  uint8_t *symlen;                // number of values (minus one) represented by each symbol
+  int sym_count;
+  uint8_t pieces[TB_MAX_PIECES];  // order of the pieces defines the groups used to encode the index
+  uint64_t group_idx[TB_MAX_PIECES+1];
+  int group_len[TB_MAX_PIECES+1];
+  uint16_t map_idx[4];            // used to map DTZ values
+} PAIRS_DATA;
+
+typedef struct {
+  uint8_t *base;
+  size_t size;
+  int state;                      // 0 if not yet mapped, 1 if ready for probing, -1 if missing or corrupt.
+  uint8_t *map;                   // DTZ value maps
+  PAIRS_DATA items[2][4];         // [side to move][leading pawn file]
+} TB_FILE;
+
+typedef struct {
+  BB key, key2;                   // material keys with the stronger side as white, and as black.
+  char *path;                     // path to the table files, without extension.
+  int piece_count;
+  int has_pawns;
+  int has_unique_pieces;
+  int pawn_count[2];              // [leading color][other color]
+  int has_dtz;
+  TB_FILE wdl;
+  TB_FILE dtz;
+} TB_ENTRY;
+
+// Positions are probed on a private copy of the board, so that captures can be resolved by a small search.
+typedef struct {
+  BRD brd;
+  int side;
+  int enp;                        // square of a pawn that can be captured en-passant, or -1.
+} TB_POS;
+
+typedef struct {
+  int from, to, promote;
+} TB_MOVE;
+
+extern int tb_max_pieces;
+
+extern int probe_wdl(TB_POS *pos, int *result);
+extern int probe_dtz(TB_POS *pos, int *result);
+
+static VALUE load_tables(VALUE self, VALUE path);
+static VALUE get_max_pieces(VALUE self);
+static VALUE object_probe_wdl(VALUE self, VALUE p_board, VALUE color, VALUE enp_target);
+static VALUE object_probe_dtz(VALUE self, VALUE p_board, VALUE color, VALUE enp_target);
+static VALUE object_probe_root(VALUE self, VALUE p_board, VALUE color, VALUE enp_target, VALUE halfmove_clock);
+
+extern void Init_tablebase();
+
+#endif
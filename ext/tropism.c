@@ -24,13 +24,12 @@
 int tropism_bonus[64][64][6];
 
 void setup_bonus_table(){
-  float base_bonus_ratio = 0.15;
   float bonus;
   for (int f = 0; f < 64; f++){
     for (int t = 0; t < 64; t++){
       for (int type = PAWN; type < KING; type++){
-        // bonus = piece_values[type] * base_bonus_ratio * manhattan_distance_ratio(f, t);
-        bonus = piece_values[type] * base_bonus_ratio * chebyshev_distance_ratio(f, t);
+        // bonus = piece_values[type] * eval_params.tropism_ratio * manhattan_distance_ratio(f, t);
+        bonus = piece_values[type] * eval_params.tropism_ratio * chebyshev_distance_ratio(f, t);
         tropism_bonus[f][t][type] = round(bonus);
       }
     }
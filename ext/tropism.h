@@ -26,6 +26,7 @@
 
 extern int tropism_bonus[64][64][6];
 
+extern void setup_bonus_table();
 extern float chebyshev_distance_ratio(int from, int to);
 extern float manhattan_distance_ratio(int from, int to);
 
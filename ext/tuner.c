@@ -0,0 +1,424 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#include "tuner.h"
+
+// Texel-style tuning of the evaluation parameters in eval_params.  Given positions labeled with game results, the 
+// tuner minimizes the squared error between each result and a logistic function of the position's static eval.
+//
+// The tuned terms enter the evaluation linearly, so each position is reduced once to a short list of parameter 
+// coefficients plus a base score for everything else (material, mobility).  After that, the error and its 
+// gradient are cheap sums that are split across threads, and the parameters are fitted by gradient descent with 
+// Adam step sizes.  Black's tables are tied to mirror images of white's.
+
+#define relative_sq(c, sq) ((c) ? (sq) : (sq)^56)
+#define relative_row(c, sq) ((c) ? row(sq) : 7-row(sq))
+
+// Reads the current parameters, as seen from white's side of the board.  The tropism ratio is kept in percent so 
+// that its step size is comparable to that of the other parameters.
+static void get_weights(double *w){
+  for(int type = PAWN; type < KING; type++){
+    for(int sq = 0; sq < 64; sq++) w[P_PST + type*64 + sq] = eval_params.main_pst[WHITE][type][sq];
+  }
+  for(int endgame = 0; endgame < 2; endgame++){
+    for(int sq = 0; sq < 64; sq++) w[P_KING_PST + endgame*64 + sq] = eval_params.king_pst[WHITE][endgame][sq];
+  }
+  for(int r = 0; r < 8; r++) w[P_PASSED + r] = eval_params.passed_pawn_bonus[WHITE][r];
+  w[P_ISOLATED] = eval_params.isolated_pawn_penalty;
+  w[P_DOUBLED] = eval_params.double_pawn_penalty;
+  w[P_DUO] = eval_params.pawn_duo_bonus;
+  w[P_TROPISM] = eval_params.tropism_ratio * 100.0;
+}
+
+static void set_weights(double *w){
+  for(int c = BLACK; c <= WHITE; c++){
+    for(int sq = 0; sq < 64; sq++){
+      for(int type = PAWN; type < KING; type++){
+        eval_params.main_pst[c][type][sq] = lround(w[P_PST + type*64 + relative_sq(c, sq)]);
+      }
+      for(int endgame = 0; endgame < 2; endgame++){
+        eval_params.king_pst[c][endgame][sq] = lround(w[P_KING_PST + endgame*64 + relative_sq(c, sq)]);
+      }
+    }
+    for(int r = 0; r < 8; r++) eval_params.passed_pawn_bonus[c][r] = lround(w[P_PASSED + (c ? r : 7-r)]);
+  }
+  eval_params.isolated_pawn_penalty = lround(w[P_ISOLATED]);
+  eval_params.double_pawn_penalty = lround(w[P_DOUBLED]);
+  eval_params.pawn_duo_bonus = lround(w[P_DUO]);
+  eval_params.tropism_ratio = w[P_TROPISM] / 100.0;
+  setup_bonus_table();
+}
+
+// Adds the coefficients of the tuned parameters used by side c, following adjusted_placement and pawn_structure.
+static void add_side_features(BRD *cBoard, int c, float *dense){
+  int e = c^1;
+  float sign = c ? 1.0 : -1.0;
+  int enemy_king_sq = furthest_forward(e, cBoard->pieces[e][KING]);
+  int sq;
+  BB b;
+  for(int type = PAWN; type < KING; type++){
+    for(b = cBoard->pieces[c][type]; b; clear_sq(sq, b)){
+      sq = lsb(b);
+      dense[P_PST + type*64 + relative_sq(c, sq)] += sign;
+      dense[P_TROPISM] += sign * piece_values[type] * chebyshev_distance_ratio(sq, enemy_king_sq) / 100.0;
+    }
+  }
+  for(b = cBoard->pieces[c][KING]; b; clear_sq(sq, b)){
+    sq = lsb(b);
+    dense[P_KING_PST + in_endgame(c)*64 + relative_sq(c, sq)] += sign;
+  }
+  BB own_pawns = cBoard->pieces[c][PAWN];
+  for(b = own_pawns; b; clear_sq(sq, b)){
+    sq = lsb(b);
+    if(!(pawn_passed_masks[c][sq] & cBoard->pieces[e][PAWN])){
+      int doubled = 0;
+      if(row(sq) == promote_row[c][0]){
+        doubled = !(attacks_by(cBoard, e) & sq_mask_on(c ? sq+8 : sq-8));
+      } else if(row(sq) == promote_row[c][1]){
+        doubled = !(attacks_by(cBoard, e) & (sq_mask_on(c ? sq+8 : sq-8) | sq_mask_on(c ? sq+16 : sq-16)));
+      }
+      dense[P_PASSED + relative_row(c, sq)] += sign * (doubled ? 2 : 1);
+    }
+    if(!(pawn_isolated_masks[sq] & own_pawns)) dense[P_ISOLATED] += sign;
+    if(pawn_side_masks[sq] & own_pawns) dense[P_DUO] += sign;
+  }
+  for(int i = 0; i < 8; i++){
+    int column_count = pop_count(column_masks[i] & own_pawns);
+    if(column_count > 1) dense[P_DOUBLED] += sign * (1 << (column_count-2));
+  }
+}
+
+static void* extract_chunk(void *data){
+  TUNER_JOB *job = data;
+  TUNER_CHUNK *chunk = job->chunk;
+  float dense[N_PARAMS] = { 0 };
+  BRD board;
+  long capacity = 1024;
+  chunk->offsets = malloc((chunk->count + 1) * sizeof(long));
+  chunk->base = malloc(chunk->count * sizeof(float));
+  chunk->results = malloc(chunk->count * sizeof(float));
+  chunk->indices = malloc(capacity * sizeof(uint16_t));
+  chunk->coefficients = malloc(capacity * sizeof(float));
+  chunk->n_features = 0;
+
+  for(long i = 0; i < chunk->count; i++){
+    BRD *cBoard = &board;
+    unpack_board(&job->positions[i], cBoard);
+    add_side_features(cBoard, WHITE, dense);
+    add_side_features(cBoard, BLACK, dense);
+
+    if(chunk->n_features + N_PARAMS > capacity){
+      capacity = 2*capacity + N_PARAMS;
+      chunk->indices = realloc(chunk->indices, capacity * sizeof(uint16_t));
+      chunk->coefficients = realloc(chunk->coefficients, capacity * sizeof(float));
+    }
+    double linear = 0;
+    chunk->offsets[i] = chunk->n_features;
+    for(int p = 0; p < N_PARAMS; p++){
+      if(dense[p] == 0) continue;
+      chunk->indices[chunk->n_features] = p;
+      chunk->coefficients[chunk->n_features++] = dense[p];
+      linear += dense[p] * job->weights[p];
+      dense[p] = 0;
+    }
+    int eval = adjusted_placement(WHITE, BLACK, cBoard) - adjusted_placement(BLACK, WHITE, cBoard);
+    chunk->base[i] = eval - linear;
+    chunk->results[i] = job->results[i] / 2.0;
+  }
+  chunk->offsets[chunk->count] = chunk->n_features;
+  return NULL;
+}
+
+// Sums the squared error of the chunk, and the gradient of the error if requested.
+static void* chunk_error(void *data){
+  TUNER_JOB *job = data;
+  TUNER_CHUNK *chunk = job->chunk;
+  double *w = job->weights;
+  job->error = 0;
+  for(long i = 0; i < chunk->count; i++){
+    double eval = chunk->base[i];
+    for(long f = chunk->offsets[i]; f < chunk->offsets[i+1]; f++) eval += w[chunk->indices[f]] * chunk->coefficients[f];
+    double sigmoid = 1.0 / (1.0 + exp(-job->scale * eval));
+    double diff = chunk->results[i] - sigmoid;
+    job->error += diff * diff;
+    if(job->gradient){
+      double g = -2.0 * diff * sigmoid * (1.0 - sigmoid) * job->scale;
+      for(long f = chunk->offsets[i]; f < chunk->offsets[i+1]; f++) job->gradient[chunk->indices[f]] += g * chunk->coefficients[f];
+    }
+  }
+  return NULL;
+}
+
+static void run_jobs(void* (*fn)(void*), TUNER_JOB *jobs, int n_jobs){
+  pthread_t threads[TUNER_MAX_THREADS];
+  for(int t = 1; t < n_jobs; t++) pthread_create(&threads[t], NULL, fn, &jobs[t]);
+  fn(&jobs[0]);
+  for(int t = 1; t < n_jobs; t++) pthread_join(threads[t], NULL);
+}
+
+// Returns the mean squared error over the dataset, adding the mean gradient into gradient unless it's NULL.
+static double total_error(TUNER_DATA *data, double *weights, double scale, double *gradient){
+  TUNER_JOB jobs[TUNER_MAX_THREADS];
+  long count = 0;
+  double error = 0;
+  for(int t = 0; t < data->n_chunks; t++){
+    jobs[t].chunk = &data->chunks[t];
+    jobs[t].weights = weights;
+    jobs[t].scale = scale;
+    jobs[t].gradient = gradient ? calloc(N_PARAMS, sizeof(double)) : NULL;
+    count += data->chunks[t].count;
+  }
+  run_jobs(chunk_error, jobs, data->n_chunks);
+  for(int t = 0; t < data->n_chunks; t++){
+    error += jobs[t].error;
+    if(gradient){
+      for(int p = 0; p < N_PARAMS; p++) gradient[p] += jobs[t].gradient[p] / count;
+      free(jobs[t].gradient);
+    }
+  }
+  return count ? error / count : 0;
+}
+
+// Converts the usual Texel scaling constant K into the exponent scale used in the logistic function.
+#define LOGISTIC_SCALE(k) ((k) * log(10.0) / 400.0)
+
+typedef struct {
+  TUNER_DATA *data;
+  double k;
+  int iterations;
+  double rate;
+  double error;
+} TUNE_ARGS;
+
+static void* fit_scale(void *data){
+  TUNE_ARGS *args = data;
+  double phi = (sqrt(5.0) - 1.0) / 2.0;
+  double lo = 0.1, hi = 3.0;
+  double a = hi - phi*(hi-lo), b = lo + phi*(hi-lo);
+  double err_a = total_error(args->data, args->data->weights, LOGISTIC_SCALE(a), NULL);
+  double err_b = total_error(args->data, args->data->weights, LOGISTIC_SCALE(b), NULL);
+  for(int i = 0; i < 40; i++){
+    if(err_a < err_b){
+      hi = b; b = a; err_b = err_a;
+      a = hi - phi*(hi-lo);
+      err_a = total_error(args->data, args->data->weights, LOGISTIC_SCALE(a), NULL);
+    } else {
+      lo = a; a = b; err_a = err_b;
+      b = lo + phi*(hi-lo);
+      err_b = total_error(args->data, args->data->weights, LOGISTIC_SCALE(b), NULL);
+    }
+  }
+  args->k = (lo + hi) / 2;
+  return NULL;
+}
+
+static void* tune(void *data){
+  TUNE_ARGS *args = data;
+  double *w = args->data->weights;
+  double scale = LOGISTIC_SCALE(args->k);
+  double m[N_PARAMS] = { 0 }, v[N_PARAMS] = { 0 }, gradient[N_PARAMS];
+  for(int i = 1; i <= args->iterations; i++){
+    for(int p = 0; p < N_PARAMS; p++) gradient[p] = 0;
+    total_error(args->data, w, scale, gradient);
+    for(int p = 0; p < N_PARAMS; p++){
+      m[p] = ADAM_BETA_1*m[p] + (1-ADAM_BETA_1)*gradient[p];
+      v[p] = ADAM_BETA_2*v[p] + (1-ADAM_BETA_2)*gradient[p]*gradient[p];
+      double m_hat = m[p] / (1 - pow(ADAM_BETA_1, i));
+      double v_hat = v[p] / (1 - pow(ADAM_BETA_2, i));
+      w[p] -= args->rate * m_hat / (sqrt(v_hat) + 1e-12);
+    }
+  }
+  args->error = total_error(args->data, w, scale, NULL);
+  return NULL;
+}
+
+
+// Ruby interface
+
+static void free_dataset(TUNER_DATA *data){
+  for(int t = 0; t < data->n_chunks; t++){
+    TUNER_CHUNK *chunk = &data->chunks[t];
+    free(chunk->offsets);
+    free(chunk->indices);
+    free(chunk->coefficients);
+    free(chunk->base);
+    free(chunk->results);
+  }
+  ruby_xfree(data);
+}
+
+static TUNER_DATA* get_dataset(VALUE self){
+  TUNER_DATA *data;
+  Data_Get_Struct(self, TUNER_DATA, data);
+  return data;
+}
+
+static VALUE dataset_alloc(VALUE klass){
+  TUNER_DATA *data = ALLOC(TUNER_DATA);
+  data->n_chunks = 0;
+  return Data_Wrap_Struct(klass, 0, free_dataset, data);
+}
+
+typedef struct {
+  TUNER_JOB *jobs;
+  int n_jobs;
+} EXTRACT_ARGS;
+
+static void* extract(void *data){
+  EXTRACT_ARGS *args = data;
+  run_jobs(extract_chunk, args->jobs, args->n_jobs);
+  return NULL;
+}
+
+// Reduces each position to its features.  packed holds positions in the batch_eval format, and results holds one 
+// byte per position: 2 if white won, 1 for a draw, and 0 if black won.
+static VALUE dataset_initialize(VALUE self, VALUE packed, VALUE results, VALUE threads){
+  TUNER_DATA *data = get_dataset(self);
+  TUNER_JOB jobs[TUNER_MAX_THREADS];
+  StringValue(packed);
+  StringValue(results);
+  long count = RSTRING_LEN(packed) / sizeof(PACKED_BOARD);
+  if(RSTRING_LEN(packed) % sizeof(PACKED_BOARD) || RSTRING_LEN(results) != count){
+    rb_raise(rb_eArgError, "expected one result for each packed position");
+  }
+  int n_threads = max(1, min(NUM2INT(threads), TUNER_MAX_THREADS));
+  get_weights(data->weights);
+  data->n_chunks = n_threads;
+  long start = 0;
+  for(int t = 0; t < n_threads; t++){
+    long end = count * (t+1) / n_threads;
+    data->chunks[t].count = end - start;
+    jobs[t].chunk = &data->chunks[t];
+    jobs[t].positions = (PACKED_BOARD *)RSTRING_PTR(packed) + start;
+    jobs[t].results = (uint8_t *)RSTRING_PTR(results) + start;
+    jobs[t].weights = data->weights;
+    start = end;
+  }
+  EXTRACT_ARGS args = { jobs, n_threads };
+  rb_str_locktmp(packed);
+  rb_str_locktmp(results);
+  rb_thread_call_without_gvl(extract, &args, NULL, NULL);
+  rb_str_unlocktmp(packed);
+  rb_str_unlocktmp(results);
+  return self;
+}
+
+static VALUE dataset_size(VALUE self){
+  TUNER_DATA *data = get_dataset(self);
+  long count = 0;
+  for(int t = 0; t < data->n_chunks; t++) count += data->chunks[t].count;
+  return LONG2NUM(count);
+}
+
+// Returns the mean squared error of the current weights for the given scaling constant K.
+static VALUE dataset_error(VALUE self, VALUE k){
+  TUNER_DATA *data = get_dataset(self);
+  return rb_float_new(total_error(data, data->weights, LOGISTIC_SCALE(NUM2DBL(k)), NULL));
+}
+
+// Returns the scaling constant K that best fits the current weights to the results.
+static VALUE dataset_fit_scale(VALUE self){
+  TUNE_ARGS args = { get_dataset(self), 0, 0, 0, 0 };
+  rb_thread_call_without_gvl(fit_scale, &args, NULL, NULL);
+  return rb_float_new(args.k);
+}
+
+// Runs the given number of gradient descent steps, and returns the resulting error.
+static VALUE dataset_tune(VALUE self, VALUE k, VALUE iterations, VALUE rate){
+  TUNE_ARGS args = { get_dataset(self), NUM2DBL(k), NUM2INT(iterations), NUM2DBL(rate), 0 };
+  rb_thread_call_without_gvl(tune, &args, NULL, NULL);
+  return rb_float_new(args.error);
+}
+
+// Copies the tuned weights into eval_params, so that the engine evaluates with them.
+static VALUE dataset_apply(VALUE self){
+  set_weights(get_dataset(self)->weights);
+  return Qnil;
+}
+
+static void write_table(FILE *f, const int *values, int count, const char *indent){
+  for(int i = 0; i < count; i++){
+    fprintf(f, "%s%4d%s", i % 8 ? "" : indent, values[i], i == count-1 ? "" : (i % 8 == 7 ? ",\n" : ","));
+  }
+}
+
+// Writes eval_params as C source, in the format of eval_params.c.
+static VALUE write_params(VALUE self, VALUE path){
+  const char *color_names[2] = { "Black", "White" };
+  const char *type_names[5] = { "Pawn", "Knight", "Bishop", "Rook", "Queen" };
+  FILE *f = fopen(StringValueCStr(path), "w");
+  if(!f) rb_sys_fail(StringValueCStr(path));
+  fprintf(f, "// Evaluation parameters written by the tuner (tuner.c).\n\n#include \"eval.h\"\n\n");
+  fprintf(f, "EVAL_PARAMS eval_params = {\n  .main_pst = {\n");
+  for(int c = BLACK; c <= WHITE; c++){
+    fprintf(f, "    { // %s\n", color_names[c]);
+    for(int type = PAWN; type < KING; type++){
+      fprintf(f, "      // %s\n      {\n", type_names[type]);
+      write_table(f, eval_params.main_pst[c][type], 64, "        ");
+      fprintf(f, " }%s\n", type < QUEEN ? "," : "");
+    }
+    fprintf(f, "    }%s\n", c == BLACK ? "," : "");
+  }
+  fprintf(f, "  },\n  .king_pst = {\n");
+  for(int c = BLACK; c <= WHITE; c++){
+    fprintf(f, "    { // %s\n", color_names[c]);
+    for(int endgame = 0; endgame < 2; endgame++){
+      fprintf(f, "      { // %s\n", endgame ? "Endgame" : "Middlegame");
+      write_table(f, eval_params.king_pst[c][endgame], 64, "        ");
+      fprintf(f, " }%s\n", endgame ? "" : ",");
+    }
+    fprintf(f, "    }%s\n", c == BLACK ? "," : "");
+  }
+  fprintf(f, "  },\n  .passed_pawn_bonus = {\n");
+  for(int c = BLACK; c <= WHITE; c++){
+    fprintf(f, "    {");
+    write_table(f, eval_params.passed_pawn_bonus[c], 8, " ");
+    fprintf(f, " }%s\n", c == BLACK ? "," : "");
+  }
+  fprintf(f, "  },\n");
+  fprintf(f, "  .isolated_pawn_penalty = %d,\n", eval_params.isolated_pawn_penalty);
+  fprintf(f, "  .double_pawn_penalty   = %d,\n", eval_params.double_pawn_penalty);
+  fprintf(f, "  .pawn_duo_bonus        = %d,\n", eval_params.pawn_duo_bonus);
+  fprintf(f, "  .tropism_ratio         = %.4f\n};\n", eval_params.tropism_ratio);
+  fclose(f);
+  return path;
+}
+
+extern void Init_tuner(){
+  printf("  -Loading tuner extension...");
+
+  VALUE mod_chess = rb_define_module("Chess");
+  VALUE mod_eval = rb_define_module_under(mod_chess, "Evaluation");
+  VALUE cls_tuner = rb_define_class_under(mod_chess, "Tuner", rb_cObject);
+  VALUE cls_dataset = rb_define_class_under(cls_tuner, "Dataset", rb_cObject);
+
+  rb_define_module_function(mod_eval, "write_params", write_params, 1);
+
+  rb_define_alloc_func(cls_dataset, dataset_alloc);
+  rb_define_method(cls_dataset, "initialize", RUBY_METHOD_FUNC(dataset_initialize), 3);
+  rb_define_method(cls_dataset, "size", RUBY_METHOD_FUNC(dataset_size), 0);
+  rb_define_method(cls_dataset, "error", RUBY_METHOD_FUNC(dataset_error), 1);
+  rb_define_method(cls_dataset, "fit_scale", RUBY_METHOD_FUNC(dataset_fit_scale), 0);
+  rb_define_method(cls_dataset, "tune", RUBY_METHOD_FUNC(dataset_tune), 3);
+  rb_define_method(cls_dataset, "apply", RUBY_METHOD_FUNC(dataset_apply), 0);
+
+  printf("done.\n");
+}
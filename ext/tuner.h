@@ -0,0 +1,86 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+#ifndef TUNER
+#define TUNER
+
+#include "shared.h"
+#include <math.h>
+#include <pthread.h>
+#include <ruby/thread.h>
+
+#define TUNER_MAX_THREADS 64
+
+// Tuned parameters, with the black half of each table tied to the white half.
+#define P_PST        0                  // 5 piece types x 64 squares
+#define P_KING_PST   (P_PST + 5*64)     // middlegame, endgame x 64 squares
+#define P_PASSED     (P_KING_PST + 2*64)
+#define P_ISOLATED   (P_PASSED + 8)
+#define P_DOUBLED    (P_ISOLATED + 1)
+#define P_DUO        (P_DOUBLED + 1)
+#define P_TROPISM    (P_DUO + 1)
+#define N_PARAMS     (P_TROPISM + 1)
+
+#define MAX_POSITION_FEATURES 64
+
+#define ADAM_BETA_1  0.9
+#define ADAM_BETA_2  0.999
+
+// The positions given to one thread.  Since the evaluation is linear in the tuned parameters, each position is 
+// reduced to the coefficients of the parameters it uses, plus a base score from everything else.
+typedef struct {
+  long count;
+  long n_features;
+  long *offsets;          // start of each position's features, with a final entry marking the end.
+  uint16_t *indices;
+  float *coefficients;
+  float *base;
+  float *results;         // 1 if white won, 0.5 for a draw, 0 if black won.
+} TUNER_CHUNK;
+
+typedef struct {
+  int n_chunks;
+  TUNER_CHUNK chunks[TUNER_MAX_THREADS];
+  double weights[N_PARAMS];
+} TUNER_DATA;
+
+typedef struct {
+  TUNER_CHUNK *chunk;
+  PACKED_BOARD *positions;
+  uint8_t *results;
+  double *weights;
+  double scale;
+  double error;
+  double *gradient;
+} TUNER_JOB;
+
+static VALUE dataset_alloc(VALUE klass);
+static VALUE dataset_initialize(VALUE self, VALUE packed, VALUE results, VALUE threads);
+static VALUE dataset_size(VALUE self);
+static VALUE dataset_error(VALUE self, VALUE scale);
+static VALUE dataset_fit_scale(VALUE self);
+static VALUE dataset_tune(VALUE self, VALUE scale, VALUE iterations, VALUE rate);
+static VALUE dataset_apply(VALUE self);
+static VALUE write_params(VALUE self, VALUE path);
+
+extern void Init_tuner();
+
+#endif
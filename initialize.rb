@@ -30,6 +30,14 @@ def play
   Chess::CLI::play
 end
 
+def bench(depth=Chess::Bench::DEPTH)
+  Chess::Bench::run(depth)
+end
+
+def kernel_bench(out_path=Chess::KernelBench::DEFAULT_OUTPUT)
+  Chess::KernelBench::run(out_path)
+end
+
 
 
 
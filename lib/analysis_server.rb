@@ -0,0 +1,188 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'socket'
+require 'json'
+require 'etc'
+
+module Chess
+  # A long-lived analysis engine listening on a Unix domain socket, so that tools can send positions without paying 
+  # for interpreter startup, and without starting each search from cold tables.  Start it with 
+  # `ruby analysis_server.rb [socket path]`.  Each request is one line, and gets one line of JSON back, in order:
+  #
+  #   go [depth N] [movetime MS] fen <fen> [moves ...]   (or startpos instead of fen <fen>)
+  #     => {"bestmove":"e2e4","score":25,"pv":["e2e4","e7e5"],"depth":6,"nodes":51234,"time":812,"tt_size":40211}
+  #   mate [nodes N] fen <fen> [moves ...]
+  #     => {"mate":["h4d8","d7d8","f7f8n"],"time":4}   ("mate":null if none was proven)
+  #   newgame   => {"ok":true}   clears the search tables.
+  #   stats     => {"requests":12,"searches":10,"tt_size":40211}
+  #
+  # Errors are returned as {"error":"..."}.  A client can send several requests without waiting for the replies.
+  # Requests from all connections are queued onto a pool of worker threads.  The Ruby search keeps its state in 
+  # module and global variables, so go and newgame requests run one at a time.  Mate searches run in the native 
+  # extension without holding the interpreter lock, so they run in parallel with each other and with searches.
+  #
+  # The transposition table, killer and history tables are kept between searches.  Successive positions of the same
+  # game, or of the same line of analysis, start from what was learned in the last search.  Send newgame when 
+  # switching to unrelated work.  The tables are also cleared if the TT grows beyond TT_LIMIT entries.
+
+  class AnalysisServer
+    DEFAULT_PATH = '/tmp/ruby_chess.sock'
+    THREADS = Etc.nprocessors
+    DEPTH = 6
+    TT_LIMIT = 1_000_000
+
+    attr_reader :path
+
+    def initialize(path=DEFAULT_PATH, threads=THREADS, depth=DEPTH)
+      @path, @threads, @depth = path, threads, depth
+      @jobs = Queue.new
+      @search_lock = Mutex.new
+      @stats_lock = Mutex.new
+      @requests, @searches = 0, 0
+    end
+
+    # Sends one request to a running server and returns the parsed reply.
+    def self.request(line, path=DEFAULT_PATH)
+      UNIXSocket.open(path) do |socket|
+        socket.puts(line)
+        JSON.parse(socket.gets)
+      end
+    end
+
+    # Listens until stop is called, serving each connection on its own thread.
+    def run
+      File.delete(@path) if File.socket?(@path)
+      @server = UNIXServer.new(@path)
+      workers = (1..@threads).collect { Thread.new { work } }
+      loop do
+        socket = begin
+          @server.accept
+        rescue IOError, Errno::EBADF  # closed by stop.
+          break
+        end
+        Thread.new(socket) { |s| serve(s) }
+      end
+      workers.each { @jobs.push(nil) }
+      workers.each(&:join)
+    ensure
+      File.delete(@path) if File.socket?(@path)
+    end
+
+    def stop
+      @server.close if @server && !@server.closed?
+    end
+
+    private
+
+    # Requests are read as they arrive and queued for the workers.  Each reply is written as soon as it and all 
+    # earlier replies on the connection are ready.
+    def serve(socket)
+      replies = Queue.new
+      writer = Thread.new do
+        while (reply = replies.pop)
+          socket.puts(reply.pop)
+        end
+      end
+      while (line = socket.gets)
+        break if line.strip == 'quit'
+        next if line.strip.empty?
+        reply = Queue.new
+        replies.push(reply)
+        @jobs.push([line, reply])
+      end
+      replies.push(nil)
+      writer.join
+    rescue IOError, SystemCallError
+      writer.kill if writer
+    ensure
+      socket.close unless socket.closed?
+    end
+
+    def work
+      while (job = @jobs.pop)
+        line, reply = job
+        @stats_lock.synchronize { @requests += 1 }
+        result = begin
+          handle(line.split)
+        rescue StandardError => e
+          { error: e.message }
+        end
+        reply.push(JSON.generate(result))
+      end
+    end
+
+    def handle(args)
+      case args.shift
+      when 'go'     then search(*parse_request(args))
+      when 'mate'   then mate(*parse_request(args))
+      when 'newgame'
+        @search_lock.synchronize { Search::clear_memory }
+        { ok: true }
+      when 'stats'
+        @stats_lock.synchronize { { requests: @requests, searches: @searches, tt_size: $tt.size } }
+      else
+        raise ArgumentError, 'unknown request'
+      end
+    end
+
+    # Splits a request into its position and its limits, which come before the position.
+    def parse_request(args)
+      start = args.index('fen') || args.index('startpos')
+      raise ArgumentError, 'no position given' if start.nil?
+      limits = Hash[args[0...start].each_slice(2).collect { |k, v| [k, Integer(v)] }]
+      return UCI::parse_position(args[start..-1]), limits
+    end
+
+    def search(pos, limits)
+      depth = limits['depth'] || @depth
+      time = limits['movetime'] ? limits['movetime'] / 1000.0 : $INF
+      @search_lock.synchronize do
+        Search::clear_memory if $tt.size > TT_LIMIT
+        Chess::current_game = Game.new(FLIP_COLOR[pos.side_to_move], time)
+        t0 = Time.now
+        move, value = Search::select_move(pos, depth, nil, false, false)
+        elapsed = ((Time.now - t0) * 1000).round
+        @stats_lock.synchronize { @searches += 1 }
+        { bestmove: move && UCI::move_to_uci(move), score: value.to_i, 
+          pv: principal_variation(pos, depth).collect { |m| UCI::move_to_uci(m) }, depth: depth, 
+          nodes: $main_calls + $quiescence_calls, time: elapsed, tt_size: $tt.size }
+      end
+    end
+
+    def mate(pos, limits)
+      t0 = Time.now
+      line = Search::mate_search(pos, limits['nodes'] || Search::MATE_NODES)
+      { mate: line && line.collect { |m| UCI::move_to_uci(m) }, time: ((Time.now - t0) * 1000).round }
+    end
+
+    # Follows the hash moves from the root, up to length moves.
+    def principal_variation(pos, length)
+      moves = []
+      while moves.count < length && (move = $tt.get_hash_move(pos, pos.in_check?))
+        MoveGen::make!(pos, move)
+        moves << move
+      end
+      moves.reverse_each { |m| MoveGen::unmake!(pos, m) }
+      moves
+    end
+  end
+end
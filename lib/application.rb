@@ -171,7 +171,8 @@ module Chess # top-level application namespace.
     end
 
     def ai_move
-      move, value = Search::select_move(@position) 
+      move = Book::select_move(@position)  # While in book, moves are played without searching.
+      move, value = Search::select_move(@position) if move.nil?
       if move.nil?
         @winner = @opponent
       else
@@ -0,0 +1,75 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+require './ext/ruby_chess'
+
+module Chess
+  module Book
+    # Opening moves are played from a Polyglot-format book without searching.  The book file is memory-mapped by 
+    # the native extension (book.c), and entries for the current position are found by binary search on the 
+    # position key.  When a position has several book moves, one is chosen at random in proportion to its weight.
+
+    DEFAULT_PATH = './book/book.bin'
+
+    def self.open(path=DEFAULT_PATH)
+      @book = File.exist?(path) ? Polyglot.new(path) : nil
+    end
+
+    def self.close
+      @book = nil
+    end
+
+    def self.loaded?
+      !@book.nil?
+    end
+
+    # Returns the book entries for the position as [move, weight] pairs, skipping any entry that doesn't 
+    # correspond to a legal move.
+    def self.moves(pos)
+      return [] if @book.nil?
+      entries = @book.probe(pos.pieces, pos.side_to_move, pos.castle, pos.enp_target)
+      return [] if entries.empty?
+      in_check = pos.in_check?
+      legal_moves = pos.get_moves(0, false, in_check).select { |m| pos.avoids_check?(m, in_check) }
+      entries.collect do |from, to, promoted_type, weight|
+        move = legal_moves.find do |m| 
+          m.from == from && m.to == to && 
+            (m.promoted_piece.nil? ? promoted_type.nil? : Notation::piece_type(m.promoted_piece) == promoted_type)
+        end
+        [move, weight] unless move.nil?
+      end.compact
+    end
+
+    # Returns a weighted random choice among the book moves for the position, or nil when out of book.
+    def self.select_move(pos)
+      candidates = moves(pos)
+      total = candidates.inject(0) { |sum, (move, weight)| sum + weight }
+      return nil if total == 0
+      pick = rand(total)
+      candidates.each do |move, weight|
+        return move if pick < weight
+        pick -= weight
+      end
+    end
+
+    open
+
+  end
+end
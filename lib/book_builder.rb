@@ -0,0 +1,236 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'etc'
+require 'tmpdir'
+require 'fileutils'
+require './lib/location.rb'
+
+module Chess
+  module Book
+    # Builds Polyglot-format books from PGN game collections.  Games are streamed from the PGN files by the parent 
+    # process and handed out to worker processes, which replay each game's opening moves with the native move 
+    # generator and count (position key, move) pairs.  Each move is credited 2 points when the side playing it went 
+    # on to win the game, and 1 point for a draw.
+    #
+    # To keep memory bounded on large inputs, a worker spills its counts to disk as a sorted run whenever its table 
+    # fills up.  Once all games have been read, the runs from every worker are merged into a single sorted stream, 
+    # counts for the same entry are summed, and the book is written out in key order.
+    #
+    # Workers are forked processes rather than threads, since the interpreter lock would otherwise serialize the 
+    # replay work.
+    class Builder
+      RECORD = 'Q>nN'     # spill file record: position key, Polyglot move, points.
+      RECORD_SIZE = 14
+      PREFIX_SIZE = 10    # key and move; records are sorted on these bytes.
+      MAX_WEIGHT = 0xffff
+
+      RESULTS = { '1-0' => { w: 2, b: 0 }, '0-1' => { w: 0, b: 2 }, '1/2-1/2' => { w: 1, b: 1 } }
+
+      attr_reader :games, :entries
+
+      # Options:
+      #   max_ply:     number of half-moves from each game to include in the book.
+      #   min_points:  entries with fewer total points are left out of the book.
+      #   workers:     number of worker processes.
+      #   spill_limit: number of distinct entries a worker holds in memory before spilling a sorted run to disk.
+      def initialize(max_ply: 24, min_points: 1, workers: Etc.nprocessors, spill_limit: 500_000)
+        @max_ply, @min_points, @workers, @spill_limit = max_ply, min_points, workers, spill_limit
+        @games, @entries = 0, 0
+      end
+
+      def build(pgn_paths, out_path=DEFAULT_PATH)
+        Dir.mktmpdir('book') do |dir|
+          distribute(Array(pgn_paths), dir)
+          FileUtils.mkdir_p(File.dirname(out_path))
+          merge(Dir[File.join(dir, '*.run')], out_path)
+        end
+        self
+      end
+
+      private
+
+      # Streams games to the workers round-robin over pipes, one game per line.  Writes block while a worker's pipe 
+      # is full, so the parent never reads far ahead of the workers.
+      def distribute(pgn_paths, dir)
+        pipes = []
+        @workers.times do |id|
+          reader, writer = IO.pipe
+          pid = fork do
+            writer.close
+            pipes.each { |_, w| w.close }  # pipes to workers forked earlier.
+            begin
+              work(reader, File.join(dir, "#{id}"))
+            rescue StandardError => e
+              warn(e.message)
+              exit!(1)
+            end
+            exit!(0)
+          end
+          reader.close
+          pipes << [pid, writer]
+        end
+        pgn_paths.each do |path|
+          each_game(path) do |result, movetext|
+            pipes[@games % @workers][1].puts("#{result}\t#{movetext}")
+            @games += 1
+          end
+        end
+        pipes.each { |pid, writer| writer.close }
+        pipes.each do |pid, writer| 
+          Process.wait(pid)
+          raise "book worker #{pid} failed" unless $?.success?
+        end
+      end
+
+      # Yields the result and movetext of each game in a PGN file.  Comments, variations and move numbers are 
+      # left for the workers to strip.
+      def each_game(path)
+        result, movetext, in_comment = nil, [], false
+        File.foreach(path) do |line|
+          if !in_comment && line.start_with?('[')
+            unless movetext.empty?
+              yield(result, movetext.join(' '))
+              result, movetext = nil, []
+            end
+            result = $1 if line =~ /\A\[Result\s+"([^"]*)"/
+          else
+            line = line.chomp
+            line = line.sub(/;.*/, '') unless in_comment
+            movetext << line unless line.strip.empty?
+            in_comment = line.count('{') > line.count('}') if line.include?('{') || line.include?('}')
+          end
+        end
+        yield(result, movetext.join(' ')) unless movetext.empty?
+      end
+
+      def work(reader, run_prefix)
+        counts, runs = Hash.new(0), 0
+        reader.each_line do |line|
+          result, movetext = line.chomp.split("\t", 2)
+          points = RESULTS[result]
+          next if points.nil? || movetext.nil?
+          replay(movetext, points, counts)
+          if counts.size >= @spill_limit
+            spill(counts, "#{run_prefix}-#{runs}.run")
+            counts.clear
+            runs += 1
+          end
+        end
+        spill(counts, "#{run_prefix}-#{runs}.run") unless counts.empty?
+      end
+
+      # Plays through the opening moves of a game, crediting each (position, move) pair.  Replay stops at the first 
+      # move that can't be parsed or isn't legal.
+      def replay(movetext, points, counts)
+        pos = Position.new
+        sans(movetext).first(@max_ply).each do |san|
+          begin
+            move = Notation::san_to_move(pos, san)
+          rescue Notation::InvalidMoveError
+            return
+          end
+          credit = points[pos.side_to_move]
+          if credit > 0
+            key = Book::polyglot_key(pos.pieces, pos.side_to_move, pos.castle, pos.enp_target)
+            counts[[key, Builder.encode_move(move)].pack('Q>n')] += credit
+          end
+          MoveGen::make!(pos, move)
+        end
+      end
+
+      def sans(movetext)
+        text = movetext.gsub(/\{[^}]*\}/, ' ')
+        nil while text.gsub!(/\([^()]*\)/, ' ')  # strip variations, innermost first.
+        text.split.collect { |token| token.sub(/\A\d+\.+/, '') }.reject do |token|
+          token.empty? || token.start_with?('$') || RESULTS.has_key?(token) || token == '*'
+        end
+      end
+
+      # Packed keys compare bytewise in the same order as the (key, move) pairs they encode.
+      def spill(counts, path)
+        File.open(path, 'wb') do |f|
+          counts.keys.sort!.each { |prefix| f.write(prefix + [counts[prefix]].pack('N')) }
+        end
+      end
+
+      # Merges the sorted runs, summing the points for each (key, move) pair, and writes each position's moves to the 
+      # book once all of them have been seen.
+      def merge(run_paths, out_path)
+        runs = run_paths.collect { |path| File.open(path, 'rb') }
+        heads = runs.collect { |f| f.read(RECORD_SIZE) }
+        File.open(out_path, 'wb') do |out|
+          group, group_key = [], nil
+          until (i = min_head(heads)).nil?
+            prefix, points = heads[i][0, PREFIX_SIZE], heads[i].unpack(RECORD)[2]
+            heads[i] = runs[i].read(RECORD_SIZE)
+            while (j = heads.index { |h| h && h[0, PREFIX_SIZE] == prefix })
+              points += heads[j].unpack(RECORD)[2]
+              heads[j] = runs[j].read(RECORD_SIZE)
+            end
+            key, move = prefix.unpack('Q>n')
+            if key != group_key
+              write_group(out, group_key, group)
+              group, group_key = [], key
+            end
+            group << [move, points] if points >= @min_points
+          end
+          write_group(out, group_key, group)
+        end
+      ensure
+        runs.each(&:close) if runs
+      end
+
+      def min_head(heads)
+        min = nil
+        heads.each_with_index { |h, i| min = i if h && (min.nil? || h < heads[min]) }
+        min
+      end
+
+      # Weights are scaled down when needed to fit Polyglot's 16-bit field, keeping their proportions.  Moves are 
+      # written in order of decreasing weight.
+      def write_group(out, key, group)
+        return if group.empty?
+        max = group.collect(&:last).max
+        group.sort_by { |move, points| -points }.each do |move, points|
+          weight = max > MAX_WEIGHT ? points * MAX_WEIGHT / max : points
+          next if weight == 0
+          out.write([key, move, weight, 0].pack('Q>nnN'))
+          @entries += 1
+        end
+      end
+
+      CASTLE_ROOK = { Location::SQUARES[:g1] => Location::SQUARES[:h1], Location::SQUARES[:c1] => Location::SQUARES[:a1],
+                      Location::SQUARES[:g8] => Location::SQUARES[:h8], Location::SQUARES[:c8] => Location::SQUARES[:a8] }
+
+      # Encodes a move in Polyglot format.  Castling is written as the king capturing its own rook.
+      def self.encode_move(move)
+        to = move.to
+        if Notation::piece_type(move.piece) == 5 && (move.to - move.from).abs == 2
+          to = CASTLE_ROOK[move.to]
+        end
+        promoted_type = move.promoted_piece.nil? ? 0 : Notation::piece_type(move.promoted_piece)
+        to | (move.from << 6) | (promoted_type << 12)
+      end
+
+    end
+  end
+end
@@ -0,0 +1,96 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require './ext/ruby_chess'
+
+module Chess
+  module EPDFile
+    # Fast loading of large EPD (or FEN) files.  The native reader (see ext/epd_file.h) memory-maps the file and 
+    # parses every line in one pass, packing each position into a position file record and keeping the bm, am, id 
+    # and c0 operations as spans of the file, so no Ruby objects are created until a position or operation is 
+    # asked for:
+    #
+    #   EPDFile::Reader.open('./test_suites/wac_300.epd') do |r|
+    #     puts r.report
+    #     r.count.times { |i| puts "#{r.id(i)}: #{r.best_moves(i)}" }
+    #   end
+    #
+    # Game results given by c9 "1-0" or a bracketed score such as [0.5] are stored as 2 if white won, 1 for a draw,
+    # and 0 if black won, as in position files.
+
+    # Parses the file and prints its size and the parse throughput.
+    def self.benchmark(path)
+      Reader.open(path) { |r| puts r.report }
+    end
+
+    class Reader
+      include Enumerable
+
+      def self.open(path)
+        reader = new(path)
+        return reader unless block_given?
+        begin
+          yield reader
+        ensure
+          reader.close
+        end
+      end
+
+      alias :size :count
+
+      def position(index)
+        squares, side, castle, enp_target, halfmove_clock = entry(index)
+        Position.new(Board.new(squares), side, castle, enp_target, halfmove_clock)
+      end
+
+      def each
+        count.times { |i| yield position(i) }
+      end
+
+      # Yields [packed boards, results] for each run of up to size positions, as for PositionFile::Reader.
+      def each_batch(size=PositionFile::BATCH_SIZE)
+        (0...count).step(size) { |start| yield batch(start, [size, count - start].min) }
+      end
+
+      def id(index)
+        operation(index, 'id')
+      end
+
+      def best_moves(index)
+        (operation(index, 'bm') || '').split(' ')
+      end
+
+      def avoid_moves(index)
+        (operation(index, 'am') || '').split(' ')
+      end
+
+      # Parse throughput, in MB/s.
+      def throughput
+        bytes / 1e6 / [parse_time, 1e-9].max
+      end
+
+      def report
+        "Parsed #{count} positions (#{(bytes / 1e6).round(2)} MB) in #{parse_time.round(4)} seconds: " + 
+        "#{throughput.round(1)} MB/s"
+      end
+    end
+  end
+end
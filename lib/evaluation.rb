@@ -18,6 +18,8 @@
 # IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 # CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #-----------------------------------------------------------------------------------
+require 'etc'
+require './ext/ruby_chess'
 
 module Chess
   module Evaluation
@@ -31,8 +33,15 @@ module Chess
     # 3. Piece-Square Tables - Small bunuses/penalties are applied based on piece type/location.
     # 4. Piece Mobility - Each piece is awarded a bonus based on how many squares it can move to. 
     # 5. Pawn Structure - Adjusts pawn values are by looking for several pawn structure patterns.
+    #
+    # Endgames recognized by their material (endgame.c) are scored by specialized rules instead, or have their score 
+    # scaled toward a draw.
+    #
+    # When a HalfKP network is loaded (nnue.c), it replaces all of the above.  The network is loaded at startup 
+    # from NNUE_PATH, which can be overridden by setting the CHESS_NNUE environment variable.
 
     EVAL_GRAIN = 1
+    NNUE_PATH = ENV['CHESS_NNUE'] || './nnue/nn.nnue'
 
     # The main evaluation method.  Calls methods for calculation of each evaluation component,
     # then divides the total eval score by EVAL_GRAIN to achieve the desired 'coarseness' of evaluation.
@@ -45,6 +54,17 @@ module Chess
     def self.base_material(pos, side)
       pos.pieces.get_base_material(side) - Pieces::PIECE_VALUES[:K]    
     end
+
+    # Evaluates many positions at once in the native extension (batch_eval.c), returning their scores from the 
+    # perspective of each side to move.  When qsearch is true, each score is resolved by a search of captures.
+    def self.evaluate_positions(positions, qsearch=false, threads=Etc.nprocessors)
+      packed = positions.collect { |pos| pack_position(pos.pieces, pos.side_to_move) }.join
+      scores = "\0" * (4 * positions.count)
+      evaluate_batch(packed, scores, qsearch, threads)
+      scores.unpack('l*')
+    end
+
+    load_network(NNUE_PATH) if File.exist?(NNUE_PATH)
   end
 end 
 
@@ -0,0 +1,76 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'json'
+
+module Chess
+  module KernelBench
+    # Micro-benchmarks for the native kernels (attack maps, SEE, evaluation terms and move generators), run over 
+    # every position in the EPD test suites.  Timing is done by the native extension (kernel_bench.c), which reports 
+    # the mean time per kernel call for a number of passes over the corpus.  Each kernel is sampled repeatedly after 
+    # a few warmup runs, and the median and spread of the samples are reported in nanoseconds per call.  Kernels run
+    # at the ISA level in use (see Chess::CPU.isa), which is recorded with the results.
+    #
+    # Results are printed as a table, and written as JSON so that runs can be compared by other tools.
+
+    DEFAULT_OUTPUT = './kernel_bench.json'
+    WARMUP = 3
+    REPETITIONS = 21
+    PASSES = 20
+
+    # Each corpus entry holds the arguments the kernels need: [p_board, side_to_move, sq_board, enp_target, castle]
+    def self.corpus(files=Dir['./test_suites/*.epd'].sort)
+      lines = files.collect { |file| File.readlines(file) }.flatten.reject { |line| line.strip.empty? }
+      lines.collect do |line|
+        pos = Notation::epd_to_position(line)
+        [pos.pieces, pos.side_to_move, pos.board.squares, pos.enp_target, pos.castle]
+      end
+    end
+
+    def self.run(out_path=DEFAULT_OUTPUT, repetitions=REPETITIONS, warmup=WARMUP, passes=PASSES)
+      positions = corpus
+      results = kernels.collect do |kernel|
+        warmup.times { time_kernel(kernel, positions, passes) }
+        samples = Array.new(repetitions) { time_kernel(kernel, positions, passes) }
+        summarize(kernel, samples)
+      end
+      tp results, :kernel, :median_ns, :p10_ns, :p90_ns, :min_ns, :max_ns
+      report = { isa: CPU.isa, positions: positions.count, repetitions: repetitions, warmup: warmup, 
+                 passes: passes, results: results }
+      File.write(out_path, JSON.pretty_generate(report)) unless out_path.nil?
+      results
+    end
+
+    # Kernels that don't apply to any position in the corpus (e.g. get_evasions when no side to move is in check) 
+    # are reported with nil timings.
+    def self.summarize(kernel, samples)
+      return { kernel: kernel } if samples.first.nil?
+      sorted = samples.sort
+      { kernel: kernel, median_ns: percentile(sorted, 50), p10_ns: percentile(sorted, 10), 
+        p90_ns: percentile(sorted, 90), min_ns: sorted.first.round(1), max_ns: sorted.last.round(1) }
+    end
+
+    def self.percentile(sorted, p)  # nearest-rank percentile of a sorted sample.
+      sorted[((p/100.0)*sorted.count).ceil - 1].round(1)
+    end
+
+  end
+end
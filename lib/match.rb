@@ -0,0 +1,319 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'etc'
+require 'rbconfig'
+require 'fileutils'
+require 'tmpdir'
+
+module Chess
+  class Match
+    # Plays two engine configurations against each other, to measure whether a change gains strength.  Each engine 
+    # runs in its own process and is driven over UCI (see UCI), so the two may differ in UCI options, environment 
+    # variables (e.g. CHESS_NNUE), the build of the native extension they load, or be different engines altogether:
+    #
+    #   base = { name: 'base', library: './build/pgo/default.so' }
+    #   test = { name: 'test', options: { 'EvalFile' => './nnue/test.nnue' } }
+    #   Chess::Match.new(test, base, './test_suites/openings.epd', tc: '10+0.1', concurrency: 4).run(1000)
+    #
+    # Moves are limited by the time control (tc), a fixed depth, or both.  Games are played concurrently by up to 
+    # concurrency worker threads.  Each worker starts one pair of engine processes and reuses it for every game it 
+    # plays, sending ucinewgame before each.  Each opening is played twice, with colors reversed.  Games end by mate, 
+    # stalemate, the fifty move rule, threefold repetition, insufficient material, a loss on time or an illegal move, or 
+    # by adjudication: won once both engines agree on a decisive score for several moves, and drawn once both report a 
+    # near-zero score for several moves late in the game.
+    #
+    # After each game the runner prints the score and Elo estimate of the first engine against the second, and the 
+    # log-likelihood ratio of a sequential probability ratio test of elo1 against elo0.  The match stops once the 
+    # test accepts either hypothesis, so patches that lose strength are stopped early.
+
+    ROOT = File.expand_path('..', File.dirname(__FILE__))
+    UCI_SCRIPT = File.join(ROOT, 'uci.rb')
+
+    CONCURRENCY = Etc.nprocessors
+    MAX_PLIES = 400            # games still running after this many plies are scored as draws.
+    WIN_SCORE = 1000           # win adjudication: both engines agree on at least this score (in centipawns)...
+    WIN_MOVES = 4              # ...for this many moves each.
+    DRAW_SCORE = 10            # draw adjudication: both engines report at most this score...
+    DRAW_MOVES = 8             # ...for this many moves each...
+    DRAW_START = 40            # ...after this move number.
+
+    class SPRT
+      # A sequential probability ratio test of the hypotheses that the Elo difference is elo0 (H0) or elo1 (H1), 
+      # with false positive rate alpha and false negative rate beta.  Game outcomes are modeled as trinomial 
+      # (win/draw/loss), with the log-likelihood ratio approximated from the mean and variance of the score.
+
+      attr_reader :elo0, :elo1, :alpha, :beta
+
+      def initialize(elo0=0, elo1=5, alpha=0.05, beta=0.05)
+        @elo0, @elo1, @alpha, @beta = elo0, elo1, alpha, beta
+      end
+
+      def lower_bound
+        Math.log(@beta / (1 - @alpha))
+      end
+
+      def upper_bound
+        Math.log((1 - @beta) / @alpha)
+      end
+
+      def llr(wins, draws, losses)
+        n = wins + draws + losses
+        return 0.0 if n == 0
+        score, variance = Match::score_stats(wins, draws, losses)
+        return 0.0 if variance == 0
+        s0, s1 = Match::expected_score(@elo0), Match::expected_score(@elo1)
+        n * (s1 - s0) * (2 * score - s0 - s1) / (2 * variance)
+      end
+
+      # Returns :accept (H1) or :reject (H0) once either bound is crossed, otherwise nil.
+      def status(wins, draws, losses)
+        llr = llr(wins, draws, losses)
+        return :accept if llr >= upper_bound
+        return :reject if llr <= lower_bound
+        nil
+      end
+    end
+
+    def self.expected_score(elo)
+      1.0 / (1.0 + 10**(-elo / 400.0))
+    end
+
+    # Returns the mean score per game and its variance.
+    def self.score_stats(wins, draws, losses)
+      n = (wins + draws + losses).to_f
+      w, d, l = wins / n, draws / n, losses / n
+      score = w + d / 2
+      return score, w * (1 - score)**2 + d * (0.5 - score)**2 + l * score**2
+    end
+
+    # Returns the Elo difference implied by the results, and the margin of its 95% confidence interval.
+    def self.elo(wins, draws, losses)
+      n = wins + draws + losses
+      return 0.0, $INF if n == 0
+      score, variance = score_stats(wins, draws, losses)
+      to_elo = lambda { |s| s <= 0 ? -$INF : (s >= 1 ? $INF : -400 * Math.log10(1 / s - 1)) }
+      margin = 1.959964 * Math.sqrt(variance / n)
+      return to_elo.call(score), (to_elo.call(score + margin) - to_elo.call(score - margin)) / 2
+    end
+
+    # Parses a time control of the form "base+increment" in seconds (e.g. "10+0.1").  Returns base and increment 
+    # in milliseconds, or nil for no time control.
+    def self.parse_time_control(tc)
+      return nil if tc.nil?
+      base, inc = tc.to_s.split('+')
+      return (base.to_f * 1000).round, (inc.to_f * 1000).round
+    end
+
+    class Engine
+      # A running engine process.  config holds the name, and optionally command (defaults to this engine's 
+      # uci.rb), library (a build of the native extension), env and UCI options.
+      attr_reader :name
+
+      def initialize(config)
+        @name = config[:name]
+        env = (config[:env] || {}).dup
+        env['CHESS_LIBRARY'] = Engine::library_path(config[:library]) if config[:library]
+        argv = config[:command] || [RbConfig.ruby, UCI_SCRIPT]
+        @io = IO.popen(env, argv, 'r+', chdir: ROOT, err: File::NULL)
+        command('uci')
+        wait_for('uciok')
+        (config[:options] || {}).each { |name, value| command("setoption name #{name} value #{value}") }
+        ready
+      end
+
+      # Ruby names an extension's init function after its file, so builds saved under other names (e.g. by 
+      # ext/build_pgo.rb) are loaded from a copy named ruby_chess.
+      def self.library_path(path)
+        path = File.expand_path(path, ROOT)
+        target = "ruby_chess.#{RbConfig::CONFIG['DLEXT']}"
+        return path if File.basename(path) == target
+        dir = File.join(Dir.tmpdir, "ruby_chess_match_#{Process.pid}", File.basename(path, '.*'))
+        FileUtils.mkdir_p(dir)
+        FileUtils.cp(path, File.join(dir, target))
+        File.join(dir, target)
+      end
+
+      def command(line)
+        @io.puts(line)
+        @io.flush
+      end
+
+      # Reads lines until one starting with prefix, which is returned along with the last score reported.
+      def wait_for(prefix)
+        score = nil
+        while (line = @io.gets)
+          score = $1.to_i if line =~ /score cp (-?\d+)/
+          score = ($1.to_i > 0 ? MATE_SCORE : -MATE_SCORE) if line =~ /score mate (-?\d+)/
+          return line, score if line.start_with?(prefix)
+        end
+        raise IOError, "engine #{@name} exited"
+      end
+
+      def ready
+        command('isready')
+        wait_for('readyok')
+      end
+
+      def new_game
+        command('ucinewgame')
+        ready
+      end
+
+      # Returns the engine's move in long algebraic notation, its score, and the time taken in milliseconds.
+      def go(fen, moves, clocks, inc, depth)
+        command("position fen #{fen}" + (moves.empty? ? '' : " moves #{moves.join(' ')}"))
+        start = Time.now
+        limits = depth ? " depth #{depth}" : ''
+        limits += " wtime #{clocks[:w]} btime #{clocks[:b]} winc #{inc} binc #{inc}" if clocks
+        command('go' + limits)
+        line, score = wait_for('bestmove')
+        return line.split[1], score, ((Time.now - start) * 1000).round
+      end
+
+      def close
+        command('quit')
+        @io.close
+      rescue IOError, Errno::EPIPE
+      end
+    end
+
+    MATE_SCORE = 100000
+
+    attr_reader :wins, :draws, :losses
+
+    def initialize(first, second, openings, options={})
+      @engines = [first, second]
+      @openings = File.readlines(openings).collect(&:strip).reject(&:empty?).collect { |epd| Notation::epd_to_fen(epd) }
+      @time_control = Match::parse_time_control(options[:tc])
+      @depth = options[:depth]
+      @concurrency = options[:concurrency] || CONCURRENCY
+      @sprt = options[:sprt] || SPRT.new
+      @verbose = options.fetch(:verbose, true)
+      @wins, @draws, @losses = 0, 0, 0
+      @lock = Mutex.new
+    end
+
+    def games
+      @wins + @draws + @losses
+    end
+
+    # Plays up to max_games games, or until the SPRT reaches a decision.  Returns the SPRT status (nil if 
+    # undecided), and the first engine's wins, draws and losses.
+    def run(max_games=2*@openings.count)
+      jobs = Queue.new
+      max_games.times { |i| jobs << [@openings[(i/2) % @openings.count], i.odd?] }
+      @status = nil
+      threads = [@concurrency, max_games].min.times.collect do
+        Thread.new do
+          engines = @engines.collect { |config| Engine.new(config) }
+          begin
+            until @status || (job = (jobs.pop(true) rescue nil)).nil?
+              fen, swapped = job
+              white, black = swapped ? engines.reverse : engines
+              result, reason = play_game(white, black, fen)
+              record(swapped ? -result : result, reason)
+            end
+          ensure
+            engines.each(&:close)
+          end
+        end
+      end
+      threads.each(&:join)
+      print_summary if @verbose
+      return @status, @wins, @draws, @losses
+    end
+
+    # Plays one game from fen.  Returns the result from white's perspective (1, 0 or -1) and the reason.
+    def play_game(white, black, fen)
+      [white, black].each(&:new_game)
+      pos = Notation::fen_to_position(fen)
+      engines = { w: white, b: black }
+      clocks = @time_control && { w: @time_control[0], b: @time_control[0] }
+      inc = @time_control ? @time_control[1] : 0
+      seen = Hash.new(0)
+      moves, decisive, draw_count = [], 0, 0
+      (0...MAX_PLIES).each do |ply|
+        seen[pos.hash] += 1
+        side, winner = pos.side_to_move, (pos.side_to_move == :w ? -1 : 1)
+        legal = UCI::legal_moves(pos)
+        return (pos.in_check? ? winner : 0), (pos.in_check? ? 'mate' : 'stalemate') if legal.empty?
+        return 0, 'fifty move rule' if pos.halfmove_clock >= 100
+        return 0, 'repetition' if seen[pos.hash] >= 3
+        return 0, 'insufficient material' if insufficient_material?(pos)
+
+        str, score, elapsed = engines[side].go(fen, moves, clocks, inc, @depth)
+        if clocks
+          clocks[side] -= elapsed
+          return winner, "#{engines[side].name} lost on time" if clocks[side] < 0
+          clocks[side] += inc
+        end
+        move = legal.find { |m| UCI::move_to_uci(m) == str }
+        return winner, "#{engines[side].name} played an illegal move (#{str})" if move.nil?
+
+        # Adjudication, on the scores reported by both engines for their last moves.
+        if score
+          white_score = side == :w ? score : -score
+          sign = white_score.abs >= WIN_SCORE ? (white_score <=> 0) : 0
+          decisive = sign != 0 && (decisive <=> 0) != -sign ? decisive + sign : sign
+          return (decisive <=> 0), 'adjudicated win' if decisive.abs >= 2*WIN_MOVES
+          draw_count = score.abs <= DRAW_SCORE ? draw_count + 1 : 0
+          return 0, 'adjudicated draw' if ply >= 2*DRAW_START && draw_count >= 2*DRAW_MOVES
+        end
+        MoveGen::make!(pos, move)
+        moves << str
+      end
+      return 0, 'game too long'
+    end
+
+    def insufficient_material?(pos)
+      pieces = pos.board.squares.reject { |id| id == 0 }.collect { |id| Notation::piece_type(id) }
+      pieces.count <= 3 && (pieces - [1, 2, 5]).empty?  # kings plus at most one minor piece.
+    end
+
+    # Records a result from the first engine's perspective, and checks the SPRT.
+    def record(result, reason)
+      @lock.synchronize do
+        @wins += 1 if result > 0
+        @draws += 1 if result == 0
+        @losses += 1 if result < 0
+        @status ||= @sprt.status(@wins, @draws, @losses)
+        if @verbose
+          elo, margin = Match::elo(@wins, @draws, @losses)
+          puts "Game #{games.to_s.rjust(4)} (#{reason}): +#{@wins} =#{@draws} -#{@losses}  " +
+               "Elo #{elo.round(1)} +/- #{margin.round(1)}  " + 
+               "LLR #{@sprt.llr(@wins, @draws, @losses).round(2)} [#{@sprt.lower_bound.round(2)}, #{@sprt.upper_bound.round(2)}]"
+        end
+      end
+    end
+
+    def print_summary
+      elo, margin = Match::elo(@wins, @draws, @losses)
+      names = @engines.collect { |config| config[:name] }
+      puts "\n==========================="
+      puts "#{names[0]} vs #{names[1]}: +#{@wins} =#{@draws} -#{@losses}"
+      puts "Elo            : #{elo.round(1)} +/- #{margin.round(1)}"
+      puts "SPRT           : elo0=#{@sprt.elo0} elo1=#{@sprt.elo1} alpha=#{@sprt.alpha} beta=#{@sprt.beta}"
+      puts "LLR            : #{@sprt.llr(@wins, @draws, @losses).round(2)} " + 
+           "(#{@status == :accept ? 'H1 accepted' : (@status == :reject ? 'H0 accepted' : 'undecided')})"
+    end
+  end
+end
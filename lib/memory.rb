@@ -20,7 +20,6 @@
 #-----------------------------------------------------------------------------------
 
 require './lib/location.rb'
-require 'SecureRandom'
 require './lib/pieces.rb'
 
 module Chess
@@ -45,8 +44,15 @@ module Chess
     TTBound = Struct.new(:depth, :count, :bound)
 
     class TranspositionTable
-      def initialize
+      attr_accessor :max_size
+
+      def initialize(max_size=nil)  # max_size limits the number of entries.  The default is no limit.
         @table = {}
+        @max_size = max_size
+      end
+
+      def full?
+        !@max_size.nil? && @table.length >= @max_size
       end
 
       def clear
@@ -71,8 +77,10 @@ module Chess
       # Probe the TT for saved search results.  If a valid entry is found, push the stored best move into
       # first_moves array. If stored result would cause cutoff of local search, return the stored result.
       def probe(node, depth, alpha, beta, in_check)
+        Analytics::Counters::add(Analytics::Counters::TT_PROBES) if Analytics::INSTRUMENT
         if key_ok?(node.hash)
           $memory_calls += 1
+          Analytics::Counters::add(Analytics::Counters::TT_HITS) if Analytics::INSTRUMENT
           e = @table[node.hash]
           lower = e.lower
           upper = e.upper
@@ -80,9 +88,11 @@ module Chess
           move = !e.move.nil? && node.avoids_check?(e.move, in_check) ? e.move : nil
 
           if lower.depth >= depth && lower.bound >= beta
+            Analytics::Counters::add(Analytics::Counters::TT_CUTOFFS) if Analytics::INSTRUMENT
             return move, lower.bound, lower.count
           end
           if upper.depth >= depth && upper.bound <= alpha
+            Analytics::Counters::add(Analytics::Counters::TT_CUTOFFS) if Analytics::INSTRUMENT
             return move, upper.bound, upper.count
           end
           return move, nil, nil
@@ -127,7 +137,7 @@ module Chess
               lower.bound = alpha
             end
           end
-        else 
+        elsif !full?  # Once the table is full, only existing entries are updated.
           b = (result <= alpha) ? result : beta
           a = (result >= beta)  ? result : alpha
           @table[h] = TTEntry.new(h, TTBound.new(depth, count, a), TTBound.new(depth, count, b), move)
@@ -152,8 +162,12 @@ module Chess
     # generated by merging (via XOR) the keys for each piece/square combination, and merging in keys representing
     # the side to move, castling rights, and any en-passant target square.
 
+    # Keys are drawn from a generator with a fixed seed, so that the same keys (and the same search, node for node) 
+    # are produced on every run.
+    KEY_GENERATOR = Random.new(0x2014_0708)
+
     def self.create_key  # Return a random 64-bit integer.
-      SecureRandom::random_number(2**64)
+      KEY_GENERATOR.rand(2**64)
     end
 
     # Associate each possible square and piece combination with its own random 64-bit key.
@@ -26,6 +26,7 @@ module Chess
     # reversible via unmake!
 
     def self.make!(position, move) 
+      position.key_stack.push(position.hash)  # Save the key of the position being left for repetition detection.
       move.make!(position)  # Delegate most of the heavy lifting to the Move class.
       set_castle_flag(position, move)  # Old castle rights are cached in move for unmake.
       flip(position, move)
@@ -34,6 +35,7 @@ module Chess
     def self.unmake!(position, move)
       flip(position, move) # Unmake operations are done relative to original side to move, so update side to move first.         
       move.unmake!(position) # Delegate most of the heavy lifting to the Move class.
+      position.key_stack.pop
     end
 
     # Updates the side to move and hash key for position.
@@ -33,10 +33,13 @@ module Chess
     #  2. Some heuristics needed during Evaluation can be stored in the position object and incrementally
     #     updated during make/unmake, eliminating the need to loop over the piece lists to recalculate these
     #     heuristics for each evaluation call. Material balance and hash key are updated in this way.
+    #  3. The hash keys of previously reached positions are kept in a native KeyStack. Since the same position 
+    #     instance is used for the game and for the search, the stack covers both the game history and the 
+    #     current search path, allowing draws by repetition to be detected.
 
     class Position
       attr_accessor :board, :pieces, :side_to_move, :enemy, :halfmove_clock, :castle, :enp_target, 
-                    :hash, :king_location, :tropism
+                    :hash, :king_location, :tropism, :key_stack
 
       def initialize(board=nil, side_to_move=:w, castle=0b1111, enp_target=nil, halfmove_clock=0)
         @side_to_move, @castle, @enp_target, @halfmove_clock = side_to_move, castle, enp_target, halfmove_clock
@@ -46,6 +49,8 @@ module Chess
         @pieces = Bitboard::PiecewiseBoard.new(@board)
         # Calculate an initial Zobrist hash key for the position.
         @hash = @board.hash ^ Memory::enp_key(enp_target) ^ (@side_to_move==:w ? 1 : 0)
+        # Keys for positions reached before this one are pushed onto the stack as moves are made.
+        @key_stack = Memory::KeyStack.new
       end
 
       def own_king_location
@@ -75,6 +80,12 @@ module Chess
         side_in_check?(@pieces, @side_to_move)
       end
 
+      # Returns true if the current position has already occurred since the last irreversible move, 
+      # either earlier in the game or along the current search path.
+      def repetition?
+        @key_stack.repetition?(@hash, @halfmove_clock)
+      end
+
       def enemy_in_check?
         side_in_check?(@pieces, @enemy)
       end
@@ -89,7 +100,7 @@ module Chess
       end
 
       def gives_check?(move)
-        move_gives_check?(@pieces, @board.squares, move.from, move.to, @side_to_move, move.promoted_piece)
+        move_gives_check?(@pieces, move.piece, move.from, move.to, @side_to_move, move.promoted_piece)
       end
 
       # Return a string decribing the position in Forsyth-Edwards Notation.
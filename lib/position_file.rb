@@ -0,0 +1,93 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require './ext/ruby_chess'
+
+module Chess
+  module PositionFile
+    # Dense binary storage for large sets of positions, as used for tuning and training data.  Each position is a 
+    # fixed-size 32 byte record (see ext/position_file.h): the occupancy bitboard, a 4-bit code for each occupied 
+    # square, side to move, castling rights, en passant target, clocks, and optionally a score and game result.  
+    # Writers buffer records in the native extension; readers memory-map the file and decode records straight into 
+    # the native board, or into packed boards for Evaluation::evaluate_batch, without parsing any strings:
+    #
+    #   PositionFile::Writer.open('./positions.bin') { |w| positions.each { |pos| w.write(pos, score, result) } }
+    #   PositionFile::Reader.open('./positions.bin') do |r|
+    #     r.each_batch { |packed, results| ... }
+    #   end
+    #
+    # Results are stored as 2 if white won, 1 for a draw, and 0 if black won.
+
+    BATCH_SIZE = 4096
+
+    class Writer
+      def self.open(path)
+        writer = new(path)
+        return writer unless block_given?
+        begin
+          yield writer
+        ensure
+          writer.close
+        end
+      end
+
+      def write(pos, score=nil, result=nil)
+        add(pos.pieces, pos.side_to_move, pos.castle, pos.enp_target, pos.halfmove_clock, 
+            pos.halfmove_clock/2 + 1, score, result)
+      end
+    end
+
+    class Reader
+      include Enumerable
+
+      def self.open(path)
+        reader = new(path)
+        return reader unless block_given?
+        begin
+          yield reader
+        ensure
+          reader.close
+        end
+      end
+      
+      alias :size :count
+
+      def position(index)
+        squares, side, castle, enp_target, halfmove_clock = entry(index)
+        Position.new(Board.new(squares), side, castle, enp_target, halfmove_clock)
+      end
+
+      # Yields each position with its score and result (nil if not stored).
+      def each
+        count.times do |i|
+          squares, side, castle, enp_target, halfmove_clock, fullmove, score, result = entry(i)
+          yield Position.new(Board.new(squares), side, castle, enp_target, halfmove_clock), score, result
+        end
+      end
+
+      # Yields [packed boards, results] for each run of up to size records, in the formats taken by 
+      # Evaluation::evaluate_batch and Tuner::Dataset.
+      def each_batch(size=BATCH_SIZE)
+        (0...count).step(size) { |start| yield batch(start, [size, count - start].min) }
+      end
+    end
+  end
+end
@@ -21,6 +21,7 @@
 
 require './lib/pieces.rb'
 require './lib/evaluation.rb'
+require './lib/search_analytics.rb'
 
 module Chess
   module Search # this module defines tree traversal algorithms for move selection.
@@ -45,6 +46,12 @@ module Chess
     MATE = Pieces::MATE/Evaluation::EVAL_GRAIN
 
     KING_LOSS = Pieces::KING_LOSS/Evaluation::EVAL_GRAIN
+
+    TB_WIN = MATE/2  # Tablebase wins are scored below mate, but above any heuristic evaluation.
+
+    MATE_NODES = 5_000_000  # default limit on the positions visited by mate_search.
+
+    INSTRUMENT = Analytics::INSTRUMENT  # Native search counters are updated only when instrumentation is enabled.
     
     F_MARGIN_HIGH = Pieces::PIECE_VALUES[:Q]/Evaluation::EVAL_GRAIN   
     F_MARGIN_MID = Pieces::PIECE_VALUES[:R]/Evaluation::EVAL_GRAIN    
@@ -63,7 +70,7 @@ module Chess
     #     to be cut off cleanly without risk of serious tactical blunders.
     def self.iterative_deepening(depth)
       best_move, guess, value = nil, nil, -$INF
-      search_records = [] if @verbose
+      search_records, counter_records = [], [] if @verbose
       first_total = 0.0
       (1..depth).each do |d|
         @i_depth = d
@@ -75,9 +82,14 @@ module Chess
         # Save some performance data about the search.
         first_total = $quiescence_calls + $main_calls if d == 1
         record = Analytics::SearchRecord.new(d, value, $passes, $main_calls, $quiescence_calls, 
-                                             $evaluation_calls, $memory_calls, previous_total, first_total)
+                                             $evaluation_calls, $memory_calls, $tb_hits, previous_total, first_total)
         search_records << record if @verbose
         @aggregator.aggregate(record) unless @aggregator.nil?
+        if INSTRUMENT
+          counters = Analytics::CounterRecord.take(d, $tt)
+          counter_records << counters if @verbose
+          @aggregator.aggregate_counters(counters) unless @aggregator.nil?
+        end
 
         guess = value
         if Chess::current_game.clock.time_up?
@@ -88,6 +100,7 @@ module Chess
       if @verbose 
         puts "\n"
         tp search_records  # Print out performance data as a table when in verbose mode.
+        tp counter_records if INSTRUMENT
       end
       return best_move, value
     end
@@ -322,6 +335,18 @@ module Chess
     def self.alpha_beta(depth, draft, alpha=-$INF, beta=$INF, extension=0, can_null=true)
       result, best_move = -$INF, nil
 
+      # A position repeated since the last irreversible move is scored as a draw, pruning the repeated subtree.
+      return 0, 1 if @node.repetition?
+
+      # Probe the endgame tablebases after each capture or pawn move, once few enough pieces remain.
+      if @node.halfmove_clock == 0 && Tablebase::probe?(@node)
+        wdl = Tablebase::wdl(@node)
+        unless wdl.nil?
+          $tb_hits += 1
+          return Tablebase::score(wdl, draft), 1
+        end
+      end
+
       return quiescence(0, draft, alpha, beta) if depth+extension < PLY_VALUE
 
       in_check = @node.in_check?
@@ -333,15 +358,17 @@ module Chess
 
       # Null Move Pruning
       if !in_check && can_null && adjusted_depth > TWO_PLY && !@node.in_endgame? && @node.value >= beta
-        enp, reduction = @node.enp_target, TWO_PLY
+        enp, reduction, halfmove_clock = @node.enp_target, TWO_PLY, @node.halfmove_clock
         MoveGen::flip_null(@node, enp)
-        @node.enp_target = nil
+        # The null move isn't recorded in the key stack, so start a new repetition window below it.
+        @node.enp_target, @node.halfmove_clock = nil, 0
         value, count = alpha_beta(depth-PLY_VALUE-reduction, draft+1, -beta, -beta+1, extension, false)
         value *= -1       
         MoveGen::flip_null(@node, enp)
-        @node.enp_target = enp
+        @node.enp_target, @node.halfmove_clock = enp, halfmove_clock
 
         if value >= beta
+          instrument(Analytics::Counters::NULL_PRUNES) if INSTRUMENT
           $tt.store(@node, adjusted_depth, count, value, alpha, beta, nil)
           return value, count 
         end
@@ -349,6 +376,7 @@ module Chess
 
       # Internal Iterative Deepening (IID)
       if first_move.nil? && depth >= @iid_minimum
+        instrument(Analytics::Counters::IID_CALLS) if INSTRUMENT
         first_move, value = internal_iterative_deepening_alpha_beta(depth-THREE_PLY, alpha, beta, extension)
       end
 
@@ -370,6 +398,7 @@ module Chess
           alpha = result
           best_move = first_move
           if result >= beta
+            instrument(Analytics::Counters::FIRST_CUTOFFS, Analytics::Counters::CUT_NODES) if INSTRUMENT
             store_cutoff(first_move, adjusted_depth, count, in_check)
             return $tt.store(@node, adjusted_depth, sum, result, alpha, beta, first_move)
           end
@@ -385,7 +414,11 @@ module Chess
       moves.each do |move|
         # Prune any illegal moves.  
         # If futility pruning flag is set, also prune moves that don't alter material balance or give check.
-        next if !@node.avoids_check?(move, in_check) || (f_prune && legal_moves && move.quiet? && !@node.gives_check?(move))
+        next unless @node.avoids_check?(move, in_check)
+        if f_prune && legal_moves && move.quiet? && !@node.gives_check?(move)
+          instrument(Analytics::Counters::FUTILITY_PRUNES) if INSTRUMENT
+          next
+        end
 
         MoveGen::make!(@node, move)
         value, count = alpha_beta(depth-PLY_VALUE, draft+1, -beta, -alpha, extension)
@@ -394,18 +427,25 @@ module Chess
         $main_calls += 1
         result = Chess::max(-value, result)
         sum += count
+        first = !legal_moves if INSTRUMENT
         legal_moves = true
 
         if result > alpha
           alpha = result
           best_move = move
           if result >= beta
+            instrument(first ? Analytics::Counters::FIRST_CUTOFFS : Analytics::Counters::LATE_CUTOFFS) if INSTRUMENT
             store_cutoff(move, adjusted_depth, count, in_check)
             break
           end
         end  
       end
 
+      if INSTRUMENT
+        instrument(result >= beta ? Analytics::Counters::CUT_NODES : 
+                   (best_move.nil? ? Analytics::Counters::ALL_NODES : Analytics::Counters::PV_NODES))
+      end
+
       unless legal_moves  # if no legal moves available, it's either a draw or checkmate.
         result = in_check ? ((@i_depth - adjusted_depth/PLY_VALUE) - MATE) : 0 # mate in 1 is more valuable than mate in 2
       end
@@ -419,6 +459,7 @@ module Chess
 
       result, best_move, sum = -$INF, nil, 1
       legal_moves = false
+      Analytics::Counters::add_q_depth(-depth/PLY_VALUE) if INSTRUMENT
 
       in_check = @node.in_check?
 
@@ -467,7 +508,11 @@ module Chess
       @node.get_captures(in_check).each do |move|
         $quiescence_calls += 1
 
-        next if !@node.avoids_check?(move, in_check) || (f_prune && !move.promotion? && !@node.gives_check?(move))
+        next unless @node.avoids_check?(move, in_check)
+        if f_prune && !move.promotion? && !@node.gives_check?(move)
+          instrument(Analytics::Counters::FUTILITY_PRUNES) if INSTRUMENT
+          next
+        end
 
         MoveGen::make!(@node, move)
         value, count = quiescence(depth-PLY_VALUE, draft+1, -beta, -alpha)
@@ -499,7 +544,12 @@ module Chess
     end
 
     def self.reset_counters
-      $main_calls, $quiescence_calls, $evaluation_calls, $memory_calls, $passes = 0, 0, 0, 0, 0
+      $main_calls, $quiescence_calls, $evaluation_calls, $memory_calls, $passes, $tb_hits = 0, 0, 0, 0, 0, 0
+      Analytics::Counters::reset if INSTRUMENT
+    end
+
+    def self.instrument(*stats)  # only called when instrumentation is enabled.
+      stats.each { |stat| Analytics::Counters::add(stat) }
     end
 
     def self.clear_memory
@@ -511,16 +561,19 @@ module Chess
 
     # Module interface
 
-    def self.select_move(node, max_ply=6, aggregator=nil, verbose=true)
+    # The search tables are cleared before each search unless clear is false, as when the analysis server keeps them 
+    # warm across related positions.
+    def self.select_move(node, max_ply=6, aggregator=nil, verbose=true, clear=true)
       Chess::current_game.clock.restart
       @node, @max_depth, @aggregator, @verbose = node, max_ply*PLY_VALUE, aggregator, verbose
       @iid_minimum = Chess::max(@max_depth-THREE_PLY, FOUR_PLY)
       @max_side = @node.side_to_move
       
       reset_counters
-      clear_memory
+      clear_memory if clear
 
-      move, value = block_given? ? yield : iterative_deepening_alpha_beta
+      move, value = Tablebase::select_move(@node) if Tablebase::probe?(@node)  # DTZ tables choose root moves.
+      move, value = (block_given? ? yield : iterative_deepening_alpha_beta) if move.nil?
 
       if @verbose && !move.nil? 
         puts "Move chosen: #{move.print}, Score: #{value}, TT size: #{$tt.size}"
@@ -528,6 +581,30 @@ module Chess
       return move, value
     end 
 
+    # Looks for a forced mate by the side to move with proof-number search (see ext/mate_search.c), visiting at most 
+    # max_nodes positions.  Unlike select_move, no depth is given: the search proves or refutes the mate best-first.
+    # Returns the mating line as an array of moves, or nil if no mate was proven.  The line is replayed on node 
+    # before it is returned, and is only accepted if every move is legal here and it ends in checkmate.
+    def self.mate_search(node, max_nodes=MATE_NODES)
+      line, nodes = MateSearch::search(node.pieces, node.side_to_move, node.castle, node.enp_target, max_nodes)
+      return nil if line.nil?
+      moves = []
+      line.each do |from, to, promoted_type|
+        in_check = node.in_check?
+        move = node.get_moves(0, false, in_check).find do |m|
+          m.from == from && m.to == to && node.avoids_check?(m, in_check) &&
+            (m.promoted_piece.nil? ? promoted_type.nil? : Notation::piece_type(m.promoted_piece) == promoted_type)
+        end
+        break if move.nil?
+        MoveGen::make!(node, move)
+        moves << move
+      end
+      mated = moves.length == line.length && node.in_check? && 
+              node.get_moves(0, false, true).none? { |m| node.avoids_check?(m, true) }
+      moves.reverse_each { |move| MoveGen::unmake!(node, move) }
+      mated ? moves : nil
+    end
+
   end
 end
 
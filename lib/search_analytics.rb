@@ -22,13 +22,94 @@
 module Chess
   module Analytics
 
+    # When the CHESS_INSTRUMENT environment variable is set, the search updates a set of native counters (see 
+    # search_stats.c) as it goes, and a CounterRecord is taken for each iteration.  When it isn't set, the checks on 
+    # this constant are the only overhead.
+    INSTRUMENT = !ENV['CHESS_INSTRUMENT'].nil?
+
+    class CounterRecord
+      attr_reader :depth, :hashfull
+
+      # hashfull is the number of TT entries per thousand slots, when the TT size is limited.
+      def initialize(depth, counts=Array.new(Counters::ALL_NODES+1, 0), q_depths=Array.new(Counters::Q_DEPTH_MAX, 0), 
+                     hashfull=nil)
+        @depth, @counts, @q_depths, @hashfull = depth, counts, q_depths, hashfull
+      end
+
+      # Takes a record of the counters accumulated since the last reset.
+      def self.take(depth, tt)
+        hashfull = tt.max_size.nil? ? nil : tt.size*1000/tt.max_size
+        new(depth, Counters::counts, Counters::q_depths, hashfull)
+      end
+
+      def merge!(other)
+        @counts = @counts.each_with_index.collect { |n, i| n + other.count(i) }
+        @q_depths = @q_depths.each_with_index.collect { |n, i| n + other.q_depth_count(i) }
+        @hashfull = [@hashfull, other.hashfull].compact.max
+      end
+
+      def count(stat)
+        @counts[stat]
+      end
+
+      def q_depth_count(ply)
+        @q_depths[ply]
+      end
+
+      def tt_probes
+        count(Counters::TT_PROBES)
+      end
+
+      def tt_hit_rate
+        percent(count(Counters::TT_HITS), tt_probes)
+      end
+
+      def tt_cutoff_rate
+        percent(count(Counters::TT_CUTOFFS), tt_probes)
+      end
+
+      # Percentage of beta cutoffs caused by the first move searched.  Good move ordering keeps this high.
+      def first_cutoff_rate
+        percent(count(Counters::FIRST_CUTOFFS), count(Counters::FIRST_CUTOFFS) + count(Counters::LATE_CUTOFFS))
+      end
+
+      def null_prunes
+        count(Counters::NULL_PRUNES)
+      end
+
+      def futility_prunes
+        count(Counters::FUTILITY_PRUNES)
+      end
+
+      def iid_calls
+        count(Counters::IID_CALLS)
+      end
+
+      # Node types are shown as PV/CUT/ALL counts.
+      def node_types
+        "#{count(Counters::PV_NODES)}/#{count(Counters::CUT_NODES)}/#{count(Counters::ALL_NODES)}"
+      end
+
+      # Quiescence nodes by number of plies below the horizon.
+      def q_depths
+        @q_depths[0..(@q_depths.rindex { |n| n > 0 } || 0)].join('/')
+      end
+
+      private 
+
+      def percent(n, total)
+        total == 0 ? 0.0 : (100.0*n/total).round(1)
+      end
+    end
+
     class SearchRecord
       attr_accessor :depth, :score, :passes, :m_nodes, :q_nodes,
-                    :evals, :memory, :eff_branching, :avg_eff_branching
+                    :evals, :memory, :tb_hits, :eff_branching, :avg_eff_branching
 
-      def initialize(depth, score, passes, m_nodes, q_nodes, evals, memory, previous_total=0.0, first_total=0.0)
+      def initialize(depth, score, passes, m_nodes, q_nodes, evals, memory, tb_hits=0, previous_total=0.0, 
+                     first_total=0.0)
         @depth, @score, @passes, @m_nodes = depth, score, passes, m_nodes
-        @q_nodes, @evals, @memory = q_nodes, evals, memory
+        @q_nodes, @evals, @memory, @tb_hits = q_nodes, evals, memory, tb_hits
         @eff_branching = previous_total == 0.0 ? 0.0 : all_nodes.to_f/previous_total
         @avg_eff_branching = depth == 1 ? 0.0 : (all_nodes.to_f/first_total)**(1r/(depth-1)) 
       end
@@ -39,6 +120,7 @@ module Chess
         @q_nodes += other.q_nodes
         @evals += other.evals
         @memory += other.memory
+        @tb_hits += other.tb_hits
         @score, @eff_branching, @avg_eff_branching = nil, 0.0, 0.0
       end
 
@@ -50,13 +132,31 @@ module Chess
 
     class Aggregator
       def initialize(max_depth)
-        @data = (1..max_depth).collect { |d| SearchRecord.new(d, nil, 0, 0, 0, 0, 0, 0.0) }
+        @data = (1..max_depth).collect { |d| SearchRecord.new(d, nil, 0, 0, 0, 0, 0, 0, 0.0) }
+        @counters = (1..max_depth).collect { |d| CounterRecord.new(d) } if INSTRUMENT
       end
 
       def aggregate(record)
         @data[record.depth-1].merge!(record)
       end
 
+      def aggregate_counters(record)
+        @counters[record.depth-1].merge!(record)
+      end
+
+      def merge!(other) # combines the statistics gathered by another aggregator, e.g. from a worker process.
+        other.records.each { |record| aggregate(record) }
+        other.counter_records.each { |record| aggregate_counters(record) } if INSTRUMENT
+      end
+
+      def records
+        @data
+      end
+
+      def counter_records
+        @counters
+      end
+
       def refresh # recalculates branching factor statistics.
         previous_total = 0.0
         initial = @data[0].all_nodes
@@ -71,6 +171,10 @@ module Chess
         refresh
         puts "\n\n------ Aggregate Search Performance -------\n\n"
         tp @data
+        if INSTRUMENT
+          puts "\n\n------ Aggregate Search Counters -------\n\n"
+          tp @counters
+        end
       end
 
       def print_summary(accuracy=nil, time=nil)
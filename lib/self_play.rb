@@ -0,0 +1,76 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'etc'
+require './ext/ruby_chess'
+
+module Chess
+  module SelfPlay
+    # Generates labeled training positions by self-play in the native extension (self_play.c).  Games are played 
+    # concurrently, one per thread, each by a private engine searching a fixed number of nodes (and/or plies) per 
+    # move, after a few random opening plies.  Every quiet position is written to a position file (see PositionFile) 
+    # with its search score, from the side to move's perspective, and the game's result:
+    #
+    #   Chess::SelfPlay.generate('./selfplay.bin', 1000, nodes: 5000, threads: 8)
+    #   Chess::Tuner.new.load_packed('./selfplay.bin').run
+    #
+    # Games are seeded by their index, so a given seed produces the same games whatever the number of threads.
+    #
+    # The private engine is not the engine being tuned.  It has its own Zobrist keys, move generator and search (PVS
+    # with null move pruning, LMR and a capture search), sharing only the attack tables, evaluation and network with 
+    # Search.  Scores, and so the labels, come from that search rather than from Search::select_move, and its games 
+    # include rook and bishop promotions, which MoveGen doesn't generate.  Its move generator is checked by perft 
+    # against MoveGen and against published counts (see self_play_spec.rb).
+
+    GAMES = 100
+    NODES = 5000
+    RANDOM_PLIES = 8
+    HASH_BITS = 18  # 2^18 table entries (4 MB) per engine.
+
+    DEFAULTS = { nodes: NODES, depth: 0, threads: Etc.nprocessors, random_plies: RANDOM_PLIES, seed: nil,
+                 hash_bits: HASH_BITS, verbose: true }
+
+    def self.generate(path, games=GAMES, options={})
+      options = DEFAULTS.merge(options)
+      seed = options[:seed] || rand(2**32)
+      start = Time.now
+      positions, black_wins, draws, white_wins, nodes = PositionFile::Writer.open(path) do |writer|
+        play_games(writer, games, options[:threads], options[:nodes], options[:depth], options[:random_plies], 
+                   seed, options[:hash_bits])
+      end
+      elapsed = Time.now - start
+      stats = { games: games, positions: positions, white_wins: white_wins, draws: draws, black_wins: black_wins, 
+                nodes: nodes, seed: seed, time: elapsed }
+      print_stats(stats) if options[:verbose]
+      stats
+    end
+
+    def self.print_stats(stats)
+      puts "\n==========================="
+      puts "Games          : #{stats[:games]} (+#{stats[:white_wins]} =#{stats[:draws]} -#{stats[:black_wins]})"
+      puts "Positions      : #{stats[:positions]}"
+      puts "Nodes searched : #{stats[:nodes]}"
+      puts "Total time (s) : #{stats[:time].round(1)}"
+      puts "Positions/sec  : #{(stats[:positions] / stats[:time]).round}"
+      puts "Nodes/second   : #{(stats[:nodes] / stats[:time]).round}"
+    end
+  end
+end
@@ -0,0 +1,92 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+module Chess
+  module Tablebase
+    # Syzygy endgame tablebases are probed by the native extension (tablebase.c).  Tables are located by material 
+    # signature (e.g. KRvK.rtbw) in the directories passed to Tablebase::init, and each table file is memory-mapped 
+    # the first time it is probed.
+    #
+    #   1. WDL (win/draw/loss) tables are probed during search just after captures and pawn moves, once few enough 
+    #      pieces remain. The subtree below a successful probe need not be searched.
+    #   2. DTZ (distance to zeroing move) tables are used to choose moves at the root, so that won endgames are 
+    #      converted without running afoul of the Halfmove Rule.
+    #
+    # Tables can be loaded at startup by setting the SYZYGY_PATH environment variable.
+
+    def self.init(path)
+      @path = path
+      @max_pieces = load_tables(path)
+    end
+
+    # The directories the tables were loaded from, or nil if none are loaded.
+    def self.path
+      @path
+    end
+
+    def self.enabled?
+      @max_pieces.to_i > 0
+    end
+
+    # Tables don't cover positions where castling is still possible.
+    def self.probe?(pos)
+      enabled? && pos.castle == 0
+    end
+
+    # Returns the WDL value of the position for the side to move (2 for a win, 0 for a draw, -2 for a loss), or 
+    # nil if the position can't be probed.  Cursed wins (1) and blessed losses (-1) are drawn under the Halfmove Rule.
+    def self.wdl(pos)
+      probe_wdl(pos.pieces, pos.side_to_move, pos.enp_target)
+    end
+
+    # Converts a WDL value to a search score.  Tablebase wins are valued below mate scores but above any 
+    # heuristic score, and nearer wins are preferred.
+    def self.score(wdl, draft)
+      case wdl
+      when 2 then Search::TB_WIN - draft
+      when -2 then draft - Search::TB_WIN
+      else 0
+      end
+    end
+
+    # Chooses the best root move according to DTZ.  Returns the move and its score, or nil if the position can't 
+    # be probed.
+    def self.select_move(pos)
+      ranked = probe_root(pos.pieces, pos.side_to_move, pos.enp_target, pos.halfmove_clock)
+      return nil if ranked.nil?
+      in_check = pos.in_check?
+      moves = pos.get_moves(0, false, in_check).select { |m| pos.avoids_check?(m, in_check) }
+      ranked.sort_by { |entry| -entry.last }.each do |from, to, promoted_type, dtz, rank|
+        move = moves.find do |m| 
+          m.from == from && m.to == to && 
+            (m.promoted_piece.nil? ? promoted_type.nil? : Notation::piece_type(m.promoted_piece) == promoted_type)
+        end
+        next if move.nil?  # underpromotions to rook or bishop are not generated.
+        value = dtz > 0 ? Search::TB_WIN - dtz : (dtz < 0 ? -Search::TB_WIN - dtz : 0)
+        return move, value
+      end
+      nil
+    end
+
+    init(ENV['SYZYGY_PATH']) if ENV['SYZYGY_PATH']
+
+  end
+end
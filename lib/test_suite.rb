@@ -0,0 +1,172 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'etc'
+
+module Chess
+  module Analytics
+    # Runs an EPD test suite (e.g. wac_300.epd) and scores the engine's answers against each problem's best move (bm) 
+    # and avoid move (am) fields.  Problems are handed out to a pool of worker processes one at a time as each worker 
+    # becomes free, so a few slow problems don't hold up the rest of the suite.  Since each worker is a separate 
+    # process, it searches with its own transposition, killer and history tables.  Search statistics from every 
+    # worker are collected into a single Aggregator.
+
+    class TestSuite
+      Problem = Struct.new(:id, :epd, :best_moves, :avoid_moves, :ai_response, :score)
+
+      attr_reader :problems, :aggregator, :time
+
+      def initialize(file)
+        raise "test suite #{file} not found" unless File.exist?(file)
+        @problems = EPDFile::Reader.open(file) do |r|
+          (0...r.count).collect { |i| Problem.new(r.id(i) || '', r.line(i), r.best_moves(i), r.avoid_moves(i)) }
+        end
+      end
+
+      def run(depth, workers=Etc.nprocessors, verbose=false)
+        @aggregator = Aggregator.new(depth)
+        t0 = Time.now
+        workers = Chess::min(workers, @problems.count)
+        if workers > 1
+          run_parallel(depth, workers, verbose)
+        else
+          run_serial(depth, verbose)
+        end
+        @time = Time.now - t0
+        self
+      end
+
+      def correct
+        @problems.inject(0) { |total, prob| total + prob.score.to_i }
+      end
+
+      def accuracy
+        (correct+0.0)/@problems.count*100
+      end
+
+      # An answer is correct if it matches any of the best moves, and does not match any of the avoid moves.
+      def self.score(problem, move)
+        return 0 if move.nil?
+        pos = Notation::epd_to_position(problem.epd)
+        return 1 if problem.best_moves.any? { |san| matches?(pos, move, san) }
+        return 0 if problem.avoid_moves.any? { |san| matches?(pos, move, san) }
+        problem.best_moves.empty? ? 1 : 0
+      end
+
+      def self.matches?(pos, move, san)
+        expected = Notation::san_to_move(pos, san)
+        expected.from == move.from && expected.to == move.to && expected.promoted_piece == move.promoted_piece
+      rescue Notation::InvalidMoveError
+        false
+      end
+
+      private
+
+      def solve(prob, depth, verbose)
+        move, value = Search::select_move(Notation::epd_to_position(prob.epd), depth, @aggregator, verbose)
+        move
+      end
+
+      def record(i, move, verbose)
+        prob = @problems[i]
+        prob.ai_response = move
+        prob.score = TestSuite.score(prob, move)
+        if verbose
+          puts "#{prob.id}  Best: #{prob.best_moves} Avoid: #{prob.avoid_moves} AI Answer: #{move}"
+        else
+          number = (i+1).to_s.rjust(3," ")
+          print "| #{Chess::colorize(number, prob.score > 0 ? 32 : 31)} "
+        end
+      end
+
+      def run_serial(depth, verbose)
+        @problems.each_with_index { |prob, i| record(i, solve(prob, depth, verbose), verbose) }
+      end
+
+      # Each worker reads problem indices from its own pipe and writes back its answers.  A worker is sent its next 
+      # problem only once it has answered the last one.  On receiving nil, a worker sends back its search statistics 
+      # and exits.  If a worker dies before answering, the remaining workers are stopped and the problem it was 
+      # working on is reported.
+      def run_parallel(depth, workers, verbose)
+        pool = (0...workers).collect do 
+          tasks, task_writer = IO.pipe
+          result_reader, results = IO.pipe
+          pid = fork do
+            task_writer.close
+            result_reader.close
+            until (i = Marshal.load(tasks)).nil?
+              Marshal.dump([i, solve(@problems[i], depth, verbose)], results)
+              results.flush
+            end
+            Marshal.dump(@aggregator, results)
+            results.flush
+            exit!(0)
+          end
+          tasks.close
+          results.close
+          [pid, task_writer, result_reader]
+        end
+        queue = (0...@problems.count).to_a
+        assigned = {}
+        pool.each { |pid, writer, reader| assigned[reader] = assign(writer, queue.shift) }
+        busy = pool.collect { |worker| worker[2] }
+        until busy.empty?
+          IO.select(busy)[0].each do |reader|
+            pid, writer, _ = pool.find { |worker| worker[2] == reader }
+            message = receive(pool, pid, reader, assigned[reader])
+            if message.is_a?(Aggregator)
+              @aggregator.merge!(message)
+              busy.delete(reader)
+              reader.close
+              Process.wait(pid)
+            else
+              record(*message, verbose)
+              assigned[reader] = assign(writer, queue.shift)
+            end
+          end
+        end
+      end
+
+      def assign(writer, i)
+        Marshal.dump(i, writer)
+        writer.flush
+        writer.close if i.nil?
+        i
+      end
+
+      def receive(pool, pid, reader, i)
+        Marshal.load(reader)
+      rescue EOFError
+        status = Process.wait2(pid)[1]
+        others = pool.collect(&:first) - [pid]
+        others.each do |other| 
+          Process.kill(:KILL, other)
+          Process.wait(other)
+        rescue Errno::ESRCH, Errno::ECHILD
+        end
+        task = i ? "problem #{@problems[i].id}" : "sending its search statistics"
+        raise "test suite worker #{pid} died (#{status}) during #{task}"
+      end
+
+    end
+
+  end
+end
@@ -0,0 +1,89 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'etc'
+require './ext/ruby_chess'
+
+module Chess
+  class Tuner
+    # Tunes the hand-set evaluation weights (eval_params.c) against positions labeled with game results, using the 
+    # native Texel tuner (tuner.c).  Positions are added one at a time or loaded from EPD files, where each line 
+    # carries the result as c9 "1-0", [1.0] or similar.  Parsed positions can be saved as a position file (see 
+    # PositionFile), which loads without any parsing:
+    #
+    #   tuner = Chess::Tuner.new
+    #   tuner.load_epd('./quiet-labeled.epd')
+    #   tuner.save_packed('./quiet-labeled.bin')
+    #   tuner.run
+    #   tuner.write  # writes the tuned tables in the format of ext/eval_params.c
+
+    ITERATIONS = 1000
+    LEARNING_RATE = 1.0
+    DEFAULT_OUTPUT = './eval_params_tuned.c'
+
+    attr_reader :scale, :error
+
+    def initialize(threads=Etc.nprocessors)
+      @threads = threads
+      @records = ''.b
+    end
+
+    def size
+      @records.bytesize / PositionFile::RECORD_SIZE
+    end
+
+    # Adds a position, with result 2 if white won, 1 for a draw, and 0 if black won.
+    def add(pos, result)
+      @records << PositionFile::pack(pos.pieces, pos.side_to_move, pos.castle, pos.enp_target, pos.halfmove_clock, 
+                                     1, nil, result)
+    end
+
+    # Lines without a result are skipped.
+    def load_epd(path)
+      EPDFile::Reader.open(path) { |r| @records << r.labeled_records }
+      self
+    end
+
+    def save_packed(path)
+      PositionFile::Writer.open(path) { |w| w.add_records(@records) }
+    end
+
+    def load_packed(path)
+      PositionFile::Reader.open(path) { |r| @records << r.records(0, r.count) }
+      self
+    end
+
+    # Fits the scaling constant K to the current weights, then tunes the weights and applies them to the engine's 
+    # evaluation.  Returns the error before and after tuning.
+    def run(iterations=ITERATIONS, rate=LEARNING_RATE)
+      dataset = Dataset.new(*PositionFile::unpack_records(@records), @threads)
+      @scale = dataset.fit_scale
+      initial_error = dataset.error(@scale)
+      @error = dataset.tune(@scale, iterations, rate)
+      dataset.apply
+      return initial_error, @error
+    end
+
+    def write(path=DEFAULT_OUTPUT)
+      Evaluation::write_params(path)
+    end
+  end
+end
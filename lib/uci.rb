@@ -0,0 +1,134 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+module Chess
+  module UCI
+    # A minimal Universal Chess Interface driver, so that the engine can be run by a GUI or by the match runner 
+    # (see Match).  Start it with `ruby uci.rb`.  Supported commands are uci, isready, ucinewgame, setoption, 
+    # position and go (with depth, movetime or wtime/btime/winc/binc), and quit.  Options:
+    #
+    #   Depth       - maximum search depth in plies.
+    #   EvalFile    - path of an NNUE network to load, or <empty> to use the hand-set evaluation.
+    #   SyzygyPath  - directory holding Syzygy endgame tables.
+    #   OwnBook     - play from the opening book while in book.
+    #
+    # The search only checks the clock between iterations, and the next iteration usually takes several times as 
+    # long as the last.  Under a time control, each move is therefore given a soft limit of a fraction of its 
+    # allotted time, after which no new iteration is started.
+
+    NAME = 'RubyChess'
+    AUTHOR = 'Stephen J. Lovell'
+    MAX_DEPTH = 20
+    MOVES_TO_GO = 30     # moves the remaining time is spread over, when the time control doesn't say.
+    SOFT_LIMIT = 0.3     # fraction of a move's time after which no new iteration is started.
+    PROMOTION_TYPES = 'pnbrq'
+
+    def self.move_to_uci(move)
+      str = Location::sq_to_s(move.from) + Location::sq_to_s(move.to)
+      str += PROMOTION_TYPES[Notation::piece_type(move.promoted_piece)] unless move.promoted_piece.nil?
+      str
+    end
+
+    def self.legal_moves(pos)
+      in_check = pos.in_check?
+      pos.get_moves(0, false, in_check).select { |m| pos.avoids_check?(m, in_check) }
+    end
+
+    # Returns the legal move in pos given by str in long algebraic notation (e.g. e2e4, e7e8q), or nil.
+    def self.uci_to_move(pos, str)
+      legal_moves(pos).find { |m| move_to_uci(m) == str }
+    end
+
+    # Parses the arguments of a position command: "startpos" or "fen <fen>", optionally followed by "moves ...".
+    def self.parse_position(args)
+      moves_index = args.index('moves') || args.count
+      pos = args.first == 'fen' ? Notation::fen_to_position(args[1...moves_index].join(' ')) : Position.new
+      args[moves_index+1..-1].to_a.each do |str|
+        move = uci_to_move(pos, str)
+        raise Notation::InvalidMoveError, "illegal move: #{str}" if move.nil?
+        MoveGen::make!(pos, move)
+      end
+      pos
+    end
+
+    # Returns the depth and time limit (in seconds) for a go command.
+    def self.search_limits(pos, args, max_depth)
+      params = Hash[args.each_slice(2).collect { |k, v| [k, v.to_i] }]
+      side = pos.side_to_move.to_s
+      depth = params['depth'] || max_depth
+      if params['movetime']
+        time = params['movetime'] / 1000.0
+      elsif params["#{side}time"]
+        moves_to_go = params['movestogo'] || MOVES_TO_GO
+        time = SOFT_LIMIT * (params["#{side}time"] / moves_to_go + params["#{side}inc"].to_i * 0.75) / 1000.0
+      else
+        time = $INF
+      end
+      return depth, time
+    end
+
+    def self.run(input=$stdin, output=$stdout)
+      output.sync = true
+      output.flush  # anything buffered before sync was set (e.g. load messages) would otherwise hold back replies.
+      pos, max_depth, own_book = Position.new, MAX_DEPTH, false
+      input.each_line do |line|
+        args = line.split
+        case args.shift
+        when 'uci'
+          output.puts "id name #{NAME}", "id author #{AUTHOR}"
+          output.puts "option name Depth type spin default #{MAX_DEPTH} min 1 max 64"
+          output.puts "option name EvalFile type string default <empty>"
+          output.puts "option name SyzygyPath type string default <empty>"
+          output.puts "option name OwnBook type check default false"
+          output.puts "option name AttackMaps type check default false"
+          output.puts 'uciok'
+        when 'isready'
+          output.puts 'readyok'
+        when 'ucinewgame'
+          Search::clear_memory
+        when 'setoption'
+          name = args[1...(args.index('value') || args.count)].join(' ')
+          value = args.index('value') ? args[args.index('value')+1..-1].join(' ') : nil
+          case name
+          when 'Depth' then max_depth = value.to_i
+          when 'EvalFile' then value == '<empty>' ? Evaluation::unload_network : Evaluation::load_network(value)
+          when 'SyzygyPath' then Tablebase::init(value) unless value == '<empty>'
+          when 'OwnBook' then own_book = value == 'true'
+          when 'AttackMaps' then Bitboard::attack_maps = value == 'true'
+          end
+        when 'position'
+          pos = parse_position(args)
+        when 'go'
+          depth, time = search_limits(pos, args, max_depth)
+          move = Book::select_move(pos) if own_book
+          if move.nil?
+            Chess::current_game = Game.new(FLIP_COLOR[pos.side_to_move], time)
+            move, value = Search::select_move(pos, depth, nil, false)
+          end
+          output.puts "info score cp #{value.to_i}"
+          output.puts "bestmove #{move ? move_to_uci(move) : '0000'}"
+        when 'quit'
+          break
+        end
+      end
+    end
+  end
+end
@@ -102,6 +102,39 @@ module Chess
       return move
     end
 
+    SAN_PIECES = { 'N' => 1, 'B' => 2, 'R' => 3, 'Q' => 4, 'K' => 5 }  # piece types, as used by the extension.
+    SAN_FORMAT = /\A([NBRQK])?([a-h])?([1-8])?x?([a-h][1-8])(?:=?([NBRQ]))?\z/
+
+    # Create a move object from Standard Algebraic Notation (used by PGN). Examples: e4, Nbd7, exd5, R1e2, e8=Q,
+    # O-O.  Check and annotation suffixes are ignored.
+    def self.san_to_move(pos, san)
+      san = san.sub(/[+#!?]+\z/, '')
+      in_check = pos.in_check?
+      moves = pos.get_moves(0, false, in_check).select { |m| pos.avoids_check?(m, in_check) }
+      if san == 'O-O' || san == '0-0' || san == 'O-O-O' || san == '0-0-0'
+        offset = san.length == 3 ? 2 : -2
+        candidates = moves.select { |m| piece_type(m.piece) == 5 && m.to - m.from == offset }
+      else
+        match = SAN_FORMAT.match(san)
+        raise InvalidMoveError, "invalid SAN move: #{san}" if match.nil?
+        type = match[1] ? SAN_PIECES[match[1]] : 0
+        to = Location::SQUARES[match[4].to_sym]
+        promoted_type = match[5] && SAN_PIECES[match[5]]
+        candidates = moves.select do |m|
+          m.to == to && piece_type(m.piece) == type &&
+            (match[2].nil? || Location::sq_to_s(m.from)[0] == match[2]) &&
+            (match[3].nil? || Location::sq_to_s(m.from)[1] == match[3]) &&
+            (m.promoted_piece.nil? ? promoted_type.nil? : piece_type(m.promoted_piece) == promoted_type)
+        end
+      end
+      raise InvalidMoveError, "illegal or ambiguous SAN move: #{san}" unless candidates.count == 1
+      candidates.first
+    end
+
+    def self.piece_type(id)
+      (id & 0xe) >> 1
+    end
+
     SYM_TO_FEN = { wP: 'P', wN: 'N', wB: 'B', wR: 'R', wQ: 'Q', wK: 'K',
                    bP: 'p', bN: 'n', bB: 'b', bR: 'r', bQ: 'q', bK: 'k' }
 
@@ -0,0 +1,75 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'spec_helper'
+require 'tmpdir'
+
+describe Chess::AnalysisServer do
+
+  let(:path) { File.join(Dir.tmpdir, 'analysis_server_spec.sock') }
+
+  def with_server
+    server = Chess::AnalysisServer.new(path, 2, 3)
+    thread = Thread.new { server.run }
+    sleep 0.01 until File.socket?(path)
+    yield
+  ensure
+    server.stop
+    thread.join
+  end
+
+  it "should answer searches with a legal move, score and principal variation" do
+    with_server do
+      reply = Chess::AnalysisServer.request('go depth 2 startpos moves e2e4', path)
+      pos = Chess::UCI::parse_position(%w(startpos moves e2e4))
+      Chess::UCI::uci_to_move(pos, reply['bestmove']).nil?.should == false
+      reply['pv'].first.should == reply['bestmove']
+      reply['score'].is_a?(Integer).should == true
+      reply['nodes'].should > 0
+    end
+  end
+
+  it "should keep the transposition table warm between requests" do
+    with_server do
+      Chess::AnalysisServer.request('newgame', path)
+      first = Chess::AnalysisServer.request('go depth 3 startpos', path)
+      second = Chess::AnalysisServer.request('go depth 3 startpos', path)
+      second['tt_size'].should >= first['tt_size']
+      second['nodes'].should < first['nodes']
+      Chess::AnalysisServer.request('newgame', path)
+      Chess::AnalysisServer.request('stats', path)['tt_size'].should == 0
+    end
+  end
+
+  it "should answer pipelined requests in order" do
+    with_server do
+      UNIXSocket.open(path) do |socket|
+        socket.puts 'mate fen 6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1'
+        socket.puts 'go depth 1 fen 6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1'
+        socket.puts 'bogus'
+        JSON.parse(socket.gets)['mate'].should == ['d1d8']
+        JSON.parse(socket.gets)['bestmove'].should == 'd1d8'
+        JSON.parse(socket.gets)['error'].should == 'unknown request'
+      end
+    end
+  end
+
+end
@@ -0,0 +1,94 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'spec_helper'
+require 'tmpdir'
+
+describe Chess::Book::Builder do
+
+  PGN = <<-PGN
+[Event "Ruy Lopez"]
+[Result "1-0"]
+
+1. e4 e5 2. Nf3 {a comment
+that spans [two] lines} Nc6 3. Bb5 (3. Bc4 Bc5) a6 4. Ba4 Nf6 5. O-O Be7 1-0
+
+[Event "Sicilian"]
+[Result "1/2-1/2"]
+
+1. e4 c5 2. Nf3 d6 ; a rest-of-line comment
+3. d4 cxd4 4. Nxd4 Nf6 5. Nc3 a6 $1 1/2-1/2
+
+[Event "Queen's Gambit"]
+[Result "0-1"]
+
+1. d4 d5 2. c4 e6 3. Nc3 Nf6 0-1
+
+[Event "Unfinished"]
+[Result "*"]
+
+1. e4 e5 *
+  PGN
+
+  def book_moves(fen)
+    pos = Chess::Notation::fen_to_position(fen)
+    Chess::Book::moves(pos).collect { |move, weight| [move.to_s, weight] }
+  end
+
+  before(:all) do
+    @pgn_path = File.join(Dir.tmpdir, 'book_builder_spec.pgn')
+    @book_path = File.join(Dir.tmpdir, 'book_builder_spec.bin')
+    File.write(@pgn_path, PGN * 20)
+    # A tiny spill limit forces many sorted runs to be merged.
+    @builder = Chess::Book::Builder.new(workers: 3, spill_limit: 5).build(@pgn_path, @book_path)
+    Chess::Book::open(@book_path)
+  end
+
+  after(:all) do
+    Chess::Book::open
+    File.delete(@pgn_path, @book_path)
+  end
+
+  it "should read every game in the collection" do
+    @builder.games.should == 80
+  end
+
+  it "should sum points across workers and spill files" do
+    book_moves("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1").should == [["wP e2 e4", 60]]
+    book_moves("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1").should == [["bP c7 c5", 20]]
+  end
+
+  it "should write entries under the standard Polyglot keys" do
+    entries = File.binread(@book_path).unpack('Q>nnN' * (File.size(@book_path) / 16)).each_slice(4).to_a
+    # e2e4 from the start position, and c7c5 after 1. e4.
+    entries.select { |key, *| key == 0x463b96181691fc9c }.should == [[0x463b96181691fc9c, 28 | (12 << 6), 60, 0]]
+    entries.select { |key, *| key == 0x823c9b50fd114196 }.should == [[0x823c9b50fd114196, 34 | (50 << 6), 20, 0]]
+  end
+
+  it "should leave out moves by the losing side" do
+    book_moves("rnbqkbnr/pppppppp/8/8/3P4/8/PPP1PPPP/RNBQKBNR b KQkq - 0 1").should == [["bP d7 d5", 40]]
+  end
+
+  it "should encode castling moves" do
+    book_moves("r1bqkb1r/1ppp1ppp/p1n2n2/4p3/B3P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 0 1").should == [["wK e1 g1", 40]]
+  end
+
+end
@@ -0,0 +1,92 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'spec_helper'
+require 'tmpdir'
+
+describe Chess::Book do
+
+  START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+  CASTLE_FEN = "r3k2r/pppq1ppp/2np1n2/2b1p1B1/2B1P1b1/2NP1N2/PPPQ1PPP/R3K2R w KQkq - 0 1"
+
+  def key(fen, enp_target = nil)
+    pos = Chess::Notation::fen_to_position(fen)
+    Chess::Book::polyglot_key(pos.pieces, pos.side_to_move, pos.castle, enp_target || pos.enp_target)
+  end
+
+  def move_str(move)
+    Chess::Location::sq_to_s(move.from) + Chess::Location::sq_to_s(move.to)
+  end
+
+  # Writes a book with entries of [key, from, to, weight], sorted by key as Polyglot requires.
+  def write_book(path, entries)
+    File.open(path, 'wb') do |f|
+      entries.sort_by(&:first).each do |k, from, to, weight| 
+        f.write([k, to | (from << 6), weight, 0].pack('Q>nnN'))
+      end
+    end
+  end
+
+  before(:all) do
+    @path = File.join(Dir.tmpdir, 'book_spec.bin')
+    write_book(@path, [[key(START_FEN), 12, 28, 3],   # e2e4
+                       [key(START_FEN), 11, 27, 1],   # d2d4
+                       [key(CASTLE_FEN), 4, 7, 1],    # e1h1, castling as encoded by Polyglot
+                       [key(START_FEN) ^ 1, 6, 21, 1]])
+    Chess::Book::open(@path)
+  end
+
+  after(:all) do
+    Chess::Book::open
+    File.delete(@path)
+  end
+
+  it "should compute the standard Polyglot keys" do
+    key(START_FEN).should == 0x463b96181691fc9c
+    # The pawn on f5 can be taken en passant.
+    key("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq - 0 3", 37).should == 0x22a48b5a8e47ff78
+    key("rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4").should == 0x00fdd303c946bdd9
+  end
+
+  it "should find each book move for the position" do
+    pos = Chess::Notation::fen_to_position(START_FEN)
+    Chess::Book::moves(pos).collect { |move, weight| [move_str(move), weight] }.should == [["e2e4", 3], ["d2d4", 1]]
+  end
+
+  it "should decode castling moves" do
+    pos = Chess::Notation::fen_to_position(CASTLE_FEN)
+    move_str(Chess::Book::moves(pos).first.first).should == "e1g1"
+  end
+
+  it "should choose moves in proportion to their weight" do
+    pos = Chess::Notation::fen_to_position(START_FEN)
+    counts = Hash.new(0)
+    400.times { counts[move_str(Chess::Book::select_move(pos))] += 1 }
+    counts.keys.sort.should == ["d2d4", "e2e4"]
+    counts["e2e4"].should > counts["d2d4"]
+  end
+
+  it "should return nil when out of book" do
+    pos = Chess::Notation::fen_to_position("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1")
+    Chess::Book::select_move(pos).should be_nil
+  end
+
+end
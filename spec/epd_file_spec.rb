@@ -0,0 +1,93 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'spec_helper'
+require 'tmpdir'
+
+describe Chess::EPDFile do
+
+  let(:path) { File.join(Dir.tmpdir, 'epd_file_spec.epd') }
+  let(:suites) { Dir['./test_suites/*.epd'] }
+
+  after { File.delete(path) if File.exist?(path) }
+
+  it "should parse the same positions as Notation" do
+    suites.each do |suite|
+      lines = File.readlines(suite).reject { |line| line.strip.empty? }
+      Chess::EPDFile::Reader.open(suite) do |r|
+        r.count.should == lines.count
+        lines.each_with_index do |line, i|
+          expected = Chess::Notation::epd_to_position(line)
+          pos = r.position(i)
+          pos.board.squares.should == expected.board.squares
+          pos.side_to_move.should == expected.side_to_move
+          pos.castle.should == expected.castle
+          pos.enp_target.should == expected.enp_target
+          pos.hash.should == expected.hash
+        end
+      end
+    end
+  end
+
+  it "should read the bm, am, id and c0 operations" do
+    Chess::EPDFile::Reader.open('./test_suites/wac_300.epd') do |r|
+      r.id(149).should == 'WAC.150'
+      r.best_moves(149).should == ['Ba3', 'Be5', 'Bf8', 'e3']
+      r.avoid_moves(149).should == []
+      r.operation(149, 'c0').should == 'All win but e3 is best.'
+      r.line(149).should == File.readlines('./test_suites/wac_300.epd')[149].chomp
+    end
+    Chess::EPDFile::Reader.open('./test_suites/kaufman.epd') do |r|
+      r.avoid_moves(2).should == ['Rd1']
+      r.best_moves(2).should == []
+    end
+  end
+
+  it "should read FEN clocks and game results" do
+    File.write(path, "4k3/8/8/8/8/8/4P3/4K3 w - - 12 40\n\n" +
+                     "4k3/8/8/8/8/8/4P3/4K3 b - - c0 \"a; b\"; c9 \"0-1\"; hmvc 3;\n" +
+                     "4k3/8/8/8/8/8/4P3/4K3 w - - [0.5]\n")
+    Chess::EPDFile::Reader.open(path) do |r|
+      r.count.should == 3
+      r.entry(0)[4..5].should == [12, 40]
+      r.entry(1)[4..5].should == [3, 1]
+      r.operation(1, 'c0').should == 'a; b'
+      r.entry(0).last.should == nil
+      r.entry(1).last.should == 0
+      r.entry(2).last.should == 1
+      r.labeled_records.bytesize.should == 2 * Chess::PositionFile::RECORD_SIZE
+    end
+  end
+
+  it "should decode batches into packed boards" do
+    positions = File.readlines('./test_suites/wac_75.epd').collect { |epd| Chess::Notation::epd_to_position(epd) }
+    packed = positions.collect { |pos| Chess::Evaluation::pack_position(pos.pieces, pos.side_to_move) }.join
+    Chess::EPDFile::Reader.open('./test_suites/wac_75.epd') do |r|
+      r.batch(0, r.count).first.should == packed
+    end
+  end
+
+  it "should report the line of an invalid position" do
+    File.write(path, "4k3/8/8/8/8/8/4P3/4K3 w - -\n4k3/8/8/8/8/4P3/4K3 w - -\n")
+    lambda { Chess::EPDFile::Reader.new(path) }.should raise_error(ArgumentError, /:2:/)
+  end
+
+end
@@ -0,0 +1,103 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+
+require 'spec_helper'
+
+describe Chess::Evaluation do
+
+  describe "batch evaluation" do
+    let(:positions) do
+      File.readlines('./test_suites/wac_75.epd').collect { |epd| Chess::Notation::epd_to_position(epd) }
+    end
+
+    it "should match the static eval of each position" do
+      expected = positions.collect { |pos| Chess::Evaluation::net_placement(pos.pieces, pos.side_to_move) }
+      Chess::Evaluation::evaluate_positions(positions).should == expected
+    end
+
+    it "should give the same results however the batch is split" do
+      Chess::Evaluation::evaluate_positions(positions, true, 1).should == 
+        Chess::Evaluation::evaluate_positions(positions, true, 4)
+    end
+
+    it "should resolve hanging pieces with a capture search" do
+      pos = Chess::Notation::fen_to_position("4k3/8/8/3q4/8/8/8/3RK3 w - - 0 1")
+      static, resolved = [false, true].collect { |qsearch| Chess::Evaluation::evaluate_positions([pos], qsearch).first }
+      static.should < 0
+      resolved.should > 0
+    end
+
+    it "should not capture into a losing exchange" do
+      pos = Chess::Notation::fen_to_position("4k3/8/2p5/3p4/8/8/8/3QK3 w - - 0 1")
+      Chess::Evaluation::evaluate_positions([pos], true).first.should == 
+        Chess::Evaluation::evaluate_positions([pos]).first
+    end
+
+    it "should reject buffers that are too small" do
+      packed = Chess::Evaluation::pack_position(positions.first.pieces, positions.first.side_to_move)
+      lambda { Chess::Evaluation::evaluate_batch(packed, "", false, 1) }.should raise_error(ArgumentError)
+    end
+  end
+
+  describe "endgames" do
+    def score(fen)
+      pos = Chess::Notation::fen_to_position(fen)
+      Chess::Evaluation::net_placement(pos.pieces, pos.side_to_move)
+    end
+
+    it "should keep the material key in step with the board as moves are made and unmade" do
+      pos = Chess::Notation::fen_to_position("r3k2r/1P3ppp/8/3p4/4P3/8/5PPP/R3K2R w KQkq - 0 1")
+      original = pos.pieces.material_key
+      pos.get_moves(0).each do |move|  # includes promotions and captures.
+        Chess::MoveGen::make!(pos, move)
+        pos.pieces.material_key.should == Chess::Bitboard::PiecewiseBoard.new(pos.board).material_key
+        Chess::MoveGen::unmake!(pos, move)
+        pos.pieces.material_key.should == original
+      end
+    end
+
+    it "should score KPK from the bitbase" do
+      score("3k4/8/3K4/3P4/8/8/8/8 w - - 0 1").should > 10000
+      score("3k4/8/3K4/3P4/8/8/8/8 b - - 0 1").should < -10000
+      score("4k3/4P3/4K3/8/8/8/8/8 b - - 0 1").should == 0  # stalemate
+      score("8/8/8/8/8/4k3/4P3/4K3 w - - 0 1").should == 0
+      score("8/8/8/8/4p3/4k3/8/3K4 b - - 0 1").should == score("3k4/8/3K4/3P4/8/8/8/8 w - - 0 1")
+    end
+
+    it "should drive the losing king to the corner of the bishop's color in KBNK" do
+      score("8/8/8/8/8/8/8/NB2K2k w - - 0 1").should > score("8/8/8/8/8/8/8/kB2K1N1 w - - 0 1")
+      score("8/8/8/4k3/8/8/8/NB2K3 w - - 0 1").should > 10000
+    end
+
+    it "should score dead draws as zero" do
+      Chess::Evaluation::endgame(Chess::Notation::fen_to_position("k7/8/8/8/8/8/8/3NKN2 w - - 0 1").pieces).should == "KNNvK"
+      score("k7/8/8/8/8/8/8/3NKN2 w - - 0 1").should == 0
+      score("k7/8/8/8/8/8/8/4K1b1 w - - 0 1").should == 0
+    end
+
+    it "should scale down a rook pawn with the wrong bishop" do
+      score("k7/8/P7/8/8/8/8/4K1B1 w - - 0 1").should == 0
+      score("k7/8/P7/8/8/8/8/4KB2 w - - 0 1").should > 0
+    end
+  end
+
+end
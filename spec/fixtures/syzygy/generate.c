@@ -0,0 +1,1011 @@
+//-----------------------------------------------------------------------------------
+// Copyright (c) 2013 Stephen J. Lovell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------------
+
+// Writes the endgame tables probed by tablebase_spec.rb.  Each ending is solved by retrograde analysis, and the
+// results are written in the Syzygy file format: the same index encoding, Re-Pair symbols and canonical Huffman
+// codes that ext/tablebase.c reads.  To regenerate the fixtures, run from the repository root:
+//
+//   cc -O2 -o /tmp/generate spec/fixtures/syzygy/generate.c && /tmp/generate spec/fixtures/syzygy
+//
+// The solver ignores the Halfmove Rule, so it only supports endings whose wins are all converted within 100 plies
+// (no cursed wins), and it doesn't generate en-passant captures, so at most one side may have pawns.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MAX_PIECES 4
+#define MAX_CHILDREN 128
+#define MAX_SYMBOLS 4000
+#define BLOCK_LOG 10
+#define SPAN_LOG 10
+
+enum { PAWN = 1, KNIGHT, BISHOP, ROOK, QUEEN, KING };  // Syzygy piece codes.  Black pieces add 8.
+enum { UNKNOWN, WIN, LOSS, DRAW, INVALID };            // position values for the side to move
+enum { NO_MOVES = 1, DRAWING_EXIT = 2 };               // solver flags
+enum { TB_STM = 1, TB_WIN_PLIES = 4, TB_LOSS_PLIES = 8, TB_SINGLE_VALUE = 128 };
+
+static const char piece_chars[] = " PNBRQK";
+static const uint8_t wdl_magic[] = { 0x71, 0xE8, 0x23, 0x5D };
+static const uint8_t dtz_magic[] = { 0xD7, 0x66, 0x0C, 0xA5 };
+
+// A position is a list of pieces with their squares.  Positions of a solved ending have the stronger side as white,
+// and list white's pieces before black's, each side from king down to pawn.
+typedef struct {
+  int n;
+  int code[MAX_PIECES];
+  int sq[MAX_PIECES];
+  int stm;              // 0 for white to move, 1 for black
+} POS;
+
+typedef struct {
+  POS next;
+  int zeroing;          // a capture or pawn move
+} CHILD;
+
+typedef struct {
+  char name[16];
+  int n;
+  int code[MAX_PIECES];
+  uint64_t size;
+  uint8_t *val;         // value of each position for the side to move
+  uint8_t *dtz;         // plies to the next zeroing move, for won and lost positions
+} TABLE;
+
+static TABLE tables[64];
+static int table_count = 0;
+
+static void fail(const char *message, const char *name){
+  fprintf(stderr, "%s: %s\n", name, message);
+  exit(1);
+}
+
+
+// Move generation
+
+static const int king_dirs[8][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+static const int knight_dirs[8][2] = { { 1, 2 }, { 2, 1 }, { -1, 2 }, { -2, 1 }, { 1, -2 }, { 2, -1 }, { -1, -2 }, { -2, -1 } };
+
+static int on_board(int r, int f){ return r >= 0 && r < 8 && f >= 0 && f < 8; }
+static int color_of(int code){ return code >> 3; }
+static int type_of(int code){ return code & 7; }
+
+// Writes the squares attacked by the piece on sq to to[], and returns their number.  occ[] holds 1 + the index of
+// the piece on each square, or 0 for an empty square.
+static int piece_targets(int code, int sq, const int *occ, int *to){
+  int type = type_of(code), r = sq >> 3, f = sq & 7, n = 0;
+  if(type == PAWN){
+    int dr = color_of(code) ? -1 : 1;
+    for(int df = -1; df <= 1; df += 2) if(on_board(r + dr, f + df)) to[n++] = (r + dr) * 8 + f + df;
+    return n;
+  }
+  const int (*dirs)[2] = type == KNIGHT ? knight_dirs : king_dirs;
+  int first = type == BISHOP ? 4 : 0, last = type == ROOK ? 4 : 8;
+  int slides = type == BISHOP || type == ROOK || type == QUEEN;
+  for(int d = first; d < last; d++){
+    int r2 = r + dirs[d][0], f2 = f + dirs[d][1];
+    while(on_board(r2, f2)){
+      to[n++] = r2 * 8 + f2;
+      if(!slides || occ[r2 * 8 + f2]) break;
+      r2 += dirs[d][0];
+      f2 += dirs[d][1];
+    }
+  }
+  return n;
+}
+
+static void set_occupancy(const POS *p, int *occ){
+  memset(occ, 0, 64 * sizeof(int));
+  for(int i = 0; i < p->n; i++) occ[p->sq[i]] = i + 1;
+}
+
+// Returns whether the piece on from attacks sq.
+static int attacks(int code, int from, int sq, const int *occ){
+  int type = type_of(code), dr = (sq >> 3) - (from >> 3), df = (sq & 7) - (from & 7);
+  if(type == PAWN) return dr == (color_of(code) ? -1 : 1) && abs(df) == 1;
+  if(type == KNIGHT) return abs(dr * df) == 2;
+  if(type == KING) return abs(dr) <= 1 && abs(df) <= 1 && (dr || df);
+  int straight = !dr != !df, diagonal = dr && abs(dr) == abs(df);
+  if(!(type == ROOK ? straight : (type == BISHOP ? diagonal : straight || diagonal))) return 0;
+  int step = ((dr > 0) - (dr < 0)) * 8 + (df > 0) - (df < 0);
+  for(int s = from + step; s != sq; s += step) if(occ[s]) return 0;
+  return 1;
+}
+
+static int is_attacked(const POS *p, const int *occ, int sq, int by){
+  for(int i = 0; i < p->n; i++){
+    if(color_of(p->code[i]) == by && attacks(p->code[i], p->sq[i], sq, occ)) return 1;
+  }
+  return 0;
+}
+
+static int king_square(const POS *p, int c){
+  for(int i = 0; i < p->n; i++) if(p->code[i] == KING + 8 * c) return p->sq[i];
+  return -1;
+}
+
+static int in_check(const POS *p){
+  int occ[64];
+  set_occupancy(p, occ);
+  return is_attacked(p, occ, king_square(p, p->stm), p->stm ^ 1);
+}
+
+// Positions are legal when no two pieces share a square, no pawn stands on the first or last rank, and the side
+// that just moved isn't in check.
+static int is_legal(const POS *p){
+  int occ[64] = { 0 };
+  for(int i = 0; i < p->n; i++){
+    if(occ[p->sq[i]]) return 0;
+    occ[p->sq[i]] = i + 1;
+    if(type_of(p->code[i]) == PAWN && (p->sq[i] < 8 || p->sq[i] >= 56)) return 0;
+  }
+  return !is_attacked(p, occ, king_square(p, p->stm ^ 1), p->stm);
+}
+
+static void add_child(const POS *p, int i, int to, int promote, CHILD *out, int *count){
+  POS next = *p;
+  int zeroing = type_of(p->code[i]) == PAWN;
+  for(int j = 0; j < next.n; j++){
+    if(next.sq[j] != to) continue;
+    zeroing = 1;
+    memmove(next.code + j, next.code + j + 1, (next.n - j - 1) * sizeof(int));
+    memmove(next.sq + j, next.sq + j + 1, (next.n - j - 1) * sizeof(int));
+    next.n--;
+    if(j < i) i--;
+    break;
+  }
+  next.sq[i] = to;
+  if(promote) next.code[i] = promote + 8 * p->stm;
+  next.stm ^= 1;
+  if(!is_legal(&next)) return;
+  out[*count].next = next;
+  out[*count].zeroing = zeroing;
+  (*count)++;
+}
+
+// Generates the legal moves of the side to move.  Promotions to each of the four piece types are separate moves.
+static int gen_children(const POS *p, CHILD *out){
+  int occ[64], to[32], count = 0;
+  set_occupancy(p, occ);
+  for(int i = 0; i < p->n; i++){
+    int code = p->code[i], sq = p->sq[i];
+    if(color_of(code) != p->stm) continue;
+    int n = piece_targets(code, sq, occ, to);
+    for(int j = 0; j < n; j++){
+      int target = occ[to[j]];
+      if(target && color_of(p->code[target-1]) == p->stm) continue;
+      if(type_of(code) == PAWN && !target) continue;
+      if(type_of(code) == PAWN && (to[j] < 8 || to[j] >= 56)){
+        for(int pc = QUEEN; pc >= KNIGHT; pc--) add_child(p, i, to[j], pc, out, &count);
+      } else add_child(p, i, to[j], 0, out, &count);
+    }
+    if(type_of(code) != PAWN) continue;
+    int step = p->stm ? -8 : 8, push = sq + step;
+    if(occ[push]) continue;
+    if(push < 8 || push >= 56){
+      for(int pc = QUEEN; pc >= KNIGHT; pc--) add_child(p, i, push, pc, out, &count);
+    } else {
+      add_child(p, i, push, 0, out, &count);
+      int start_rank = p->stm ? 6 : 1;
+      if((sq >> 3) == start_rank && !occ[push + step]) add_child(p, i, push + step, 0, out, &count);
+    }
+  }
+  return count;
+}
+
+// Generates the positions from which a move by the side not to move leads to p without capturing or promoting.
+// Pawn moves are included only if pawns is set.
+static int gen_parents(const POS *p, POS *out, int pawns){
+  int occ[64], to[32], count = 0, mover = p->stm ^ 1;
+  set_occupancy(p, occ);
+  for(int i = 0; i < p->n; i++){
+    int code = p->code[i], sq = p->sq[i];
+    if(color_of(code) != mover) continue;
+    if(type_of(code) == PAWN){
+      if(!pawns) continue;
+      int step = mover ? 8 : -8, from = sq + step;
+      if(from < 8 || from >= 56 || occ[from]) continue;
+      out[count] = *p;
+      out[count].sq[i] = from;
+      out[count++].stm = mover;
+      int double_rank = mover ? 4 : 3;
+      if((sq >> 3) == double_rank && !occ[from + step]){
+        out[count] = *p;
+        out[count].sq[i] = from + step;
+        out[count++].stm = mover;
+      }
+      continue;
+    }
+    int n = piece_targets(code, sq, occ, to);
+    for(int j = 0; j < n; j++){
+      if(occ[to[j]]) continue;
+      out[count] = *p;
+      out[count].sq[i] = to[j];
+      out[count++].stm = mover;
+    }
+  }
+  return count;
+}
+
+
+// Solving
+
+static int sort_key(int code){ return color_of(code) * 8 + KING - type_of(code); }
+
+// Returns a positive number if black has the stronger pieces: more queens, or as many queens and more rooks, and
+// so on down to pawns.
+static int black_stronger(const POS *p){
+  int counts[2][8] = { { 0 } };
+  for(int i = 0; i < p->n; i++) counts[color_of(p->code[i])][type_of(p->code[i])]++;
+  for(int type = QUEEN; type >= PAWN; type--){
+    if(counts[0][type] != counts[1][type]) return counts[1][type] - counts[0][type];
+  }
+  return 0;
+}
+
+// Brings a position into the form its ending is solved in.  Colors are swapped (and the board mirrored) so that
+// the stronger side is white, and the pieces are ordered as the ending lists them.  Sets the name of the ending
+// (e.g. "KRvKP").
+static void canonical_form(POS *p, char *name){
+  if(black_stronger(p) > 0){
+    for(int i = 0; i < p->n; i++){
+      p->code[i] ^= 8;
+      p->sq[i] ^= 56;
+    }
+    p->stm ^= 1;
+  }
+  for(int i = 1; i < p->n; i++){
+    for(int j = i; j > 0 && sort_key(p->code[j]) < sort_key(p->code[j-1]); j--){
+      int tmp = p->code[j]; p->code[j] = p->code[j-1]; p->code[j-1] = tmp;
+      tmp = p->sq[j]; p->sq[j] = p->sq[j-1]; p->sq[j-1] = tmp;
+    }
+  }
+  int len = 0;
+  for(int i = 0; i < p->n; i++){
+    if(i && color_of(p->code[i]) != color_of(p->code[i-1])) name[len++] = 'v';
+    name[len++] = piece_chars[type_of(p->code[i])];
+  }
+  name[len] = '\0';
+}
+
+static uint64_t pos_index(const POS *p){
+  uint64_t idx = 0;
+  for(int i = p->n - 1; i >= 0; i--) idx = idx * 64 + p->sq[i];
+  return idx * 2 + p->stm;
+}
+
+static void pos_from_index(const TABLE *t, uint64_t idx, POS *p){
+  p->n = t->n;
+  p->stm = idx & 1;
+  idx >>= 1;
+  for(int i = 0; i < t->n; i++, idx >>= 6){
+    p->code[i] = t->code[i];
+    p->sq[i] = idx & 63;
+  }
+}
+
+static TABLE *get_table(const POS *p);
+
+// Returns the value of a position for the side to move, solving its ending first if needed.
+static int value_of(const POS *p){
+  if(p->n == 2) return DRAW;
+  POS q = *p;
+  char name[16];
+  canonical_form(&q, name);
+  return get_table(&q)->val[pos_index(&q)];
+}
+
+static int same_ending(const TABLE *t, const POS *p){
+  return p->n == t->n && !memcmp(p->code, t->code, t->n * sizeof(int));
+}
+
+// Finds the value of every position by retrograde analysis.  Moves that capture or promote lead into smaller
+// endings, which are solved first.  Positions that can't be shown to be won or lost are drawn.
+static void solve_wdl(TABLE *t, uint8_t *count, uint8_t *flags){
+  CHILD children[MAX_CHILDREN];
+  POS p, parents[MAX_CHILDREN];
+  uint64_t *queue = malloc(t->size * sizeof(uint64_t)), head = 0, tail = 0;
+  for(uint64_t idx = 0; idx < t->size; idx++){
+    pos_from_index(t, idx, &p);
+    if(!is_legal(&p)){
+      t->val[idx] = INVALID;
+      continue;
+    }
+    int n = gen_children(&p, children);
+    if(!n){
+      t->val[idx] = in_check(&p) ? LOSS : DRAW;
+      flags[idx] |= NO_MOVES;
+    }
+    for(int i = 0; i < n; i++){
+      if(same_ending(t, &children[i].next)){
+        count[idx]++;
+        continue;
+      }
+      int v = value_of(&children[i].next);
+      if(v == LOSS) t->val[idx] = WIN;
+      if(v == DRAW) flags[idx] |= DRAWING_EXIT;
+    }
+    if(n && !count[idx] && !(flags[idx] & DRAWING_EXIT) && t->val[idx] != WIN) t->val[idx] = LOSS;
+    if(t->val[idx] == WIN || t->val[idx] == LOSS) queue[tail++] = idx;
+  }
+  while(head < tail){
+    uint64_t idx = queue[head++];
+    pos_from_index(t, idx, &p);
+    int n = gen_parents(&p, parents, 1);
+    for(int i = 0; i < n; i++){
+      uint64_t parent = pos_index(&parents[i]);
+      if(t->val[parent] != UNKNOWN) continue;
+      if(t->val[idx] == LOSS) t->val[parent] = WIN;
+      else if(--count[parent] == 0 && !(flags[parent] & DRAWING_EXIT)) t->val[parent] = LOSS;
+      else continue;
+      queue[tail++] = parent;
+    }
+  }
+  for(uint64_t idx = 0; idx < t->size; idx++) if(t->val[idx] == UNKNOWN) t->val[idx] = DRAW;
+  free(queue);
+}
+
+// Finds the distance to zeroing of every won or lost position.  The winner zeroes in as few plies as possible
+// and the loser holds out as long as possible.  Checkmate counts as a zeroing move.
+static void solve_dtz(TABLE *t, uint8_t *count, const uint8_t *flags){
+  CHILD children[MAX_CHILDREN];
+  POS p, parents[MAX_CHILDREN];
+  for(uint64_t idx = 0; idx < t->size; idx++){
+    if(t->val[idx] != WIN && t->val[idx] != LOSS) continue;
+    pos_from_index(t, idx, &p);
+    int n = gen_children(&p, children);
+    count[idx] = 0;
+    for(int i = 0; i < n; i++){
+      int same = same_ending(t, &children[i].next);
+      uint64_t child = same ? pos_index(&children[i].next) : 0;
+      if(t->val[idx] == LOSS){
+        count[idx] += !children[i].zeroing;
+      } else if(children[i].zeroing){
+        if((same ? t->val[child] : value_of(&children[i].next)) == LOSS) t->dtz[idx] = 1;
+      } else if(t->val[child] == LOSS && (flags[child] & NO_MOVES)) t->dtz[idx] = 1;
+    }
+    if(t->val[idx] == LOSS && !count[idx]) t->dtz[idx] = 1;
+  }
+  for(int ply = 1, found = 1; found; ply++){
+    found = 0;
+    for(uint64_t idx = 0; idx < t->size; idx++){
+      if(t->dtz[idx] != ply) continue;
+      found = 1;
+      pos_from_index(t, idx, &p);
+      int n = gen_parents(&p, parents, 0);
+      if(ply == 100 && n) fail("cursed wins are not supported", t->name);
+      for(int i = 0; i < n; i++){
+        uint64_t parent = pos_index(&parents[i]);
+        if(t->val[idx] == WIN && t->val[parent] == LOSS && --count[parent] == 0) t->dtz[parent] = ply + 1;
+        if(t->val[idx] == LOSS && t->val[parent] == WIN && !t->dtz[parent]) t->dtz[parent] = ply + 1;
+      }
+    }
+  }
+}
+
+static TABLE *get_table(const POS *p){
+  char name[16];
+  POS q = *p;
+  canonical_form(&q, name);
+  for(int i = 0; i < table_count; i++) if(!strcmp(tables[i].name, name)) return &tables[i];
+
+  for(int i = 0; i < q.n; i++){
+    for(int j = 0; j < q.n; j++){
+      if(type_of(q.code[i]) == PAWN && type_of(q.code[j]) == PAWN && color_of(q.code[i]) != color_of(q.code[j])){
+        fail("en-passant captures are not supported", name);
+      }
+    }
+  }
+  TABLE *t = &tables[table_count++];
+  strcpy(t->name, name);
+  t->n = q.n;
+  memcpy(t->code, q.code, sizeof(q.code));
+  t->size = 2ULL << (6 * q.n);
+  t->val = calloc(t->size, 1);
+  t->dtz = calloc(t->size, 1);
+  uint8_t *count = calloc(t->size, 1), *flags = calloc(t->size, 1);
+  solve_wdl(t, count, flags);
+  solve_dtz(t, count, flags);
+  free(count);
+  free(flags);
+  fprintf(stderr, "solved %s\n", name);
+  return t;
+}
+
+static TABLE *table_named(const char *name){
+  POS p = { 0 };
+  for(int c = 0; *name; name++){
+    if(*name == 'v'){
+      c = 8;
+      continue;
+    }
+    p.code[p.n++] = (int)(strchr(piece_chars, *name) - piece_chars) + c;
+  }
+  return get_table(&p);
+}
+
+
+// Index encoding.  This mirrors do_probe_table() in ext/tablebase.c.
+
+static int map_b1h1h7[64], map_a1d1d4[64], map_kk[10][64], map_pawns[64];
+static int lead_pawn_idx[6][64], lead_pawns_size[6][4];
+static uint64_t binomial[6][64];
+
+static int off_a1h8(int sq){ return (sq >> 3) - (sq & 7); }
+static int adjacent(int a, int b){ return abs((a >> 3) - (b >> 3)) <= 1 && abs((a & 7) - (b & 7)) <= 1; }
+
+static void init_encoding_tables(){
+  int code = 0;
+  for(int sq = 0; sq < 64; sq++) if(off_a1h8(sq) < 0) map_b1h1h7[sq] = code++;
+  code = 0;
+  for(int sq = 0; sq < 28; sq++) if(off_a1h8(sq) < 0 && (sq & 7) <= 3) map_a1d1d4[sq] = code++;
+  for(int sq = 0; sq < 28; sq++) if(off_a1h8(sq) == 0 && (sq & 7) <= 3) map_a1d1d4[sq] = code++;
+
+  // Two kings with the first on the a1-h8 diagonal take the last codes.
+  int diag[64][2], diag_count = 0;
+  code = 0;
+  for(int idx = 0; idx < 10; idx++){
+    for(int s1 = 0; s1 < 28; s1++){
+      if(map_a1d1d4[s1] != idx || (idx == 0 && s1 != 1)) continue;
+      for(int s2 = 0; s2 < 64; s2++){
+        if(adjacent(s1, s2) || (!off_a1h8(s1) && off_a1h8(s2) > 0)) continue;
+        if(!off_a1h8(s1) && !off_a1h8(s2)){
+          diag[diag_count][0] = idx;
+          diag[diag_count++][1] = s2;
+        } else map_kk[idx][s2] = code++;
+      }
+    }
+  }
+  for(int i = 0; i < diag_count; i++) map_kk[diag[i][0]][diag[i][1]] = code++;
+
+  binomial[0][0] = 1;
+  for(int n = 1; n < 64; n++){
+    for(int k = 0; k < 6 && k <= n; k++){
+      binomial[k][n] = (k > 0 ? binomial[k-1][n-1] : 0) + (k < n ? binomial[k][n-1] : 0);
+    }
+  }
+  int available = 47;
+  for(int lead_pawns = 1; lead_pawns <= 5; lead_pawns++){
+    for(int f = 0; f < 4; f++){
+      int idx = 0;
+      for(int r = 1; r < 7; r++){
+        int sq = r * 8 + f;
+        if(lead_pawns == 1){
+          map_pawns[sq] = available--;
+          map_pawns[sq ^ 7] = available--;
+        }
+        lead_pawn_idx[lead_pawns][sq] = idx;
+        idx += binomial[lead_pawns-1][map_pawns[sq]];
+      }
+      lead_pawns_size[lead_pawns][f] = idx;
+    }
+  }
+}
+
+// How a table file lists its pieces.  The order of the pieces defines the groups used to encode the index.
+typedef struct {
+  int n;
+  int pieces[MAX_PIECES];
+  int has_pawns, has_unique_pieces;
+  int group_len[MAX_PIECES+1];
+  uint64_t group_idx[4][MAX_PIECES+1];
+} ENCODING;
+
+static void init_encoding(ENCODING *e, const int *pieces, int n){
+  int counts[16] = { 0 };
+  e->n = n;
+  memcpy(e->pieces, pieces, n * sizeof(int));
+  e->has_pawns = e->has_unique_pieces = 0;
+  for(int i = 0; i < n; i++) counts[pieces[i]]++;
+  for(int i = 0; i < n; i++){
+    if(type_of(pieces[i]) == PAWN) e->has_pawns = 1;
+    if(type_of(pieces[i]) != KING && counts[pieces[i]] == 1) e->has_unique_pieces = 1;
+  }
+  int groups = 0, first_len = e->has_pawns ? 0 : (e->has_unique_pieces ? 3 : 2);
+  e->group_len[0] = 1;
+  for(int i = 1; i < n; i++){
+    if(--first_len > 0 || pieces[i] == pieces[i-1]) e->group_len[groups]++;
+    else e->group_len[++groups] = 1;
+  }
+  e->group_len[++groups] = 0;
+  for(int f = 0; f < 4; f++){
+    int free_squares = 64 - e->group_len[0];
+    e->group_idx[f][0] = 1;
+    uint64_t idx = e->has_pawns ? lead_pawns_size[e->group_len[0]][f] : (e->has_unique_pieces ? 31332 : 462);
+    for(int g = 1; g < groups; g++){
+      e->group_idx[f][g] = idx;
+      idx *= binomial[e->group_len[g]][free_squares];
+      free_squares -= e->group_len[g];
+    }
+    e->group_idx[f][groups] = idx;
+  }
+}
+
+static uint64_t table_size(const ENCODING *e, int f){
+  int g = 0;
+  while(e->group_len[g]) g++;
+  return e->group_idx[f][g];
+}
+
+static void swap_ints(int *a, int *b){ int tmp = *a; *a = *b; *b = tmp; }
+
+// Returns the index of a position in the table, and sets *file to the sub-table (the leading pawn's file).
+static uint64_t encode(const ENCODING *e, const POS *p, int *file){
+  int squares[MAX_PIECES], pieces[MAX_PIECES], size = 0, lead_pawns_cnt = 0, tb_file = 0, next = 0;
+  uint64_t idx;
+  if(e->has_pawns){
+    for(int i = 0; i < p->n; i++) if(p->code[i] == e->pieces[0]) squares[size++] = p->sq[i];
+    lead_pawns_cnt = size;
+    for(int i = 1; i < lead_pawns_cnt; i++){
+      if(map_pawns[squares[i]] > map_pawns[squares[0]]) swap_ints(&squares[0], &squares[i]);
+    }
+    tb_file = (squares[0] & 7) > 3 ? 7 - (squares[0] & 7) : squares[0] & 7;
+  }
+  for(int sq = 0; sq < 64; sq++){
+    for(int i = 0; i < p->n; i++){
+      if(p->sq[i] != sq || (e->has_pawns && p->code[i] == e->pieces[0])) continue;
+      squares[size] = sq;
+      pieces[size++] = p->code[i];
+    }
+  }
+  for(int i = lead_pawns_cnt; i < size - 1; i++){
+    for(int j = i + 1; j < size; j++){
+      if(e->pieces[i] == pieces[j]){
+        swap_ints(&pieces[i], &pieces[j]);
+        swap_ints(&squares[i], &squares[j]);
+        break;
+      }
+    }
+  }
+  if((squares[0] & 7) > 3) for(int i = 0; i < size; i++) squares[i] ^= 7;
+
+  if(e->has_pawns){
+    idx = lead_pawn_idx[lead_pawns_cnt][squares[0]];
+    for(int i = 1; i < lead_pawns_cnt; i++){
+      for(int j = i; j > 1 && map_pawns[squares[j]] < map_pawns[squares[j-1]]; j--) swap_ints(&squares[j], &squares[j-1]);
+    }
+    for(int i = 1; i < lead_pawns_cnt; i++) idx += binomial[i][map_pawns[squares[i]]];
+  } else {
+    if((squares[0] >> 3) > 3) for(int i = 0; i < size; i++) squares[i] ^= 56;
+    for(int i = 0; i < e->group_len[0]; i++){
+      if(!off_a1h8(squares[i])) continue;
+      if(off_a1h8(squares[i]) > 0){
+        for(int j = i; j < size; j++) squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+      }
+      break;
+    }
+    if(e->has_unique_pieces){
+      int *s = squares;
+      int adjust1 = s[1] > s[0], adjust2 = (s[2] > s[0]) + (s[2] > s[1]);
+      if(off_a1h8(s[0])){
+        idx = (map_a1d1d4[s[0]] * 63 + (s[1] - adjust1)) * 62 + s[2] - adjust2;
+      } else if(off_a1h8(s[1])){
+        idx = (6 * 63 + (s[0] >> 3) * 28 + map_b1h1h7[s[1]]) * 62 + s[2] - adjust2;
+      } else if(off_a1h8(s[2])){
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + (s[0] >> 3) * 7 * 28 + ((s[1] >> 3) - adjust1) * 28 + map_b1h1h7[s[2]];
+      } else {
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + (s[0] >> 3) * 7 * 6 + ((s[1] >> 3) - adjust1) * 6
+              + ((s[2] >> 3) - adjust2);
+      }
+    } else {
+      idx = map_kk[map_a1d1d4[squares[0]]][squares[1]];
+    }
+  }
+
+  idx *= e->group_idx[tb_file][0];
+  int *group_sq = squares + e->group_len[0];
+  while(e->group_len[++next]){
+    uint64_t n = 0;
+    for(int i = 1; i < e->group_len[next]; i++){
+      for(int j = i; j > 0 && group_sq[j] < group_sq[j-1]; j--) swap_ints(&group_sq[j], &group_sq[j-1]);
+    }
+    for(int i = 0; i < e->group_len[next]; i++){
+      int adjust = 0;
+      for(int *sq = squares; sq < group_sq; sq++) adjust += group_sq[i] > *sq;
+      n += binomial[i+1][group_sq[i] - adjust];
+    }
+    idx += n * e->group_idx[tb_file][next];
+    group_sq += e->group_len[next];
+  }
+  *file = tb_file;
+  return idx;
+}
+
+
+// Compression.  Runs of values are replaced by Re-Pair symbols, and the symbols are written with a canonical
+// Huffman code in fixed-size blocks.
+
+typedef struct {
+  uint8_t *data;
+  size_t len, cap;
+} BUFFER;
+
+static void put8(BUFFER *b, int v){
+  if(b->len == b->cap){
+    b->cap = b->cap ? 2 * b->cap : 4096;
+    b->data = realloc(b->data, b->cap);
+  }
+  b->data[b->len++] = (uint8_t)v;
+}
+
+static void put16(BUFFER *b, int v){ put8(b, v & 0xFF); put8(b, (v >> 8) & 0xFF); }
+static void put32(BUFFER *b, uint32_t v){ put16(b, v & 0xFFFF); put16(b, v >> 16); }
+static void align(BUFFER *b, size_t n){ while(b->len % n) put8(b, 0); }
+
+typedef struct {
+  BUFFER sizes, sparse_index, block_length, data;
+} PACKED;
+
+static uint32_t *pair_count = NULL;
+
+static void compress(const uint16_t *values, uint64_t count, int flags, PACKED *out){
+  memset(out, 0, sizeof(PACKED));
+  int leaf[MAX_SYMBOLS], left[MAX_SYMBOLS], right[MAX_SYMBOLS], symlen[MAX_SYMBOLS], sym_count = 0;
+  uint16_t *tok = malloc(count * sizeof(uint16_t));
+  uint64_t tok_count = count;
+
+  int single = 1;
+  for(uint64_t i = 1; i < count; i++) if(values[i] != values[0]) single = 0;
+  if(single){
+    put8(&out->sizes, flags | TB_SINGLE_VALUE);
+    put8(&out->sizes, values[0]);
+    free(tok);
+    return;
+  }
+  int sym_of[4096];
+  memset(sym_of, 0xFF, sizeof(sym_of));
+  for(uint64_t i = 0; i < count; i++) sym_of[values[i]] = 0;
+  for(int v = 0; v < 4096; v++){
+    if(sym_of[v] < 0) continue;
+    sym_of[v] = sym_count;
+    leaf[sym_count] = v;
+    symlen[sym_count++] = 1;
+  }
+  for(uint64_t i = 0; i < count; i++) tok[i] = sym_of[values[i]];
+
+  // Re-Pair: repeatedly replace the most frequent pair of adjacent symbols with a new symbol.
+  if(!pair_count) pair_count = calloc(4096 * 4096, sizeof(uint32_t));
+  while(sym_count < MAX_SYMBOLS - 1){
+    uint32_t best = 0, best_key = 0;
+    for(uint64_t i = 0; i + 1 < tok_count; i++) pair_count[tok[i] * 4096 + tok[i+1]]++;
+    for(uint64_t i = 0; i + 1 < tok_count; i++){
+      uint32_t key = tok[i] * 4096 + tok[i+1];
+      if(symlen[tok[i]] + symlen[tok[i+1]] > 256) continue;
+      if(pair_count[key] > best || (pair_count[key] == best && key > best_key)){
+        best = pair_count[key];
+        best_key = key;
+      }
+    }
+    for(uint64_t i = 0; i + 1 < tok_count; i++) pair_count[tok[i] * 4096 + tok[i+1]] = 0;
+    if(best < 8) break;
+    int a = best_key >> 12, b = best_key & 0xFFF, s = sym_count++;
+    leaf[s] = -1;
+    left[s] = a;
+    right[s] = b;
+    symlen[s] = symlen[a] + symlen[b];
+    uint64_t n = 0;
+    for(uint64_t i = 0; i < tok_count; i++){
+      if(i + 1 < tok_count && tok[i] == a && tok[i+1] == b){
+        tok[n++] = s;
+        i++;
+      } else tok[n++] = tok[i];
+    }
+    tok_count = n;
+  }
+
+  // Huffman code lengths.  A code needs at least two symbols, so a lone symbol is paired with an unused one.
+  uint64_t freq[MAX_SYMBOLS] = { 0 }, weight[MAX_SYMBOLS];
+  int length[MAX_SYMBOLS] = { 0 }, group[MAX_SYMBOLS], coded = 0;
+  for(uint64_t i = 0; i < tok_count; i++) freq[tok[i]]++;
+  for(int s = 0; s < sym_count; s++){
+    group[s] = freq[s] ? s : -1;
+    weight[s] = freq[s];
+    coded += freq[s] > 0;
+  }
+  for(int s = 0; s < sym_count && coded == 1; s++){
+    if(group[s] >= 0) continue;
+    group[s] = s;
+    coded++;
+  }
+  for(;;){
+    int g1 = -1, g2 = -1;
+    for(int s = 0; s < sym_count; s++){
+      if(group[s] != s) continue;
+      if(g1 < 0 || weight[s] < weight[g1]){
+        g2 = g1;
+        g1 = s;
+      } else if(g2 < 0 || weight[s] < weight[g2]) g2 = s;
+    }
+    if(g2 < 0) break;
+    for(int s = 0; s < sym_count; s++){
+      if(group[s] == g1 || group[s] == g2){
+        length[s]++;
+        group[s] = g1;
+      }
+    }
+    weight[g1] += weight[g2];
+  }
+  int max_len = 0, min_len = 64;
+  for(int s = 0; s < sym_count; s++){
+    if(group[s] < 0) continue;
+    if(length[s] > max_len) max_len = length[s];
+    if(length[s] < min_len) min_len = length[s];
+  }
+  if(max_len > 32) fail("Huffman code too long", "compress");
+
+  // Canonical code: longer codes have lower values, and symbols are renumbered so that each length's symbols
+  // are consecutive, starting from the longest.
+  int newnum[MAX_SYMBOLS], order[MAX_SYMBOLS], n = 0;
+  for(int len = max_len; len >= min_len; len--){
+    for(int s = 0; s < sym_count; s++) if(group[s] >= 0 && length[s] == len) order[n++] = s;
+  }
+  for(int s = 0; s < sym_count; s++) if(group[s] < 0) order[n++] = s;
+  for(int i = 0; i < sym_count; i++) newnum[order[i]] = i;
+  int lowest[64] = { 0 }, count_of[64] = { 0 };
+  uint64_t base[64];
+  for(int s = 0; s < sym_count; s++){
+    if(group[s] < 0) continue;
+    count_of[length[s]]++;
+    for(int len = min_len; len < length[s]; len++) lowest[len]++;
+  }
+  base[max_len] = 0;
+  for(int len = max_len - 1; len >= min_len; len--){
+    if((base[len+1] + count_of[len+1]) & 1) fail("invalid Huffman code", "compress");
+    base[len] = (base[len+1] + count_of[len+1]) >> 1;
+  }
+
+  BUFFER *sizes = &out->sizes;
+  put8(sizes, flags);
+  put8(sizes, BLOCK_LOG);
+  put8(sizes, SPAN_LOG);
+  put8(sizes, 0);
+  size_t num_blocks_at = sizes->len;
+  put32(sizes, 0);
+  put8(sizes, max_len);
+  put8(sizes, min_len);
+  for(int len = min_len; len <= max_len; len++) put16(sizes, lowest[len]);
+  put16(sizes, sym_count);
+  for(int i = 0; i < sym_count; i++){
+    int s = order[i];
+    int l = leaf[s] >= 0 ? leaf[s] : newnum[left[s]], r = leaf[s] >= 0 ? 0xFFF : newnum[right[s]];
+    put8(sizes, l & 0xFF);
+    put8(sizes, ((l >> 8) & 0xF) | ((r & 0xF) << 4));
+    put8(sizes, r >> 4);
+  }
+  if(sym_count & 1) put8(sizes, 0);
+
+  // Blocks.  Each holds at most 65536 values, less the slack needed by the last sparse index entry.
+  size_t block_size = (size_t)1 << BLOCK_LOG, span = (size_t)1 << SPAN_LOG;
+  uint64_t *starts = malloc((tok_count + 2) * sizeof(uint64_t));
+  uint32_t num_blocks = 0;
+  uint64_t values_in_block = 0, value_count = 0, bits = 0;
+  uint8_t *block = calloc(block_size, 1);
+  starts[0] = 0;
+  for(uint64_t i = 0; i <= tok_count; i++){
+    int s = i < tok_count ? tok[i] : -1;
+    if(s < 0 ? values_in_block > 0 : (bits + length[s] > block_size * 8 || values_in_block + symlen[s] > 65536 - span)){
+      for(size_t j = 0; j < block_size; j++) put8(&out->data, block[j]);
+      memset(block, 0, block_size);
+      put16(&out->block_length, (int)(values_in_block - 1));
+      starts[++num_blocks] = value_count;
+      values_in_block = bits = 0;
+    }
+    if(s < 0) break;
+    uint64_t code = base[length[s]] + newnum[s] - lowest[length[s]];
+    for(int b = length[s] - 1; b >= 0; b--, bits++){
+      if((code >> b) & 1) block[bits >> 3] |= 0x80 >> (bits & 7);
+    }
+    values_in_block += symlen[s];
+    value_count += symlen[s];
+  }
+  memcpy(sizes->data + num_blocks_at, &num_blocks, 4);
+
+  for(uint64_t k = 0, b = 0; k < (count + span - 1) / span; k++){
+    uint64_t idx = k * span + span / 2;
+    while(b + 1 < num_blocks && starts[b+1] <= idx) b++;
+    put32(&out->sparse_index, (uint32_t)b);
+    put16(&out->sparse_index, (int)(idx - starts[b]));
+  }
+  free(starts);
+  free(block);
+  free(tok);
+}
+
+
+// Table files
+
+typedef struct {
+  const char *name;
+  int pieces[MAX_PIECES];   // the order the file lists the pieces in, with the stronger side as white; chosen
+                            // by trying every order and keeping the smallest files
+  int dtz_side;             // the side to move stored by the DTZ table, or -1 if there is no DTZ table
+} FIXTURE;
+
+static const FIXTURE fixtures[] = {
+  { "KQvK",  { KING, QUEEN, KING + 8 }, 0 },
+  { "KRvK",  { KING, ROOK, KING + 8 }, 0 },
+  { "KBvK",  { KING, BISHOP, KING + 8 }, -1 },
+  { "KNvK",  { KING, KNIGHT, KING + 8 }, -1 },
+  { "KPvK",  { PAWN, KING, KING + 8 }, 0 },
+  { "KBNvK", { KING + 8, BISHOP, KING, KNIGHT }, 0 },
+  { "KQvKR", { KING, QUEEN, ROOK + 8, KING + 8 }, -1 },  // KRvKP promotes into these endings
+  { "KRvKR", { KING + 8, ROOK + 8, ROOK, KING }, -1 },
+  { "KRvKB", { BISHOP + 8, KING + 8, KING, ROOK }, -1 },
+  { "KRvKN", { KING + 8, KNIGHT + 8, ROOK, KING }, -1 },
+  { "KRvKP", { PAWN + 8, KING, KING + 8, ROOK }, 0 }
+};
+
+// Symmetric endings store only white to move in their WDL tables.
+static void write_table(const char *dir, const FIXTURE *fx, const ENCODING *e, int symmetric, int dtz, int flags,
+                        uint16_t *items[2][4]){
+  int files = e->has_pawns ? 4 : 1, sides = (dtz || symmetric) ? 1 : 2;
+  PACKED packed[2][4];
+  BUFFER out = { 0 };
+  for(int i = 0; i < 4; i++) put8(&out, (dtz ? dtz_magic : wdl_magic)[i]);
+  put8(&out, (symmetric ? 0 : 1) | (e->has_pawns ? 2 : 0));
+  for(int f = 0; f < files; f++){
+    put8(&out, 0);
+    for(int k = 0; k < e->n; k++) put8(&out, e->pieces[k] | (e->pieces[k] << 4));
+  }
+  align(&out, 2);
+  for(int f = 0; f < files; f++){
+    for(int i = 0; i < sides; i++){
+      compress(items[i][f], table_size(e, f), flags, &packed[i][f]);
+      for(size_t j = 0; j < packed[i][f].sizes.len; j++) put8(&out, packed[i][f].sizes.data[j]);
+    }
+  }
+  if(dtz) align(&out, 2);
+  for(int f = 0; f < files; f++){
+    for(int i = 0; i < sides; i++){
+      for(size_t j = 0; j < packed[i][f].sparse_index.len; j++) put8(&out, packed[i][f].sparse_index.data[j]);
+    }
+  }
+  for(int f = 0; f < files; f++){
+    for(int i = 0; i < sides; i++){
+      for(size_t j = 0; j < packed[i][f].block_length.len; j++) put8(&out, packed[i][f].block_length.data[j]);
+    }
+  }
+  for(int f = 0; f < files; f++){
+    for(int i = 0; i < sides; i++){
+      align(&out, 64);
+      for(size_t j = 0; j < packed[i][f].data.len; j++) put8(&out, packed[i][f].data.data[j]);
+      free(packed[i][f].sizes.data);
+      free(packed[i][f].sparse_index.data);
+      free(packed[i][f].block_length.data);
+      free(packed[i][f].data.data);
+    }
+  }
+  align(&out, 64);
+  for(int i = 0; i < 16; i++) put8(&out, 0);
+
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s.%s", dir, fx->name, dtz ? "rtbz" : "rtbw");
+  FILE *fp = fopen(path, "wb");
+  if(!fp || fwrite(out.data, 1, out.len, fp) != out.len) fail("can't write the table", path);
+  fclose(fp);
+  free(out.data);
+}
+
+// Table entries hold a value, FREE for a position the prober never reads, or AT_MOST plus a value for a position
+// whose value the prober finds by searching captures unless a greater value is stored.  Like the published tables,
+// these entries take whatever value keeps runs of equal values long.
+#define FREE 0xFFFF
+#define AT_MOST 0x8000
+
+static void set_entry(uint16_t *entry, uint16_t value, const char *name){
+  if(*entry != FREE && value != FREE && *entry != value) fail("positions share an index", name);
+  if(value != FREE) *entry = value;
+}
+
+static void fill_gaps(uint16_t *values, uint64_t count){
+  uint16_t last = FREE;
+  for(uint64_t i = 0; i < count && last == FREE; i++) if(values[i] != FREE) last = values[i] & ~AT_MOST;
+  if(last == FREE) last = 0;
+  for(uint64_t i = 0; i < count; i++){
+    if(values[i] == FREE) values[i] = last;
+    else if((values[i] & AT_MOST) && last <= (values[i] & ~AT_MOST)) values[i] = last;
+    else values[i] &= ~AT_MOST;
+    last = values[i];
+  }
+}
+
+static void write_fixture(const char *dir, const FIXTURE *fx){
+  static const int wdl_value[] = { 0, 4, 0, 2 }, parent_value[] = { 0, 0, 4, 2 };
+  TABLE *t = table_named(fx->name);
+  ENCODING e;
+  init_encoding(&e, fx->pieces, t->n);
+  int files = e.has_pawns ? 4 : 1;
+  uint16_t *wdl[2][4], *dtz[2][4];
+  for(int f = 0; f < files; f++){
+    for(int i = 0; i < 2; i++){
+      wdl[i][f] = malloc(table_size(&e, f) * sizeof(uint16_t));
+      dtz[i][f] = malloc(table_size(&e, f) * sizeof(uint16_t));
+      memset(wdl[i][f], 0xFF, table_size(&e, f) * sizeof(uint16_t));
+      memset(dtz[i][f], 0xFF, table_size(&e, f) * sizeof(uint16_t));
+    }
+  }
+  CHILD children[MAX_CHILDREN];
+  POS p;
+
+  // DTZ is stored in moves, which only gives odd numbers of plies, unless an even number is needed.
+  int dtz_flags = fx->dtz_side > 0 ? TB_STM : 0;
+  for(uint64_t idx = 0; idx < t->size; idx++){
+    if((int)(idx & 1) != fx->dtz_side || t->dtz[idx] & 1) continue;
+    if(t->val[idx] == WIN) dtz_flags |= TB_WIN_PLIES;
+    if(t->val[idx] == LOSS) dtz_flags |= TB_LOSS_PLIES;
+  }
+  for(uint64_t idx = 0; idx < t->size; idx++){
+    int v = t->val[idx], f;
+    if(v == INVALID) continue;
+    pos_from_index(t, idx, &p);
+    uint64_t i = encode(&e, &p, &f);
+
+    // The prober searches captures before reading a WDL table, and zeroing moves before reading a DTZ table.
+    int n = gen_children(&p, children), captures = 0, zeroing = 0, zeroing_win = 0, best_capture = -1;
+    for(int c = 0; c < n; c++){
+      if(!children[c].zeroing) continue;
+      POS *next = &children[c].next;
+      int value = parent_value[same_ending(t, next) ? t->val[pos_index(next)] : value_of(next)];
+      zeroing++;
+      zeroing_win |= value == wdl_value[WIN];
+      if(next->n < p.n){
+        captures++;
+        if(value > best_capture) best_capture = value;
+      }
+    }
+    if(n && captures == n) set_entry(&wdl[p.stm][f][i], FREE, fx->name);
+    else if(best_capture == wdl_value[v]) set_entry(&wdl[p.stm][f][i], AT_MOST | wdl_value[v], fx->name);
+    else set_entry(&wdl[p.stm][f][i], wdl_value[v], fx->name);
+
+    if(v == DRAW || p.stm != fx->dtz_side) continue;
+    if((v == WIN && zeroing_win) || (n && zeroing == n)) set_entry(&dtz[0][f][i], FREE, fx->name);
+    else if(dtz_flags & (v == WIN ? TB_WIN_PLIES : TB_LOSS_PLIES)) set_entry(&dtz[0][f][i], t->dtz[idx] - 1, fx->name);
+    else set_entry(&dtz[0][f][i], (t->dtz[idx] - 1) / 2, fx->name);
+  }
+  for(int f = 0; f < files; f++){
+    for(int i = 0; i < 2; i++){
+      fill_gaps(wdl[i][f], table_size(&e, f));
+      fill_gaps(dtz[i][f], table_size(&e, f));
+    }
+  }
+  pos_from_index(t, 0, &p);
+  int symmetric = !black_stronger(&p);
+  write_table(dir, fx, &e, symmetric, 0, 0, wdl);
+  if(fx->dtz_side >= 0) write_table(dir, fx, &e, symmetric, 1, dtz_flags, dtz);
+  for(int f = 0; f < files; f++){
+    for(int i = 0; i < 2; i++){
+      free(wdl[i][f]);
+      free(dtz[i][f]);
+    }
+  }
+  fprintf(stderr, "wrote %s\n", fx->name);
+}
+
+int main(int argc, char **argv){
+  if(argc != 2){
+    fprintf(stderr, "usage: %s <directory>\n", argv[0]);
+    return 1;
+  }
+  init_encoding_tables();
+  for(size_t i = 0; i < sizeof(fixtures) / sizeof(fixtures[0]); i++) write_fixture(argv[1], &fixtures[i]);
+  return 0;
+}
@@ -0,0 +1,71 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'spec_helper'
+require 'stringio'
+
+describe Chess::Match do
+
+  it "should estimate Elo differences from match results" do
+    Chess::Match::elo(10, 20, 10)[0].should be_within(1e-9).of(0.0)
+    Chess::Match::elo(30, 0, 10)[0].should be_within(0.01).of(190.85)
+    Chess::Match::elo(10, 0, 30)[0].should be_within(0.01).of(-190.85)
+    Chess::Match::elo(300, 0, 100)[1].should < Chess::Match::elo(30, 0, 10)[1]
+  end
+
+  it "should stop the SPRT once either hypothesis is accepted" do
+    sprt = Chess::Match::SPRT.new(0, 5, 0.05, 0.05)
+    sprt.upper_bound.should be_within(0.01).of(2.94)
+    sprt.lower_bound.should be_within(0.01).of(-2.94)
+    sprt.status(100, 200, 100).should == nil
+    sprt.llr(1000, 2000, 1000).should < 0
+    sprt.status(3000, 4000, 2000).should == :accept
+    sprt.status(2000, 4000, 3000).should == :reject
+  end
+
+  it "should parse time controls" do
+    Chess::Match::parse_time_control('10+0.1').should == [10000, 100]
+    Chess::Match::parse_time_control('60').should == [60000, 0]
+    Chess::Match::parse_time_control(nil).should == nil
+  end
+
+end
+
+describe Chess::UCI do
+
+  it "should convert moves to and from long algebraic notation" do
+    pos = Chess::UCI::parse_position(%w(startpos moves e2e4 e7e5 g1f3))
+    pos.side_to_move.should == :b
+    Chess::UCI::move_to_uci(Chess::UCI::uci_to_move(pos, 'b8c6')).should == 'b8c6'
+    Chess::UCI::uci_to_move(pos, 'e5e4').should == nil
+  end
+
+  it "should answer a search with a legal move" do
+    output = StringIO.new
+    Chess::UCI::run(StringIO.new("uci\nisready\nposition startpos moves e2e4\ngo depth 2\nquit\n"), output)
+    lines = output.string.lines.collect(&:strip)
+    lines.include?('uciok').should == true
+    lines.include?('readyok').should == true
+    move = lines.last.split[1]
+    Chess::UCI::uci_to_move(Chess::UCI::parse_position(%w(startpos moves e2e4)), move).nil?.should == false
+  end
+
+end
@@ -75,6 +75,31 @@ describe Chess::MoveGen do
 
   end
 
+  describe "attack maps" do
+    def attack_maps_match?(pos)
+      reference = Chess::Bitboard::PiecewiseBoard.new(pos.board)  # scans for attackers instead.
+      (0..63).all? { |sq| pos.pieces.attack_map(sq) == reference.attack_map(sq) }
+    end
+
+    it "should stay in step with the board as moves are made and unmade" do
+      File.readlines('./test_suites/wac_75.epd').first(10).each do |epd|
+        pos = Chess::Notation::epd_to_position(epd)
+        pos.pieces.attack_maps = true
+        pos.get_moves(0).each do |move|
+          Chess::MoveGen::make!(pos, move)
+          attack_maps_match?(pos).should == true
+          pos.get_moves(0).each do |reply|
+            Chess::MoveGen::make!(pos, reply)
+            attack_maps_match?(pos).should == true
+            Chess::MoveGen::unmake!(pos, reply)
+          end
+          Chess::MoveGen::unmake!(pos, move)
+        end
+        attack_maps_match?(pos).should == true
+      end
+    end
+  end
+
 end
 
 
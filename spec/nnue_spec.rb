@@ -0,0 +1,115 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+
+require 'spec_helper'
+require 'tmpdir'
+
+describe "NNUE evaluation" do
+
+  NNUE_FEN = "r3k2r/pppq1ppp/2np1n2/2b1p1B1/2B1P1b1/2NP1N2/PPPQ1PPP/R3K2R w KQkq - 0 1"
+
+  # Writes a network with the HalfKP 256x2-32-32 layout and small random weights.
+  def write_network(path, seed)
+    r = Random.new(seed)
+    small = lambda { |n| r.bytes(n).unpack('c*').map { |v| v >> 2 } }
+    File.open(path, 'wb') do |f|
+      f.write([0x7AF32F16, 0x3E5AA6EE, 4].pack('V3') + 'test')
+      f.write([0x5D69D7B8].pack('V') + small.call(256).pack('s<*') + r.bytes(41024*256).unpack('c*').pack('s<*'))
+      f.write([0x63337156].pack('V'))
+      [[32, 512], [32, 32], [1, 32]].each do |outputs, inputs|
+        f.write(small.call(outputs).map { |v| v << 8 }.pack('l<*') + r.bytes(outputs*inputs))
+      end
+    end
+  end
+
+  def evaluate(pos, refresh)
+    Chess::Evaluation::evaluate_network(pos.pieces, pos.side_to_move, refresh)
+  end
+
+  def legal_moves(pos)
+    in_check = pos.in_check?
+    pos.get_moves(0, false, in_check).select { |m| pos.avoids_check?(m, in_check) }
+  end
+
+  before(:all) do
+    @path = File.join(Dir.tmpdir, 'nnue_spec.nnue')
+    write_network(@path, 1)
+    pos = Chess::Notation::fen_to_position(NNUE_FEN)
+    @hand_crafted = Chess::Evaluation::net_placement(pos.pieces, pos.side_to_move)
+    Chess::Evaluation::load_network(@path)
+  end
+
+  after(:all) do
+    Chess::Evaluation::unload_network
+    File.delete(@path)
+  end
+
+  it "should reject files in other formats" do
+    bad_path = File.join(Dir.tmpdir, 'nnue_spec_bad.nnue')
+    File.open(bad_path, 'wb') { |f| f.write([0, 0, 0].pack('V3')) }
+    lambda { Chess::Evaluation::load_network(bad_path) }.should raise_error(ArgumentError)
+    File.delete(bad_path)
+    Chess::Evaluation::network_loaded?.should == true
+  end
+
+  it "should keep the accumulators in step with the board as moves are made and unmade" do
+    pos = Chess::Notation::fen_to_position(NNUE_FEN)
+    original = evaluate(pos, true)
+    legal_moves(pos).each do |move|  # includes castling and king moves, which refresh one perspective.
+      Chess::MoveGen::make!(pos, move)
+      incremental = evaluate(pos, false)
+      incremental.should == evaluate(pos, true)
+      legal_moves(pos).each do |reply|
+        Chess::MoveGen::make!(pos, reply)
+        evaluate(pos, false).should == evaluate(pos, true)
+        Chess::MoveGen::unmake!(pos, reply)
+      end
+      Chess::MoveGen::unmake!(pos, move)
+      evaluate(pos, false).should == original
+    end
+  end
+
+  it "should be used in place of the hand-crafted evaluation" do
+    pos = Chess::Notation::fen_to_position(NNUE_FEN)
+    Chess::Evaluation::net_placement(pos.pieces, pos.side_to_move).should == evaluate(pos, false)
+  end
+
+  it "should refresh accumulators built for another network" do
+    pos = Chess::Notation::fen_to_position(NNUE_FEN)
+    evaluate(pos, false)
+    other_path = File.join(Dir.tmpdir, 'nnue_spec_other.nnue')
+    write_network(other_path, 2)
+    Chess::Evaluation::load_network(other_path)
+    File.delete(other_path)
+    evaluate(pos, false).should == evaluate(pos, true)
+    Chess::Evaluation::load_network(@path)
+  end
+
+  it "should fall back to the hand-crafted evaluation when no network is loaded" do
+    pos = Chess::Notation::fen_to_position(NNUE_FEN)
+    Chess::Evaluation::unload_network
+    Chess::Evaluation::evaluate_network(pos.pieces, pos.side_to_move, true).should be_nil
+    Chess::Evaluation::net_placement(pos.pieces, pos.side_to_move).should == @hand_crafted
+    Chess::Evaluation::load_network(@path)
+  end
+
+end
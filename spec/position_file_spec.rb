@@ -0,0 +1,97 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'spec_helper'
+require 'tmpdir'
+
+describe Chess::PositionFile do
+
+  let(:path) { File.join(Dir.tmpdir, 'position_file_spec.bin') }
+  let(:positions) do
+    File.readlines('./test_suites/wac_75.epd').collect { |epd| Chess::Notation::epd_to_position(epd) }
+  end
+
+  after { File.delete(path) if File.exist?(path) }
+
+  def write_positions
+    Chess::PositionFile::Writer.open(path) do |w|
+      positions.each_with_index { |pos, i| w.write(pos, i - 30, i % 3) }
+    end
+  end
+
+  it "should store each position in a 32 byte record" do
+    write_positions
+    File.size(path).should == 8 + 32 * positions.count
+  end
+
+  it "should round trip positions with their scores and results" do
+    write_positions
+    Chess::PositionFile::Reader.open(path) do |r|
+      r.count.should == positions.count
+      r.each_with_index do |(pos, score, result), i|
+        pos.board.squares.should == positions[i].board.squares
+        pos.side_to_move.should == positions[i].side_to_move
+        pos.castle.should == positions[i].castle
+        pos.enp_target.should == positions[i].enp_target
+        pos.hash.should == positions[i].hash
+        score.should == i - 30
+        result.should == i % 3
+      end
+    end
+  end
+
+  it "should decode records straight into a native board" do
+    write_positions
+    board = Chess::Position.new.pieces
+    Chess::PositionFile::Reader.open(path) do |r|
+      r.count.times do |i|
+        r.load(i, board)
+        Chess::Evaluation::net_placement(board, :w).should == 
+          Chess::Evaluation::net_placement(positions[i].pieces, :w)
+      end
+    end
+  end
+
+  it "should decode batches into packed boards" do
+    write_positions
+    packed = positions.collect { |pos| Chess::Evaluation::pack_position(pos.pieces, pos.side_to_move) }.join
+    Chess::PositionFile::Reader.open(path) do |r|
+      boards, results = r.batch(0, r.count)
+      boards.should == packed
+      results.unpack('C*').should == positions.count.times.map { |i| i % 3 }
+    end
+  end
+
+  it "should reject files in other formats" do
+    File.binwrite(path, "\0" * 40)
+    lambda { Chess::PositionFile::Reader.new(path) }.should raise_error(ArgumentError)
+  end
+
+  it "should refuse to reopen a writer or reader that is already open" do
+    writer = Chess::PositionFile::Writer.new(path)
+    lambda { writer.send(:initialize, path) }.should raise_error(IOError)
+    writer.close
+    reader = Chess::PositionFile::Reader.new(path)
+    lambda { reader.send(:initialize, path) }.should raise_error(IOError)
+    reader.close
+  end
+
+end
@@ -48,6 +48,7 @@ describe Chess::Position do
     end
   end
 
+
   describe "move generation" do
     describe "generates a valid move list" do
       it "for all moves" do
@@ -69,10 +70,64 @@ describe Chess::Position do
 
 end
 
+describe Chess::Position, "repetition detection" do
+  let(:pos) { Chess::Notation::fen_to_position("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1") }
 
+  def make_moves(pos, moves)
+    moves.map do |str| 
+      move = Chess::Notation::str_to_move(pos, str)
+      Chess::MoveGen::make!(pos, move)
+      move
+    end
+  end
 
+  it "should detect a position repeated since the last irreversible move" do
+    make_moves(pos, %w{ g1f3 g8f6 f3g1 })
+    pos.repetition?.should == false
+    make_moves(pos, %w{ f6g8 })
+    pos.repetition?.should == true
+  end
 
+  it "should forget positions as moves are unmade" do
+    moves = make_moves(pos, %w{ g1f3 g8f6 f3g1 f6g8 })
+    Chess::MoveGen::unmake!(pos, moves.last)
+    pos.repetition?.should == false
+    pos.key_stack.count.should == 3
+  end
+end
 
+describe Chess::Position, "legality" do
+  let(:pos) { Chess::Notation::fen_to_position("4k3/8/8/b7/4r3/8/3PN3/4K3 w - - 0 1") }
 
+  it "should not let a pinned piece leave the line of the pin" do
+    moves = pos.get_moves(0, false, false).select { |m| pos.avoids_check?(m, false) }
+    moves.select { |m| m.from == Chess::Location::SQUARES[:e2] }.should be_empty
+    moves.select { |m| m.from == Chess::Location::SQUARES[:d2] }.should be_empty
+  end
 
+  it "should agree with a full check test for every pseudolegal move" do
+    pos.get_moves(0, false, false).each { |m| pos.avoids_check?(m, false).should == pos.legal?(m) }
+  end
 
+  it "should not allow an en-passant capture that uncovers a check along the rank" do
+    pos = Chess::Notation::fen_to_position("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 b - - 0 1")
+    Chess::MoveGen::make!(pos, Chess::Notation::str_to_move(pos, "c7c5"))
+    moves = pos.get_moves(0, false, false).select { |m| pos.avoids_check?(m, false) }
+    moves.select { |m| m.from == Chess::Location::SQUARES[:b5] }.collect(&:to).should == 
+      [Chess::Location::SQUARES[:b6]]
+  end
+end
+
+describe Chess::Position, "checking moves" do
+  it "should agree with making the move for direct, discovered and promotion checks" do
+    ["4k3/8/8/8/4N3/8/8/Q3RK2 w - - 0 1", "4k3/8/8/8/8/4B3/8/4R1K1 w - - 0 1",
+     "r7/1P6/2k5/8/8/8/8/4K3 w - - 0 1"].each do |fen|  # the last promotes with check through the pawn's square.
+      pos = Chess::Notation::fen_to_position(fen)
+      pos.get_moves(0).each do |move|
+        next unless pos.avoids_check?(move, false)
+        expected = (Chess::MoveGen::make!(pos, move); checked = pos.in_check?; Chess::MoveGen::unmake!(pos, move); checked)
+        pos.gives_check?(move).should == expected
+      end
+    end
+  end
+end
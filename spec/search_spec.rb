@@ -65,11 +65,35 @@ describe Chess::Search do
   #   end
   # end
 
+  describe "mate search" do
+    MATE_TESTS = {
+      "rn2r2k/8/p1p1P1Qp/2q5/5P1P/4NNP1/8/R1B2RK1 w - - 0 1" => "b2",
+      "r1b1kb1r/pppp1ppp/5q2/4n3/3KP3/2N3PN/PPP4P/R1BQ1B1R b kq - 0 1" => "c5",
+      "3r3k/3r1P1p/pp1Nn3/2pp4/7Q/6R1/Pq4PP/5RK1 w - - 0 1" => "d8"
+    }
+
+    MATE_TESTS.each do |fen, target|
+      it "should prove forced mates" do
+        pos = Chess::Notation::fen_to_position(fen)
+        line = @s::mate_search(pos)
+        Chess::Location::sq_to_s(line.first.to).should == target
+        line.each { |move| Chess::MoveGen::make!(pos, move) }
+        pos.in_check?.should == true
+        pos.get_moves(0, false, true).select { |m| pos.avoids_check?(m, true) }.should == []
+      end
+    end
+
+    it "should return nil when no mate is proven" do
+      pos = Chess::Notation::fen_to_position("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1")
+      @s::mate_search(pos, 10000).should == nil
+    end
+  end
+
   describe "playing strength" do
-    let(:problems) { load_test_suite('./test_suites/wac_300.epd') }
+    let(:suite) { load_test_suite('./test_suites/wac_300.epd') }
     
     it "should be able to take standardized tests" do
-      take_test(problems, @depth, false)
+      take_test(suite, @depth, false)
     end
 
     # it "should search more accurately at depth d+1" do 
@@ -0,0 +1,96 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'spec_helper'
+require 'tmpdir'
+
+describe Chess::SelfPlay do
+
+  let(:path) { File.join(Dir.tmpdir, 'self_play_spec.bin') }
+
+  after { File.delete(path) if File.exist?(path) }
+
+  def perft(fen, depth)
+    pos = Chess::Notation::fen_to_position(fen)
+    Chess::SelfPlay::perft(pos.pieces, pos.side_to_move, pos.castle, pos.enp_target, depth)
+  end
+
+  it "should generate legal moves" do
+    perft("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4).should == 197281
+    perft("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 3).should == 97862
+    perft("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 4).should == 43238
+    perft("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 3).should == 9467
+  end
+
+  # MoveGen only generates queen and knight promotions, so positions are compared at depths where no pawn can 
+  # promote.  The published counts above cover the other promotions.
+  def move_gen_perft(pos, depth)
+    in_check = pos.in_check?
+    moves = pos.get_moves(0, false, in_check).select { |m| pos.avoids_check?(m, in_check) }
+    return moves.count if depth == 1
+    moves.inject(0) do |count, move|
+      Chess::MoveGen::make!(pos, move)
+      count += move_gen_perft(pos, depth - 1)
+      Chess::MoveGen::unmake!(pos, move)
+      count
+    end
+  end
+
+  it "should generate the same moves as the engine" do
+    { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1" => 3,
+      "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1" => 2,
+      "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1" => 4,
+      "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10" => 2 }.each do |fen, depth|
+      perft(fen, depth).should == move_gen_perft(Chess::Notation::fen_to_position(fen), depth)
+    end
+  end
+
+  it "should take en-passant squares in the engine's convention" do
+    pos = Chess::Notation::fen_to_position("rnbqkbnr/ppp1pppp/8/8/3p4/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1")
+    Chess::MoveGen::make!(pos, Chess::Notation::str_to_move(pos, "e2e4"))
+    pos.enp_target.should == Chess::Location::SQUARES[:e4]
+    Chess::SelfPlay::perft(pos.pieces, pos.side_to_move, pos.castle, pos.enp_target, 3).should == 
+      move_gen_perft(pos, 3)
+  end
+
+  it "should write each quiet position with its score and the game result" do
+    stats = Chess::SelfPlay.generate(path, 4, nodes: 500, threads: 2, seed: 1, verbose: false)
+    (stats[:white_wins] + stats[:draws] + stats[:black_wins]).should == 4
+    Chess::PositionFile::Reader.open(path) do |r|
+      r.count.should == stats[:positions]
+      r.count.should > 0
+      r.each do |pos, score, result|
+        pos.in_check?.should == false
+        score.abs.should < 31000
+        [0, 1, 2].include?(result).should == true
+      end
+    end
+  end
+
+  it "should play the same games for a given seed on any number of threads" do
+    records = [1, 3].collect do |threads|
+      Chess::SelfPlay.generate(path, 3, nodes: 500, threads: threads, seed: 2, verbose: false)
+      File.binread(path)[8..-1].scan(/.{32}/m).sort
+    end
+    records.first.should == records.last
+  end
+
+end
@@ -98,115 +98,30 @@ def test_evasions_for_each(file, depth)
   end
 end
 
-ChessProblem = Struct.new(:id, :position, :best_moves, :avoid_moves, :ai_response, :score)
-
 def load_test_suite(file)
-  raise "test suite #{file} not found" unless File.exists?(file)
-  problems = []
-  File.readlines(file).each do |line|
-    line = %Q{#{line}}
-
-    pos = Chess::Notation::epd_to_position(line)
-    best_moves = best_moves_from_epd(line)
-    avoid_moves = avoid_moves_from_epd(line)
-    id = id_from_epd(line)
-    problems << ChessProblem.new(id, pos, best_moves, avoid_moves)
-  end
-  return problems
+  Chess::Analytics::TestSuite.new(file)
 end
 
-def id_from_epd(epd)
-  return epd[epd.index('id')+4..epd.index(';',epd.index('id')+4)-2]
-end
-
-def best_moves_from_epd(epd)
-  return [] if epd.index('bm').nil?
-  epd[epd.index('bm')+3..epd.index(';')-1].split(' ') # scan string for "bm <move>;"
-end
-
-def avoid_moves_from_epd(epd)
-  return [] if epd.index('am').nil?
-  epd[epd.index('am')+3..epd.index(';')-1].split(' ') # scan string for "am <move>;"
-end
-
-def take_test(problems, depth, verbose=false)
-  aggregator = Chess::Analytics::Aggregator.new(depth)
-  
-  t0 = Time.now
-  puts t0
-  answer_questions(problems, depth, aggregator, verbose)
-  time = Time.now - t0
+# Problems are solved in parallel by a pool of worker processes, each with its own search tables.
+def take_test(suite, depth, verbose=false, workers=Etc.nprocessors)
+  puts Time.now
+  suite.run(depth, workers, verbose)
+  problems, time = suite.problems, suite.time
 
   if verbose
     puts "\n"
     tp problems, :id, :best_moves, :avoid_moves, :ai_response, :score
   end
-  total_right = problems.inject(0) { |memo, prob| memo += score_question(prob) }
+  total_right = suite.correct
   count =  problems.count
-  accuracy = ((total_right+0.0)/count)*100
-  aggregator.print
+  accuracy = suite.accuracy
+  suite.aggregator.print
   puts "\nTotal AI score: #{total_right}/#{count} (#{accuracy}%)"
   puts "#{time/count} seconds/search at depth #{depth}"
-  puts aggregator.print_summary(accuracy, time)
+  puts suite.aggregator.print_summary(accuracy, time)
   return total_right
 end
 
-def answer_questions(problems, depth, aggregator, verbose=false)
-  correct, total = 0, 0
-  
-  # debug  # uncomment this line to dump full stack trace to './trace.txt'. Execution will slow significantly.
-
-  # profile do
-    problems.each_with_index do |prob, i|
-      begin
-        move, value = Chess::Search::select_move(prob.position, depth, aggregator, verbose)
-      rescue SystemStackError
-        count_objects
-        raise
-      end
-      prob.ai_response = move
-      prob.score = score_question(prob)
-      correct += prob.score
-      total += 1
-      if verbose
-        puts prob.id
-        puts "Best: #{prob.best_moves} Avoid: #{prob.avoid_moves} AI Answer: #{prob.ai_response}"
-        puts "Running score: #{correct}/#{total} (#{(correct+0.0)/total*100}%)"
-      else
-        number = (i+1).to_s.rjust(3," ")
-        number = prob.score > 0 ? Chess::colorize(number,32) : Chess::colorize(number,31)
-        print "| #{number} "
-      end
-    end
-  # end
-
-end 
-
-
-
-def score_question(problem) # answer is considered correct if it matches any answer in
-                            # best_moves, and does not match any answer in avoid_moves.
-  problem.best_moves.each { |pgn| return 1 if move_matches_pgn?(problem.ai_response, pgn) }
-  problem.avoid_moves.each { |pgn| return 0 if move_matches_pgn?(problem.ai_response, pgn) }
-  return problem.best_moves.empty? ? 1 : 0
-end
-
-def move_matches_pgn?(move, pgn)
-  
-  return false if move.nil?
-  
-  type, to = Chess::Pieces::PIECE_TYPES[(move.piece>>1)&7].to_s , Chess::Location::sq_to_s(move.to)
-  
-  if pgn.length == 2
-    return pgn == to
-  elsif pgn[-1] == "+"
-    new_pgn = pgn.slice(0..-2)
-    return new_pgn[0] == type && new_pgn[-2..-1] == to  # this should also test whether the correct piece is moving.
-  else
-    return pgn[0] == type && pgn[-2..-1] == to
-  end
-end
-
 
 def debug
   $enable_tracing = false
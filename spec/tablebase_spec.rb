@@ -0,0 +1,101 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+require 'spec_helper'
+
+# The fixture tables are written by spec/fixtures/syzygy/generate.c, which solves each ending and stores the results 
+# in the Syzygy file format.
+describe Chess::Tablebase do
+
+  before(:all) { Chess::Tablebase::init('./spec/fixtures/syzygy') }
+  after(:all) { Chess::Tablebase::init(nil) }
+
+  def probe_dtz(pos)
+    Chess::Tablebase::probe_dtz(pos.pieces, pos.side_to_move, pos.enp_target)
+  end
+
+  it "should register the tables found in the fixture directory" do
+    Chess::Tablebase::enabled?.should == true
+    Chess::Tablebase::max_pieces.should == 4
+  end
+
+  describe "WDL probing" do
+    WDL_TESTS = { 
+      "4k3/8/8/8/8/8/8/3QK3 w - - 0 1" => 2,   # KQvK, stronger side to move
+      "4k3/8/8/8/8/8/8/3QK3 b - - 0 1" => -2,  # KQvK, weaker side to move
+      "3qk3/8/8/8/8/8/8/4K3 w - - 0 1" => -2,  # black is the stronger side
+      "4k3/8/4K3/4P3/8/8/8/8 w - - 0 1" => 2,
+      "4k3/4P3/4K3/8/8/8/8/8 b - - 0 1" => 0,  # stalemate
+      "4k3/8/8/8/8/8/8/3NK3 w - - 0 1" => 0,
+      "7k/8/6KN/8/7B/8/8/8 w - - 0 1" => 2,    # KBNvK, Bf6 mates
+      "4k3/8/8/8/8/8/p7/R3K3 b - - 0 1" => -2, # KRvKP
+      "r3k3/P7/8/8/8/8/8/4K3 w - - 0 1" => -2  # KRvKP with colors reversed
+    }
+    WDL_TESTS.each do |fen, wdl|
+      it "should find the value of #{fen}" do
+        Chess::Tablebase::wdl(Chess::Notation::fen_to_position(fen)).should == wdl
+      end
+    end
+
+    it "should not probe positions with more pieces than the largest table" do
+      pos = Chess::Notation::fen_to_position("4k3/8/8/8/8/8/2PPP3/4K3 w - - 0 1")
+      Chess::Tablebase::wdl(pos).should be_nil
+    end
+  end
+
+  describe "DTZ probing" do
+    it "should count plies to the next pawn move" do
+      probe_dtz(Chess::Notation::fen_to_position("4k3/8/4K3/4P3/8/8/8/8 w - - 0 1")).should == 3
+      probe_dtz(Chess::Notation::fen_to_position("4k3/8/4K3/4P3/8/8/8/8 b - - 0 1")).should == -4
+    end
+
+    it "should choose root moves that preserve the win" do
+      pos = Chess::Notation::fen_to_position("4k3/8/8/8/8/8/8/3QK3 w - - 0 1")
+      move, value = Chess::Tablebase::select_move(pos)
+      value.should > 0
+      Chess::MoveGen::make!(pos, move)
+      Chess::Tablebase::wdl(pos).should == -2
+    end
+  end
+
+  # These values can be worked out over the board, so they hold for the published tables too.  The 4-piece examples 
+  # cover the prober's encoding of pawnful tables (KRvKP) and of three unique pieces (KBNvK).
+  describe "4-piece tables" do
+    FOUR_PIECE_TESTS = {
+      "7k/8/6KN/8/7B/8/8/8 w - - 0 1" => [2, 1],     # KBNvK, Bf6 mates
+      "7k/8/5BKN/8/8/8/8/8 b - - 0 1" => [-2, -1],   # KBNvK, black is mated
+      "8/8/8/8/8/5k2/6B1/K6N b - - 0 1" => [0, 0],   # KBNvK, the king takes the bishop
+      "4k3/8/8/8/8/8/p7/R3K3 w - - 0 1" => [2, 1],   # KRvKP, the rook takes the pawn
+      "7K/8/8/8/8/8/1pk5/7R b - - 0 1" => [0, 0],    # KRvKP, the pawn queens and is traded for the rook
+      "8/8/8/8/8/8/1p6/R1k1K3 b - - 0 1" => [2, 1],  # KRvKP, the pawn takes the rook and queens
+      "1K4r1/4P3/1k6/8/8/8/8/8 w - - 0 1" => [-2, -1]  # KRvKP reversed, every promotion loses the new piece
+    }
+
+    FOUR_PIECE_TESTS.each do |fen, (wdl, dtz)|
+      it "should find the value of #{fen}" do
+        pos = Chess::Notation::fen_to_position(fen)
+        Chess::Tablebase::wdl(pos).should == wdl
+        probe_dtz(pos).should == dtz
+      end
+    end
+  end
+
+end
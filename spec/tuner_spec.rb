@@ -0,0 +1,76 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+
+require 'spec_helper'
+require 'tmpdir'
+
+describe Chess::Tuner do
+
+  # Labels each position by the sign of its eval, so that the results are reasonably well predicted.
+  let(:positions) do
+    File.readlines('./test_suites/wac_75.epd').collect { |epd| Chess::Notation::epd_to_position(epd) }
+  end
+  let(:results) do
+    positions.collect { |pos| Chess::Evaluation::net_placement(pos.pieces, :w) > 0 ? 2 : 0 }
+  end
+  let(:dataset) do 
+    packed = positions.collect { |pos| Chess::Evaluation::pack_position(pos.pieces, pos.side_to_move) }.join
+    Chess::Tuner::Dataset.new(packed, results.pack('C*'), 2)
+  end
+
+  def error(k)
+    positions.zip(results).inject(0.0) do |sum, (pos, result)|
+      sigmoid = 1.0 / (1.0 + 10**(-k * Chess::Evaluation::net_placement(pos.pieces, :w) / 400.0))
+      sum + (result / 2.0 - sigmoid)**2
+    end / positions.count
+  end
+
+  it "should reproduce the static eval of each position from its features" do
+    dataset.size.should == positions.count
+    dataset.error(1.0).should be_within(1e-9).of(error(1.0))
+  end
+
+  it "should reduce the error when tuning" do
+    k = dataset.fit_scale
+    initial_error = dataset.error(k)
+    dataset.tune(k, 50, 1.0).should < initial_error
+  end
+
+  it "should save and load packed datasets" do
+    path = File.join(Dir.tmpdir, 'tuner_spec.bin')
+    tuner = Chess::Tuner.new(1)
+    positions.zip(results).each { |pos, result| tuner.add(pos, result) }
+    tuner.save_packed(path)
+    Chess::Tuner.new(1).load_packed(path).size.should == positions.count
+    File.delete(path)
+  end
+
+  it "should write the parameters as C source" do
+    path = File.join(Dir.tmpdir, 'tuner_spec.c')
+    Chess::Evaluation::write_params(path)
+    source = File.read(path)
+    source.should =~ /EVAL_PARAMS eval_params = \{/
+    source.should =~ /\.isolated_pawn_penalty = -5,/
+    File.delete(path)
+  end
+
+end
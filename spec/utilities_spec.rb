@@ -29,6 +29,26 @@ describe Chess::Notation do
     end
   end
 
+  describe 'when translating standard algebraic notation' do
+    let(:pos) { Chess::Notation::fen_to_position("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1") }
+
+    it 'should disambiguate moves by file and rank' do
+      move = Chess::Notation::san_to_move(pos, 'Nxd7')
+      [move.from, move.to].should == [Chess::Location::SQUARES[:e5], Chess::Location::SQUARES[:d7]]
+      move = Chess::Notation::san_to_move(pos, 'Rb1')
+      move.from.should == Chess::Location::SQUARES[:a1]
+    end
+
+    it 'should translate castling and ignore check and annotation marks' do
+      Chess::Notation::san_to_move(pos, 'O-O-O').to.should == Chess::Location::SQUARES[:c1]
+      Chess::Notation::san_to_move(pos, 'Qxf6!?').to.should == Chess::Location::SQUARES[:f6]
+    end
+
+    it 'should reject illegal moves' do
+      lambda { Chess::Notation::san_to_move(pos, 'Ke3') }.should raise_error(Chess::Notation::InvalidMoveError)
+    end
+  end
+
   describe 'when translating long algebraic chess notation' do
     pending '' do
 
@@ -0,0 +1,36 @@
+#-----------------------------------------------------------------------------------
+# Copyright (c) 2013 Stephen J. Lovell
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#-----------------------------------------------------------------------------------
+
+# Runs the engine as a UCI engine on stdin/stdout (see lib/uci.rb):
+#
+#   ruby uci.rb
+#
+# If CHESS_LIBRARY is set, that build of the native extension (a ruby_chess shared library) is loaded in place of
+# the one in ext/.  The match runner uses this to play different builds against each other.
+
+Dir.chdir(File.dirname(File.expand_path(__FILE__)))
+if ENV['CHESS_LIBRARY']
+  require File.expand_path(ENV['CHESS_LIBRARY'])
+  $LOADED_FEATURES << File.expand_path("./ext/ruby_chess.#{RbConfig::CONFIG['DLEXT']}")
+end
+require './initialize.rb'
+
+Chess::UCI::run